@@ -0,0 +1,269 @@
+// Benchmark.cpp : Times the performance critical processors of BasicRecon and GrappaRecon.
+//
+// Usage: Benchmark [name ...], e.g. "Benchmark Fft2D Grappa". All benchmarks are run if no
+// name is given. Plug-ins are loaded from the working directory.
+
+#include "stdafx.h"
+
+#include "Yap/PipelineCompiler.h"
+#include "Implement/CompositeProcessor.h"
+#include "Implement/DataObject.h"
+#include "Implement/VariableSpace.h"
+#include "BasicRecon/FftShift.h"
+
+#include <chrono>
+#include <complex>
+#include <cstring>
+#include <functional>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+using namespace Yap;
+
+namespace
+{
+	/// Creates the input of a run. Every run gets fresh data, since processors may modify
+	/// their input in place or reuse results computed from the same data.
+	typedef function<SmartPtr<IData>(unsigned int run)> InputFactory;
+
+	struct Timing
+	{
+		double first;		///< Time of the first run, which includes planning, in ms.
+		double average;		///< Average time of the other runs, in ms.
+	};
+
+	/// Feed repeat + 1 inputs to the pipeline. Creating the inputs is not timed.
+	Timing Measure(CompositeProcessor * pipeline, const InputFactory& create_input, unsigned int repeat)
+	{
+		Timing timing{ 0.0, 0.0 };
+		for (unsigned int run = 0; run <= repeat; ++run)
+		{
+			auto input = create_input(run);
+
+			auto start = chrono::steady_clock::now();
+			pipeline->Input(L"Input", input.get());
+			auto time = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+			if (run == 0)
+			{
+				timing.first = time;
+			}
+			else
+			{
+				timing.average += time / repeat;
+			}
+		}
+
+		return timing;
+	}
+
+	/// Time a function called repeatedly on the same buffer, after one untimed call.
+	double Measure(const function<void()>& pass, unsigned int repeat)
+	{
+		pass();
+
+		auto start = chrono::steady_clock::now();
+		for (unsigned int i = 0; i < repeat; ++i)
+		{
+			pass();
+		}
+
+		return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count() / repeat;
+	}
+
+	/// Pseudo random k-space data, different for each seed. Lines for which sampled()
+	/// returns false are zero.
+	SmartPtr<IData> CreateKSpace(Dimensions& dimensions, unsigned int seed,
+		const function<bool(unsigned int line)>& sampled = nullptr)
+	{
+		auto data = DataObject<complex<float>>::Create(nullptr, &dimensions);
+		auto width = dimensions.GetLength(0);
+		auto size = width;
+		for (unsigned int i = 1; i < dimensions.GetDimensionCount(); ++i)
+		{
+			size *= dimensions.GetLength(i);
+		}
+
+		auto data_array = data->GetData();
+		unsigned int state = seed * 2654435761u + 1;
+		for (unsigned int i = 0; i < size; ++i)
+		{
+			state = state * 1664525u + 1013904223u;
+			data_array[i] = (!sampled || sampled((i / width) % dimensions.GetLength(1))) ?
+				complex<float>(float(state >> 16) / 65536.0f, float(state & 0xffff) / 65536.0f) : 0.0f;
+		}
+
+		VariableSpace variables;
+		data->SetVariables(variables.Variables());
+
+		return SmartPtr<IData>(data);
+	}
+
+	/// Compare transforming the slices one by one with the batched transform of Fft2D.
+	void Fft2DBenchmark()
+	{
+		const unsigned int width = 256, height = 256, slice_count = 64, repeat = 20;
+
+		PipelineCompiler compiler;
+		auto per_slice = compiler.Compile(
+			L"import \"BasicRecon.dll\";"
+			L"SliceIterator slice_iterator;"
+			L"Fft2D fft;"
+			L"slice_iterator->fft;"
+			L"self.Input->slice_iterator.Input;");
+		auto batched = compiler.Compile(
+			L"import \"BasicRecon.dll\";"
+			L"Fft2D fft;"
+			L"self.Input->fft.Input;");
+		if (!per_slice || !batched)
+			return;
+
+		Dimensions dimensions;
+		dimensions(DimensionReadout, 0, width)
+			(DimensionPhaseEncoding, 0, height)
+			(DimensionSlice, 0, slice_count);
+		auto create_input = [&](unsigned int run) { return CreateKSpace(dimensions, run); };
+
+		auto per_slice_time = Measure(per_slice.get(), create_input, repeat);
+		auto batched_time = Measure(batched.get(), create_input, repeat);
+
+		wcout << L"Fft2D " << width << L"x" << height << L"x" << slice_count
+			<< L", per slice: " << per_slice_time.average << L" ms (first " << per_slice_time.first
+			<< L" ms), batched: " << batched_time.average << L" ms (first " << batched_time.first
+			<< L" ms)" << endl;
+	}
+
+	/// Compare separate normalization and shift passes with the fused pass used by the FFT processors.
+	void FftShiftBenchmark()
+	{
+		const vector<int> sizes{ 64, 255, 256 };
+		const unsigned int repeat = 20;
+		const float scale = 1.0f / 256.0f;
+
+		vector<complex<float>> data(FftShift::GetElementCount(sizes), complex<float>(1.0f, 2.0f));
+
+		auto separate_time = Measure([&]() {
+			for (auto& element : data)
+			{
+				element *= scale;
+			}
+			FftShift::Shift(data.data(), sizes, 1.0f);
+		}, repeat);
+		auto fused_time = Measure([&]() { FftShift::Shift(data.data(), sizes, scale); }, repeat);
+
+		const vector<int> even_sizes{ 64, 256, 256 };
+		data.resize(FftShift::GetElementCount(even_sizes));
+		auto modulate_time = Measure([&]() {
+			FftShift::Modulate(data.data(), data.data(), even_sizes, scale);
+		}, repeat);
+
+		wcout << L"Shift 64x255x256, separate: " << separate_time << L" ms, fused: " << fused_time
+			<< L" ms; modulate 64x256x256: " << modulate_time << L" ms" << endl;
+	}
+
+	/// Compare ZeroFilling followed by Fft2D with the fused ZeroFilledFft2D.
+	void ZeroFilledFft2DBenchmark()
+	{
+		const unsigned int width = 256, height = 128, dest_size = 512, repeat = 20;
+
+		PipelineCompiler compiler;
+		auto separate = compiler.Compile(
+			L"import \"BasicRecon.dll\";"
+			L"ZeroFilling zero_filling(DestWidth = 512, DestHeight = 512);"
+			L"Fft2D fft;"
+			L"zero_filling->fft;"
+			L"self.Input->zero_filling.Input;");
+		auto fused = compiler.Compile(
+			L"import \"BasicRecon.dll\";"
+			L"ZeroFilledFft2D fft(DestWidth = 512, DestHeight = 512);"
+			L"self.Input->fft.Input;");
+		if (!separate || !fused)
+			return;
+
+		Dimensions dimensions;
+		dimensions(DimensionReadout, 0, width)
+			(DimensionPhaseEncoding, 0, height);
+		auto create_input = [&](unsigned int run) { return CreateKSpace(dimensions, run); };
+
+		auto separate_time = Measure(separate.get(), create_input, repeat);
+		auto fused_time = Measure(fused.get(), create_input, repeat);
+
+		wcout << L"Zero filling " << width << L"x" << height << L" to " << dest_size << L"x" << dest_size
+			<< L", separate: " << separate_time.average << L" ms, fused: " << fused_time.average
+			<< L" ms" << endl;
+	}
+
+	/// Time GRAPPA reconstruction of 32-channel data, R = 2.
+	/**
+		Grappa caches the weights fitted to the calibration lines. The cold runs get different
+		data each time, so every run fits the weights, the cached runs repeat the same data.
+	*/
+	void GrappaBenchmark()
+	{
+		const unsigned int width = 256, height = 256, channel_count = 32, repeat = 5;
+		const unsigned int rate = 2, acs_count = 32;	// As in the pipeline below.
+
+		PipelineCompiler compiler;
+		auto pipeline = compiler.Compile(
+			L"import \"GrappaRecon.dll\";"
+			L"Grappa grappa(Rate = 2, AcsCount = 32, Block = 4);"
+			L"self.Input->grappa.Input;");
+		if (!pipeline)
+			return;
+
+		Dimensions dimensions;
+		dimensions(DimensionReadout, 0, width)
+			(DimensionPhaseEncoding, 0, height)
+			(DimensionChannel, 0, channel_count);
+
+		// Every rate-th line is acquired, and the central acs_count lines the weights are fitted
+		// to, starting where Grappa looks for them.
+		auto first_acs = (height - acs_count) / (2 * rate) * rate + 1;
+		auto sampled = [=](unsigned int line) {
+			return line % rate == 0 || (line >= first_acs && line < first_acs + acs_count);
+		};
+
+		auto cold = Measure(pipeline.get(), [&](unsigned int run) {
+			return CreateKSpace(dimensions, run, sampled);
+		}, repeat);
+		auto cached = Measure(pipeline.get(), [&](unsigned int) {
+			return CreateKSpace(dimensions, repeat + 1, sampled);
+		}, repeat);
+
+		wcout << L"Grappa " << width << L"x" << height << L"x" << channel_count
+			<< L", fit: " << cold.average << L" ms, cached weights: " << cached.average << L" ms" << endl;
+	}
+
+	struct Benchmark
+	{
+		const char * name;
+		void(*run)();
+	};
+
+	const Benchmark benchmarks[] = {
+		{ "Fft2D", Fft2DBenchmark },
+		{ "FftShift", FftShiftBenchmark },
+		{ "ZeroFilledFft2D", ZeroFilledFft2DBenchmark },
+		{ "Grappa", GrappaBenchmark },
+	};
+}
+
+int main(int argc, char * argv[])
+{
+	for (auto& benchmark : benchmarks)
+	{
+		bool selected = (argc == 1);
+		for (int i = 1; i < argc && !selected; ++i)
+		{
+			selected = (_stricmp(argv[i], benchmark.name) == 0);
+		}
+
+		if (selected)
+		{
+			benchmark.run();
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,104 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "Implement/BufferPool.h"
+#include "Implement/DataObject.h"
+
+#include <complex>
+#include <cstdint>
+#include <future>
+#include <thread>
+#include <vector>
+
+using namespace Yap;
+
+BOOST_AUTO_TEST_CASE(buffer_pool_alignment_and_capacity)
+{
+	auto& pool = BufferPool::GetInstance();
+	for (size_t size : { 1, 256, 257, 1000, 4096, 5000, 1 << 20 })
+	{
+		auto buffer = pool.Allocate(size);
+		BOOST_CHECK(reinterpret_cast<uintptr_t>(buffer) % BufferPool::Alignment == 0);
+		BOOST_CHECK(BufferPool::GetCapacity(buffer) >= size);
+		pool.Free(buffer);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(buffer_pool_reuses_freed_buffers)
+{
+	auto& pool = BufferPool::GetInstance();
+	auto buffer = pool.Allocate(10000);
+	pool.Free(buffer);
+
+	// Same size class, served from the thread cache.
+	auto reused = pool.Allocate(9000);
+	BOOST_CHECK(reused == buffer);
+	pool.Free(reused);
+}
+
+BOOST_AUTO_TEST_CASE(data_object_uses_pooled_buffers)
+{
+	Dimensions dimensions;
+	dimensions(DimensionReadout, 0, 256)(DimensionPhaseEncoding, 0, 256);
+
+	auto first = ComplexFloatData::Create(nullptr, &dimensions);
+	BOOST_REQUIRE(first);
+	auto data = first->GetData();
+	BOOST_CHECK(reinterpret_cast<uintptr_t>(data) % BufferPool::Alignment == 0);
+	BOOST_CHECK(data[0] == std::complex<float>(0.0f, 0.0f));
+	first.reset();
+
+	auto second = ComplexFloatData::Create(nullptr, &dimensions);
+	BOOST_REQUIRE(second);
+	BOOST_CHECK(second->GetData() == data);
+	BOOST_CHECK(second->GetData()[0] == std::complex<float>(0.0f, 0.0f));
+}
+
+BOOST_AUTO_TEST_CASE(buffer_pool_limit_includes_thread_caches)
+{
+	auto& pool = BufferPool::GetInstance();
+	pool.Trim();
+	pool.SetCacheLimit(64 * 1024);
+
+	std::vector<void*> buffers;
+	for (size_t size = 1000; size < 40000; size += 3000)
+	{
+		buffers.push_back(pool.Allocate(size));
+	}
+	for (auto buffer : buffers)
+	{
+		pool.Free(buffer);
+	}
+
+	// A thread cache holds at most an eighth of the limit.
+	auto statistics = pool.GetStatistics();
+	BOOST_CHECK(statistics.thread_cached_bytes > 0);
+	BOOST_CHECK(statistics.thread_cached_bytes <= 8 * 1024);
+	BOOST_CHECK(statistics.cached_bytes + statistics.thread_cached_bytes <= 64 * 1024);
+
+	pool.SetCacheLimit(512 * 1024 * 1024);
+}
+
+BOOST_AUTO_TEST_CASE(buffer_pool_trim_empties_thread_caches)
+{
+	auto& pool = BufferPool::GetInstance();
+	pool.Trim();
+
+	// The buffer stays in the cache of a thread which is idle while the pool is trimmed.
+	std::promise<void> cached, trimmed;
+	std::thread idle([&]() {
+		pool.Free(pool.Allocate(10000));
+		cached.set_value();
+		trimmed.get_future().wait();
+	});
+	cached.get_future().wait();
+	BOOST_CHECK(pool.GetStatistics().thread_cached_bytes > 0);
+
+	pool.Trim();
+	BOOST_CHECK_EQUAL(pool.GetStatistics().thread_cached_bytes, 0u);
+	BOOST_CHECK_EQUAL(pool.GetStatistics().cached_bytes, 0u);
+
+	trimmed.set_value();
+	idle.join();
+}
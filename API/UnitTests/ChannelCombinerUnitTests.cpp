@@ -0,0 +1,211 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "BasicRecon/ChannelCombiner.h"
+#include "TestProcessors.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <random>
+#include <vector>
+
+using namespace Yap;
+using namespace Yap::Test;
+using namespace std;
+
+namespace
+{
+	/// Combined images have no channel dimension.
+	void CheckChannelsRemoved(Sink<float>& sink)
+	{
+		for (size_t i = 0; i < sink.received.size(); ++i)
+		{
+			BOOST_CHECK_EQUAL(sink.GetDimension(i, DimensionChannel).length, 0u);
+		}
+	}
+
+	Dimensions ChannelDimensions(unsigned int width, unsigned int height, unsigned int channel)
+	{
+		Dimensions dimensions;
+		dimensions(DimensionReadout, 0, width)
+			(DimensionPhaseEncoding, 0, height)
+			(DimensionChannel, channel, 1)
+			(DimensionSlice, 0, 1);
+		return dimensions;
+	}
+
+	template <typename T>
+	T Random(mt19937& generator);
+
+	template <>
+	float Random<float>(mt19937& generator)
+	{
+		return normal_distribution<float>(0.0f, 5.0f)(generator);
+	}
+
+	template <>
+	complex<float> Random<complex<float>>(mt19937& generator)
+	{
+		normal_distribution<float> normal(0.0f, 5.0f);
+		return complex<float>(normal(generator), normal(generator));
+	}
+
+	/// Combine width x height x channel_count x slice_count data at once, check against a scalar root sum of squares.
+	template <typename T>
+	void CheckCombine(unsigned int width, unsigned int height, unsigned int channel_count, unsigned int slice_count)
+	{
+		Dimensions dimensions;
+		dimensions(DimensionReadout, 0, width)
+			(DimensionPhaseEncoding, 0, height)
+			(DimensionChannel, 0, channel_count)
+			(DimensionSlice, 0, slice_count);
+		auto data = DataObject<T>::Create(nullptr, &dimensions);
+		size_t image_size = size_t(width) * height;
+		mt19937 generator(width * 31 + channel_count);
+		for (size_t i = 0; i < image_size * channel_count * slice_count; ++i)
+		{
+			data->GetData()[i] = Random<T>(generator);
+		}
+
+		auto combiner = YapShared(new ChannelCombiner);
+		auto sink = YapShared(new Sink<float>);
+		BOOST_REQUIRE(combiner->Link(L"Output", sink.get(), L"Input"));
+		BOOST_REQUIRE(Input(combiner.get(), L"Input", data.get()));
+		BOOST_REQUIRE_EQUAL(sink->outputs.size(), 1u);
+		CheckChannelsRemoved(*sink);
+		BOOST_REQUIRE_EQUAL(sink->outputs[0].size(), image_size * slice_count);
+
+		for (unsigned int slice = 0; slice < slice_count; ++slice)
+		{
+			for (size_t i = 0; i < image_size; ++i)
+			{
+				double sum = 0.0;
+				for (unsigned int channel = 0; channel < channel_count; ++channel)
+				{
+					sum += norm(complex<double>(data->GetData()[(slice * channel_count + channel) * image_size + i]));
+				}
+				BOOST_CHECK_CLOSE(sink->outputs[0][slice * image_size + i], sqrt(sum), 1e-4);
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(channel_combiner_combine)
+{
+	CheckCombine<complex<float>>(37, 5, 4, 3);
+	CheckCombine<float>(37, 5, 4, 3);
+
+	// More pixels than combined by one task.
+	CheckCombine<complex<float>>(131, 129, 3, 1);
+}
+
+BOOST_AUTO_TEST_CASE(channel_combiner_odd_counts)
+{
+	// Counts which leave a remainder after the AVX-512, AVX2 and SSE loops.
+	for (auto count : { 1u, 3u, 5u, 7u, 9u, 13u, 15u, 17u, 23u, 31u, 33u })
+	{
+		CheckCombine<complex<float>>(count, 1, 3, 1);
+		CheckCombine<float>(count, 1, 3, 1);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(channel_combiner_accumulate)
+{
+	const unsigned int width = 37, height = 5, channel_count = 4, slice_count = 2;
+	auto combiner = YapShared(new ChannelCombiner);
+	SetProperty<int>(combiner.get(), L"ChannelCount", channel_count);
+	auto sink = YapShared(new Sink<float>);
+	BOOST_REQUIRE(combiner->Link(L"Output", sink.get(), L"Input"));
+
+	// Channels arrive one at a time with the slices interleaved, each slice is fed once all of
+	// its channels are in.
+	mt19937 generator(1);
+	vector<vector<double>> sums(slice_count, vector<double>(width * height, 0.0));
+	for (unsigned int channel = 0; channel < channel_count; ++channel)
+	{
+		for (unsigned int slice = 0; slice < slice_count; ++slice)
+		{
+			Dimensions dimensions;
+			dimensions(DimensionReadout, 0, width)
+				(DimensionPhaseEncoding, 0, height)
+				(DimensionChannel, channel, 1)
+				(DimensionSlice, slice, 1);
+			auto data = DataObject<complex<float>>::Create(nullptr, &dimensions);
+			for (size_t i = 0; i < width * height; ++i)
+			{
+				data->GetData()[i] = Random<complex<float>>(generator);
+				sums[slice][i] += norm(complex<double>(data->GetData()[i]));
+			}
+
+			BOOST_REQUIRE(Input(combiner.get(), L"Input", data.get()));
+			BOOST_CHECK_EQUAL(sink->outputs.size(), (channel + 1 == channel_count) ? slice + 1 : 0);
+		}
+	}
+
+	for (unsigned int slice = 0; slice < slice_count; ++slice)
+	{
+		for (size_t i = 0; i < width * height; ++i)
+		{
+			BOOST_CHECK_CLOSE(sink->outputs[slice][i], sqrt(sums[slice][i]), 1e-4);
+		}
+	}
+
+	// A completed set is fed once, the next channels with the same indices start a new one.
+	for (unsigned int channel = 0; channel < channel_count; ++channel)
+	{
+		auto dimensions = ChannelDimensions(width, height, channel);
+		auto data = DataObject<float>::Create(nullptr, &dimensions);
+		fill(data->GetData(), data->GetData() + width * height, 2.0f);
+		BOOST_REQUIRE(Input(combiner.get(), L"Input", data.get()));
+	}
+	BOOST_REQUIRE_EQUAL(sink->outputs.size(), slice_count + 1);
+	BOOST_CHECK_CLOSE(sink->outputs.back()[width * height - 1], 4.0f, 1e-4);
+
+	// Data holding all channels is combined at once, even if ChannelCount is set.
+	Dimensions all_channels;
+	all_channels(DimensionReadout, 0, width)
+		(DimensionPhaseEncoding, 0, height)
+		(DimensionChannel, 0, channel_count);
+	auto block = DataObject<float>::Create(nullptr, &all_channels);
+	for (size_t i = 0; i < width * height * channel_count; ++i)
+	{
+		block->GetData()[i] = 3.0f;
+	}
+	BOOST_REQUIRE(Input(combiner.get(), L"Input", block.get()));
+	BOOST_REQUIRE_EQUAL(sink->outputs.size(), slice_count + 2);
+	BOOST_CHECK_CLOSE(sink->outputs.back()[0], 6.0f, 1e-4);
+	CheckChannelsRemoved(*sink);
+}
+
+BOOST_AUTO_TEST_CASE(channel_combiner_rejects_repeated_channels)
+{
+	const unsigned int width = 8, height = 4;
+	auto combiner = YapShared(new ChannelCombiner);
+	SetProperty<int>(combiner.get(), L"ChannelCount", 2);
+	auto sink = YapShared(new Sink<float>);
+	BOOST_REQUIRE(combiner->Link(L"Output", sink.get(), L"Input"));
+
+	auto first_dimensions = ChannelDimensions(width, height, 0);
+	auto first = DataObject<float>::Create(nullptr, &first_dimensions);
+	fill(first->GetData(), first->GetData() + width * height, 3.0f);
+	BOOST_REQUIRE(Input(combiner.get(), L"Input", first.get()));
+
+	// The same channel again neither adds up nor completes the set.
+	BOOST_CHECK(!Input(combiner.get(), L"Input", first.get()));
+	BOOST_CHECK(sink->outputs.empty());
+
+	// A larger image of the same slice doesn't fit the accumulated one.
+	auto larger_dimensions = ChannelDimensions(2 * width, height, 1);
+	auto larger = DataObject<float>::Create(nullptr, &larger_dimensions);
+	BOOST_CHECK(!Input(combiner.get(), L"Input", larger.get()));
+	BOOST_CHECK(sink->outputs.empty());
+
+	auto second_dimensions = ChannelDimensions(width, height, 1);
+	auto second = DataObject<float>::Create(nullptr, &second_dimensions);
+	fill(second->GetData(), second->GetData() + width * height, 4.0f);
+	BOOST_REQUIRE(Input(combiner.get(), L"Input", second.get()));
+	BOOST_REQUIRE_EQUAL(sink->outputs.size(), 1u);
+	BOOST_CHECK_CLOSE(sink->outputs[0][0], 5.0f, 1e-4);
+}
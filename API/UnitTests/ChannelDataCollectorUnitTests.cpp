@@ -0,0 +1,217 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "BasicRecon/ChannelDataCollector.h"
+#include "TestProcessors.h"
+
+#include <algorithm>
+#include <complex>
+#include <vector>
+
+using namespace Yap;
+using namespace Yap::Test;
+using namespace std;
+
+namespace
+{
+	Dimensions ChannelDimensions(unsigned int width, unsigned int height, unsigned int channel, unsigned int slice)
+	{
+		Dimensions dimensions;
+		dimensions(DimensionReadout, 0, width)
+			(DimensionPhaseEncoding, 0, height)
+			(DimensionChannel, channel, 1)
+			(DimensionSlice, slice, 1);
+		return dimensions;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(channel_data_collector_places_channels_by_index)
+{
+	const unsigned int width = 4, height = 2, channel_count = 3, channel_size = width * height;
+	auto collector = YapShared(new ChannelDataCollector);
+	SetProperty<int>(collector.get(), L"ChannelCount", channel_count);
+	auto producer = YapShared(new Producer<complex<float>>);
+	auto sink = YapShared(new Sink<complex<float>>);
+	BOOST_REQUIRE(producer->Link(L"Output", collector.get(), L"Input"));
+	BOOST_REQUIRE(collector->Link(L"Output", sink.get(), L"Input"));
+
+	// A slot which is never fed, e.g. by a producer bailing out, doesn't use up a position.
+	auto dimensions = ChannelDimensions(width, height, 1, 0);
+	BOOST_REQUIRE(producer->Produce(&dimensions, 99.0f, true));
+
+	// Channels of two slices arrive interleaved and out of order.
+	for (unsigned int channel : { 2u, 0u, 1u })
+	{
+		for (unsigned int slice : { 1u, 0u })
+		{
+			dimensions = ChannelDimensions(width, height, channel, slice);
+			BOOST_REQUIRE(producer->Produce(&dimensions, float(10 * slice + channel)));
+		}
+	}
+
+	BOOST_REQUIRE_EQUAL(sink->outputs.size(), 2u);
+	vector<unsigned int> slices;
+	for (unsigned int i = 0; i < sink->outputs.size(); ++i)
+	{
+		BOOST_CHECK_EQUAL(sink->GetDimension(i, DimensionChannel).start_index, 0u);
+		slices.push_back(sink->GetDimension(i, DimensionSlice).start_index);
+	}
+	BOOST_CHECK((slices == vector<unsigned int>{ 1, 0 }));
+
+	for (unsigned int i = 0; i < sink->outputs.size(); ++i)
+	{
+		auto& block = sink->outputs[i];
+		BOOST_REQUIRE_EQUAL(block.size(), size_t(channel_size) * channel_count);
+		for (unsigned int j = 0; j < block.size(); ++j)
+		{
+			BOOST_CHECK_EQUAL(block[j], complex<float>(float(10 * slices[i] + j / channel_size)));
+		}
+	}
+
+	// The channels were written straight into the buffers, the abandoned slot was handed out again.
+	auto slice1 = sink->arrays[0], slice0 = sink->arrays[1];
+	BOOST_CHECK((producer->outputs == vector<complex<float> *>{ slice0 + channel_size,
+		slice1 + 2 * channel_size, slice0 + 2 * channel_size, slice1, slice0,
+		slice1 + channel_size, slice0 + channel_size }));
+}
+
+BOOST_AUTO_TEST_CASE(channel_data_collector_copies_channels_without_position)
+{
+	const unsigned int width = 4, height = 2, channel_count = 2;
+	auto collector = YapShared(new ChannelDataCollector);
+	SetProperty<int>(collector.get(), L"ChannelCount", channel_count);
+	auto sink = YapShared(new Sink<complex<float>>);
+	BOOST_REQUIRE(collector->Link(L"Output", sink.get(), L"Input"));
+
+	// Channels with indices beyond ChannelCount, e.g. a subset of the coils, fill the buffer in
+	// the order they arrive.
+	for (float value : { 5.0f, 6.0f })
+	{
+		auto dimensions = ChannelDimensions(width, height, unsigned(value), 0);
+		auto channel = ComplexFloatData::Create(nullptr, &dimensions);
+		fill(channel->GetData(), channel->GetData() + width * height, complex<float>(value));
+		BOOST_REQUIRE(Input(collector.get(), L"Input", channel.get()));
+	}
+
+	BOOST_REQUIRE_EQUAL(sink->outputs.size(), 1u);
+	BOOST_CHECK_EQUAL(sink->outputs[0].front(), complex<float>(5.0f));
+	BOOST_CHECK_EQUAL(sink->outputs[0].back(), complex<float>(6.0f));
+
+	// The same channel index twice is an error.
+	auto indexed = ChannelDimensions(width, height, 1, 0);
+	auto channel = ComplexFloatData::Create(nullptr, &indexed);
+	BOOST_CHECK(Input(collector.get(), L"Input", channel.get()));
+	BOOST_CHECK(!Input(collector.get(), L"Input", channel.get()));
+	BOOST_CHECK_EQUAL(sink->outputs.size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(channel_data_collector_slices_before_channel)
+{
+	// Layout of CmrDataReader: each channel holds all slices, so it is contiguous in the buffer.
+	const unsigned int width = 4, height = 2, slice_count = 2, dim4 = 3, channel_count = 3;
+	const size_t channel_size = size_t(width) * height * slice_count * dim4;
+	auto collector = YapShared(new ChannelDataCollector);
+	SetProperty<int>(collector.get(), L"ChannelCount", channel_count);
+	auto producer = YapShared(new Producer<complex<float>>);
+	auto sink = YapShared(new Sink<complex<float>>);
+	BOOST_REQUIRE(producer->Link(L"Output", collector.get(), L"Input"));
+	BOOST_REQUIRE(collector->Link(L"Output", sink.get(), L"Input"));
+
+	for (unsigned int channel : { 1u, 2u, 0u })
+	{
+		Dimensions dimensions;
+		dimensions(DimensionReadout, 0, width)
+			(DimensionPhaseEncoding, 0, height)
+			(DimensionSlice, 0, slice_count)
+			(Dimension4, 0, dim4)
+			(DimensionChannel, channel, 1);
+		BOOST_REQUIRE(producer->Produce(&dimensions, float(channel + 1)));
+	}
+
+	BOOST_REQUIRE_EQUAL(sink->outputs.size(), 1u);
+	auto& block = sink->outputs[0];
+	BOOST_REQUIRE_EQUAL(block.size(), channel_size * channel_count);
+	for (size_t i = 0; i < block.size(); ++i)
+	{
+		BOOST_CHECK_EQUAL(block[i], complex<float>(float(i / channel_size + 1)));
+	}
+
+	auto buffer = sink->arrays[0];
+	BOOST_CHECK((producer->outputs == vector<complex<float> *>{ buffer + channel_size,
+		buffer + 2 * channel_size, buffer }));
+}
+
+BOOST_AUTO_TEST_CASE(channel_data_collector_channel_before_slices)
+{
+	// Each channel is split over the slices following it in the buffer, so it is copied.
+	const unsigned int width = 4, height = 2, slice_count = 2, channel_count = 3;
+	const size_t image_size = size_t(width) * height;
+	auto collector = YapShared(new ChannelDataCollector);
+	SetProperty<int>(collector.get(), L"ChannelCount", channel_count);
+	auto producer = YapShared(new Producer<complex<float>>);
+	auto sink = YapShared(new Sink<complex<float>>);
+	BOOST_REQUIRE(producer->Link(L"Output", collector.get(), L"Input"));
+	BOOST_REQUIRE(collector->Link(L"Output", sink.get(), L"Input"));
+
+	for (unsigned int channel : { 2u, 0u, 1u })
+	{
+		Dimensions dimensions;
+		dimensions(DimensionReadout, 0, width)
+			(DimensionPhaseEncoding, 0, height)
+			(DimensionChannel, channel, 1)
+			(DimensionSlice, 0, slice_count);
+		auto data = ComplexFloatData::Create(nullptr, &dimensions);
+		for (size_t i = 0; i < image_size * slice_count; ++i)
+		{
+			data->GetData()[i] = complex<float>(float(i), float(channel));
+		}
+		BOOST_REQUIRE(Input(collector.get(), L"Input", data.get()));
+	}
+
+	BOOST_REQUIRE_EQUAL(sink->outputs.size(), 1u);
+	auto& block = sink->outputs[0];
+	BOOST_REQUIRE_EQUAL(block.size(), image_size * slice_count * channel_count);
+	for (unsigned int slice = 0; slice < slice_count; ++slice)
+	{
+		for (unsigned int channel = 0; channel < channel_count; ++channel)
+		{
+			for (size_t i = 0; i < image_size; ++i)
+			{
+				BOOST_CHECK_EQUAL(block[(slice * channel_count + channel) * image_size + i],
+					complex<float>(float(slice * image_size + i), float(channel)));
+			}
+		}
+	}
+
+	// Slots are only handed out for channels which are contiguous in the buffer.
+	Dimensions dimensions;
+	dimensions(DimensionReadout, 0, width)
+		(DimensionPhaseEncoding, 0, height)
+		(DimensionChannel, 0, 1)
+		(DimensionSlice, 0, slice_count);
+	BOOST_REQUIRE(producer->Produce(&dimensions, 1.0f, true));
+	BOOST_CHECK(producer->outputs.back() < sink->arrays[0] ||
+		producer->outputs.back() >= sink->arrays[0] + block.size());
+}
+
+BOOST_AUTO_TEST_CASE(channel_data_collector_rejects_mismatched_channels)
+{
+	auto collector = YapShared(new ChannelDataCollector);
+	SetProperty<int>(collector.get(), L"ChannelCount", 2);
+	auto sink = YapShared(new Sink<complex<float>>);
+	BOOST_REQUIRE(collector->Link(L"Output", sink.get(), L"Input"));
+
+	auto first_dimensions = ChannelDimensions(4, 2, 0, 0);
+	auto first = ComplexFloatData::Create(nullptr, &first_dimensions);
+	BOOST_REQUIRE(Input(collector.get(), L"Input", first.get()));
+
+	// A larger image of the same slice doesn't fit the buffer.
+	auto larger_dimensions = ChannelDimensions(8, 2, 1, 0);
+	auto larger = ComplexFloatData::Create(nullptr, &larger_dimensions);
+	BOOST_CHECK(!Input(collector.get(), L"Input", larger.get()));
+
+	auto wrong_type = FloatData::Create(nullptr, &first_dimensions);
+	BOOST_CHECK(!Input(collector.get(), L"Input", wrong_type.get()));
+	BOOST_CHECK(sink->outputs.empty());
+}
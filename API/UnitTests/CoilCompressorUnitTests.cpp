@@ -0,0 +1,213 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "BasicRecon/CoilCompressor.h"
+#include "TestProcessors.h"
+
+#include <cmath>
+#include <complex>
+#include <random>
+#include <vector>
+
+using namespace Yap;
+using namespace Yap::Test;
+using namespace std;
+
+namespace
+{
+	/// Compresses width x height x coil_count data, returns the virtual coils.
+	template <typename T>
+	vector<complex<T>> Compress(vector<complex<T>>& data, unsigned int width, unsigned int height,
+		unsigned int coil_count, const wchar_t * mode, int target_count, double energy_threshold,
+		unsigned int& virtual_count)
+	{
+		Dimensions dimensions;
+		dimensions(DimensionReadout, 0, width)
+			(DimensionPhaseEncoding, 0, height)
+			(DimensionChannel, 0, coil_count);
+		auto input = DataObject<complex<T>>::Create(nullptr, &dimensions);
+		copy(data.begin(), data.end(), input->GetData());
+
+		auto compressor = YapShared(new CoilCompressor);
+		SetProperty<std::wstring>(compressor.get(), L"Mode", mode);
+		SetProperty<int>(compressor.get(), L"TargetCount", target_count);
+		SetProperty<double>(compressor.get(), L"EnergyThreshold", energy_threshold);
+		SetProperty<int>(compressor.get(), L"CalibrationLines", 0);
+		auto sink = YapShared(new Sink<complex<T>>);
+		BOOST_REQUIRE(compressor->Link(L"Output", sink.get(), L"Input"));
+		BOOST_REQUIRE(Input(compressor.get(), L"Input", input.get()));
+		BOOST_REQUIRE_EQUAL(sink->outputs.size(), 1u);
+
+		virtual_count = sink->GetDimension(0, DimensionChannel).length;
+		return sink->outputs[0];
+	}
+
+	/// Coil c at pixel i is sum_j sensitivities[c][j] * components[j][i].
+	template <typename T>
+	vector<complex<T>> Mix(const vector<vector<complex<T>>>& components,
+		const vector<vector<complex<T>>>& sensitivities)
+	{
+		auto pixel_count = components[0].size();
+		vector<complex<T>> data(pixel_count * sensitivities.size());
+		for (size_t coil = 0; coil < sensitivities.size(); ++coil)
+		{
+			for (size_t j = 0; j < components.size(); ++j)
+			{
+				for (size_t i = 0; i < pixel_count; ++i)
+				{
+					data[coil * pixel_count + i] += sensitivities[coil][j] * components[j][i];
+				}
+			}
+		}
+
+		return data;
+	}
+
+	template <typename T>
+	vector<vector<complex<T>>> RandomMatrix(size_t rows, size_t columns, mt19937& generator)
+	{
+		normal_distribution<T> normal;
+		vector<vector<complex<T>>> matrix(rows, vector<complex<T>>(columns));
+		for (auto& row : matrix)
+		{
+			for (auto& element : row)
+			{
+				element = complex<T>(normal(generator), normal(generator));
+			}
+		}
+
+		return matrix;
+	}
+
+	/// Root sum of squares over the coils at each pixel.
+	template <typename T>
+	vector<double> GetRss(const vector<complex<T>>& data, size_t pixel_count)
+	{
+		vector<double> rss(pixel_count, 0.0);
+		for (size_t i = 0; i < data.size(); ++i)
+		{
+			rss[i % pixel_count] += norm(complex<double>(data[i]));
+		}
+		for (auto& value : rss)
+		{
+			value = sqrt(value);
+		}
+
+		return rss;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(coil_compressor_virtual_coil_count)
+{
+	arma::vec eigenvalues{ 6.0, 3.0, 1.0, 0.0 };
+	BOOST_CHECK_EQUAL(CoilCompressor::GetVirtualCoilCount(eigenvalues, 0.5), 1u);
+	BOOST_CHECK_EQUAL(CoilCompressor::GetVirtualCoilCount(eigenvalues, 0.9), 2u);
+	BOOST_CHECK_EQUAL(CoilCompressor::GetVirtualCoilCount(eigenvalues, 0.95), 3u);
+	BOOST_CHECK_EQUAL(CoilCompressor::GetVirtualCoilCount(eigenvalues, 1.0), 3u);
+
+	arma::vec zeros{ 0.0, 0.0, 0.0 };
+	BOOST_CHECK_EQUAL(CoilCompressor::GetVirtualCoilCount(zeros, 0.95), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(coil_compressor_global_keeps_energy_of_low_rank_data)
+{
+	const unsigned int width = 16, height = 24, coil_count = 6, rank = 3;
+	mt19937 generator(1);
+	auto data = Mix(RandomMatrix<float>(rank, width * height, generator),
+		RandomMatrix<float>(coil_count, rank, generator));
+
+	// Every pixel lies in the span of the rank sensitivity vectors, so rank virtual coils keep all of it.
+	unsigned int virtual_count;
+	auto output = Compress(data, width, height, coil_count, L"Global", 0, 0.9999, virtual_count);
+	BOOST_REQUIRE_EQUAL(virtual_count, rank);
+	BOOST_REQUIRE_EQUAL(output.size(), size_t(width) * height * rank);
+
+	auto input_rss = GetRss(data, width * height);
+	auto output_rss = GetRss(output, width * height);
+	for (size_t i = 0; i < input_rss.size(); ++i)
+	{
+		BOOST_CHECK_CLOSE(output_rss[i], input_rss[i], 1e-2);
+	}
+
+	// A lower threshold drops the weakest components.
+	Compress(data, width, height, coil_count, L"Global", 0, 1e-6, virtual_count);
+	BOOST_CHECK_EQUAL(virtual_count, 1u);
+	Compress(data, width, height, coil_count, L"Global", 2, 0.9999, virtual_count);
+	BOOST_CHECK_EQUAL(virtual_count, 2u);
+}
+
+BOOST_AUTO_TEST_CASE(coil_compressor_geometric_matches_global_for_uniform_readout)
+{
+	const unsigned int width = 16, height = 20, coil_count = 5, rank = 3, virtual_count = 2;
+	mt19937 generator(2);
+
+	// k(kx, ky) = g(kx) * f(ky): the sensitivities don't vary along x, so every readout position
+	// has the same covariance up to a scale, and the per position matrices reduce to the global one.
+	auto lines = RandomMatrix<double>(rank, height, generator);
+	const double weights[] = { 1.0, 0.5, 0.2 };
+	vector<vector<complex<double>>> components(rank, vector<complex<double>>(width * height));
+	for (unsigned int j = 0; j < rank; ++j)
+	{
+		for (unsigned int y = 0; y < height; ++y)
+		{
+			components[j][y * width + width / 2] = weights[j] * lines[j][y];
+			components[j][y * width + width / 2 + 1] = 0.3 * weights[j] * lines[j][y];
+		}
+	}
+	auto data = Mix(components, RandomMatrix<double>(coil_count, rank, generator));
+
+	unsigned int global_count, geometric_count;
+	auto global = Compress(data, width, height, coil_count, L"Global", virtual_count, 0.0, global_count);
+	auto geometric = Compress(data, width, height, coil_count, L"Geometric", virtual_count, 0.0, geometric_count);
+	BOOST_REQUIRE_EQUAL(global_count, virtual_count);
+	BOOST_REQUIRE_EQUAL(geometric_count, virtual_count);
+
+	// Virtual coils are only defined up to a unitary rotation, find it by least squares:
+	// rotation = (global^H global)^-1 global^H geometric.
+	size_t pixel_count = width * height;
+	complex<double> gram[2][2] = {}, cross[2][2] = {};
+	for (size_t i = 0; i < pixel_count; ++i)
+	{
+		for (unsigned int a = 0; a < 2; ++a)
+		{
+			for (unsigned int b = 0; b < 2; ++b)
+			{
+				gram[a][b] += conj(global[a * pixel_count + i]) * global[b * pixel_count + i];
+				cross[a][b] += conj(global[a * pixel_count + i]) * geometric[b * pixel_count + i];
+			}
+		}
+	}
+	auto determinant = gram[0][0] * gram[1][1] - gram[0][1] * gram[1][0];
+	complex<double> inverse[2][2] = { { gram[1][1] / determinant, -gram[0][1] / determinant },
+		{ -gram[1][0] / determinant, gram[0][0] / determinant } };
+	complex<double> rotation[2][2];
+	for (unsigned int a = 0; a < 2; ++a)
+	{
+		for (unsigned int b = 0; b < 2; ++b)
+		{
+			rotation[a][b] = inverse[a][0] * cross[0][b] + inverse[a][1] * cross[1][b];
+		}
+	}
+
+	for (unsigned int a = 0; a < 2; ++a)
+	{
+		for (unsigned int b = 0; b < 2; ++b)
+		{
+			auto product = conj(rotation[0][a]) * rotation[0][b] + conj(rotation[1][a]) * rotation[1][b];
+			BOOST_CHECK_SMALL(abs(product - (a == b ? 1.0 : 0.0)), 1e-6);
+		}
+	}
+
+	double residual = 0.0, total = 0.0;
+	for (size_t i = 0; i < pixel_count; ++i)
+	{
+		for (unsigned int b = 0; b < 2; ++b)
+		{
+			auto rotated = global[i] * rotation[0][b] + global[pixel_count + i] * rotation[1][b];
+			residual += norm(rotated - geometric[b * pixel_count + i]);
+			total += norm(geometric[b * pixel_count + i]);
+		}
+	}
+	BOOST_CHECK_SMALL(sqrt(residual / total), 1e-6);
+}
@@ -0,0 +1,95 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "Implement/DataObject.h"
+#include "Implement/RetainedData.h"
+
+using namespace Yap;
+
+BOOST_AUTO_TEST_CASE(data_object_strided_view)
+{
+	// 4 x 3 x 2 x 2 (readout, phase encoding, slice, channel)
+	Dimensions dimensions;
+	dimensions(DimensionReadout, 0, 4)(DimensionPhaseEncoding, 0, 3)(DimensionSlice, 0, 2)(DimensionChannel, 0, 2);
+	auto volume = IntData::Create(nullptr, &dimensions);
+	BOOST_REQUIRE(volume);
+	for (int i = 0; i < 4 * 3 * 2 * 2; ++i)
+	{
+		volume->GetData()[i] = i;
+	}
+
+	// Slice 1 of all channels.
+	Dimensions slice_dimensions(dimensions);
+	slice_dimensions.SetDimension(DimensionSlice, 1, 1);
+	std::vector<size_t> strides{ 1, 4, 12, 24 };
+	auto view = IntData::CreateView(nullptr, volume->GetData() + 12, slice_dimensions, strides, volume.get());
+	BOOST_REQUIRE(view);
+	BOOST_CHECK(!view->IsContiguous());
+	BOOST_CHECK(view->GetStride(3) == 24);
+
+	auto copy = YapShared<IntData>(static_cast<IData*>(view.get())->Clone());
+	BOOST_REQUIRE(copy);
+	BOOST_CHECK(copy->IsContiguous());
+	BOOST_CHECK(copy->GetStride(3) == 12);
+	for (int channel = 0; channel < 2; ++channel)
+	{
+		for (int i = 0; i < 12; ++i)
+		{
+			BOOST_CHECK(copy->GetData()[channel * 12 + i] == 12 + channel * 24 + i);
+		}
+	}
+
+	// Single channel of the slice is contiguous.
+	Dimensions channel_dimensions(slice_dimensions);
+	channel_dimensions.SetDimension(DimensionChannel, 1, 1);
+	auto channel = IntData::CreateView(nullptr, volume->GetData() + 36, channel_dimensions, strides, volume.get());
+	BOOST_REQUIRE(channel);
+	BOOST_CHECK(channel->IsContiguous());
+}
+
+BOOST_AUTO_TEST_CASE(data_object_exclusive_ownership)
+{
+	Dimensions dimensions;
+	dimensions(DimensionReadout, 0, 4)(DimensionPhaseEncoding, 0, 4);
+	auto image = IntData::Create(nullptr, &dimensions);
+	BOOST_REQUIRE(image);
+	BOOST_CHECK(image->IsExclusive());
+
+	// Shared while fed to a consumer which is not the last one.
+	image->Share();
+	BOOST_CHECK(!image->IsExclusive());
+	image->Unshare();
+	BOOST_CHECK(image->IsExclusive());
+
+	// References held by the pipeline, e.g. by a pending task, don't count.
+	{
+		auto another_reference = image;
+		BOOST_CHECK(image->IsExclusive());
+	}
+
+	// Neither does the reference of a view to its parent.
+	Dimensions line_dimensions;
+	line_dimensions(DimensionReadout, 0, 4);
+	auto line = IntData::Create(nullptr, image->GetData(), line_dimensions, image.get());
+	BOOST_REQUIRE(line);
+	BOOST_CHECK(line->IsExclusive());
+
+	// A view is shared if its parent is.
+	image->Share();
+	BOOST_CHECK(!line->IsExclusive());
+	image->Unshare();
+	BOOST_CHECK(line->IsExclusive());
+
+	// Data kept by a processor is shared as long as it is kept.
+	{
+		RetainedData retained(image.get());
+		BOOST_CHECK(!image->IsExclusive());
+		BOOST_CHECK(!line->IsExclusive());
+
+		auto copy = retained;
+		retained.reset();
+		BOOST_CHECK(!image->IsExclusive());
+	}
+	BOOST_CHECK(image->IsExclusive());
+}
@@ -0,0 +1,263 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "Implement/ExecutionEngine.h"
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+using namespace Yap;
+using namespace std;
+
+namespace
+{
+	/// Engine of a host, queues the tasks till the test runs them.
+	class FakeEngine : public IExecutionEngine
+	{
+	public:
+		virtual bool IsEnabled() const override
+		{
+			return true;
+		}
+
+		virtual bool IsWorkerThread() const override
+		{
+			return false;
+		}
+
+		virtual unsigned int GetThreadCount() const override
+		{
+			return 3;
+		}
+
+		virtual void Submit(ITask * task) override
+		{
+			tasks.push_back(task);
+		}
+
+		virtual bool RunLocal(const void * group) override
+		{
+			return false;
+		}
+
+		void RunAll()
+		{
+			for (auto task : tasks)
+			{
+				task->Complete(task->Run());
+			}
+			tasks.clear();
+		}
+
+		vector<ITask*> tasks;
+	};
+
+	/// Run count tasks in a group, return the threads they ran on.
+	set<thread::id> RunTasks(unsigned int count, bool& succeeded)
+	{
+		set<thread::id> threads;
+		mutex threads_mutex;
+
+		TaskGroup tasks;
+		for (unsigned int i = 0; i < count; ++i)
+		{
+			tasks.Run([&]() {
+				this_thread::sleep_for(chrono::milliseconds(5));
+				lock_guard<mutex> lock(threads_mutex);
+				threads.insert(this_thread::get_id());
+				return true;
+			});
+		}
+		succeeded = tasks.Wait();
+
+		return threads;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(execution_engine_thread_count)
+{
+	auto& engine = ExecutionEngine::GetInstance();
+	auto thread_count = engine.GetThreadCount();
+
+	// 0 and 1 disable the engine, tasks run synchronously on the calling thread.
+	for (unsigned int count : { 0u, 1u })
+	{
+		engine.SetThreadCount(count);
+		BOOST_CHECK(!engine.IsEnabled());
+		BOOST_CHECK_EQUAL(engine.GetThreadCount(), 0u);
+
+		bool succeeded = false;
+		auto threads = RunTasks(4, succeeded);
+		BOOST_CHECK(succeeded);
+		BOOST_REQUIRE_EQUAL(threads.size(), 1u);
+		BOOST_CHECK(*threads.begin() == this_thread::get_id());
+	}
+
+	engine.SetThreadCount(3);
+	BOOST_CHECK(engine.IsEnabled());
+	BOOST_CHECK_EQUAL(engine.GetThreadCount(), 3u);
+	BOOST_CHECK(!engine.IsWorkerThread());
+
+	atomic<bool> on_worker{ false };
+	TaskGroup tasks;
+	tasks.Run([&]() {
+		on_worker = engine.IsWorkerThread();
+		return true;
+	});
+	BOOST_CHECK(tasks.Wait());
+	BOOST_CHECK(on_worker);
+
+	bool succeeded = false;
+	auto threads = RunTasks(16, succeeded);
+	BOOST_CHECK(succeeded);
+	BOOST_CHECK(threads.size() > 1);
+	BOOST_CHECK(threads.find(this_thread::get_id()) == threads.end());
+
+	engine.SetThreadCount(thread_count);
+}
+
+BOOST_AUTO_TEST_CASE(execution_engine_nested_wait_on_worker)
+{
+	auto& engine = ExecutionEngine::GetInstance();
+	auto thread_count = engine.GetThreadCount();
+	engine.SetThreadCount(3);
+
+	// Tasks submitted by a worker go to its own deque, the others have to steal them while the
+	// worker waits for its group.
+	set<thread::id> threads;
+	thread::id outer_thread;
+	bool inner_succeeded = false;
+
+	TaskGroup outer;
+	outer.Run([&]() {
+		outer_thread = this_thread::get_id();
+		inner_succeeded = false;
+		threads = RunTasks(16, inner_succeeded);
+		return inner_succeeded;
+	});
+	BOOST_CHECK(outer.Wait());
+	BOOST_CHECK(inner_succeeded);
+	BOOST_CHECK(threads.size() > 1);
+
+	threads.erase(outer_thread);
+	BOOST_CHECK(!threads.empty());
+
+	engine.SetThreadCount(thread_count);
+}
+
+BOOST_AUTO_TEST_CASE(execution_engine_failure)
+{
+	auto& engine = ExecutionEngine::GetInstance();
+	auto thread_count = engine.GetThreadCount();
+
+	for (unsigned int count : { 0u, 3u })
+	{
+		engine.SetThreadCount(count);
+
+		atomic<unsigned int> finished{ 0 };
+		TaskGroup failed;
+		for (unsigned int i = 0; i < 8; ++i)
+		{
+			failed.Run([&finished, i]() {
+				++finished;
+				return i != 5;
+			});
+		}
+		BOOST_CHECK(!failed.Wait());
+		BOOST_CHECK_EQUAL(finished.load(), 8u);
+
+		// Exceptions don't leave the task, they fail the group.
+		TaskGroup thrown;
+		thrown.Run([]() -> bool { throw runtime_error("task"); });
+		thrown.Run([]() { return true; });
+		BOOST_CHECK(!thrown.Wait());
+
+		// Failures of nested groups only fail the outer group if the task reports them.
+		TaskGroup outer;
+		outer.Run([]() {
+			TaskGroup inner;
+			inner.Run([]() { return false; });
+			return !inner.Wait();
+		});
+		BOOST_CHECK(outer.Wait());
+	}
+
+	engine.SetThreadCount(thread_count);
+}
+
+BOOST_AUTO_TEST_CASE(execution_engine_shutdown)
+{
+	auto& engine = ExecutionEngine::GetInstance();
+	auto thread_count = engine.GetThreadCount();
+	engine.SetThreadCount(3);
+	BOOST_CHECK(engine.IsEnabled());
+
+	ExecutionEngine::Shutdown();
+	BOOST_CHECK(!engine.IsEnabled());
+	BOOST_CHECK_EQUAL(engine.GetThreadCount(), 0u);
+
+	bool succeeded = false;
+	auto threads = RunTasks(4, succeeded);
+	BOOST_CHECK(succeeded);
+	BOOST_REQUIRE_EQUAL(threads.size(), 1u);
+	BOOST_CHECK(*threads.begin() == this_thread::get_id());
+
+	// The engine can be started again.
+	engine.SetThreadCount(2);
+	BOOST_CHECK(engine.IsEnabled());
+	engine.SetThreadCount(thread_count);
+}
+
+BOOST_AUTO_TEST_CASE(execution_engine_forwards_to_host)
+{
+	auto& engine = ExecutionEngine::GetInstance();
+	auto thread_count = engine.GetThreadCount();
+	engine.SetThreadCount(2);
+
+	// The workers of the module are stopped, everything goes to the engine of the host.
+	FakeEngine host;
+	ExecutionEngine::GetUser().SetExecutionEngine(&host);
+	BOOST_CHECK(engine.IsEnabled());
+	BOOST_CHECK_EQUAL(engine.GetThreadCount(), 3u);
+
+	// The thread count belongs to the host.
+	engine.SetThreadCount(4);
+	BOOST_CHECK_EQUAL(engine.GetThreadCount(), 3u);
+
+	unsigned int finished = 0;
+	TaskGroup tasks;
+	for (unsigned int i = 0; i < 4; ++i)
+	{
+		tasks.Run([&finished, i]() {
+			++finished;
+			return i != 2;
+		});
+	}
+	BOOST_CHECK_EQUAL(host.tasks.size(), 4u);
+	BOOST_CHECK_EQUAL(finished, 0u);
+	for (auto task : host.tasks)
+	{
+		BOOST_CHECK(task->GetGroup() == &tasks);
+	}
+
+	host.RunAll();
+	BOOST_CHECK(!tasks.Wait());
+	BOOST_CHECK_EQUAL(finished, 4u);
+
+	// Passing the own engine detaches the module like nullptr does.
+	ExecutionEngine::GetUser().SetExecutionEngine(&engine);
+	BOOST_CHECK(!engine.IsEnabled());
+	ExecutionEngine::GetUser().SetExecutionEngine(&host);
+	ExecutionEngine::GetUser().SetExecutionEngine(nullptr);
+	BOOST_CHECK(!engine.IsEnabled());
+
+	engine.SetThreadCount(2);
+	BOOST_CHECK_EQUAL(engine.GetThreadCount(), 2u);
+	engine.SetThreadCount(thread_count);
+}
@@ -0,0 +1,128 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "BasicRecon/FastNlm.h"
+
+#include <algorithm>
+#include <cmath>
+#include <random>
+#include <vector>
+
+using namespace Yap;
+using namespace std;
+
+namespace
+{
+	/// Mirror index i into [0, size), repeating the edge pixel, as done by FastNlm.
+	int Reflect(int i, int size)
+	{
+		while (i < 0 || i >= size)
+		{
+			i = (i < 0) ? -i - 1 : 2 * size - 1 - i;
+		}
+		return i;
+	}
+
+	/// Pixelwise non-local means computing every patch distance directly.
+	vector<float> ReferenceDenoise(const vector<float>& input, int width, int height,
+		int patch_radius, int search_radius, float sigma, float h)
+	{
+		auto pixel = [&](int x, int y) {
+			return double(input[size_t(Reflect(y, height)) * width + Reflect(x, width)]);
+		};
+
+		double patch_area = (2.0 * patch_radius + 1) * (2.0 * patch_radius + 1);
+		double bias = 2.0 * sigma * sigma;
+		double filter = 1.0 / (double(h) * sigma * h * sigma);
+
+		vector<float> output(input.size());
+		for (int y = 0; y < height; ++y)
+		{
+			for (int x = 0; x < width; ++x)
+			{
+				double total_weight = 0.0, max_weight = 0.0, weighted_sum = 0.0;
+				for (int dy = -search_radius; dy <= search_radius; ++dy)
+				{
+					for (int dx = -search_radius; dx <= search_radius; ++dx)
+					{
+						if (dx == 0 && dy == 0)
+							continue;
+
+						double distance = 0.0;
+						for (int j = -patch_radius; j <= patch_radius; ++j)
+						{
+							for (int i = -patch_radius; i <= patch_radius; ++i)
+							{
+								auto difference = pixel(x + i, y + j) - pixel(x + dx + i, y + dy + j);
+								distance += difference * difference;
+							}
+						}
+
+						auto exponent = max(distance / patch_area - bias, 0.0) * filter;
+						if (exponent >= 30.0)
+							continue;
+
+						auto weight = exp(-exponent);
+						total_weight += weight;
+						weighted_sum += weight * pixel(x + dx, y + dy);
+						max_weight = max(max_weight, weight);
+					}
+				}
+
+				auto weight = total_weight + max_weight;
+				output[size_t(y) * width + x] = float((weight > 0.0) ?
+					(weighted_sum + max_weight * pixel(x, y)) / weight : pixel(x, y));
+			}
+		}
+
+		return output;
+	}
+
+	/// Smooth gradient with an edge, plus Gaussian noise.
+	vector<float> CreateImage(unsigned int width, unsigned int height, float sigma)
+	{
+		mt19937 generator(7);
+		normal_distribution<float> noise(0.0f, sigma);
+		vector<float> image(size_t(width) * height);
+		for (unsigned int y = 0; y < height; ++y)
+		{
+			for (unsigned int x = 0; x < width; ++x)
+			{
+				image[size_t(y) * width + x] = 2.0f * x + y + (x > width / 2 ? 60.0f : 0.0f) + noise(generator);
+			}
+		}
+
+		return image;
+	}
+
+	void CheckAgainstReference(unsigned int width, unsigned int height, unsigned int patch_radius,
+		unsigned int search_radius)
+	{
+		const float sigma = 10.0f, h = 0.4f;
+		auto input = CreateImage(width, height, sigma);
+		vector<float> output(input.size());
+		FastNlm::Denoise(input.data(), output.data(), width, height, patch_radius, search_radius, sigma, h);
+
+		auto expected = ReferenceDenoise(input, int(width), int(height), int(patch_radius),
+			int(search_radius), sigma, h);
+		for (size_t i = 0; i < output.size(); ++i)
+		{
+			BOOST_CHECK_SMALL(output[i] - expected[i], 1e-3f);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(fast_nlm_matches_direct_evaluation)
+{
+	// 70 rows are denoised as three bands of up to 32 rows, so patches and search windows cross
+	// the seams between the bands as well as the mirrored borders.
+	CheckAgainstReference(23, 70, 1, 3);
+	CheckAgainstReference(23, 70, 2, 4);
+}
+
+BOOST_AUTO_TEST_CASE(fast_nlm_reflects_small_images)
+{
+	// The margins are wider than the image, so indices are mirrored more than once.
+	CheckAgainstReference(5, 4, 2, 5);
+}
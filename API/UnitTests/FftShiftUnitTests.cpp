@@ -0,0 +1,139 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "BasicRecon/FftShift.h"
+
+#include <cmath>
+#include <vector>
+
+using namespace Yap;
+using namespace std;
+
+namespace
+{
+	typedef complex<double> Complex;
+
+	/// Straightforward fftshift of the flagged axes (all if empty), sizes slowest varying first.
+	vector<Complex> ReferenceShift(const vector<Complex>& data, const vector<int>& sizes,
+		const vector<bool>& axes = vector<bool>())
+	{
+		vector<Complex> result(data.size());
+		vector<int> index(sizes.size(), 0);
+		for (size_t i = 0; i < data.size(); ++i)
+		{
+			size_t source = 0;
+			for (size_t axis = 0; axis < sizes.size(); ++axis)
+			{
+				auto shift = FftShift::IsShifted(axes, axis) ? sizes[axis] - sizes[axis] / 2 : 0;
+				source = source * sizes[axis] + (index[axis] + shift) % sizes[axis];
+			}
+			result[i] = data[source];
+
+			for (int axis = int(sizes.size()) - 1; axis >= 0 && ++index[axis] == sizes[axis]; --axis)
+			{
+				index[axis] = 0;
+			}
+		}
+
+		return result;
+	}
+
+	/// Naive multi-dimensional DFT, sizes slowest varying first.
+	vector<Complex> Dft(const vector<Complex>& data, const vector<int>& sizes)
+	{
+		const double pi = 3.14159265358979323846;
+		vector<Complex> result(data.size());
+		for (size_t k = 0; k < data.size(); ++k)
+		{
+			for (size_t n = 0; n < data.size(); ++n)
+			{
+				double phase = 0.0;
+				auto k_rest = k, n_rest = n;
+				for (int axis = int(sizes.size()) - 1; axis >= 0; --axis)
+				{
+					phase += double(k_rest % sizes[axis]) * (n_rest % sizes[axis]) / sizes[axis];
+					k_rest /= sizes[axis];
+					n_rest /= sizes[axis];
+				}
+				result[k] += data[n] * polar(1.0, -2.0 * pi * phase);
+			}
+		}
+
+		return result;
+	}
+
+	vector<Complex> MakeData(const vector<int>& sizes)
+	{
+		vector<Complex> data(FftShift::GetElementCount(sizes));
+		for (size_t i = 0; i < data.size(); ++i)
+		{
+			data[i] = Complex(sin(1.3 * i), double(i % 7));
+		}
+
+		return data;
+	}
+
+	double MaxDifference(const vector<Complex>& a, const vector<Complex>& b)
+	{
+		double difference = 0.0;
+		for (size_t i = 0; i < a.size(); ++i)
+		{
+			difference = max(difference, abs(a[i] - b[i]));
+		}
+
+		return difference;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(fft_shift_odd_and_even_sizes)
+{
+	vector<vector<int>> cases{ { 5 }, { 6 }, { 3, 5 }, { 4, 6 }, { 1, 7 }, { 7, 7, 3 }, { 2, 4, 6 } };
+	for (auto& sizes : cases)
+	{
+		auto data = MakeData(sizes);
+		auto expected = ReferenceShift(data, sizes);
+		for (auto& element : expected)
+		{
+			element *= 0.5;
+		}
+
+		FftShift::Shift(data.data(), sizes, 0.5);
+		BOOST_CHECK_SMALL(MaxDifference(data, expected), 1e-12);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(fft_shift_modulation)
+{
+	vector<vector<int>> cases{ { 6 }, { 4, 6 }, { 1, 4, 2 }, { 2, 4, 6 } };
+	for (auto& sizes : cases)
+	{
+		BOOST_REQUIRE(FftShift::IsModulatable(sizes));
+
+		auto data = MakeData(sizes);
+		auto expected = ReferenceShift(Dft(data, sizes), sizes);
+
+		vector<Complex> modulated(data.size());
+		FftShift::Modulate(data.data(), modulated.data(), sizes, 1.0);
+		BOOST_CHECK_SMALL(MaxDifference(Dft(modulated, sizes), expected), 1e-9);
+	}
+
+	BOOST_CHECK(!FftShift::IsModulatable({ 4, 5 }));
+}
+
+BOOST_AUTO_TEST_CASE(fft_shift_selected_axes)
+{
+	vector<int> sizes{ 4, 3, 5 };
+	vector<vector<bool>> cases{ { true, false, false }, { false, true, true }, { true, false, true } };
+	for (auto& axes : cases)
+	{
+		auto data = MakeData(sizes);
+		auto expected = ReferenceShift(data, sizes, axes);
+
+		FftShift::Shift(data.data(), sizes, 1.0, axes);
+		BOOST_CHECK_SMALL(MaxDifference(data, expected), 1e-12);
+	}
+
+	BOOST_CHECK(FftShift::IsModulatable(sizes, { true, false, false }));
+	BOOST_CHECK(!FftShift::IsModulatable(sizes, { true, true, false }));
+}
@@ -0,0 +1,225 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "BasicRecon/Fft1D.h"
+#include "BasicRecon/Fft2D.h"
+#include "TestProcessors.h"
+
+#include <algorithm>
+#include <complex>
+#include <random>
+#include <vector>
+
+using namespace Yap;
+using namespace Yap::Test;
+using namespace std;
+
+namespace
+{
+	/// Run data through a new FFT processor with the given properties, return the output elements.
+	/**
+		\remarks data is left unchanged, so it can be transformed again.
+	*/
+	template <typename T, typename PROCESSOR>
+	vector<T> Transform(IData * data, bool inverse, bool half_spectrum = false, bool real_output = false,
+		unsigned int * width = nullptr)
+	{
+		auto fft = YapShared(new PROCESSOR);
+		SetProperty<bool>(fft.get(), L"Inverse", inverse);
+		SetProperty<bool>(fft.get(), L"InPlace", false);
+		SetProperty<bool>(fft.get(), L"HalfSpectrum", half_spectrum);
+		SetProperty<bool>(fft.get(), L"RealOutput", real_output);
+		auto sink = YapShared(new Sink<T>);
+		BOOST_REQUIRE(fft->Link(L"Output", sink.get(), L"Input"));
+		BOOST_REQUIRE(Input(fft.get(), L"Input", data));
+		BOOST_REQUIRE_EQUAL(sink->outputs.size(), 1u);
+
+		if (width != nullptr)
+		{
+			*width = sink->GetDimension(0, DimensionReadout).length;
+		}
+		return sink->outputs[0];
+	}
+
+	template <typename T>
+	SmartPtr<DataObject<T>> CreateData(const vector<T>& elements, Dimensions& dimensions)
+	{
+		auto data = DataObject<T>::Create(nullptr, &dimensions);
+		copy(elements.begin(), elements.end(), data->GetData());
+		return data;
+	}
+
+	vector<float> CreateReal(size_t size, unsigned int seed)
+	{
+		mt19937 generator(seed);
+		normal_distribution<float> distribution(0.0f, 1.0f);
+		vector<float> elements(size);
+		for (auto& element : elements)
+		{
+			element = distribution(generator);
+		}
+
+		return elements;
+	}
+
+	template <typename T>
+	void CheckClose(const vector<T>& result, const vector<T>& expected)
+	{
+		BOOST_REQUIRE_EQUAL(result.size(), expected.size());
+		for (size_t i = 0; i < result.size(); ++i)
+		{
+			BOOST_CHECK_SMALL(abs(result[i] - expected[i]), 1e-4f);
+		}
+	}
+
+	/// Check the real transforms of the processor against its complex transform of the same data.
+	/**
+		\remarks dimensions are width x height x ..., height is 1 for 1D transforms.
+	*/
+	template <typename PROCESSOR>
+	void CheckRealTransforms(Dimensions& dimensions, unsigned int width, unsigned int height, unsigned int seed)
+	{
+		size_t size = 1;
+		for (unsigned int i = 0; i < dimensions.GetDimensionCount(); ++i)
+		{
+			DimensionType type;
+			unsigned int start, length;
+			dimensions.GetDimensionInfo(i, type, start, length);
+			size *= length;
+		}
+
+		auto real = CreateReal(size, seed);
+		vector<complex<float>> converted(real.begin(), real.end());
+		auto real_data = CreateData(real, dimensions);
+		auto complex_data = CreateData(converted, dimensions);
+		auto image_count = real.size() / (size_t(width) * height);
+
+		for (bool inverse : { false, true })
+		{
+			// Full centered spectrum, the negative frequencies filled in from Hermitian symmetry.
+			auto spectrum = Transform<complex<float>, PROCESSOR>(complex_data.get(), inverse);
+			CheckClose(Transform<complex<float>, PROCESSOR>(real_data.get(), inverse), spectrum);
+
+			// Half spectrum, the non-negative readout frequencies without fftshift.
+			unsigned int half_width = 0;
+			auto half = Transform<complex<float>, PROCESSOR>(real_data.get(), inverse, true, false, &half_width);
+			BOOST_CHECK_EQUAL(half_width, width / 2 + 1);
+			BOOST_REQUIRE_EQUAL(half.size(), image_count * height * half_width);
+
+			vector<complex<float>> expected;
+			for (size_t image = 0; image < image_count; ++image)
+			{
+				for (unsigned int y = 0; y < height; ++y)
+				{
+					auto row = spectrum.data() + (image * height + (y + height / 2) % height) * width;
+					for (unsigned int x = 0; x < half_width; ++x)
+					{
+						expected.push_back(row[(x + width / 2) % width]);
+					}
+				}
+			}
+			CheckClose(half, expected);
+
+			// Real output is only defined for half spectra of even widths.
+			if (width % 2 == 0)
+			{
+				Dimensions half_dimensions(dimensions);
+				DimensionType type;
+				unsigned int start, length;
+				half_dimensions.GetDimensionInfo(0, type, start, length);
+				half_dimensions.SetDimensionInfo(0, type, start, half_width);
+				auto half_data = CreateData(half, half_dimensions);
+
+				unsigned int real_width = 0;
+				auto restored = Transform<float, PROCESSOR>(half_data.get(), !inverse, false, true, &real_width);
+				BOOST_CHECK_EQUAL(real_width, width);
+				CheckClose(restored, real);
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(fft1d_real_transforms_match_complex_transform)
+{
+	for (unsigned int width : { 16u, 15u })
+	{
+		Dimensions dimensions;
+		dimensions(DimensionReadout, 0, width);
+		CheckRealTransforms<Fft1D>(dimensions, width, 1, width);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(fft2d_real_transforms_match_complex_transform)
+{
+	for (unsigned int width : { 12u, 9u })
+	{
+		for (unsigned int height : { 8u, 7u })
+		{
+			Dimensions dimensions;
+			dimensions(DimensionReadout, 0, width)
+				(DimensionPhaseEncoding, 0, height);
+			CheckRealTransforms<Fft2D>(dimensions, width, height, width * height);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(fft2d_real_transforms_batched)
+{
+	// Slices and channels are transformed as a batch of images.
+	const unsigned int width = 10, height = 6;
+	Dimensions dimensions;
+	dimensions(DimensionReadout, 0, width)
+		(DimensionPhaseEncoding, 0, height)
+		(DimensionSlice, 0, 3)
+		(DimensionChannel, 0, 2);
+	CheckRealTransforms<Fft2D>(dimensions, width, height, 1);
+
+	dimensions = Dimensions();
+	dimensions(DimensionReadout, 0, width - 1)
+		(DimensionPhaseEncoding, 0, height + 1)
+		(DimensionSlice, 0, 2);
+	CheckRealTransforms<Fft2D>(dimensions, width - 1, height + 1, 2);
+}
+
+BOOST_AUTO_TEST_CASE(fft2d_resolved_links)
+{
+	// Resolved links feed through the cached port handles and InputByHandle(), the result must
+	// be the same as with links looked up by name.
+	const unsigned int width = 8, height = 6;
+	Dimensions dimensions;
+	dimensions(DimensionReadout, 0, width)
+		(DimensionPhaseEncoding, 0, height)
+		(DimensionSlice, 0, 2);
+	auto real = CreateReal(size_t(width) * height * 2, 3);
+	vector<complex<float>> elements(real.begin(), real.end());
+
+	vector<complex<float>> expected;
+	for (bool resolved : { false, true })
+	{
+		auto forward = YapShared(new Fft2D);
+		SetProperty<bool>(forward.get(), L"InPlace", false);
+		auto inverse = YapShared(new Fft2D);
+		SetProperty<bool>(inverse.get(), L"Inverse", true);
+		auto sink = YapShared(new Sink<complex<float>>);
+		BOOST_REQUIRE(forward->Link(L"Output", inverse.get(), L"Input"));
+		BOOST_REQUIRE(inverse->Link(L"Output", sink.get(), L"Input"));
+		if (resolved)
+		{
+			forward->ResolveLinks();
+			inverse->ResolveLinks();
+		}
+
+		auto data = CreateData(elements, dimensions);
+		BOOST_REQUIRE(Input(forward.get(), L"Input", data.get()));
+		BOOST_REQUIRE_EQUAL(sink->outputs.size(), 1u);
+		if (resolved)
+		{
+			CheckClose(sink->outputs[0], expected);
+		}
+		else
+		{
+			expected = sink->outputs[0];
+		}
+	}
+}
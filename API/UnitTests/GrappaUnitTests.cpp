@@ -0,0 +1,134 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "../../GrappaRecon/Grappa.h"
+#include "TestProcessors.h"
+
+#include <complex>
+#include <random>
+#include <vector>
+
+using namespace Yap;
+using namespace Yap::Test;
+using namespace std;
+
+namespace
+{
+	class TestGrappa : public Grappa
+	{
+	public:
+		using Grappa::GetCoef;
+		using Grappa::FitCoef;
+		using Grappa::SolveRegularized;
+
+		size_t GetCachedCount() const
+		{
+			return _coef_cache.size();
+		}
+	};
+
+	const unsigned int Width = 16, Height = 32, CoilCount = 4, Rate = 2, AcsCount = 16, Block = 4;
+
+	/// Random width x height x coil k-space.
+	vector<complex<float>> CreateKSpace(unsigned int seed)
+	{
+		mt19937 generator(seed);
+		normal_distribution<float> distribution(0.0f, 1.0f);
+		vector<complex<float>> data(size_t(Width) * Height * CoilCount);
+		for (auto& element : data)
+		{
+			element = complex<float>(distribution(generator), distribution(generator));
+		}
+
+		return data;
+	}
+
+	arma::cx_fmat Fit(TestGrappa * grappa, vector<complex<float>>& data)
+	{
+		return grappa->GetCoef(data.data(), Rate, AcsCount, Block, Width, Height, CoilCount);
+	}
+
+	void CheckEqual(const arma::cx_fmat& coef, const arma::cx_fmat& expected, float tolerance)
+	{
+		BOOST_REQUIRE_EQUAL(coef.n_rows, expected.n_rows);
+		BOOST_REQUIRE_EQUAL(coef.n_cols, expected.n_cols);
+		for (size_t i = 0; i < coef.n_elem; ++i)
+		{
+			BOOST_CHECK_SMALL(abs(coef[i] - expected[i]), tolerance);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(grappa_unregularized_fit_matches_pinv)
+{
+	// Overdetermined and well conditioned, so the normal equations agree with the pseudo-inverse.
+	mt19937 generator(7);
+	normal_distribution<float> distribution(0.0f, 1.0f);
+	arma::cx_fmat a(60, 12), b(60, 3);
+	for (auto matrix : { &a, &b })
+	{
+		for (size_t i = 0; i < matrix->n_elem; ++i)
+		{
+			(*matrix)[i] = complex<float>(distribution(generator), distribution(generator));
+		}
+	}
+
+	arma::cx_fmat x;
+	BOOST_REQUIRE(TestGrappa::SolveRegularized(a, b, 0.0f, x));
+	CheckEqual(x, arma::cx_fmat(arma::pinv(a) * b), 1e-4f);
+
+	// With Lambda = 0 the weights are fitted with the pseudo-inverse.
+	auto grappa = YapShared(new TestGrappa);
+	SetProperty<double>(grappa.get(), L"Lambda", 0.0);
+	auto data = CreateKSpace(1);
+	CheckEqual(Fit(grappa.get(), data),
+		grappa->FitCoef(data.data(), Rate, AcsCount, Block, Width, Height, CoilCount, 0.0f), 0.0f);
+}
+
+BOOST_AUTO_TEST_CASE(grappa_cached_weights_equal_fresh_fit)
+{
+	const float lambda = 1e-3f;
+	auto grappa = YapShared(new TestGrappa);
+	SetProperty<double>(grappa.get(), L"Lambda", lambda);
+	auto data = CreateKSpace(2);
+
+	auto fitted = Fit(grappa.get(), data);
+	auto cached = Fit(grappa.get(), data);
+	BOOST_CHECK_EQUAL(grappa->GetCachedCount(), 1u);
+
+	auto fresh = grappa->FitCoef(data.data(), Rate, AcsCount, Block, Width, Height, CoilCount, lambda);
+	CheckEqual(fitted, fresh, 0.0f);
+	CheckEqual(cached, fresh, 0.0f);
+}
+
+BOOST_AUTO_TEST_CASE(grappa_changed_acs_lines_miss_cache)
+{
+	const float lambda = 1e-3f;
+	auto grappa = YapShared(new TestGrappa);
+	SetProperty<double>(grappa.get(), L"Lambda", lambda);
+	auto data = CreateKSpace(3);
+	auto original = Fit(grappa.get(), data);
+
+	// A single changed sample of the calibration region, e.g. the next frame of a dynamic series.
+	auto changed = data;
+	changed[size_t(Height / 2) * Width + Width / 2] += complex<float>(1.0f, 0.0f);
+	auto refitted = Fit(grappa.get(), changed);
+	BOOST_CHECK_EQUAL(grappa->GetCachedCount(), 2u);
+	CheckEqual(refitted, grappa->FitCoef(changed.data(), Rate, AcsCount, Block, Width, Height, CoilCount, lambda), 0.0f);
+
+	bool differs = false;
+	for (size_t i = 0; i < original.n_elem; ++i)
+	{
+		differs = differs || original[i] != refitted[i];
+	}
+	BOOST_CHECK(differs);
+
+	// The cache holds the weights of the last four calibration regions.
+	for (unsigned int seed = 10; seed < 14; ++seed)
+	{
+		auto other = CreateKSpace(seed);
+		Fit(grappa.get(), other);
+	}
+	BOOST_CHECK_EQUAL(grappa->GetCachedCount(), 4u);
+}
@@ -0,0 +1,120 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "Implement/LinkQueue.h"
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+
+using namespace Yap;
+
+namespace
+{
+	/// Records the values of the data it receives, can be stalled to simulate a slow display.
+	class SlowSink : public ProcessorImpl
+	{
+		IMPLEMENT_SHARED(SlowSink)
+	public:
+		SlowSink() : ProcessorImpl(L"SlowSink")
+		{
+			AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeAll);
+		}
+
+		SlowSink(const SlowSink& rhs) : ProcessorImpl(rhs) {}
+
+		virtual bool Input(const wchar_t * port, IData * data) override
+		{
+			std::lock_guard<std::mutex> lock(gate);
+			received.push_back(GetDataArray(data)[0]);
+			return !fail;
+		}
+
+		static int * GetDataArray(IData * data)
+		{
+			return dynamic_cast<IDataArray<int>*>(data)->GetData();
+		}
+
+		std::mutex gate;
+		std::vector<int> received;
+		bool fail = false;
+
+	protected:
+		~SlowSink() {}
+	};
+
+	SmartPtr<IntData> MakeData(int value)
+	{
+		Dimensions dimensions;
+		dimensions(DimensionReadout, 0, 1);
+		auto data = IntData::Create(nullptr, &dimensions);
+		data->GetData()[0] = value;
+		return data;
+	}
+
+	std::vector<int> Run(QueuePolicy policy, unsigned int capacity)
+	{
+		auto sink = YapShared(new SlowSink);
+		auto queue = YapShared(new LinkQueue(sink.get(), L"Input", capacity, policy));
+		{
+			std::lock_guard<std::mutex> stall(sink->gate);
+			for (int i = 0; i < 10; ++i)
+			{
+				queue->Input(L"Input", MakeData(i).get());
+			}
+		}
+		queue->Flush();
+
+		return sink->received;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(link_queue_coalesce_latest)
+{
+	// The first item may already be in the sink, only the latest one must be queued after it.
+	auto received = Run(QueuePolicyCoalesceLatest, 4);
+	BOOST_REQUIRE(!received.empty() && received.size() <= 2);
+	BOOST_CHECK(received.back() == 9);
+}
+
+BOOST_AUTO_TEST_CASE(link_queue_drop_oldest)
+{
+	auto received = Run(QueuePolicyDropOldest, 4);
+	BOOST_REQUIRE(received.size() >= 4 && received.size() <= 5);
+	BOOST_CHECK(received.back() == 9);
+	BOOST_CHECK(received[received.size() - 4] == 6);
+}
+
+BOOST_AUTO_TEST_CASE(link_queue_block_keeps_all)
+{
+	auto sink = YapShared(new SlowSink);
+	auto queue = YapShared(new LinkQueue(sink.get(), L"Input", 2, QueuePolicyBlock));
+	for (int i = 0; i < 100; ++i)
+	{
+		queue->Input(L"Input", MakeData(i).get());
+	}
+	queue->Flush();
+
+	BOOST_REQUIRE(sink->received.size() == 100);
+	for (int i = 0; i < 100; ++i)
+	{
+		BOOST_CHECK(sink->received[i] == i);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(link_queue_reports_failure_to_next_input)
+{
+	auto sink = YapShared(new SlowSink);
+	sink->fail = true;
+	auto queue = YapShared(new LinkQueue(sink.get(), L"Input", 2, QueuePolicyBlock));
+	BOOST_CHECK(queue->Input(L"Input", MakeData(0).get()));
+	queue->Flush();
+
+	// The failure is reported once, the data of the failing call is not queued.
+	sink->fail = false;
+	BOOST_CHECK(!queue->Input(L"Input", MakeData(1).get()));
+	BOOST_CHECK(queue->Input(L"Input", MakeData(2).get()));
+	queue->Flush();
+	BOOST_CHECK((sink->received == std::vector<int>{ 0, 2 }));
+}
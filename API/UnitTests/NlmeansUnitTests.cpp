@@ -0,0 +1,134 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "BasicRecon/Nlmeans.h"
+#include "BasicRecon/NoiseEstimation.h"
+#include "Implement/ExecutionEngine.h"
+#include "TestProcessors.h"
+
+#include <random>
+#include <vector>
+
+using namespace Yap;
+using namespace Yap::Test;
+using namespace std;
+
+namespace
+{
+	class TestNlmeans : public Nlmeans
+	{
+	public:
+		using Nlmeans::nlmeans_ipol;
+		using Nlmeans::nlmeans_tile;
+	};
+
+	/// Noisy disk on a zero background, so that the corners only hold noise.
+	vector<float> CreateImage(unsigned int width, unsigned int height, float sigma, unsigned int seed)
+	{
+		mt19937 generator(seed);
+		normal_distribution<float> noise(0.0f, sigma);
+		vector<float> image(size_t(width) * height);
+		for (unsigned int y = 0; y < height; ++y)
+		{
+			for (unsigned int x = 0; x < width; ++x)
+			{
+				float dx = x - width / 2.0f, dy = y - height / 2.0f;
+				auto inside = dx * dx + dy * dy < width * height / 10.0f;
+				image[size_t(y) * width + x] = (inside ? 100.0f + float(seed) * x : 0.0f) + noise(generator);
+			}
+		}
+
+		return image;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(nlmeans_tiles_match_single_tile)
+{
+	const unsigned int width = 23, height = 45, win = 2, bloc = 4;
+	const float sigma = 10.0f, filter = 0.4f;
+	auto input = CreateImage(width, height, sigma, 1);
+
+	vector<float> tiled(input.size());
+	TestNlmeans::nlmeans_ipol(win, bloc, sigma, filter, input.data(), tiled.data(), width, height);
+
+	// All rows as one tile, accumulated into buffers covering the whole image.
+	float fh = filter * sigma;
+	vector<float> sum(input.size(), 0.0f), count(input.size(), 0.0f);
+	TestNlmeans::nlmeans_tile(win, bloc, sigma * sigma, fh * fh * float((2 * win + 1) * (2 * win + 1)),
+		input.data(), width, height, 0, height, sum.data(), count.data(), 0);
+
+	for (size_t i = 0; i < input.size(); ++i)
+	{
+		auto expected = (count[i] > 0.0f) ? sum[i] / count[i] : input[i];
+		BOOST_CHECK_CLOSE(tiled[i], expected, 1e-3);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(nlmeans_independent_of_thread_count)
+{
+	const unsigned int width = 31, height = 50;
+	auto input = CreateImage(width, height, 10.0f, 2);
+
+	auto& engine = ExecutionEngine::GetInstance();
+	auto thread_count = engine.GetThreadCount();
+
+	// The partial sums of the tiles are merged in tile order, so the result is exactly the same.
+	vector<float> reference;
+	for (unsigned int threads : { 0u, 1u, 3u })
+	{
+		engine.SetThreadCount(threads);
+
+		vector<float> output(input.size());
+		TestNlmeans::nlmeans_ipol(2, 5, 10.0f, 0.4f, input.data(), output.data(), width, height);
+		if (reference.empty())
+		{
+			reference = output;
+		}
+		else
+		{
+			BOOST_CHECK(output == reference);
+		}
+	}
+
+	engine.SetThreadCount(thread_count);
+}
+
+BOOST_AUTO_TEST_CASE(nlmeans_denoises_each_image_of_a_volume)
+{
+	const unsigned int width = 40, height = 40, slice_count = 3;
+	const size_t image_size = size_t(width) * height;
+
+	Dimensions dimensions;
+	dimensions(DimensionReadout, 0, width)
+		(DimensionPhaseEncoding, 0, height)
+		(DimensionSlice, 0, slice_count);
+	auto volume = FloatData::Create(nullptr, &dimensions);
+	for (unsigned int slice = 0; slice < slice_count; ++slice)
+	{
+		auto image = CreateImage(width, height, 10.0f, slice + 3);
+		copy(image.begin(), image.end(), volume->GetData() + slice * image_size);
+	}
+
+	auto nlmeans = YapShared(new TestNlmeans);
+	auto sink = YapShared(new Sink<float>);
+	BOOST_REQUIRE(nlmeans->Link(L"Output", sink.get(), L"Input"));
+	BOOST_REQUIRE(Input(nlmeans.get(), L"Input", volume.get()));
+	BOOST_REQUIRE_EQUAL(sink->outputs.size(), 1u);
+	auto& output = sink->outputs[0];
+	BOOST_REQUIRE_EQUAL(output.size(), image_size * slice_count);
+
+	// The noise level of the first image is used for all of them, it selects a 3 x 3 patch and
+	// a 21 x 21 search window.
+	float sigma;
+	BOOST_REQUIRE(NoiseEstimation::GetInstance().GetSigma(volume.get(), sigma));
+	BOOST_REQUIRE(sigma > 0.0f && sigma <= 15.0f);
+
+	for (unsigned int slice = 0; slice < slice_count; ++slice)
+	{
+		vector<float> expected(image_size);
+		TestNlmeans::nlmeans_ipol(1, 10, sigma, 0.4f, volume->GetData() + slice * image_size,
+			expected.data(), width, height);
+		BOOST_CHECK(equal(expected.begin(), expected.end(), output.begin() + slice * image_size));
+	}
+}
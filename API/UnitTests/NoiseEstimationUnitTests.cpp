@@ -0,0 +1,179 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "BasicRecon/NoiseEstimation.h"
+#include "Implement/DataObject.h"
+#include "Implement/VariableSpace.h"
+
+#include <algorithm>
+#include <cmath>
+#include <complex>
+#include <random>
+#include <vector>
+
+using namespace Yap;
+using namespace std;
+
+namespace
+{
+	/// Smooth ramp in the center, zero in the corners, plus Gaussian noise.
+	vector<float> CreateImage(unsigned int width, unsigned int height, float sigma, unsigned int seed)
+	{
+		mt19937 generator(seed);
+		normal_distribution<float> noise(0.0f, sigma);
+		vector<float> image(size_t(width) * height);
+		for (unsigned int y = 0; y < height; ++y)
+		{
+			for (unsigned int x = 0; x < width; ++x)
+			{
+				auto inside = x >= width / 4 && x < width * 3 / 4 && y >= height / 4 && y < height * 3 / 4;
+				image[size_t(y) * width + x] = (inside ? 200.0f + 0.5f * x + 0.25f * y : 0.0f) + noise(generator);
+			}
+		}
+
+		return image;
+	}
+
+	SmartPtr<FloatData> CreateData(const vector<float>& image, unsigned int width, unsigned int height,
+		IVariableContainer * series)
+	{
+		Dimensions dimensions;
+		dimensions(DimensionReadout, 0, width)(DimensionPhaseEncoding, 0, height);
+		auto data = FloatData::Create(nullptr, &dimensions);
+		copy(image.begin(), image.end(), data->GetData());
+		data->SetVariables(series);
+
+		return data;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(noise_estimation_corner)
+{
+	auto image = CreateImage(128, 96, 5.0f, 1);
+	BOOST_CHECK_CLOSE(NoiseEstimation::EstimateCorner(image.data(), 128, 96, 16), 5.0f, 10.0f);
+}
+
+BOOST_AUTO_TEST_CASE(noise_estimation_wavelet_mad)
+{
+	// 37 columns give 18 blocks per row, 16 of them by the SSE path and 2 by the scalar loop.
+	for (auto width : { 128u, 37u })
+	{
+		const unsigned int height = 91;
+		auto image = CreateImage(width, height, 5.0f, 2);
+		auto sigma = NoiseEstimation::EstimateWaveletMad(image.data(), width, height);
+		BOOST_CHECK_CLOSE(sigma, 5.0f, 10.0f);
+
+		// Median of the diagonal Haar coefficients computed directly.
+		vector<double> coefficients;
+		for (unsigned int y = 0; y + 1 < height; y += 2)
+		{
+			for (unsigned int x = 0; x + 1 < width; x += 2)
+			{
+				auto pixel = [&](unsigned int dx, unsigned int dy) {
+					return double(image[size_t(y + dy) * width + x + dx]);
+				};
+				coefficients.push_back(0.5 * fabs(pixel(0, 0) - pixel(1, 0) - pixel(0, 1) + pixel(1, 1)));
+			}
+		}
+		auto median = coefficients.begin() + coefficients.size() / 2;
+		nth_element(coefficients.begin(), median, coefficients.end());
+		BOOST_CHECK_CLOSE(sigma, *median / 0.6745, 1e-3);
+	}
+}
+
+BOOST_AUTO_TEST_CASE(noise_estimation_background_histogram)
+{
+	// The background of a magnitude image is Rayleigh distributed with its mode at sigma.
+	const unsigned int width = 128, height = 128;
+	const float sigma = 4.0f;
+	mt19937 generator(3);
+	normal_distribution<float> noise(0.0f, sigma);
+	vector<float> image(size_t(width) * height);
+	for (unsigned int y = 0; y < height; ++y)
+	{
+		for (unsigned int x = 0; x < width; ++x)
+		{
+			auto inside = x >= 48 && x < 80 && y >= 48 && y < 80;
+			complex<float> value(inside ? 300.0f : 0.0f, 0.0f);
+			image[size_t(y) * width + x] = abs(value + complex<float>(noise(generator), noise(generator)));
+		}
+	}
+
+	BOOST_CHECK_CLOSE(NoiseEstimation::EstimateBackgroundHistogram(image.data(), width, height), sigma, 10.0f);
+}
+
+BOOST_AUTO_TEST_CASE(noise_estimation_cache)
+{
+	auto& estimation = NoiseEstimation::GetInstance();
+	estimation.Reset();
+
+	const unsigned int width = 64, height = 64;
+	VariableSpace series;
+	auto first = CreateData(CreateImage(width, height, 5.0f, 4), width, height, series.Variables());
+	auto second = CreateData(CreateImage(width, height, 20.0f, 5), width, height, series.Variables());
+
+	// Later images of the series get the estimate of the first one.
+	float corner, sigma;
+	BOOST_REQUIRE(estimation.GetSigma(first.get(), corner));
+	BOOST_REQUIRE(estimation.GetSigma(second.get(), sigma));
+	BOOST_CHECK_EQUAL(sigma, corner);
+
+	// An estimate of another method is not returned for NoiseMethodAny unless it was selected.
+	float wavelet;
+	BOOST_REQUIRE(estimation.GetSigma(first.get(), wavelet, NoiseMethodWaveletMad));
+	BOOST_CHECK_NE(wavelet, corner);
+	BOOST_REQUIRE(estimation.GetSigma(second.get(), sigma));
+	BOOST_CHECK_EQUAL(sigma, corner);
+
+	BOOST_REQUIRE(estimation.SelectSigma(second.get(), sigma, NoiseMethodWaveletMad));
+	BOOST_CHECK_EQUAL(sigma, wavelet);
+	BOOST_REQUIRE(estimation.GetSigma(second.get(), sigma));
+	BOOST_CHECK_EQUAL(sigma, wavelet);
+
+	// After rescaling, the series is estimated again from the data at its new scale.
+	estimation.Invalidate(second.get());
+	BOOST_REQUIRE(estimation.GetSigma(second.get(), sigma));
+	BOOST_CHECK_CLOSE(sigma, 20.0f, 15.0f);
+
+	// Other series are independent.
+	VariableSpace other_series;
+	auto other = CreateData(CreateImage(width, height, 10.0f, 6), width, height, other_series.Variables());
+	BOOST_REQUIRE(estimation.GetSigma(other.get(), sigma));
+	BOOST_CHECK_CLOSE(sigma, 10.0f, 15.0f);
+
+	estimation.Reset();
+}
+
+BOOST_AUTO_TEST_CASE(noise_estimation_cache_series_id)
+{
+	auto& estimation = NoiseEstimation::GetInstance();
+	estimation.Reset();
+
+	// Copies of the variables, e.g. one per slice from SliceIterator, belong to the series of their series_id.
+	const unsigned int width = 64, height = 64;
+	VariableSpace series;
+	series.AddVariable(L"int", L"series_id", L"series id.");
+	series.Set(L"series_id", 1);
+	VariableSpace first_copy(series), second_copy(series), untagged_copy;
+	BOOST_REQUIRE(first_copy.Variables() != second_copy.Variables());
+
+	auto first = CreateData(CreateImage(width, height, 5.0f, 7), width, height, first_copy.Variables());
+	auto second = CreateData(CreateImage(width, height, 20.0f, 8), width, height, second_copy.Variables());
+	float corner, sigma;
+	BOOST_REQUIRE(estimation.GetSigma(first.get(), corner));
+	BOOST_REQUIRE(estimation.GetSigma(second.get(), sigma));
+	BOOST_CHECK_EQUAL(sigma, corner);
+
+	// Invalidating one copy drops the estimate of the whole series.
+	estimation.Invalidate(first.get());
+	BOOST_REQUIRE(estimation.GetSigma(second.get(), sigma));
+	BOOST_CHECK_CLOSE(sigma, 20.0f, 15.0f);
+
+	// Without a series_id each container is a series of its own.
+	auto untagged = CreateData(CreateImage(width, height, 20.0f, 8), width, height, untagged_copy.Variables());
+	BOOST_REQUIRE(estimation.GetSigma(untagged.get(), sigma));
+	BOOST_CHECK_CLOSE(sigma, 20.0f, 15.0f);
+
+	estimation.Reset();
+}
@@ -789,14 +789,14 @@ BOOST_AUTO_TEST_CASE(processor_Nlmeans)
 	auto input_port = inputs->Find(L"Input");
 	BOOST_CHECK(input_port != nullptr);
 	BOOST_CHECK(input_port->GetDataType() == DataTypeFloat);
-	BOOST_CHECK(input_port->GetDimensionCount() == 2);
+	BOOST_CHECK(input_port->GetDimensionCount() == YAP_ANY_DIMENSION);
 
 	auto outputs = processor->Outputs();
 	BOOST_CHECK(outputs != nullptr);
 	auto output_port = outputs->Find(L"Output");
 	BOOST_CHECK(output_port != nullptr);
 	BOOST_CHECK(output_port->GetDataType() == DataTypeFloat);
-	BOOST_CHECK(output_port->GetDimensionCount() == 2);
+	BOOST_CHECK(output_port->GetDimensionCount() == YAP_ANY_DIMENSION);
 }
 
 BOOST_AUTO_TEST_CASE(processor_SamplingMaskCreator)
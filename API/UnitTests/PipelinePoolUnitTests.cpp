@@ -0,0 +1,140 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "Implement/PipelinePool.h"
+
+#include <thread>
+#include <vector>
+
+using namespace Yap;
+
+namespace
+{
+	/// Adds the value of property Offset to the data.
+	class Adder : public ProcessorImpl
+	{
+		IMPLEMENT_SHARED(Adder)
+	public:
+		Adder() : ProcessorImpl(L"Adder")
+		{
+			AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeInt);
+			AddOutput(L"Output", YAP_ANY_DIMENSION, DataTypeInt);
+			AddProperty<int>(L"Offset", 1, L"Value added to the data.");
+		}
+
+		Adder(const Adder& rhs) : ProcessorImpl(rhs) {}
+
+		virtual bool Input(const wchar_t * port, IData * data) override
+		{
+			auto output = CreateData<int>(data);
+			output->GetData()[0] = dynamic_cast<IDataArray<int>*>(data)->GetData()[0] + GetProperty<int>(L"Offset");
+			return Feed(L"Output", output.get());
+		}
+
+	protected:
+		~Adder() {}
+	};
+
+	class Collector : public ProcessorImpl
+	{
+		IMPLEMENT_SHARED(Collector)
+	public:
+		Collector() : ProcessorImpl(L"Collector")
+		{
+			AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeInt);
+		}
+
+		Collector(const Collector& rhs) : ProcessorImpl(rhs) {}
+
+		virtual bool Input(const wchar_t * port, IData * data) override
+		{
+			received.push_back(dynamic_cast<IDataArray<int>*>(data)->GetData()[0]);
+			return true;
+		}
+
+		std::vector<int> received;
+
+	protected:
+		~Collector() {}
+	};
+
+	SmartPtr<CompositeProcessor> CreatePipeline()
+	{
+		auto pipeline = YapShared(new CompositeProcessor(L"Pipeline"));
+		auto first = new Adder;
+		first->SetInstanceId(L"first");
+		auto second = new Adder;
+		second->SetInstanceId(L"second");
+		auto collector = new Collector;
+		collector->SetInstanceId(L"collector");
+
+		pipeline->AddProcessor(first);
+		pipeline->AddProcessor(second);
+		pipeline->AddProcessor(collector);
+		first->Link(L"Output", second, L"Input");
+		second->Link(L"Output", collector, L"Input");
+		pipeline->MapInput(L"Input", L"first", L"Input");
+
+		return pipeline;
+	}
+
+	SmartPtr<IntData> MakeData(int value)
+	{
+		Dimensions dimensions;
+		dimensions(DimensionReadout, 0, 1);
+		auto data = IntData::Create(nullptr, &dimensions);
+		data->GetData()[0] = value;
+		return data;
+	}
+
+	Collector * GetCollector(CompositeProcessor * pipeline)
+	{
+		return dynamic_cast<Collector*>(pipeline->Find(L"collector"));
+	}
+}
+
+BOOST_AUTO_TEST_CASE(composite_processor_clone)
+{
+	auto pipeline = CreatePipeline();
+	auto clone = YapShared(dynamic_cast<CompositeProcessor*>(static_cast<IProcessor*>(pipeline.get())->Clone()));
+	BOOST_REQUIRE(clone);
+	BOOST_REQUIRE(clone->Find(L"first") != nullptr);
+	BOOST_CHECK(clone->Find(L"first") != pipeline->Find(L"first"));
+
+	BOOST_CHECK(clone->Input(L"Input", MakeData(10).get()));
+	BOOST_CHECK((GetCollector(clone.get())->received == std::vector<int>{ 12 }));
+	BOOST_CHECK(GetCollector(pipeline.get())->received.empty());
+}
+
+BOOST_AUTO_TEST_CASE(pipeline_pool_concurrent_jobs)
+{
+	auto prototype = CreatePipeline();
+	PipelinePool pool(prototype.get(), 2);
+	BOOST_REQUIRE_EQUAL(pool.GetSize(), 2);
+
+	std::vector<std::thread> workers;
+	for (int i = 0; i < 4; ++i)
+	{
+		workers.push_back(std::thread([&pool, i]() {
+			for (int job = 0; job < 25; ++job)
+			{
+				PipelinePool::Lease pipeline(pool);
+				pipeline->Input(L"Input", MakeData(i).get());
+			}
+		}));
+	}
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+
+	BOOST_CHECK_EQUAL(pool.GetIdleCount(), 2);
+
+	PipelinePool::Lease first(pool), second(pool);
+	BOOST_CHECK(first.get() != second.get());
+	BOOST_CHECK_EQUAL(pool.GetIdleCount(), 0);
+	BOOST_CHECK_EQUAL(GetCollector(first.get())->received.size() +
+		GetCollector(second.get())->received.size(), 100);
+	BOOST_CHECK(GetCollector(prototype.get())->received.empty());
+}
@@ -0,0 +1,458 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "Client/DataHelper.h"
+#include "Implement/ExecutionEngine.h"
+#include "Implement/ProcessorImpl.h"
+#include "TestProcessors.h"
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace Yap;
+
+namespace
+{
+	class Source : public ProcessorImpl
+	{
+		IMPLEMENT_SHARED(Source)
+	public:
+		Source() : ProcessorImpl(L"Source")
+		{
+			AddOutput(L"Unused", YAP_ANY_DIMENSION, DataTypeAll);
+			AddOutput(L"Output", YAP_ANY_DIMENSION, DataTypeAll);
+		}
+
+		Source(const Source& rhs) : ProcessorImpl(rhs) {}
+
+		virtual bool Input(const wchar_t * port, IData * data) override
+		{
+			return Feed(L"Output", data);
+		}
+
+	protected:
+		~Source() {}
+	};
+
+	/// Records how data was received, and whether it could have been modified in place.
+	class Sink : public ProcessorImpl
+	{
+		IMPLEMENT_SHARED(Sink)
+	public:
+		Sink() : ProcessorImpl(L"Sink")
+		{
+			AddInput(L"Unused", YAP_ANY_DIMENSION, DataTypeAll);
+			AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeAll);
+		}
+
+		Sink(const Sink& rhs) : ProcessorImpl(rhs) {}
+
+		virtual bool Input(const wchar_t * port, IData * data) override
+		{
+			by_handle.push_back(false);
+			writable.push_back(IsWritable(data));
+			return true;
+		}
+
+		virtual bool InputByHandle(PortHandle port, IData * data) override
+		{
+			BOOST_CHECK_EQUAL(port, GetInputHandle(L"Input"));
+			by_handle.push_back(true);
+			writable.push_back(IsWritable(data));
+			return true;
+		}
+
+		std::vector<bool> by_handle;
+		std::vector<bool> writable;
+
+	protected:
+		~Sink() {}
+	};
+}
+
+BOOST_AUTO_TEST_CASE(processor_resolved_links)
+{
+	auto source = YapShared(new Source);
+	auto first = YapShared(new Sink);
+	auto second = YapShared(new Sink);
+	BOOST_REQUIRE(source->Link(L"Output", first.get(), L"Input"));
+	BOOST_REQUIRE(source->Link(L"Output", second.get(), L"Input"));
+
+	Dimensions dimensions;
+	dimensions(DimensionReadout, 0, 4);
+	auto data = FloatData::Create(nullptr, &dimensions);
+
+	source->Input(L"Input", data.get());
+	source->ResolveLinks();
+	source->Input(L"Input", data.get());
+
+	BOOST_CHECK((first->by_handle == std::vector<bool>{ false, true }));
+	BOOST_CHECK((second->by_handle == std::vector<bool>{ false, true }));
+
+	// Only the last consumer may modify the data in place.
+	BOOST_CHECK((first->writable == std::vector<bool>{ false, false }));
+	BOOST_CHECK((second->writable == std::vector<bool>{ true, true }));
+
+	// Link() falls back to lookup by name till the links are resolved again.
+	auto third = YapShared(new Sink);
+	BOOST_REQUIRE(source->Link(L"Output", third.get(), L"Input"));
+	source->Input(L"Input", data.get());
+	BOOST_CHECK(!first->by_handle.back());
+	BOOST_CHECK(!third->by_handle.back());
+	BOOST_CHECK(!second->writable.back());
+}
+
+namespace
+{
+	class Scaler : public ProcessorImpl
+	{
+		IMPLEMENT_SHARED(Scaler)
+	public:
+		Scaler() : ProcessorImpl(L"Scaler")
+		{
+			AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeAll);
+			AddProperty<int>(L"Factor", 2, L"Scale factor.");
+			_factor = BindProperty<int>(L"Factor");
+		}
+
+		Scaler(const Scaler& rhs) : ProcessorImpl(rhs), _factor(rhs._factor) {}
+
+		virtual bool Input(const wchar_t * port, IData * data) override
+		{
+			return true;
+		}
+
+		int GetFactor()
+		{
+			return GetProperty<int>(_factor);
+		}
+
+		void SetFactor(int factor)
+		{
+			SetProperty<int>(_factor, factor);
+		}
+
+		PropertyHandle _factor;
+
+	protected:
+		~Scaler() {}
+	};
+}
+
+BOOST_AUTO_TEST_CASE(processor_property_binding)
+{
+	auto scaler = YapShared(new Scaler);
+	BOOST_CHECK_EQUAL(scaler->GetFactor(), 2);
+
+	// Changes made by name, e.g. by the pipeline constructor, are seen through the handle.
+	auto factor = dynamic_cast<ISimpleVariable<int>*>(scaler->GetProperties()->Find(L"Factor"));
+	BOOST_REQUIRE(factor != nullptr);
+	factor->Set(3);
+	BOOST_CHECK_EQUAL(scaler->GetFactor(), 3);
+
+	// Clones have their own properties.
+	auto clone = YapShared(dynamic_cast<Scaler*>(static_cast<IProcessor*>(scaler.get())->Clone()));
+	BOOST_REQUIRE(clone);
+	clone->SetFactor(5);
+	BOOST_CHECK_EQUAL(clone->GetFactor(), 5);
+	BOOST_CHECK_EQUAL(scaler->GetFactor(), 3);
+
+	// Mapped properties are rebound when the global variables are set.
+	VariableSpace globals;
+	BOOST_REQUIRE(globals.AddVariable(VariableInt, L"GlobalFactor", L""));
+	globals.Set<int>(L"GlobalFactor", 7);
+	BOOST_REQUIRE(scaler->MapProperty(L"Factor", L"GlobalFactor", true, true));
+	BOOST_REQUIRE(scaler->SetGlobalVariables(globals.Variables()));
+	BOOST_CHECK_EQUAL(scaler->GetFactor(), 7);
+
+	scaler->SetFactor(8);
+	BOOST_CHECK_EQUAL(globals.Get<int>(L"GlobalFactor"), 8);
+	BOOST_CHECK_EQUAL(factor->Get(), 3);
+}
+
+namespace
+{
+	/// Hands out consecutive slots of a block of four elements.
+	class Gatherer : public ProcessorImpl
+	{
+		IMPLEMENT_SHARED(Gatherer)
+	public:
+		Gatherer() : ProcessorImpl(L"Gatherer"), slot_count(0)
+		{
+			AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeAll);
+
+			Dimensions dimensions;
+			dimensions(DimensionReadout, 0, 4);
+			block = FloatData::Create(nullptr, &dimensions);
+		}
+
+		Gatherer(const Gatherer& rhs) : ProcessorImpl(rhs) {}
+
+		virtual bool Input(const wchar_t * port, IData * data) override
+		{
+			inputs.push_back(GetDataArray<float>(data));
+			return true;
+		}
+
+		virtual SmartPtr<IData> GetInputSlot(PortHandle port, int data_type, IDimensions * dimensions,
+			IData * reference) override
+		{
+			if (data_type != DataTypeFloat || slot_count == 4)
+				return SmartPtr<IData>();
+
+			return CreateData<float>(reference, block->GetData() + slot_count++, dimensions, block.get());
+		}
+
+		SmartPtr<FloatData> block;
+		unsigned int slot_count;
+		std::vector<float *> inputs;
+
+	protected:
+		~Gatherer() {}
+	};
+}
+
+BOOST_AUTO_TEST_CASE(processor_output_slots)
+{
+	auto producer = YapShared(new Test::Producer<float>);
+	auto gatherer = YapShared(new Gatherer);
+	BOOST_REQUIRE(producer->Link(L"Output", gatherer.get(), L"Input"));
+
+	Dimensions dimensions;
+	dimensions(DimensionReadout, 0, 1);
+	auto data = FloatData::Create(nullptr, &dimensions);
+
+	producer->Input(L"Input", data.get());
+	producer->ResolveLinks();
+	producer->Input(L"Input", data.get());
+
+	// The producer wrote straight into the block of the gatherer.
+	auto block = gatherer->block->GetData();
+	BOOST_CHECK((producer->outputs == std::vector<float *>{ block, block + 1 }));
+	BOOST_CHECK(gatherer->inputs == producer->outputs);
+	BOOST_CHECK_EQUAL(block[1], 1.0f);
+
+	// Data fed to several processors is allocated as usual.
+	auto sink = YapShared(new Sink);
+	BOOST_REQUIRE(producer->Link(L"Output", sink.get(), L"Input"));
+	producer->Input(L"Input", data.get());
+	BOOST_CHECK_EQUAL(gatherer->slot_count, 2u);
+	BOOST_CHECK(gatherer->inputs.back() != block + 2);
+}
+
+namespace
+{
+	/// Feeds each line of the input as a view, like SliceIterator does with slices.
+	class LineIterator : public ProcessorImpl
+	{
+		IMPLEMENT_SHARED(LineIterator)
+	public:
+		LineIterator() : ProcessorImpl(L"LineIterator")
+		{
+			AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeAll);
+			AddOutput(L"Output", YAP_ANY_DIMENSION, DataTypeAll);
+		}
+
+		LineIterator(const LineIterator& rhs) : ProcessorImpl(rhs) {}
+
+		virtual bool Input(const wchar_t * port, IData * data) override
+		{
+			auto dimensions = data->GetDimensions();
+			Dimension readout, phase_encoding;
+			dimensions->GetDimensionInfo(0, readout.type, readout.start_index, readout.length);
+			dimensions->GetDimensionInfo(1, phase_encoding.type, phase_encoding.start_index, phase_encoding.length);
+
+			Dimensions line_dimensions;
+			line_dimensions(readout.type, 0, readout.length);
+
+			TaskGroup tasks;
+			for (unsigned int i = 0; i < phase_encoding.length; ++i)
+			{
+				auto line = CreateData<float>(data, GetDataArray<float>(data) + i * readout.length,
+					line_dimensions, data);
+				FeedAsync(tasks, L"Output", line.get());
+			}
+
+			return tasks.Wait();
+		}
+
+	protected:
+		~LineIterator() {}
+	};
+
+	/// Negates the input in place when allowed, and records if it had to copy.
+	class Negator : public ProcessorImpl
+	{
+		IMPLEMENT_SHARED(Negator)
+	public:
+		Negator() : ProcessorImpl(L"Negator"), copies(0), in_place(0)
+		{
+			AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeAll);
+			SetReentrant(true);
+		}
+
+		Negator(const Negator& rhs) : ProcessorImpl(rhs), copies(0), in_place(0) {}
+
+		virtual bool Input(const wchar_t * port, IData * data) override
+		{
+			auto output = MakeWritable(data);
+			auto values = GetDataArray<float>(output.get());
+			if (output.get() == data)
+			{
+				++in_place;
+			}
+			else
+			{
+				++copies;
+			}
+
+			DataHelper helper(output.get());
+			for (size_t i = 0; i < helper.GetDataSize(); ++i)
+			{
+				values[i] = -values[i];
+			}
+			return true;
+		}
+
+		std::atomic<unsigned int> copies;
+		std::atomic<unsigned int> in_place;
+
+	protected:
+		~Negator() {}
+	};
+}
+
+BOOST_AUTO_TEST_CASE(processor_iterator_in_place)
+{
+	auto& engine = ExecutionEngine::GetInstance();
+	auto thread_count = engine.GetThreadCount();
+
+	Dimensions dimensions;
+	dimensions(DimensionReadout, 0, 4)(DimensionPhaseEncoding, 0, 3);
+	auto data = FloatData::Create(nullptr, &dimensions);
+
+	for (unsigned int threads : { 0u, 2u })
+	{
+		engine.SetThreadCount(threads);
+
+		auto source = YapShared(new Source);
+		auto iterator = YapShared(new LineIterator);
+		auto negator = YapShared(new Negator);
+		BOOST_REQUIRE(source->Link(L"Output", iterator.get(), L"Input"));
+		BOOST_REQUIRE(iterator->Link(L"Output", negator.get(), L"Input"));
+
+		// Views of the input are written in place, although the iterator, the pending tasks
+		// and the caller all keep references to the data.
+		for (size_t i = 0; i < 12; ++i)
+		{
+			data->GetData()[i] = float(i);
+		}
+		BOOST_REQUIRE(source->Input(L"Input", data.get()));
+		BOOST_CHECK_EQUAL(negator->in_place.load(), 3u);
+		BOOST_CHECK_EQUAL(negator->copies.load(), 0u);
+		BOOST_CHECK_EQUAL(data->GetData()[11], -11.0f);
+
+		// The views are copied if the iterator is not the last consumer of its input.
+		auto sink = YapShared(new Sink);
+		BOOST_REQUIRE(source->Link(L"Output", sink.get(), L"Input"));
+		BOOST_REQUIRE(source->Input(L"Input", data.get()));
+		BOOST_CHECK_EQUAL(negator->copies.load(), 3u);
+		BOOST_CHECK_EQUAL(data->GetData()[11], -11.0f);
+	}
+
+	engine.SetThreadCount(thread_count);
+}
+
+namespace
+{
+	/// Not reentrant, negates the input in place and fails on negative input.
+	class SerialNegator : public ProcessorImpl
+	{
+		IMPLEMENT_SHARED(SerialNegator)
+	public:
+		SerialNegator() : ProcessorImpl(L"SerialNegator"), calls(0), in_place(0), active(0), max_active(0)
+		{
+			AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeAll);
+		}
+
+		SerialNegator(const SerialNegator& rhs) : ProcessorImpl(rhs), calls(0), in_place(0), active(0), max_active(0) {}
+
+		virtual bool Input(const wchar_t * port, IData * data) override
+		{
+			auto current = ++active;
+			if (current > max_active)
+			{
+				max_active = current;
+			}
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+
+			auto output = MakeWritable(data);
+			if (output.get() == data)
+			{
+				++in_place;
+			}
+
+			auto values = GetDataArray<float>(output.get());
+			bool succeeded = values[0] >= 0.0f;
+			DataHelper helper(output.get());
+			for (size_t i = 0; i < helper.GetDataSize(); ++i)
+			{
+				values[i] = -values[i];
+			}
+
+			++calls;
+			--active;
+			return succeeded;
+		}
+
+		std::atomic<unsigned int> calls;
+		std::atomic<unsigned int> in_place;
+		std::atomic<unsigned int> active;
+		std::atomic<unsigned int> max_active;
+
+	protected:
+		~SerialNegator() {}
+	};
+}
+
+BOOST_AUTO_TEST_CASE(processor_queues_inputs_of_busy_processor)
+{
+	auto& engine = ExecutionEngine::GetInstance();
+	auto thread_count = engine.GetThreadCount();
+	engine.SetThreadCount(2);
+
+	Dimensions dimensions;
+	dimensions(DimensionReadout, 0, 4)(DimensionPhaseEncoding, 0, 8);
+	auto data = FloatData::Create(nullptr, &dimensions);
+	for (size_t i = 0; i < 32; ++i)
+	{
+		data->GetData()[i] = float(i);
+	}
+
+	auto source = YapShared(new Source);
+	auto iterator = YapShared(new LineIterator);
+	auto negator = YapShared(new SerialNegator);
+	BOOST_REQUIRE(source->Link(L"Output", iterator.get(), L"Input"));
+	BOOST_REQUIRE(iterator->Link(L"Output", negator.get(), L"Input"));
+
+	// Lines arriving while the negator is busy are queued to the thread running it, they are
+	// still processed one at a time and in place.
+	BOOST_REQUIRE(source->Input(L"Input", data.get()));
+	BOOST_CHECK_EQUAL(negator->calls.load(), 8u);
+	BOOST_CHECK_EQUAL(negator->in_place.load(), 8u);
+	BOOST_CHECK_EQUAL(negator->max_active.load(), 1u);
+	for (size_t i = 0; i < 32; ++i)
+	{
+		BOOST_CHECK_EQUAL(data->GetData()[i], -float(i));
+	}
+
+	// Failure of any of the queued inputs is reported by the group.
+	BOOST_CHECK(!source->Input(L"Input", data.get()));
+	BOOST_CHECK_EQUAL(negator->calls.load(), 16u);
+	BOOST_CHECK_EQUAL(negator->max_active.load(), 1u);
+
+	engine.SetThreadCount(thread_count);
+}
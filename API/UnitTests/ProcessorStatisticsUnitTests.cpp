@@ -0,0 +1,130 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "Implement/BufferPool.h"
+#include "Implement/ExecutionEngine.h"
+#include "Implement/ProcessorStatistics.h"
+#include "TestProcessors.h"
+
+#include <chrono>
+#include <thread>
+
+using namespace Yap;
+
+namespace
+{
+	/// Takes 30 ms per call, calls are serialized while the engine runs since it isn't reentrant.
+	class SlowProcessor : public ProcessorImpl
+	{
+		IMPLEMENT_SHARED(SlowProcessor)
+	public:
+		SlowProcessor() : ProcessorImpl(L"SlowProcessor")
+		{
+			AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeAll);
+			EnableStatistics(true);
+		}
+
+		SlowProcessor(const SlowProcessor& rhs) : ProcessorImpl(rhs) {}
+
+		virtual bool Input(const wchar_t * port, IData * data) override
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(30));
+			return true;
+		}
+
+	protected:
+		~SlowProcessor() {}
+	};
+}
+
+BOOST_AUTO_TEST_CASE(processor_statistics_nested_scopes)
+{
+	ProcessorStatistics outer, inner;
+	{
+		StatisticsScope outer_scope(&outer, nullptr);
+		{
+			StatisticsScope inner_scope(&inner, nullptr);
+			auto buffer = BufferPool::GetInstance().Allocate(1000);
+			BufferPool::GetInstance().Free(buffer);
+			std::this_thread::sleep_for(std::chrono::milliseconds(20));
+		}
+	}
+
+	auto outer_snapshot = outer.GetSnapshot();
+	auto inner_snapshot = inner.GetSnapshot();
+	BOOST_CHECK_EQUAL(outer_snapshot.calls, 1);
+	BOOST_CHECK_EQUAL(inner_snapshot.calls, 1);
+	BOOST_CHECK_EQUAL(inner_snapshot.allocations, 1);
+	BOOST_CHECK_EQUAL(outer_snapshot.allocations, 0);
+	BOOST_CHECK(outer_snapshot.wall_time >= inner_snapshot.wall_time);
+	BOOST_CHECK(outer_snapshot.self_time < inner_snapshot.self_time);
+}
+
+BOOST_AUTO_TEST_CASE(processor_statistics_excludes_blocked_wait)
+{
+	auto& engine = ExecutionEngine::GetInstance();
+	auto thread_count = engine.GetThreadCount();
+	engine.SetThreadCount(2);
+
+	ProcessorStatistics statistics;
+	{
+		StatisticsScope scope(&statistics, nullptr);
+		TaskGroup tasks;
+		tasks.Run([]() {
+			std::this_thread::sleep_for(std::chrono::milliseconds(50));
+			return true;
+		});
+		BOOST_CHECK(tasks.Wait());
+	}
+	engine.SetThreadCount(thread_count);
+
+	auto snapshot = statistics.GetSnapshot();
+	BOOST_CHECK(snapshot.wall_time >= 50000000ULL);
+	BOOST_CHECK(snapshot.self_time < 25000000ULL);
+}
+
+BOOST_AUTO_TEST_CASE(processor_statistics_excludes_input_lock_wait)
+{
+	auto& engine = ExecutionEngine::GetInstance();
+	auto thread_count = engine.GetThreadCount();
+	engine.SetThreadCount(2);
+
+	auto slow = YapShared(new SlowProcessor);
+	auto first = YapShared(new Test::Producer<float>);
+	auto second = YapShared(new Test::Producer<float>);
+	BOOST_REQUIRE(first->Link(L"Output", slow.get(), L"Input"));
+	BOOST_REQUIRE(second->Link(L"Output", slow.get(), L"Input"));
+
+	Dimensions dimensions;
+	dimensions(DimensionReadout, 0, 4);
+	TaskGroup tasks;
+	for (auto producer : { first.get(), second.get() })
+	{
+		tasks.Run([producer, &dimensions]() { return producer->Produce(&dimensions, 1.0f); });
+	}
+	BOOST_CHECK(tasks.Wait());
+	engine.SetThreadCount(thread_count);
+
+	// A call waiting for the other one to finish doesn't spend that time in the processor.
+	auto snapshot = slow->GetStatistics()->GetSnapshot();
+	BOOST_CHECK_EQUAL(snapshot.calls, 2);
+	BOOST_CHECK(snapshot.self_time >= 60000000ULL);
+	BOOST_CHECK(snapshot.self_time < 80000000ULL);
+}
+
+BOOST_AUTO_TEST_CASE(processor_statistics_json)
+{
+	ProcessorStatistics statistics;
+	statistics.RecordInput(3000, 2000, 1000, 64, 1, 256);
+	statistics.RecordOutput(32);
+
+	auto json = ProcessorStatistics::ToJson(statistics.GetSnapshot());
+	BOOST_CHECK(json.find(L"\"calls\": 1") != std::wstring::npos);
+	BOOST_CHECK(json.find(L"\"bytes_out\": 32") != std::wstring::npos);
+	BOOST_CHECK(json.find(L"\"self_time_histogram_us\": [0, 1]") != std::wstring::npos);
+
+	// Calls under 1 microsecond are counted in bucket 0.
+	statistics.RecordInput(500, 500, 500, 0, 0, 0);
+	BOOST_CHECK_EQUAL(statistics.GetSnapshot().histogram[0], 1);
+}
@@ -0,0 +1,111 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "BasicRecon/SliceMerger.h"
+#include "TestProcessors.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace Yap;
+using namespace Yap::Test;
+using namespace std;
+
+namespace
+{
+	Dimensions SliceDimensions(unsigned int width, unsigned int height, unsigned int slice)
+	{
+		Dimensions dimensions;
+		dimensions(DimensionReadout, 0, width)
+			(DimensionPhaseEncoding, 0, height)
+			(DimensionSlice, slice, 1);
+		return dimensions;
+	}
+}
+
+BOOST_AUTO_TEST_CASE(slice_merger_places_slices_by_index)
+{
+	const unsigned int width = 4, height = 2, slice_count = 3, slice_size = width * height;
+	auto merger = YapShared(new SliceMerger);
+	SetProperty<int>(merger.get(), L"SliceCount", slice_count);
+	auto producer = YapShared(new Producer<unsigned short>);
+	auto sink = YapShared(new Sink<unsigned short>);
+	BOOST_REQUIRE(producer->Link(L"Output", merger.get(), L"Input"));
+	BOOST_REQUIRE(merger->Link(L"Output", sink.get(), L"Input"));
+
+	// A slot which is never fed, e.g. by a producer bailing out, doesn't use up a position.
+	auto dimensions = SliceDimensions(width, height, 1);
+	BOOST_REQUIRE(producer->Produce(&dimensions, 99, true));
+
+	for (unsigned int slice : { 2u, 0u, 1u })
+	{
+		dimensions = SliceDimensions(width, height, slice);
+		BOOST_REQUIRE(producer->Produce(&dimensions, static_cast<unsigned short>(slice + 1)));
+	}
+
+	BOOST_REQUIRE_EQUAL(sink->outputs.size(), 1u);
+	auto& volume = sink->outputs[0];
+	BOOST_REQUIRE_EQUAL(volume.size(), size_t(slice_size) * slice_count);
+	for (unsigned int i = 0; i < volume.size(); ++i)
+	{
+		BOOST_CHECK_EQUAL(volume[i], i / slice_size + 1);
+	}
+
+	// The slices were written straight into the volume.
+	auto block = sink->arrays[0];
+	BOOST_CHECK((producer->outputs ==
+		vector<unsigned short *>{ block + slice_size, block + 2 * slice_size, block, block + slice_size }));
+}
+
+BOOST_AUTO_TEST_CASE(slice_merger_copies_slices_without_index)
+{
+	const unsigned int width = 4, height = 2, slice_count = 2;
+	auto merger = YapShared(new SliceMerger);
+	SetProperty<int>(merger.get(), L"SliceCount", slice_count);
+	auto sink = YapShared(new Sink<unsigned short>);
+	BOOST_REQUIRE(merger->Link(L"Output", sink.get(), L"Input"));
+
+	// Slices without a slice dimension fill the volume in the order they arrive.
+	Dimensions dimensions;
+	dimensions(DimensionReadout, 0, width)(DimensionPhaseEncoding, 0, height);
+	for (unsigned short value : { 5, 6 })
+	{
+		auto slice = UnsignedShortData::Create(nullptr, &dimensions);
+		fill(slice->GetData(), slice->GetData() + width * height, value);
+		BOOST_REQUIRE(Input(merger.get(), L"Input", slice.get()));
+	}
+
+	BOOST_REQUIRE_EQUAL(sink->outputs.size(), 1u);
+	BOOST_CHECK_EQUAL(sink->outputs[0].front(), 5);
+	BOOST_CHECK_EQUAL(sink->outputs[0].back(), 6);
+
+	// The same slice index twice is an error.
+	auto indexed = SliceDimensions(width, height, 1);
+	auto slice = UnsignedShortData::Create(nullptr, &indexed);
+	BOOST_CHECK(Input(merger.get(), L"Input", slice.get()));
+	BOOST_CHECK(!Input(merger.get(), L"Input", slice.get()));
+	BOOST_CHECK_EQUAL(sink->outputs.size(), 1u);
+}
+
+BOOST_AUTO_TEST_CASE(slice_merger_rejects_mismatched_slices)
+{
+	auto merger = YapShared(new SliceMerger);
+	SetProperty<int>(merger.get(), L"SliceCount", 2);
+	auto sink = YapShared(new Sink<unsigned short>);
+	BOOST_REQUIRE(merger->Link(L"Output", sink.get(), L"Input"));
+
+	auto first_dimensions = SliceDimensions(4, 2, 0);
+	auto first = UnsignedShortData::Create(nullptr, &first_dimensions);
+	BOOST_REQUIRE(Input(merger.get(), L"Input", first.get()));
+
+	// A larger slice doesn't fit the volume created for the first one.
+	auto larger_dimensions = SliceDimensions(8, 2, 1);
+	auto larger = UnsignedShortData::Create(nullptr, &larger_dimensions);
+	BOOST_CHECK(!Input(merger.get(), L"Input", larger.get()));
+
+	auto second_dimensions = SliceDimensions(4, 2, 1);
+	auto wrong_type = FloatData::Create(nullptr, &second_dimensions);
+	BOOST_CHECK(!Input(merger.get(), L"Input", wrong_type.get()));
+	BOOST_CHECK(sink->outputs.empty());
+}
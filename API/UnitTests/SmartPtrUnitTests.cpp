@@ -0,0 +1,139 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "Interface/smartptr.h"
+#include "Implement/DataObject.h"
+
+#include <atomic>
+#include <chrono>
+#include <complex>
+#include <thread>
+#include <vector>
+
+using namespace Yap;
+
+namespace
+{
+	std::atomic<int> s_destroyed{ 0 };
+
+	class SharedCounter : public ISharedObject
+	{
+		IMPLEMENT_SHARED(SharedCounter)
+	public:
+		SharedCounter() {}
+		SharedCounter(const SharedCounter&) {}
+
+	private:
+		~SharedCounter()
+		{
+			++s_destroyed;
+		}
+	};
+
+	const unsigned int THREAD_COUNT = 8;
+	const unsigned int COPY_COUNT = 200000;
+
+	template <typename TYPE>
+	void HammerCopies(SmartPtr<TYPE> source)
+	{
+		std::vector<std::thread> threads;
+		for (unsigned int i = 0; i < THREAD_COUNT; ++i)
+		{
+			threads.push_back(std::thread([source]() {
+				for (unsigned int j = 0; j < COPY_COUNT; ++j)
+				{
+					SmartPtr<TYPE> copy(source);
+					SmartPtr<TYPE> assigned;
+					assigned = copy;
+					SmartPtr<TYPE> moved(std::move(copy));
+				}
+			}));
+		}
+
+		for (auto& thread : threads)
+		{
+			thread.join();
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(smart_ptr_concurrent_copies)
+{
+	s_destroyed = 0;
+	{
+		auto counter = YapShared(new SharedCounter);
+		HammerCopies(counter);
+		BOOST_CHECK(s_destroyed == 0);
+	}
+	BOOST_CHECK(s_destroyed == 1);
+}
+
+BOOST_AUTO_TEST_CASE(smart_ptr_clone_starts_unreferenced)
+{
+	s_destroyed = 0;
+	{
+		auto counter = YapShared(new SharedCounter);
+		auto copy1 = counter;
+		auto copy2 = counter;
+
+		// A clone is a new object and must be deleted with its last reference.
+		auto clone = YapShared<SharedCounter>(static_cast<ISharedObject*>(counter.get())->Clone());
+		clone.reset();
+		BOOST_CHECK(s_destroyed == 1);
+	}
+	BOOST_CHECK(s_destroyed == 2);
+}
+
+BOOST_AUTO_TEST_CASE(data_object_concurrent_release)
+{
+	Dimensions dimensions;
+	dimensions(DimensionReadout, 0, 64)(DimensionPhaseEncoding, 0, 64)(DimensionSlice, 0, 16);
+
+	auto volume = ComplexFloatData::Create(nullptr, &dimensions);
+	BOOST_REQUIRE(volume);
+
+	// Slices keep the volume as parent and are released from different threads.
+	std::vector<SmartPtr<IData>> slices;
+	for (unsigned int i = 0; i < 16; ++i)
+	{
+		Dimensions slice_dimensions(dimensions);
+		slice_dimensions.SetDimension(DimensionSlice, 1, i);
+		slices.push_back(YapShared<IData>(ComplexFloatData::Create(nullptr,
+			volume->GetData() + i * 64 * 64, slice_dimensions, volume.get()).get()));
+	}
+	volume.reset();
+
+	std::vector<std::thread> threads;
+	for (auto& slice : slices)
+	{
+		threads.push_back(std::thread([slice]() {
+			for (unsigned int j = 0; j < COPY_COUNT / 10; ++j)
+			{
+				SmartPtr<IData> copy(slice);
+			}
+		}));
+	}
+	slices.clear();
+
+	for (auto& thread : threads)
+	{
+		thread.join();
+	}
+}
+
+BOOST_AUTO_TEST_CASE(smart_ptr_copy_benchmark)
+{
+	auto counter = YapShared(new SharedCounter);
+
+	auto start = std::chrono::high_resolution_clock::now();
+	for (unsigned int i = 0; i < COPY_COUNT * 10; ++i)
+	{
+		SmartPtr<SharedCounter> copy(counter);
+	}
+	auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::high_resolution_clock::now() - start).count();
+
+	BOOST_TEST_MESSAGE("SmartPtr copy + destroy, single thread: "
+		<< double(elapsed) / (COPY_COUNT * 10) << " ns");
+}
@@ -0,0 +1,112 @@
+#pragma once
+
+#ifndef TestProcessors_h__20171106
+#define TestProcessors_h__20171106
+
+#include <boost/test/unit_test.hpp>
+
+#include "Client/DataHelper.h"
+#include "Implement/DataObject.h"
+#include "Implement/ProcessorImpl.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace Yap
+{
+	namespace Test
+	{
+		/// Set a property of the processor by name, the test fails if it has another type.
+		template <typename T>
+		void SetProperty(IProcessor * processor, const wchar_t * name, typename variable_type_id<T>::set_type value)
+		{
+			auto property = dynamic_cast<ISimpleVariable<T>*>(processor->GetProperties()->Find(name));
+			BOOST_REQUIRE(property != nullptr);
+			property->Set(value);
+		}
+
+		/// Feed data to a port of the processor, Input() is protected in most processors.
+		inline bool Input(IProcessor * processor, const wchar_t * port, IData * data)
+		{
+			return processor->Input(port, data);
+		}
+
+		/// Keeps a copy of the elements of all data received, and the data itself.
+		template <typename T>
+		class Sink : public ProcessorImpl
+		{
+			IMPLEMENT_SHARED(Sink)
+		public:
+			Sink() : ProcessorImpl(L"Sink")
+			{
+				AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeAll);
+			}
+
+			Sink(const Sink& rhs) : ProcessorImpl(rhs) {}
+
+			virtual bool Input(const wchar_t * port, IData * data) override
+			{
+				DataHelper helper(data);
+				auto data_array = GetDataArray<T>(data);
+				BOOST_REQUIRE(data_array != nullptr);
+
+				outputs.push_back(std::vector<T>(data_array, data_array + helper.GetDataSize()));
+				arrays.push_back(data_array);
+				received.push_back(YapShared(data));
+				return true;
+			}
+
+			/// Return the dimension of the given type of the index-th data received.
+			Dimension GetDimension(size_t index, DimensionType type)
+			{
+				return DataHelper(received[index].get()).GetDimension(type);
+			}
+
+			std::vector<std::vector<T>> outputs;
+			std::vector<T *> arrays;
+			std::vector<SmartPtr<IData>> received;
+
+		protected:
+			~Sink() {}
+		};
+
+		/// Creates its output with CreateOutputData(), so it is written into the slots offered by
+		/// the consumer, see ProcessorImpl::GetInputSlot().
+		template <typename T>
+		class Producer : public ProcessorImpl
+		{
+			IMPLEMENT_SHARED(Producer)
+		public:
+			Producer() : ProcessorImpl(L"Producer")
+			{
+				AddOutput(L"Output", YAP_ANY_DIMENSION, DataTypeAll);
+			}
+
+			Producer(const Producer& rhs) : ProcessorImpl(rhs) {}
+
+			/// Produce data with the dimensions of the input, filled with ones.
+			virtual bool Input(const wchar_t * port, IData * data) override
+			{
+				return Produce(data->GetDimensions(), T(1), false, data);
+			}
+
+			/// Create data filled with value, feed it unless abandon is set.
+			bool Produce(IDimensions * dimensions, T value, bool abandon = false, IData * reference = nullptr)
+			{
+				auto output = CreateOutputData<T>(L"Output", reference, dimensions);
+				DataHelper helper(output.get());
+				std::fill(output->GetData(), output->GetData() + helper.GetDataSize(), value);
+				outputs.push_back(output->GetData());
+
+				return abandon || Feed(L"Output", output.get());
+			}
+
+			std::vector<T *> outputs;
+
+		protected:
+			~Producer() {}
+		};
+	}
+}
+
+#endif // TestProcessors_h__
@@ -0,0 +1,125 @@
+#include "stdafx.h"
+
+#include <boost/test/unit_test.hpp>
+
+#include "BasicRecon/Fft2D.h"
+#include "BasicRecon/ZeroFilledFft2D.h"
+#include "BasicRecon/ZeroFilling.h"
+#include "TestProcessors.h"
+
+#include <algorithm>
+#include <complex>
+#include <random>
+#include <vector>
+
+using namespace Yap;
+using namespace Yap::Test;
+using namespace std;
+
+namespace
+{
+	const unsigned int Width = 8, Height = 6;
+
+	/// Random Width x Height x slice_count k-space, without a slice dimension if slice_count is 0.
+	SmartPtr<ComplexFloatData> CreateKSpace(unsigned int slice_count, unsigned int seed)
+	{
+		Dimensions dimensions;
+		dimensions(DimensionReadout, 0, Width)
+			(DimensionPhaseEncoding, 0, Height);
+		if (slice_count > 0)
+		{
+			dimensions(DimensionSlice, 0, slice_count);
+		}
+		auto data = ComplexFloatData::Create(nullptr, &dimensions);
+
+		mt19937 generator(seed);
+		normal_distribution<float> distribution(0.0f, 1.0f);
+		generate(data->GetData(), data->GetData() + size_t(Width) * Height * max(slice_count, 1u), [&]() {
+			return complex<float>(distribution(generator), distribution(generator));
+		});
+
+		return data;
+	}
+
+	void SetZeroFilling(IProcessor * processor, int dest_width, int dest_height, int left, int top)
+	{
+		SetProperty<int>(processor, L"DestWidth", dest_width);
+		SetProperty<int>(processor, L"DestHeight", dest_height);
+		SetProperty<int>(processor, L"Left", left);
+		SetProperty<int>(processor, L"Top", top);
+	}
+
+	/// Check ZeroFilledFft2D against ZeroFilling followed by Fft2D.
+	void CheckEquivalence(IData * data, int dest_width, int dest_height, int left, int top, bool inverse)
+	{
+		auto zero_filling = YapShared(new ZeroFilling);
+		SetZeroFilling(zero_filling.get(), dest_width, dest_height, left, top);
+		auto fft = YapShared(new Fft2D);
+		SetProperty<bool>(fft.get(), L"Inverse", inverse);
+		auto expected = YapShared(new Sink<complex<float>>);
+		BOOST_REQUIRE(zero_filling->Link(L"Output", fft.get(), L"Input"));
+		BOOST_REQUIRE(fft->Link(L"Output", expected.get(), L"Input"));
+		BOOST_REQUIRE(Input(zero_filling.get(), L"Input", data));
+
+		auto zero_filled_fft = YapShared(new ZeroFilledFft2D);
+		SetZeroFilling(zero_filled_fft.get(), dest_width, dest_height, left, top);
+		SetProperty<bool>(zero_filled_fft.get(), L"Inverse", inverse);
+		auto result = YapShared(new Sink<complex<float>>);
+		BOOST_REQUIRE(zero_filled_fft->Link(L"Output", result.get(), L"Input"));
+		BOOST_REQUIRE(Input(zero_filled_fft.get(), L"Input", data));
+
+		BOOST_REQUIRE_EQUAL(expected->outputs.size(), 1u);
+		BOOST_REQUIRE_EQUAL(result->outputs.size(), 1u);
+		BOOST_CHECK_EQUAL(result->GetDimension(0, DimensionReadout).length, unsigned(dest_width));
+		BOOST_CHECK_EQUAL(result->GetDimension(0, DimensionPhaseEncoding).length, unsigned(dest_height));
+		BOOST_CHECK_EQUAL(result->GetDimension(0, DimensionSlice).length,
+			expected->GetDimension(0, DimensionSlice).length);
+		BOOST_CHECK_EQUAL(result->received[0]->GetDimensions()->GetDimensionCount(),
+			expected->received[0]->GetDimensions()->GetDimensionCount());
+
+		auto& expected_elements = expected->outputs[0];
+		auto& result_elements = result->outputs[0];
+		BOOST_REQUIRE_EQUAL(result_elements.size(), expected_elements.size());
+		for (size_t i = 0; i < result_elements.size(); ++i)
+		{
+			BOOST_CHECK_SMALL(abs(result_elements[i] - expected_elements[i]), 1e-4f);
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(zero_filled_fft2d_matches_zero_filling_and_fft2d)
+{
+	auto data = CreateKSpace(0, 1);
+
+	// Even and odd destination sizes, fftshift is folded into the copy only along even axes.
+	for (int dest_width : { 16, 15 })
+	{
+		for (int dest_height : { 12, 11 })
+		{
+			for (bool inverse : { false, true })
+			{
+				CheckEquivalence(data.get(), dest_width, dest_height, -1, -1, inverse);
+			}
+		}
+	}
+}
+
+BOOST_AUTO_TEST_CASE(zero_filled_fft2d_with_offset_source)
+{
+	auto data = CreateKSpace(1, 2);
+
+	// Odd offsets flip the sign of the modulation, the source may also touch an edge.
+	CheckEquivalence(data.get(), 16, 12, 1, 3, false);
+	CheckEquivalence(data.get(), 15, 11, 7, 0, true);
+	CheckEquivalence(data.get(), 16, 11, 0, 5, false);
+	CheckEquivalence(data.get(), 15, 12, 3, 6, true);
+}
+
+BOOST_AUTO_TEST_CASE(zero_filled_fft2d_multiple_images)
+{
+	auto data = CreateKSpace(3, 3);
+
+	CheckEquivalence(data.get(), 16, 12, -1, -1, false);
+	CheckEquivalence(data.get(), 15, 11, 2, 1, true);
+	CheckEquivalence(data.get(), 8, 6, 0, 0, false);
+}
@@ -108,92 +108,47 @@ void Databin::Load(std::wstring dataPath, int channelCount)
 
 boost::shared_array<complex<float>> Databin::GetRawData()
 {
-    int TotalSize =  _dataInfo.freq_point_count *
-                     _dataInfo.phase_point_count *
-                     _dataInfo.slice_count *
-                     _dataInfo.channel_count;
-
-     //拷贝一份返回给用户。
-    boost::shared_array<complex<float>> destChannel(new complex<float>[TotalSize]);
-
-    memcpy(destChannel.get(), _data.get(), TotalSize * sizeof(complex<float>));
-    return destChannel;
-
+    // The returned array shares ownership of _data, no copy is made.
+    return _data;
 }
 
 boost::shared_array<complex<float>> Databin::GetRawData(unsigned int channelIndex)
 {
+    assert(channelIndex < _dataInfo.channel_count);
 
-    assert(channelIndex + 1 < _dataInfo.channel_count);
-
-    int channelSize =  _dataInfo.freq_point_count *
+    unsigned int channelSize =  _dataInfo.freq_point_count *
                         _dataInfo.phase_point_count *
                         _dataInfo.slice_count;
 
-    std::complex<float>* srcChannel = _data.get() + channelIndex * channelSize;
-
-    //拷贝一份返回给用户。
-    boost::shared_array<complex<float>> destChannel(new complex<float>[channelSize]);
-
-    memcpy(destChannel.get(), srcChannel, channelSize * sizeof(complex<float>));
-    return destChannel;
-
+    return boost::shared_array<complex<float>>(_data, _data.get() + channelIndex * channelSize);
 }
-//
+
 boost::shared_array<complex<float>> Databin::GetRawData(unsigned int channelIndex, unsigned int sliceIndex)
 {
     assert(channelIndex < _dataInfo.channel_count);
     assert(sliceIndex  < _dataInfo.slice_count);
 
-    unsigned int freqPointCount  = _dataInfo.freq_point_count;
-    unsigned int phasePointCount = _dataInfo.phase_point_count;
-    unsigned int sliceCount = _dataInfo.slice_count;
-
-
-    unsigned int sliceSize = freqPointCount * phasePointCount;
-    unsigned int channelSize = freqPointCount * phasePointCount * sliceCount;
-
-
-    complex<float> *srcSlice = _data.get() + channelSize * channelIndex + sliceCount * sliceIndex;
-
-    boost::shared_array<complex<float>> destSlice(new complex<float>[freqPointCount * phasePointCount]);
-
-    memcpy(destSlice.get(), srcSlice, sliceSize * sizeof(complex<float>));
-
-    return destSlice;
-
+    unsigned int sliceSize = _dataInfo.freq_point_count * _dataInfo.phase_point_count;
+    unsigned int channelSize = sliceSize * _dataInfo.slice_count;
 
+    return boost::shared_array<complex<float>>(_data,
+        _data.get() + channelSize * channelIndex + sliceSize * sliceIndex);
 }
 
-
-
 boost::shared_array<complex<float>> Databin::GetRawData(unsigned int channelIndex, unsigned int sliceIndex, unsigned int phaseIndex)
 {
-    //assert(0);
-    //return boost::shared_array<complex<float>>(nullptr);
     assert(channelIndex  < _dataInfo.channel_count);
     assert(sliceIndex  < _dataInfo.slice_count);
     assert(phaseIndex  < _dataInfo.phase_point_count);
 
-    unsigned int sliceCount      = _dataInfo.slice_count;
-    unsigned int phasePointCount = _dataInfo.phase_point_count;
     unsigned int freqPointCount  = _dataInfo.freq_point_count;
+    unsigned int sliceSize = freqPointCount * _dataInfo.phase_point_count;
+    unsigned int channelSize = sliceSize * _dataInfo.slice_count;
 
-    //complex<float>* srcLine = GetRawData(channelIndex, sliceIndex).get() + freqPointCount * phaseIndex;
-
-    unsigned int sliceSize = freqPointCount * phasePointCount;
-    unsigned int channelSize = freqPointCount * phasePointCount * sliceCount;
-
-    complex<float>* srcLine = _data.get()
+    return boost::shared_array<complex<float>>(_data, _data.get()
             + channelSize * channelIndex
-            + sliceCount * sliceIndex
-            + freqPointCount * phaseIndex;
-
-    boost::shared_array<complex<float>> destLine(new complex<float>[freqPointCount]);
-    memcpy(destLine.get(), srcLine, sizeof(complex<float>) * freqPointCount);
-
-    return destLine;
-
+            + sliceSize * sliceIndex
+            + freqPointCount * phaseIndex);
 }
 
 
@@ -16,6 +16,7 @@ private:
     RawDataInfo _dataInfo;
     unsigned int AllChannel(int channelCount);
 
+    // Views sharing ownership of _data, callers must not modify the returned arrays.
     boost::shared_array<complex<float>> GetRawData();
     boost::shared_array<complex<float>> GetRawData(unsigned int channelIndex);
     boost::shared_array<complex<float>> GetRawData(unsigned int channelIndex, unsigned int sliceIndex);
@@ -1,6 +1,7 @@
 #include "ModuleAgent.h"
 #include <assert.h>
 #include "Implement\LogImpl.h"
+#include "Implement\ExecutionEngine.h"
 #include <WinBase.h>
 
 #ifdef _USE_PYTHON
@@ -60,6 +61,13 @@ bool Yap::ModuleAgent::Load(const wchar_t * plugin_path)
 		}
 	}
 
+	// All modules share the workers of the engine of the client.
+	auto engine_func = (Yap::IExecutionEngineUser*(*)()) ::GetProcAddress(_module, "GetExecutionEngineUser");
+	if (engine_func != nullptr)
+	{
+		engine_func()->SetExecutionEngine(&ExecutionEngine::GetInstance());
+	}
+
 	auto create_func = (Yap::IProcessorContainer*(*)())::GetProcAddress(
 		_module, "GetProcessorManager");
 	if (create_func == nullptr) 
@@ -4,6 +4,7 @@
 #include <vector>
 
 #include "Implement\LogImpl.h"
+#include "Implement\ExecutionEngine.h"
 #include "Interface\Interfaces.h"
 #include "Interface/SmartPtr.h"
 #ifdef _DEBUG
@@ -256,6 +257,13 @@ bool Yap::Module::Load(const wchar_t * plugin_path,
 			}
 		}
 
+		// All modules share the workers of the engine of the client.
+		auto engine_func = (Yap::IExecutionEngineUser*(*)()) ::GetProcAddress(_module, "GetExecutionEngineUser");
+		if (engine_func != nullptr)
+		{
+			engine_func()->SetExecutionEngine(&ExecutionEngine::GetInstance());
+		}
+
 		if (python_engine != nullptr)
 		{
 			auto python_func = (Yap::IPythonUser*(*)()) ::GetProcAddress(_module, "GetPythonUser");
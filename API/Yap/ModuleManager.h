@@ -62,16 +62,16 @@ namespace Yap
 	{
 		IMPLEMENT_CLONE(Module)
 	public:
-		Module() : _use_count{ 0 }, _module{ 0 } {}
+		Module() : _module{ 0 } {}
 
 		virtual void Lock() override
 		{
-			++_use_count;
+			_use_count.Increment();
 		}
 
 		virtual void Release() override
 		{
-			if (_use_count == 0 || --_use_count == 0)
+			if (_use_count.Decrement())
 			{
 				if (_module != 0)
 				{
@@ -92,7 +92,7 @@ namespace Yap
 	private:
 		std::wstring GetModuleNameFromPath(const wchar_t * path);
 
-		unsigned int _use_count;
+		ReferenceCount _use_count;
 
 		HINSTANCE _module;
 	};
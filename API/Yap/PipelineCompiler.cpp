@@ -44,6 +44,8 @@ bool PipelineCompiler::ProcessImport(Tokens& tokens)
 /**
 Port link is in the form of: process1.output_port->process2.input_port;
 If the output_port and input_port is not specified, they default to "Output" and "Input" respectively.
+A queued link is in the form of: process1.output_port->process2.input_port[capacity, policy];
+policy is one of Block (default), DropOldest and CoalesceLatest.
 */
 bool PipelineCompiler::ProcessPortLink(Tokens& statement)
 {
@@ -67,6 +69,37 @@ bool PipelineCompiler::ProcessPortLink(Tokens& statement)
 		dest_port = statement.GetId();
 	}
 
+	unsigned int queue_capacity = 0;
+	QueuePolicy queue_policy = QueuePolicyBlock;
+	if (statement.IsTokenOfType(TokenLeftSquareBracket, true))
+	{
+		Token capacity_token = statement.GetCurrentToken();
+		int capacity = _wtoi(statement.GetLiteralValue().c_str());
+		if (capacity <= 0)
+		{
+			throw CompileError(capacity_token, CompileErrorInvalidLinkQueue,
+				L"Capacity of a queued link must be a positive integer.");
+		}
+		queue_capacity = static_cast<unsigned int>(capacity);
+
+		if (statement.IsTokenOfType(TokenComma, true))
+		{
+			Token policy_token = statement.GetCurrentToken();
+			if (!LinkQueue::ParsePolicy(statement.GetId().c_str(), queue_policy))
+			{
+				throw CompileError(policy_token, CompileErrorInvalidLinkQueue,
+					L"Queue policy must be one of Block, DropOldest and CoalesceLatest.");
+			}
+		}
+		statement.AssertToken(TokenRightSquareBracket, true);
+
+		if (source_processor == L"self" || dest_processor == L"self")
+		{
+			throw CompileError(capacity_token, CompileErrorInvalidLinkQueue,
+				L"Only links between processors can be queued.");
+		}
+	}
+
 	if (source_processor == L"self")
 	{
 		if (dest_processor == L"self")
@@ -83,6 +116,11 @@ bool PipelineCompiler::ProcessPortLink(Tokens& statement)
 	{
 		return _constructor->MapOutput(dest_port.c_str(), source_processor.c_str(), source_port.c_str());
 	}
+	else if (queue_capacity > 0)
+	{
+		return _constructor->Link(source_processor.c_str(), source_port.c_str(),
+			dest_processor.c_str(), dest_port.c_str(), queue_capacity, queue_policy);
+	}
 	else
 	{
 		return _constructor->Link(source_processor.c_str(), source_port.empty() ? L"Output" : source_port.c_str(),
@@ -141,6 +141,49 @@ bool Yap::PipelineConstructor::Link(const wchar_t * source,
 	return true;
 }
 
+bool Yap::PipelineConstructor::Link(const wchar_t * source,
+	const wchar_t * source_port,
+	const wchar_t * dest,
+	const wchar_t * dest_port,
+	unsigned int queue_capacity,
+	QueuePolicy policy)
+{
+	auto dest_processor = _pipeline->Find(dest);
+	if (!dest_processor)
+	{
+		wstring message(L"Destination processor not found.");
+		throw ConstructError(0, ConstructErrorProcessorNotFound, message + dest);
+	}
+
+	if (source_port == nullptr)
+	{
+		source_port = L"Output";
+	}
+	if (dest_port == nullptr)
+	{
+		dest_port = L"Input";
+	}
+
+	wstring queue_id = wstring(source) + L"." + source_port + L"->" + dest + L"." + dest_port;
+	if (_pipeline->Find(queue_id.c_str()) != nullptr)
+	{
+		throw ConstructError(0, ConstructErrorIdExists, L"Link already exists: " + queue_id);
+	}
+
+	try
+	{
+		auto queue = new LinkQueue(dest_processor, dest_port, queue_capacity, policy);
+		queue->SetInstanceId(queue_id.c_str());
+		_pipeline->AddProcessor(queue);
+	}
+	catch (bad_alloc&)
+	{
+		throw ConstructError(0, ConstructErrorOutOfMemory, L"Out of memory.");
+	}
+
+	return Link(source, source_port, queue_id.c_str(), L"Input");
+}
+
 bool Yap::PipelineConstructor::MapInput(const wchar_t * pipeline_port, 
 	const wchar_t * inner_processor, 
 	const wchar_t * inner_port)
@@ -159,6 +202,12 @@ bool Yap::PipelineConstructor::MapOutput(const wchar_t * pipeline_port,
 
 Yap::SmartPtr<Pipeline> Yap::PipelineConstructor::GetPipeline()
 {
+	// Links added after this point are looked up by port name again.
+	if (_pipeline)
+	{
+		_pipeline->ResolveLinks();
+	}
+
 	return _pipeline;
 }
 
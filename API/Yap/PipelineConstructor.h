@@ -7,6 +7,7 @@
 #include <string>
 
 #include "Implement/CompositeProcessor.h"
+#include "Implement/LinkQueue.h"
 
 namespace Yap
 {
@@ -66,6 +67,10 @@ namespace Yap
 
 		bool Link(const wchar_t * source, const wchar_t * dest);
 
+		/// Add a queued link, the source feeds a LinkQueue which feeds the destination on its own thread.
+		bool Link(const wchar_t * source, const wchar_t * source_port, const wchar_t * dest, const wchar_t * dest_port,
+			unsigned int queue_capacity, QueuePolicy policy);
+
 		bool SetProperty(const wchar_t * processor_id, const wchar_t * property_id, const wchar_t * value);
 
 		bool MapProperty(const wchar_t * processor_id, const wchar_t * property_id, const wchar_t * param_id, 
@@ -136,6 +136,7 @@ namespace Yap
     const int CompileErrorMemeberExists             = 1039;
 	const int CompileErrorAmbiguousId               = 1040;
 	const int CompileErrorInvalidArrayType			= 1041;
+	const int CompileErrorInvalidLinkQueue			= 1042;
 
 	class CompileError
 	{
@@ -24,9 +24,14 @@ SOURCES += ModuleManager.cpp \
     ProcessorAgent.cpp \
     ../../shared/Client/DataHelper.cpp \
     ../../shared/Client/stdafx.cpp \
+    ../../shared/Implement/BufferPool.cpp \
     ../../shared/Implement/CompositeProcessor.cpp \
     ../../shared/Implement/DataObject.cpp \
+    ../../shared/Implement/ExecutionEngine.cpp \
+    ../../shared/Implement/LinkQueue.cpp \
+    ../../shared/Implement/PipelinePool.cpp \
     ../../shared/Implement/ProcessorImpl.cpp \
+    ../../shared/Implement/ProcessorStatistics.cpp \
     ../../shared/Implement/VariableSpace.cpp \
     ../../shared/Implement/LogImpl.cpp \
     ../../shared/Implement/LogUserImpl.cpp \
@@ -41,10 +46,15 @@ HEADERS += ModuleManager.h \
     ../../shared/Client/DataHelper.h \
     ../../shared/Client/stdafx.h \
     ../../shared/Client/targetver.h \
+    ../../shared/Implement/BufferPool.h \
     ../../shared/Implement/CompositeProcessor.h \
     ../../shared/Implement/ContainerImpl.h \
     ../../shared/Implement/DataObject.h \
+    ../../shared/Implement/ExecutionEngine.h \
+    ../../shared/Implement/LinkQueue.h \
+    ../../shared/Implement/PipelinePool.h \
     ../../shared/Implement/ProcessorImpl.h \
+    ../../shared/Implement/ProcessorStatistics.h \
     ../../shared/Implement/YapImplement.h \
     ../../shared/Implement/VariableSpace.h \
     ../../shared/Implement/LogImpl.h \
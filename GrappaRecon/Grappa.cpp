@@ -1,9 +1,14 @@
 #include "Grappa.h"
 #include <string>
 
-#include "Interface/Client/DataHelper.h"
-#include "Interface/Implement/DataObject.h"
+#include "Client/DataHelper.h"
+#include "Implement/DataObject.h"
+#include "Implement/ExecutionEngine.h"
+#include "Implement/LogUserImpl.h"
 
+#include <algorithm>
+#include <cassert>
+#include <cstring>
 #include <vector>
 
 
@@ -14,15 +19,14 @@ using namespace Yap;
 Grappa::Grappa(void) :
 	ProcessorImpl(L"Grappa")
 {
-	_properties->AddProperty(PropertyInt, L"Rate", L"The acceleration factor.");
-	_properties->SetInt(L"Rate", 2);
-	_properties->AddProperty(PropertyInt, L"AcsCount", L"The auto-calibration signal.");
-	_properties->SetInt(L"AcsCount", 16);
-	_properties->AddProperty(PropertyInt, L"Block", L"The number of blocks.");
-	_properties->SetInt(L"Block", 4);
-
-	AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeComplexDouble | DataTypeComplexFloat);
-	AddOutput(L"Output", YAP_ANY_DIMENSION, DataTypeComplexDouble | DataTypeComplexFloat);
+	AddProperty<int>(L"Rate", 2, L"The acceleration factor.");
+	AddProperty<int>(L"AcsCount", 16, L"The auto-calibration signal.");
+	AddProperty<int>(L"Block", 4, L"The number of blocks.");
+	AddProperty<double>(L"Lambda", 1e-4,
+		L"Tikhonov regularization of the weight fit, relative to the mean signal energy. 0 for the pseudo-inverse.");
+
+	AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeComplexFloat);
+	AddOutput(L"Output", YAP_ANY_DIMENSION, DataTypeComplexFloat);
 }
 
 Yap::Grappa::Grappa(const Grappa & rhs)
@@ -38,24 +42,34 @@ bool Grappa::Input(const wchar_t * port, IData * data)
 {
 	if (wstring(port) != L"Input")
 		return false;
-		auto R = _properties->GetInt(L"Rate");
-		auto Acs = _properties->GetInt(L"AcsCount");
-		auto Block = _properties->GetInt(L"Block");
-
-		DataHelper input_data(data);  //ΪǷKռ
-		if (input_data.GetDataType() != DataTypeComplexDouble && input_data.GetDataType() != DataTypeComplexFloat)
-			return false;
- 		if (input_data.GetActualDimensionCount() != 3)
- 			return false;
-		auto width = input_data.GetWidth();
-		auto height = input_data.GetHeight();
-		Dimension channel_dimension = input_data.GetDimension(DimensionChannel);
-		Recon(GetDataArray<complex<float>>(data), R, Acs, Block,
-			width, height, channel_dimension.length);
-
-		Feed(L"Output", data);
 
-	return true;
+	auto R = GetProperty<int>(L"Rate");
+	auto Acs = GetProperty<int>(L"AcsCount");
+	auto Block = GetProperty<int>(L"Block");
+
+	DataHelper input_data(data);  //ΪǷKռ
+	if (input_data.GetDataType() != DataTypeComplexFloat)
+	{
+		LOG_ERROR(L"<Grappa> Only complex float data is supported!", L"GrappaRecon");
+		return false;
+	}
+	if (input_data.GetActualDimensionCount() != 3)
+		return false;
+
+	auto width = input_data.GetWidth();
+	auto height = input_data.GetHeight();
+	Dimension channel_dimension = input_data.GetDimension(DimensionChannel);
+
+	// Reconstructed in place unless the data is shared with other consumers.
+	auto output = MakeWritable(data);
+	if (!Recon(GetDataArray<complex<float>>(output.get()), R, Acs, Block,
+		width, height, channel_dimension.length))
+	{
+		LOG_ERROR(L"<Grappa> Reconstruction failed!", L"GrappaRecon");
+		return false;
+	}
+
+	return Feed(L"Output", output.get());
 }
 
 std::vector<std::complex<float>> Grappa::GetAcsData(std::complex<float> * data, 
@@ -75,65 +89,126 @@ std::vector<std::complex<float>> Grappa::GetAcsData(std::complex<float> * data,
 bool Grappa::Recon(std::complex<float> * subsampled_data, 
 	unsigned int  r, unsigned int acs, unsigned int block, unsigned int width, unsigned int height, unsigned int num_coil)
 {
+	if (width < 3 || r < 2)
+		return false;
+
 	vector<complex<float>> acs_data = GetAcsData(subsampled_data, r, acs, width, height, num_coil);
-		cx_fmat coef = FitCoef(subsampled_data, r, acs, block, width, height, num_coil);
+	cx_fmat coef = GetCoef(subsampled_data, r, acs, block, width, height, num_coil);
+
+	// The points of a tile of phase encoding groups x readouts are reconstructed with one
+	// matrix product. Tiles only read acquired lines and write missing lines, so they can run
+	// concurrently.
+	unsigned int group_count = height / r;
+	unsigned int tile_readouts = min(width - 2, unsigned(ReadoutsPerTile));
+	unsigned int tile_groups = max(1u, unsigned(PointsPerTile) / tile_readouts);
+
+	TaskGroup tasks;
+	for (unsigned int first_group = 0; first_group < group_count; first_group += tile_groups)
+	{
+		for (unsigned int first_readout = 1; first_readout < width - 1; first_readout += tile_readouts)
+		{
+			tasks.Run([=, &coef]() {
+				vector<unsigned int> rows_above;
+				for (unsigned int n = first_group; n < min(first_group + tile_groups, group_count); ++n)
+				{
+					rows_above.push_back(n * r);
+				}
+				auto readout_count = min(tile_readouts, width - 1 - first_readout);
+
+				cx_fmat sources;
+				GatherSources(subsampled_data, rows_above, first_readout, readout_count,
+					r, block, width, height, num_coil, sources);
+				cx_fmat targets = sources * coef;
+				ScatterTargets(subsampled_data, targets, rows_above, first_readout, readout_count,
+					r, width, height, num_coil);
+
+				return true;
+			});
+		}
+	}
+	if (!tasks.Wait())
+		return false;
+
+	MakeFidelity(subsampled_data, acs_data, r, acs, width, height, num_coil);
+	return true;
+}
+
+void Grappa::GatherSources(const complex<float> * data, const vector<unsigned int>& rows_above,
+	unsigned int first_readout, unsigned int readout_count,
+	unsigned int r, unsigned int block, unsigned int width, unsigned int height, unsigned int num_coil,
+	cx_fmat& sources)
+{
+	assert(first_readout >= 1 && first_readout + readout_count < width);
 
-		cx_frowvec Temp(1, block * num_coil * 3);
-		Temp.zeros();
-		for (unsigned int n = 0; n < floor(height / r); ++n)
+	// Matrices are column major, so each column is filled with contiguous runs of readouts.
+	sources.set_size(rows_above.size() * readout_count, block * num_coil * 3);
+	for (unsigned int shift = 0; shift < 3; ++shift)
+	{
+		for (unsigned int block_index = 0; block_index < block; ++block_index)
 		{
-			for (unsigned int readout_index = 1; readout_index < width - 1; ++readout_index)
+			for (unsigned int coil_index = 0; coil_index < num_coil; ++coil_index)
 			{
-				for (unsigned int shift = 0; shift < 3; ++shift)
+				auto column = sources.colptr(coil_index + block_index * num_coil + shift * block * num_coil);
+				for (size_t group = 0; group < rows_above.size(); ++group)
 				{
-					for (unsigned int block_l = 0; block_l < block / 2; ++block_l)
-					{
-						for (unsigned int coil_index = 0; coil_index < num_coil; ++coil_index)
-						{
-							if (n < block_l)
-							{
-								Temp[coil_index + block_l * num_coil + shift * block * num_coil] = 0;
-							}
-							else
-							{
-								auto src_point =width * height * coil_index + 
-									width * (1 + n * r - block_l * r - 1) + readout_index;
-								Temp[coil_index + block_l * num_coil + shift * block * num_coil] = *(subsampled_data + src_point + shift - 1);
-							}
-						}
-					}
-					for (unsigned int block_r = 0; block_r < block / 2; ++block_r)
+					// The first block / 2 lines are above the missing lines, the others below.
+					int row = (block_index < block / 2) ?
+						int(rows_above[group]) - int(block_index * r) :
+						int(rows_above[group]) + int((block_index - block / 2 + 1) * r);
+
+					auto destination = column + group * readout_count;
+					if (row < 0 || row >= int(height))
 					{
-						for (unsigned int coil_index = 0; coil_index < num_coil; ++coil_index)
-						{
-							if ((block_r + n + 1) * r + 1 > height)
-							{
-								Temp[coil_index + (block_r + 2) * num_coil + shift * num_coil * block] = 0;
-							}
-							else
-							{
-								auto src_point =width * height * coil_index + 
-									width * (1 + n * r + block_r * r + 1) + readout_index;
-								Temp[coil_index + (block_r + 2) * num_coil + shift * num_coil * block] = *(subsampled_data + src_point - 1 + shift);
-							}
-						}
+						memset(destination, 0, readout_count * sizeof(complex<float>));
 					}
-					cx_frowvec Recon_Data = Temp * coef;
-					for (unsigned int b = 0; b < r - 1; ++b)
+					else
 					{
-						for (unsigned int coil_index = 0; coil_index < num_coil; ++coil_index)
-						{
-							auto recon_point =width * height * coil_index + 
-								width * (r * n + 1 + b) + readout_index;
-							*(subsampled_data + recon_point) = Recon_Data[coil_index + b * num_coil];
-						}
+						memcpy(destination, data + size_t(width) * height * coil_index + size_t(width) * row +
+							first_readout + shift - 1, readout_count * sizeof(complex<float>));
 					}
 				}
 			}
 		}
+	}
+}
 
-		MakeFidelity(subsampled_data, acs_data, r, acs, width, height, num_coil);
-	return true;
+void Grappa::GatherTargets(const complex<float> * data, const vector<unsigned int>& rows_above,
+	unsigned int first_readout, unsigned int readout_count,
+	unsigned int r, unsigned int width, unsigned int height, unsigned int num_coil, cx_fmat& targets)
+{
+	targets.set_size(rows_above.size() * readout_count, (r - 1) * num_coil);
+	for (unsigned int b = 0; b < r - 1; ++b)
+	{
+		for (unsigned int coil_index = 0; coil_index < num_coil; ++coil_index)
+		{
+			auto column = targets.colptr(coil_index + b * num_coil);
+			for (size_t group = 0; group < rows_above.size(); ++group)
+			{
+				assert(rows_above[group] + 1 + b < height);
+				memcpy(column + group * readout_count, data + size_t(width) * height * coil_index +
+					size_t(width) * (rows_above[group] + 1 + b) + first_readout, readout_count * sizeof(complex<float>));
+			}
+		}
+	}
+}
+
+void Grappa::ScatterTargets(complex<float> * data, const cx_fmat& targets, const vector<unsigned int>& rows_above,
+	unsigned int first_readout, unsigned int readout_count,
+	unsigned int r, unsigned int width, unsigned int height, unsigned int num_coil)
+{
+	for (unsigned int b = 0; b < r - 1; ++b)
+	{
+		for (unsigned int coil_index = 0; coil_index < num_coil; ++coil_index)
+		{
+			auto column = targets.colptr(coil_index + b * num_coil);
+			for (size_t group = 0; group < rows_above.size(); ++group)
+			{
+				assert(rows_above[group] + 1 + b < height);
+				memcpy(data + size_t(width) * height * coil_index + size_t(width) * (rows_above[group] + 1 + b) +
+					first_readout, column + group * readout_count, readout_count * sizeof(complex<float>));
+			}
+		}
+	}
 }
 
 
@@ -150,66 +225,104 @@ complex<float> * Grappa::MakeFidelity(complex<float> * recon_data, vector<comple
 	return recon_data;
 }
 
-arma::cx_fmat Grappa::FitCoef(complex<float> * subsampled_data, 
+arma::cx_fmat Grappa::GetCoef(complex<float> * subsampled_data,
 	unsigned int r, unsigned int acs, unsigned int block, unsigned int width, unsigned int height, unsigned int num_coil)
 {
-	unsigned int first =(floor((height - acs) / (2 * r))) * r + 1;
-	unsigned int fit_num = floor(acs / r);
-	cx_fmat temp1((width - 2) * fit_num, num_coil * (r - 1));
-	temp1.zeros();
-	for (unsigned int k = 0; k < fit_num; ++k)
+	auto lambda = float(GetProperty<double>(L"Lambda"));
+	vector<unsigned int> parameters{ r, acs, block, width, height, num_coil };
+	auto lines = GetCalibrationLines(subsampled_data, r, acs, block, width, height, num_coil);
+
+	// FNV-1a of the calibration lines, entries with the same hash are compared in full.
+	unsigned long long hash = 14695981039346656037ULL;
+	auto bytes = reinterpret_cast<const unsigned char*>(lines.data());
+	for (size_t i = 0; i < lines.size() * sizeof(complex<float>); ++i)
 	{
-		for (unsigned int b = 0; b < r - 1; ++b)
-		{
-			for (unsigned int readout_index = 1; readout_index < width - 1; ++readout_index)
-			{
-				for (unsigned int coil_index = 0; coil_index < num_coil; ++coil_index)
-				{
-					auto acs_point = width * height * coil_index + width * (first + k * r + b) + readout_index;
-					temp1((k * (width - 2) + readout_index - 1), coil_index + b * num_coil) = *(subsampled_data + acs_point);
-				}
-			}
-		}
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
 	}
 
-	cx_fmat temp2((width - 2) * fit_num, block * num_coil * 3);
-	temp2.zeros();
-	for (unsigned int k = 0; k < fit_num; ++k)
+	for (auto iter = _coef_cache.begin(); iter != _coef_cache.end(); ++iter)
 	{
-		for (unsigned int readout_index = 1; readout_index < width - 1; ++readout_index)
+		if (iter->hash == hash && iter->lambda == lambda && iter->parameters == parameters && iter->lines == lines)
 		{
-			for (unsigned int shift = 0; shift < 3; ++shift)
-			{
-				for (unsigned int block_l = 0; block_l < block / 2; ++block_l)
-				{
-					for (unsigned int coil_index = 0; coil_index < num_coil; ++coil_index)
-					{
-						auto src_point =width * height * coil_index + 
-							width * (first + k * r - block_l * r - 1) + readout_index;
-						temp2((k * (width - 2) + readout_index - 1), coil_index + block_l * num_coil + shift * block * num_coil)=
-							*(subsampled_data + src_point - 1 + shift);
-					}
-				}
-				for (unsigned int block_r = 0; block_r < block / 2; ++block_r)
-				{
-					for (unsigned int coil_index = 0; coil_index < num_coil; ++coil_index)
-					{
-						auto src_point =width * height * coil_index + 
-							width * (first + k * r + block_r * r + 1) + readout_index;
-						temp2((k * (width - 2) + readout_index - 1), coil_index + (block_r + 2) * num_coil + shift * block * num_coil) =
-							*(subsampled_data + src_point - 1 + shift);
-					}
-				}
-			}
+			_coef_cache.splice(_coef_cache.begin(), _coef_cache, iter);
+			return _coef_cache.front().coef;
 		}
 	}
-	cx_fmat coef = pinv(temp2, 0, "std") * temp1;
+
+	auto coef = FitCoef(subsampled_data, r, acs, block, width, height, num_coil, lambda);
+
+	_coef_cache.push_front(CachedCoef{ hash, parameters, lambda, move(lines), coef });
+	if (_coef_cache.size() > CoefCacheCapacity)
+	{
+		_coef_cache.pop_back();
+	}
+
 	return coef;
 }
 
-Yap::IProcessor * Yap::Grappa::Clone()
+vector<complex<float>> Grappa::GetCalibrationLines(const complex<float> * data,
+	unsigned int r, unsigned int acs, unsigned int block, unsigned int width, unsigned int height, unsigned int num_coil)
 {
-	return new (nothrow) Grappa(*this);
+	// Same lines as gathered by FitCoef().
+	int first = int((height - acs) / (2 * r)) * r + 1;
+	int fit_num = acs / r;
+	int top = max(first - 1 - int(block / 2 - 1) * int(r), 0);
+	int bottom = min(first + (fit_num - 1) * int(r) - 1 + int(block / 2) * int(r), int(height) - 1);
+	if (fit_num == 0 || bottom < top)
+		return vector<complex<float>>();
+
+	size_t line_count = bottom - top + 1;
+	vector<complex<float>> lines(line_count * width * num_coil);
+	for (unsigned int coil_index = 0; coil_index < num_coil; ++coil_index)
+	{
+		memcpy(lines.data() + line_count * width * coil_index, data + size_t(width) * height * coil_index +
+			size_t(width) * top, line_count * width * sizeof(complex<float>));
+	}
+
+	return lines;
+}
+
+arma::cx_fmat Grappa::FitCoef(complex<float> * subsampled_data, 
+	unsigned int r, unsigned int acs, unsigned int block, unsigned int width, unsigned int height, unsigned int num_coil,
+	float lambda)
+{
+	unsigned int first =(floor((height - acs) / (2 * r))) * r + 1;
+	unsigned int fit_num = floor(acs / r);
+
+	// Every group of r - 1 lines of the ACS region is fitted from the lines around it, in the
+	// same layout as used by Recon().
+	vector<unsigned int> rows_above(fit_num);
+	for (unsigned int k = 0; k < fit_num; ++k)
+	{
+		rows_above[k] = first + k * r - 1;
+	}
+
+	cx_fmat temp1, temp2;
+	GatherTargets(subsampled_data, rows_above, 1, width - 2, r, width, height, num_coil, temp1);
+	GatherSources(subsampled_data, rows_above, 1, width - 2, r, block, width, height, num_coil, temp2);
+
+	cx_fmat coef;
+	if (lambda > 0.0f && SolveRegularized(temp2, temp1, lambda, coef))
+		return coef;
+
+	coef = pinv(temp2, 0, "std") * temp1;
+	return coef;
 }
 
+bool Grappa::SolveRegularized(const cx_fmat& a, const cx_fmat& b, float lambda, cx_fmat& x)
+{
+	// The normal equations square the condition number, so they are solved in double precision.
+	cx_mat a_double = conv_to<cx_mat>::from(a);
+	cx_mat normal = a_double.t() * a_double;
+	normal.diag() += lambda * real(trace(normal)) / double(normal.n_rows);
+
+	cx_mat r;
+	if (!chol(r, normal))
+		return false;
 
+	// normal = r^H * r with r upper triangular.
+	cx_mat y = solve(trimatl(r.t()), a_double.t() * conv_to<cx_mat>::from(b));
+	x = conv_to<cx_fmat>::from(solve(trimatu(r), y));
+
+	return true;
+}
@@ -3,36 +3,103 @@
 #ifndef Grappa_h__20160814
 #define Grappa_h__20160814
 
-#include "Interface/Implement/ProcessorImpl.h"
-#include "Interface/Client/DataHelper.h"
+#include "Implement/ProcessorImpl.h"
+#include "Client/DataHelper.h"
 #include <complex>
+#include <list>
+#include <vector>
 #include <armadillo>
 
 
 namespace Yap
 {
+	/**
+	@brief GRAPPA reconstruction of one slice (readout x phase encoding x coil).
+
+	Weights are fitted by Tikhonov regularized least squares, see property Lambda. Fitted
+	weights are kept for the last few calibration regions, so repeated frames of a dynamic
+	series with unchanged calibration data skip the fit.
+	*/
 	class Grappa :
 		public ProcessorImpl
 	{
+		IMPLEMENT_SHARED(Grappa)
 	public:
 		Grappa(void);
 		Grappa(const Grappa& rhs);
-		virtual ~Grappa();
 
-		virtual IProcessor * Clone() override;
 		virtual bool Input(const wchar_t * port, IData * data) override;
 
 	protected:
+		~Grappa();
+
 		bool Recon(std::complex<float> * subsampled_data,
 			unsigned int r, unsigned int acs, unsigned int Block, unsigned int width, unsigned int height, unsigned int num_coil);
 
+		/// Return the weights for the calibration lines of the data, from the cache if possible.
+		arma::cx_fmat GetCoef(std::complex<float> * subsampled_data,
+			unsigned int r, unsigned int acs, unsigned int block, unsigned int width, unsigned int height, unsigned int num_coil);
+
 		std::complex<float> * MakeFidelity(std::complex<float> * recon_data, std::vector<std::complex<float>> acs_data,
 			unsigned int r, unsigned int acs, unsigned int width, unsigned int height, unsigned int num_coil);
 		 arma::cx_fmat FitCoef(std::complex<float> * subsampled_data,
-		unsigned int R, unsigned int acs, unsigned int Block, unsigned int Width, unsigned int height, unsigned int Num_coil);
+		unsigned int R, unsigned int acs, unsigned int Block, unsigned int Width, unsigned int height, unsigned int Num_coil,
+		float lambda);
+
+		/// Solve min |a * x - b|^2 + lambda' * |x|^2 by Cholesky factorization of the normal equations.
+		/**
+			\remarks lambda' is lambda times the mean of the diagonal of a^H * a. Return false if the
+			normal equations are not positive definite.
+		*/
+		static bool SolveRegularized(const arma::cx_fmat& a, const arma::cx_fmat& b, float lambda, arma::cx_fmat& x);
+
+		/// Copy all lines read by FitCoef(), for all coils.
+		static std::vector<std::complex<float>> GetCalibrationLines(const std::complex<float> * data,
+			unsigned int r, unsigned int acs, unsigned int block, unsigned int width, unsigned int height, unsigned int num_coil);
 
 		std::vector<std::complex<float>> GetAcsData(std::complex<float> * data, 
 			unsigned int r, unsigned int acs, unsigned int width, unsigned int height, unsigned int num_coil);
+
+		/// Copy the neighbourhoods of the points to be reconstructed into sources, one row per point.
+		/**
+			\remarks The points are the readouts [first_readout, first_readout + readout_count) of the
+			r - 1 lines following each line in rows_above. A neighbourhood consists of block acquired
+			lines (block / 2 above, block / 2 below) x 3 readouts x all coils, lines outside of the
+			data are zeros.
+		*/
+		static void GatherSources(const std::complex<float> * data, const std::vector<unsigned int>& rows_above,
+			unsigned int first_readout, unsigned int readout_count,
+			unsigned int r, unsigned int block, unsigned int width, unsigned int height, unsigned int num_coil,
+			arma::cx_fmat& sources);
+
+		/// Copy the points following rows_above into targets, one row per point, in the layout of the
+		/// product of sources and the coefficients.
+		static void GatherTargets(const std::complex<float> * data, const std::vector<unsigned int>& rows_above,
+			unsigned int first_readout, unsigned int readout_count,
+			unsigned int r, unsigned int width, unsigned int height, unsigned int num_coil, arma::cx_fmat& targets);
+
+		/// Write targets laid out as by GatherTargets() back into data.
+		static void ScatterTargets(std::complex<float> * data, const arma::cx_fmat& targets,
+			const std::vector<unsigned int>& rows_above, unsigned int first_readout, unsigned int readout_count,
+			unsigned int r, unsigned int width, unsigned int height, unsigned int num_coil);
+
+		/// Readouts and points per matrix product in Recon(). Tiles are large enough for an efficient
+		/// GEMM and small enough to give every thread several of them.
+		static const unsigned int ReadoutsPerTile = 128;
+		static const unsigned int PointsPerTile = 1024;
+
+		struct CachedCoef
+		{
+			unsigned long long hash;
+			std::vector<unsigned int> parameters;		///< r, acs, block, width, height, num_coil.
+			float lambda;
+			std::vector<std::complex<float>> lines;		///< Calibration lines the weights were fitted to.
+			arma::cx_fmat coef;
+		};
+
+		/// Most recently used first.
+		std::list<CachedCoef> _coef_cache;
+		static const size_t CoefCacheCapacity = 4;
 	};
 }
 #endif // Grappa_h__
@@ -1,6 +1,6 @@
 #include "stdafx.h"
-#include "Interface/Implement/ContainerImpl.h"
-#include "Interface\Implement\YapImplement.h"
+#include "Implement/ContainerImpl.h"
+#include "Implement/YapImplement.h"
 #include "Grappa.h"
 
 
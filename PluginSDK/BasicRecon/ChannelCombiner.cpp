@@ -0,0 +1,337 @@
+#include "stdafx.h"
+#include "ChannelCombiner.h"
+
+#include "Client/DataHelper.h"
+#include "Implement/ExecutionEngine.h"
+#include "Implement/LogUserImpl.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__AVX512F__)
+#define CHANNEL_COMBINER_AVX512
+#endif
+#if defined(__AVX2__)
+#define CHANNEL_COMBINER_AVX2
+#endif
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define CHANNEL_COMBINER_SSE
+#include <immintrin.h>
+#endif
+
+using namespace std;
+using namespace Yap;
+
+namespace
+{
+	/// Pixels combined by one task, so that a chunk of the output stays in cache over the channels.
+	const size_t PixelsPerTask = 16384;
+
+	void AddSquares(const float * source, float * sum, size_t count)
+	{
+		size_t i = 0;
+#ifdef CHANNEL_COMBINER_AVX512
+		for (; i + 16 <= count; i += 16)
+		{
+			__m512 x = _mm512_loadu_ps(source + i);
+			_mm512_storeu_ps(sum + i, _mm512_add_ps(_mm512_loadu_ps(sum + i), _mm512_mul_ps(x, x)));
+		}
+#endif
+#ifdef CHANNEL_COMBINER_AVX2
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 x = _mm256_loadu_ps(source + i);
+			_mm256_storeu_ps(sum + i, _mm256_add_ps(_mm256_loadu_ps(sum + i), _mm256_mul_ps(x, x)));
+		}
+#endif
+#ifdef CHANNEL_COMBINER_SSE
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 x = _mm_loadu_ps(source + i);
+			_mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i), _mm_mul_ps(x, x)));
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			sum[i] += source[i] * source[i];
+		}
+	}
+
+	void AddSquares(const complex<float> * source, float * sum, size_t count)
+	{
+		auto values = reinterpret_cast<const float*>(source);
+		size_t i = 0;
+#ifdef CHANNEL_COMBINER_AVX512
+		// Add the square of each imaginary part to its real part, then pack the even lanes.
+		const __m512i even_lanes = _mm512_setr_epi32(0, 2, 4, 6, 8, 10, 12, 14, 0, 2, 4, 6, 8, 10, 12, 14);
+		for (; i + 8 <= count; i += 8)
+		{
+			__m512 x = _mm512_loadu_ps(values + 2 * i);
+			__m512 squares = _mm512_mul_ps(x, x);
+			__m512 pairs = _mm512_add_ps(squares, _mm512_permute_ps(squares, _MM_SHUFFLE(2, 3, 0, 1)));
+			__m256 norms = _mm512_castps512_ps256(_mm512_permutexvar_ps(even_lanes, pairs));
+			_mm256_storeu_ps(sum + i, _mm256_add_ps(_mm256_loadu_ps(sum + i), norms));
+		}
+#endif
+#ifdef CHANNEL_COMBINER_AVX2
+		for (; i + 8 <= count; i += 8)
+		{
+			__m256 low = _mm256_loadu_ps(values + 2 * i);
+			__m256 high = _mm256_loadu_ps(values + 2 * i + 8);
+			low = _mm256_mul_ps(low, low);
+			high = _mm256_mul_ps(high, high);
+			// Shuffles stay within 128-bit lanes, giving elements 0 1 4 5 2 3 6 7.
+			__m256 norms = _mm256_add_ps(_mm256_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)),
+				_mm256_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+			norms = _mm256_castpd_ps(_mm256_permute4x64_pd(_mm256_castps_pd(norms), _MM_SHUFFLE(3, 1, 2, 0)));
+			_mm256_storeu_ps(sum + i, _mm256_add_ps(_mm256_loadu_ps(sum + i), norms));
+		}
+#endif
+#ifdef CHANNEL_COMBINER_SSE
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 low = _mm_loadu_ps(values + 2 * i);
+			__m128 high = _mm_loadu_ps(values + 2 * i + 4);
+			low = _mm_mul_ps(low, low);
+			high = _mm_mul_ps(high, high);
+			__m128 norms = _mm_add_ps(_mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0)),
+				_mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1)));
+			_mm_storeu_ps(sum + i, _mm_add_ps(_mm_loadu_ps(sum + i), norms));
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			sum[i] += norm(source[i]);
+		}
+	}
+
+	void SquareRoot(float * data, size_t count)
+	{
+		size_t i = 0;
+#ifdef CHANNEL_COMBINER_AVX512
+		for (; i + 16 <= count; i += 16)
+		{
+			_mm512_storeu_ps(data + i, _mm512_sqrt_ps(_mm512_loadu_ps(data + i)));
+		}
+#endif
+#ifdef CHANNEL_COMBINER_AVX2
+		for (; i + 8 <= count; i += 8)
+		{
+			_mm256_storeu_ps(data + i, _mm256_sqrt_ps(_mm256_loadu_ps(data + i)));
+		}
+#endif
+#ifdef CHANNEL_COMBINER_SSE
+		for (; i + 4 <= count; i += 4)
+		{
+			_mm_storeu_ps(data + i, _mm_sqrt_ps(_mm_loadu_ps(data + i)));
+		}
+#endif
+		for (; i < count; ++i)
+		{
+			data[i] = sqrt(data[i]);
+		}
+	}
+}
+
+ChannelCombiner::ChannelCombiner() :
+	ProcessorImpl(L"ChannelCombiner")
+{
+	AddProperty<int>(L"ChannelCount", 0,
+		L"Number of channels fed one at a time, 0 if each input holds all channels.");
+
+	AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeFloat | DataTypeComplexFloat);
+	AddOutput(L"Output", YAP_ANY_DIMENSION, DataTypeFloat);
+	_input_port = GetInputHandle(L"Input");
+	_output_port = GetOutputHandle(L"Output");
+
+	_channel_count = BindProperty<int>(L"ChannelCount");
+
+	SetReentrant(true);
+}
+
+ChannelCombiner::ChannelCombiner(const ChannelCombiner& rhs) :
+	ProcessorImpl(rhs),
+	_input_port(rhs._input_port),
+	_output_port(rhs._output_port),
+	_channel_count(rhs._channel_count)
+{
+}
+
+ChannelCombiner::~ChannelCombiner()
+{
+}
+
+bool ChannelCombiner::Input(const wchar_t * name, IData * data)
+{
+	if (_wcsicmp(name, L"Input") != 0)
+	{
+		LOG_ERROR(L"<ChannelCombiner> Error input port name!", L"BasicRecon");
+		return false;
+	}
+
+	return InputByHandle(_input_port, data);
+}
+
+bool ChannelCombiner::InputByHandle(PortHandle port, IData * data)
+{
+	assert(port == _input_port);
+
+	if (data == nullptr)
+	{
+		LOG_ERROR(L"<ChannelCombiner> Invalid input data!", L"BasicRecon");
+		return false;
+	}
+	if (data->GetDataType() != DataTypeFloat && data->GetDataType() != DataTypeComplexFloat)
+	{
+		LOG_ERROR(L"<ChannelCombiner> Error input data type!(DataTypeFloat or DataTypeComplexFloat is available)!", L"BasicRecon");
+		return false;
+	}
+
+	// The output has the dimensions of the input without DimensionChannel.
+	auto dimensions = data->GetDimensions();
+	Dimensions output_dimensions;
+	unsigned int channel_length = 1;
+	size_t block_size = 1;
+	bool before_channel = true;
+	for (unsigned int i = 0; i < dimensions->GetDimensionCount(); ++i)
+	{
+		Dimension dimension;
+		dimensions->GetDimensionInfo(i, dimension.type, dimension.start_index, dimension.length);
+		if (dimension.type == DimensionChannel)
+		{
+			channel_length = dimension.length;
+			before_channel = false;
+		}
+		else
+		{
+			output_dimensions(dimension.type, dimension.start_index, dimension.length);
+			if (before_channel)
+			{
+				block_size *= dimension.length;
+			}
+		}
+	}
+
+	auto channel_count = GetProperty<int>(_channel_count);
+	if (channel_length > 1 || channel_count <= 1)
+	{
+		return (data->GetDataType() == DataTypeComplexFloat) ?
+			Combine<complex<float>>(data, output_dimensions, block_size, channel_length) :
+			Combine<float>(data, output_dimensions, block_size, channel_length);
+	}
+
+	return (data->GetDataType() == DataTypeComplexFloat) ?
+		Accumulate<complex<float>>(data, output_dimensions, unsigned(channel_count)) :
+		Accumulate<float>(data, output_dimensions, unsigned(channel_count));
+}
+
+template <typename T>
+bool ChannelCombiner::Combine(IData * data, const Dimensions& output_dimensions, size_t block_size,
+	unsigned int channel_count)
+{
+	DataHelper helper(data);
+	auto output = CreateData<float>(data, const_cast<Dimensions*>(&output_dimensions));
+	auto source = GetDataArray<T>(data);
+	auto dest = GetDataArray<float>(output.get());
+
+	// Channels are block_size elements apart, every block of channels after them is independent.
+	auto outer_count = helper.GetDataSize() / (block_size * channel_count);
+	TaskGroup tasks;
+	for (size_t outer = 0; outer < outer_count; ++outer)
+	{
+		for (size_t first = 0; first < block_size; first += PixelsPerTask)
+		{
+			tasks.Run([=]() {
+				auto count = min(PixelsPerTask, block_size - first);
+				auto sum = dest + outer * block_size + first;
+				memset(sum, 0, count * sizeof(float));
+				for (unsigned int channel = 0; channel < channel_count; ++channel)
+				{
+					AddSquares(source + (outer * channel_count + channel) * block_size + first, sum, count);
+				}
+				SquareRoot(sum, count);
+				return true;
+			});
+		}
+	}
+	if (!tasks.Wait())
+		return false;
+
+	return Feed(_output_port, output.get());
+}
+
+template <typename T>
+bool ChannelCombiner::Accumulate(IData * data, const Dimensions& output_dimensions, unsigned int channel_count)
+{
+	DataHelper helper(data);
+	auto size = helper.GetDataSize();
+	auto key = GetKey(data->GetDimensions());
+	auto channel_index = helper.GetDimension(DimensionChannel).start_index;
+
+	shared_ptr<Accumulation> accumulation;
+	{
+		lock_guard<mutex> lock(_mutex);
+		auto& entry = _accumulations[key];
+		if (!entry)
+		{
+			entry = make_shared<Accumulation>();
+			entry->buffer = CreateData<float>(data, const_cast<Dimensions*>(&output_dimensions));
+			memset(entry->buffer->GetData(), 0, size * sizeof(float));
+			entry->filled.assign(channel_count, false);
+		}
+		accumulation = entry;
+	}
+
+	bool complete;
+	{
+		lock_guard<mutex> lock(accumulation->mutex);
+		if (DataHelper(accumulation->buffer.get()).GetDataSize() != size)
+		{
+			LOG_ERROR(L"<ChannelCombiner> Channel size doesn't match the other channels!", L"BasicRecon");
+			return false;
+		}
+
+		auto& filled = accumulation->filled;
+		if (channel_index >= channel_count)
+		{
+			channel_index = unsigned(find(filled.begin(), filled.end(), false) - filled.begin());
+		}
+		if (channel_index >= channel_count || filled[channel_index])
+		{
+			LOG_ERROR(L"<ChannelCombiner> Channel received twice!", L"BasicRecon");
+			return false;
+		}
+
+		AddSquares(GetDataArray<T>(data), accumulation->buffer->GetData(), size);
+		filled[channel_index] = true;
+		complete = (++accumulation->count == channel_count);
+	}
+	if (!complete)
+		return true;
+
+	{
+		lock_guard<mutex> lock(_mutex);
+		_accumulations.erase(key);
+	}
+
+	SquareRoot(accumulation->buffer->GetData(), size);
+	return Feed(_output_port, accumulation->buffer.get());
+}
+
+ChannelCombiner::Key ChannelCombiner::GetKey(IDimensions * dimensions)
+{
+	Key key;
+	key.fill(0);
+	for (unsigned int i = 0; i < dimensions->GetDimensionCount(); ++i)
+	{
+		Dimension dimension;
+		dimensions->GetDimensionInfo(i, dimension.type, dimension.start_index, dimension.length);
+		if (dimension.type != DimensionChannel && dimension.type < key.size())
+		{
+			key[dimension.type] = dimension.start_index;
+		}
+	}
+
+	return key;
+}
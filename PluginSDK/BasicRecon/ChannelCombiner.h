@@ -0,0 +1,73 @@
+#pragma once
+
+#ifndef ChannelCombiner_h__20171104
+#define ChannelCombiner_h__20171104
+
+#include "Implement/ProcessorImpl.h"
+
+#include <array>
+#include <complex>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Yap
+{
+	/**
+	@brief Root sum of squares of the channels, computed straight from complex or magnitude data.
+
+	Data holding the whole DimensionChannel is combined at once, no ChannelIterator is needed.
+	Data holding one channel at a time, e.g. after ChannelIterator, is accumulated until
+	ChannelCount channels with the same indices along the other dimensions have arrived, then
+	the square root is taken once and the result is fed. Each channel index is counted once,
+	channels beyond ChannelCount take the first index not received yet. The output has no DimensionChannel.
+	|x|^2 is accumulated with AVX-512, AVX2 or SSE, whichever the module is built for.
+	*/
+	class ChannelCombiner :
+		public ProcessorImpl
+	{
+		IMPLEMENT_SHARED(ChannelCombiner)
+	public:
+		ChannelCombiner();
+		ChannelCombiner(const ChannelCombiner& rhs);
+
+	protected:
+		~ChannelCombiner();
+
+		virtual bool Input(const wchar_t * name, IData * data) override;
+		virtual bool InputByHandle(PortHandle port, IData * data) override;
+
+		PortHandle _input_port;
+		PortHandle _output_port;
+
+		/// Start indices of the data indexed by DimensionType, the channel index left out.
+		typedef std::array<unsigned int, DimensionUser6 + 1> Key;
+
+		struct Accumulation
+		{
+			SmartPtr<FloatData> buffer;
+			unsigned int count;
+			std::vector<bool> filled;	///< Channel indices already added.
+			std::mutex mutex;
+
+			Accumulation() : count(0) {}
+		};
+
+		template <typename T>
+		bool Combine(IData * data, const Dimensions& output_dimensions, size_t block_size,
+			unsigned int channel_count);
+
+		template <typename T>
+		bool Accumulate(IData * data, const Dimensions& output_dimensions, unsigned int channel_count);
+
+		static Key GetKey(IDimensions * dimensions);
+
+		std::map<Key, std::shared_ptr<Accumulation>> _accumulations;
+		std::mutex _mutex;
+
+		PropertyHandle _channel_count;
+	};
+}
+
+#endif // ChannelCombiner_h__
@@ -4,20 +4,81 @@
 
 #include "Implement/LogUserImpl.h"
 
+#include <algorithm>
+
 using namespace Yap;
 using namespace std;
 
+namespace
+{
+	/// Return the index of the channel in the buffer, false if dimensions doesn't place it there.
+	bool GetChannelIndex(IDimensions * dimensions, unsigned int channel_count, unsigned int& channel_index)
+	{
+		for (unsigned int i = 0; i < dimensions->GetDimensionCount(); ++i)
+		{
+			DimensionType type = DimensionInvalid;
+			unsigned int start_index = 0, length = 0;
+			dimensions->GetDimensionInfo(i, type, start_index, length);
+			if (type == DimensionChannel)
+			{
+				channel_index = start_index;
+				return length == 1 && start_index < channel_count;
+			}
+		}
+
+		return false;
+	}
+
+	/// Return the elements of one channel, i.e. of all dimensions but the channel dimension.
+	/**
+		\remarks In the collector buffer a channel is split into run_count runs, one for each
+		index of the dimensions following the channel dimension. It is contiguous if run_count is 1.
+	*/
+	size_t GetChannelSize(IDimensions * dimensions, size_t& run_count)
+	{
+		size_t channel_size = 1;
+		run_count = 1;
+		bool after_channel = false;
+		for (unsigned int i = 0; i < dimensions->GetDimensionCount(); ++i)
+		{
+			DimensionType type = DimensionInvalid;
+			unsigned int start_index = 0, length = 0;
+			dimensions->GetDimensionInfo(i, type, start_index, length);
+			if (type == DimensionChannel)
+			{
+				after_channel = true;
+				continue;
+			}
+
+			channel_size *= length;
+			if (after_channel)
+			{
+				run_count *= length;
+			}
+		}
+
+		return channel_size;
+	}
+}
+
 ChannelDataCollector::ChannelDataCollector(void):
 	ProcessorImpl(L"ChannelDataCollector")
 {
 	AddInput(L"Input", 2, DataTypeComplexFloat);
 	AddOutput(L"Output", 3, DataTypeComplexFloat);
+	_input_port = GetInputHandle(L"Input");
+	_output_port = GetOutputHandle(L"Output");
 	AddProperty<int>(L"ChannelCount", 4, L"The total channel count.");
+
+	_channel_count = BindProperty<int>(L"ChannelCount");
 }
 
 
 Yap::ChannelDataCollector::ChannelDataCollector(const ChannelDataCollector& rhs):
-	ProcessorImpl(rhs)
+	ProcessorImpl(rhs),
+	_input_port(rhs._input_port),
+	_output_port(rhs._output_port),
+	_channel_count(rhs._channel_count)
 {
 }
 
@@ -28,61 +89,145 @@ ChannelDataCollector::~ChannelDataCollector(void)
 
 bool Yap::ChannelDataCollector::Input(const wchar_t * name, IData * data)
 {
-	assert(data != nullptr);
 	assert(Inputs()->Find(name) != nullptr);
 
-	DataHelper helper(data);
+	return InputByHandle(_input_port, data);
+}
+
+bool Yap::ChannelDataCollector::InputByHandle(PortHandle port, IData * data)
+{
+	assert(port == _input_port);
+	assert(data != nullptr);
 
-	vector<unsigned int> key = GetKey(data->GetDimensions());
-	auto iter = _collector_buffers.find(key);
-	if (iter == _collector_buffers.end())
+	auto * data_array = Yap::GetDataArray<complex<float>>(data);
+	if (data_array == nullptr)
 	{
-		Dimensions collector_dimensions(helper.GetDimensionCount());
-		DimensionType type = DimensionInvalid;
-		unsigned int index = 0, length = 0;
+		LOG_ERROR(L"<ChannelDataCollector> Only complex float data can be collected!", L"BasicRecon");
+		return false;
+	}
+
+	size_t run_count;
+	auto channel_size = GetChannelSize(data->GetDimensions(), run_count);
+	unsigned int channel_count = GetProperty<int>(_channel_count);
+
+	SmartPtr<ComplexFloatData> output;
+	{
+		lock_guard<mutex> lock(_mutex);
 
-		for (unsigned int i = 0; i < helper.GetDimensionCount(); ++i)
+		auto key = GetKey(data->GetDimensions());
+		auto& collector_buffer = GetCollectorBuffer(data, data->GetDimensions());
+		auto * collector_cursor = collector_buffer.buffer->GetData();
+		auto buffer_size = DataHelper(collector_buffer.buffer.get()).GetDataSize();
+		if (buffer_size != channel_size * channel_count)
 		{
+			LOG_ERROR(L"<ChannelDataCollector> Channel size doesn't match the buffer!", L"BasicRecon");
+			return false;
+		}
 
-			data->GetDimensions()->GetDimensionInfo(i, type, index, length);
-			if (type == DimensionChannel)
-			{
-				collector_dimensions.SetDimensionInfo(i, type, index, GetProperty<int>(L"ChannelCount"));
-			}
-			else
+		// Channels created in a slot handed out by GetInputSlot() are already in place. Others are
+		// copied to their channel index, or to the first free position if they don't carry one.
+		auto& filled = collector_buffer.filled;
+		bool in_place = run_count == 1 && data_array >= collector_cursor && data_array < collector_cursor + buffer_size;
+		unsigned int channel_index = 0;
+		if (in_place)
+		{
+			channel_index = unsigned((data_array - collector_cursor) / channel_size);
+		}
+		else if (!GetChannelIndex(data->GetDimensions(), channel_count, channel_index))
+		{
+			channel_index = unsigned(find(filled.begin(), filled.end(), false) - filled.begin());
+		}
+
+		if (channel_index >= channel_count)
+		{
+			LOG_ERROR(L"<ChannelDataCollector> More channels than ChannelCount received!", L"BasicRecon");
+			return false;
+		}
+		if (filled[channel_index])
+		{
+			LOG_ERROR(L"<ChannelDataCollector> Channel received twice!", L"BasicRecon");
+			return false;
+		}
+
+		if (!in_place)
+		{
+			auto run_size = channel_size / run_count;
+			for (size_t run = 0; run < run_count; ++run)
 			{
-				collector_dimensions.SetDimensionInfo(i, type, index, length);
+				memcpy(collector_cursor + (run * channel_count + channel_index) * run_size,
+					data_array + run * run_size, run_size * sizeof(complex<float>));
 			}
 		}
+		filled[channel_index] = true;
+
+		if (++collector_buffer.count == channel_count)
+		{
+			output = collector_buffer.buffer;
+			_collector_buffers.erase(key);
+		}
+	}
 
-		CollectorBuffer collector_buffer;
-		collector_buffer.buffer = CreateData<complex<float>>(data, &collector_dimensions);
+	return !output || Feed(_output_port, output.get());
+}
 
-		auto * data_array = Yap::GetDataArray<complex<float>>(data);
-		memcpy(collector_buffer.buffer->GetData(), data_array, helper.GetBlockSize(DimensionSlice) * sizeof(complex<float>));
-		collector_buffer.count = 1;
+SmartPtr<IData> Yap::ChannelDataCollector::GetInputSlot(PortHandle port, int data_type,
+	IDimensions * dimensions, IData * reference)
+{
+	unsigned int channel_count = GetProperty<int>(_channel_count);
+	unsigned int channel_index = 0;
+	if (data_type != DataTypeComplexFloat || !GetChannelIndex(dimensions, channel_count, channel_index))
+		return SmartPtr<IData>();
+
+	// Only channels which are contiguous in the buffer can be written in place.
+	size_t run_count;
+	auto channel_size = GetChannelSize(dimensions, run_count);
+	if (run_count != 1)
+		return SmartPtr<IData>();
+
+	lock_guard<mutex> lock(_mutex);
+
+	// The position is only marked as filled when the channel arrives in Input(), so a slot which is
+	// never fed doesn't keep the buffer from completing.
+	auto& collector_buffer = GetCollectorBuffer(reference, dimensions);
+	if (collector_buffer.filled[channel_index] ||
+		DataHelper(collector_buffer.buffer.get()).GetDataSize() != channel_size * channel_count)
+		return SmartPtr<IData>();
+
+	return CreateData<complex<float>>(reference,
+		collector_buffer.buffer->GetData() + channel_index * channel_size,
+		dimensions, collector_buffer.buffer.get());
+}
 
-		auto result = _collector_buffers.insert(make_pair(key, collector_buffer));
-		iter = result.first;
-	}
-	else
-	{
-		complex<float> * collector_cursor = reinterpret_cast<complex<float>*>(iter->second.buffer->GetData());
-
-		auto * source_data_array = Yap::GetDataArray<complex<float>>(data);
-		complex<float> * source_cursor = source_data_array;
-		
-		memcpy(collector_cursor + iter->second.count * helper.GetBlockSize(DimensionSlice), 
-			source_cursor, helper.GetBlockSize(DimensionSlice) * sizeof(complex<float>));
-		++iter->second.count;
-	}
+ChannelDataCollector::CollectorBuffer& Yap::ChannelDataCollector::GetCollectorBuffer(IData * reference,
+	IDimensions * dimensions)
+{
+	auto key = GetKey(dimensions);
+	auto iter = _collector_buffers.find(key);
+	if (iter != _collector_buffers.end())
+		return iter->second;
 
-	if (iter->second.count == GetProperty<int>(L"ChannelCount"))
+	Dimensions collector_dimensions(dimensions->GetDimensionCount());
+	DimensionType type = DimensionInvalid;
+	unsigned int index = 0, length = 0;
+
+	for (unsigned int i = 0; i < dimensions->GetDimensionCount(); ++i)
 	{
-		Feed(L"Output", iter->second.buffer.get());
+		dimensions->GetDimensionInfo(i, type, index, length);
+		if (type == DimensionChannel)
+		{
+			collector_dimensions.SetDimensionInfo(i, type, 0, GetProperty<int>(_channel_count));
+		}
+		else
+		{
+			collector_dimensions.SetDimensionInfo(i, type, index, length);
+		}
 	}
 
-	return true;
+	CollectorBuffer collector_buffer;
+	collector_buffer.buffer = CreateData<complex<float>>(reference, &collector_dimensions);
+	collector_buffer.filled.assign(GetProperty<int>(_channel_count), false);
+
+	return _collector_buffers.insert(make_pair(key, collector_buffer)).first->second;
 }
 
 std::vector<unsigned int> Yap::ChannelDataCollector::GetKey(IDimensions * dimensions)
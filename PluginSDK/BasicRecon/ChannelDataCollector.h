@@ -1,6 +1,10 @@
 #pragma once
 #include "Implement\ProcessorImpl.h"
 
+#include <map>
+#include <mutex>
+#include <vector>
+
 namespace Yap
 {
 	class ChannelDataCollector :
@@ -15,20 +19,41 @@ namespace Yap
 		~ChannelDataCollector(void);
 
 		virtual bool Input(const wchar_t * name, IData * data) override;
+		virtual bool InputByHandle(PortHandle port, IData * data) override;
+
+		PortHandle _input_port;
+		PortHandle _output_port;
+
+		/// Hand out the position of the channel in the buffer, see ProcessorImpl::GetInputSlot().
+		/**
+			\remarks The position is given by the start index along DimensionChannel, channels
+			without one are copied to the first free position when they arrive. No slot is handed
+			out if dimensions longer than 1 follow the channel dimension, since the channel is not
+			contiguous in the buffer then.
+		*/
+		virtual SmartPtr<IData> GetInputSlot(PortHandle port, int data_type, IDimensions * dimensions,
+			IData * reference) override;
 
 		struct CollectorBuffer
 		{
 			SmartPtr<ComplexFloatData> buffer;
-			unsigned int count;
+			unsigned int count;			///< Channels received.
+			std::vector<bool> filled;	///< Channel positions already received.
 
 			CollectorBuffer() : count(0) {}
-			CollectorBuffer(CollectorBuffer& rhs) : count(rhs.count), buffer(rhs.buffer) {}
-			CollectorBuffer(CollectorBuffer&& rhs) : count(rhs.count), buffer(rhs.buffer) {}
+			CollectorBuffer(CollectorBuffer& rhs) : count(rhs.count), filled(rhs.filled), buffer(rhs.buffer) {}
+			CollectorBuffer(CollectorBuffer&& rhs) : count(rhs.count), filled(std::move(rhs.filled)), buffer(rhs.buffer) {}
 
 			~CollectorBuffer() {}
 		};
 
+		/// Find or create the buffer collecting the channels of data with the given dimensions.
+		CollectorBuffer& GetCollectorBuffer(IData * reference, IDimensions * dimensions);
+
 		std::vector<unsigned int> GetKey(IDimensions * dimensions);
 		std::map<std::vector<unsigned int>, CollectorBuffer> _collector_buffers;
+		std::mutex _mutex;	///< Slots may be requested by several producers while Input() runs.
+
+		PropertyHandle _channel_count;
 	};
 }
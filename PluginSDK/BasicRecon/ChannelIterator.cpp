@@ -3,6 +3,7 @@
 #include "Client/DataHelper.h"
 #include <complex>
 #include "Implement/LogUserImpl.h"
+#include "Implement/ExecutionEngine.h"
 
 using namespace std;
 using namespace  Yap;
@@ -12,12 +13,19 @@ ChannelIterator::ChannelIterator():
 {
 	AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeComplexFloat);
 	AddOutput(L"Output", 2, DataTypeComplexFloat);
+	_input_port = GetInputHandle(L"Input");
+	_output_port = GetOutputHandle(L"Output");
 
 	AddProperty<int>(L"SliceIndex", 0, L"The index of the slice you want to get.");
+
+	SetReentrant(true);
+	SetStridedInput(true);
 }
 
 ChannelIterator::ChannelIterator(const ChannelIterator& rhs)
-	: ProcessorImpl(rhs)
+	: ProcessorImpl(rhs),
+	_input_port(rhs._input_port),
+	_output_port(rhs._output_port)
 {
 }
 
@@ -27,28 +35,61 @@ ChannelIterator::~ChannelIterator()
 
 bool Yap::ChannelIterator::Input(const wchar_t * name, IData * data)
 {
-	assert((data != nullptr) && (Yap::GetDataArray<complex<float>>(data) != nullptr));
 	assert(Inputs()->Find(name) != nullptr);
 
+	return InputByHandle(_input_port, data);
+}
+
+bool Yap::ChannelIterator::InputByHandle(PortHandle port, IData * data)
+{
+	assert(port == _input_port);
+	assert((data != nullptr) && (Yap::GetDataArray<complex<float>>(data) != nullptr));
+
 	DataHelper helper(data);
 
-	unsigned int slice_block_size = helper.GetBlockSize(DimensionSlice);
 	unsigned int slice_index = GetProperty<int>(L"SliceIndex");
 
 	Dimension channel_dimension = helper.GetDimension(DimensionChannel);
 	assert(channel_dimension.type == DimensionChannel);
 
+	// Input holding a single slice is used as is, regardless of SliceIndex.
+	auto slice_dimension = helper.GetDimension(DimensionSlice);
+	size_t slice_offset = 0;
+	if (slice_dimension.length > 1)
+	{
+		if (slice_index < slice_dimension.start_index ||
+			slice_index >= slice_dimension.start_index + slice_dimension.length)
+		{
+			LOG_ERROR(L"<ChannelIterator> SliceIndex out of range.", L"BasicRecon");
+			return false;
+		}
+		slice_offset = (slice_index - slice_dimension.start_index) * helper.GetStride(DimensionSlice);
+	}
+
+	std::vector<size_t> strides(data->GetDimensions()->GetDimensionCount());
+	for (unsigned int i = 0; i < strides.size(); ++i)
+	{
+		Dimension dimension;
+		data->GetDimensions()->GetDimensionInfo(i, dimension.type, dimension.start_index, dimension.length);
+		strides[i] = helper.GetStride(dimension.type);
+	}
+	size_t channel_stride = helper.GetStride(DimensionChannel);
+
+	TaskGroup tasks;
 	for (unsigned int i = channel_dimension.start_index; i < channel_dimension.start_index + channel_dimension.length; ++i)
 	{
 		Dimensions channel_slice_data_dimensions(data->GetDimensions());
 		channel_slice_data_dimensions.SetDimension(DimensionSlice, 1, slice_index);
 		channel_slice_data_dimensions.SetDimension(DimensionChannel, 1, i);
 
-		auto output = CreateData<complex<float>>(data,
-			Yap::GetDataArray<complex<float>>(data) + i * slice_block_size, channel_slice_data_dimensions);
+		// data is the parent of the output, so that the channel block is not freed with the output.
+		auto output = CreateView<complex<float>>(data, Yap::GetDataArray<complex<float>>(data) + 
+			slice_offset + (i - channel_dimension.start_index) * channel_stride,
+			channel_slice_data_dimensions, strides, data);
 
-		Feed(L"Output", output.get());
+		FeedAsync(tasks, _output_port, output.get());
 	}
+	tasks.Wait();
 
 	return true;
 }
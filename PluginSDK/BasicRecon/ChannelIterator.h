@@ -14,6 +14,10 @@ namespace Yap
 		~ChannelIterator();
 
 		virtual bool Input(const wchar_t * name, IData * data) override;
+		virtual bool InputByHandle(PortHandle port, IData * data) override;
+
+		PortHandle _input_port;
+		PortHandle _output_port;
 	};
 }
 
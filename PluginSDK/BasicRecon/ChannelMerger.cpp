@@ -16,10 +16,13 @@ ChannelMerger::ChannelMerger(void) :
 
 	AddProperty<int>(L"ChannelCount", 4, L"通道数");
 	AddProperty<int>(L"ChannelSwitch", 0xf, L"通道开关指示值");
+
+	_channel_count = BindProperty<int>(L"ChannelCount");
 }
 
 ChannelMerger::ChannelMerger( const ChannelMerger& rhs )
-	: ProcessorImpl(rhs)
+	: ProcessorImpl(rhs),
+	_channel_count(rhs._channel_count)
 {
 }
 
@@ -101,7 +104,7 @@ bool ChannelMerger::Input(const wchar_t * name, IData * data)
 // 		bit_number &= (bit_number - 1);   // 消除最低位的1.
 // 	}   // 最后used_channel_count得到1的个数。即打开的通道总数
 
-	if (iter->second.count == GetProperty<int>(L"ChannelCount"))
+	if (iter->second.count == GetProperty<int>(_channel_count))
 	{
 		Feed(L"Output", iter->second.buffer.get());
 	}
@@ -36,6 +36,8 @@ namespace Yap
 		std::vector<unsigned int> GetKey(IDimensions * dimensions);
 		std::map<std::vector<unsigned int>, MergeBuffer> _merge_buffers; 
 
+		PropertyHandle _channel_count;
+
 	};
 }
 
@@ -80,7 +80,7 @@ bool CmrDataReader::ReadRawData(unsigned int channel_index)
 	output << GetProperty<std::wstring>(L"DataPath") << L"\\ChannelData"
 		<< setfill(L'0') << setw(2) << channel_index + 1 << L".fid";
 
-	std::vector<float*> channel_data_buffer;
+	std::vector<ifstream> files;
 	std::vector<unsigned int> slices;
 	unsigned int width = 0, height = 0, dim4 = 0, total_slice_count = 0; // 对于未进行累加处理的数据，得到的slice实际是 真实的slice  × 实际累加次数。
 	int group_count = GetProperty<int>(L"GroupCount");
@@ -89,6 +89,8 @@ bool CmrDataReader::ReadRawData(unsigned int channel_index)
 		group_count = 1;
 	}
 
+	// Headers of all groups are read first, so that the data of the groups can be read straight
+	// into the output, which may be a slot in the buffer of the next processor.
 	for (int i = 0; i < group_count; ++i)
 	{
 		wstring data_path = output.str();
@@ -100,41 +102,16 @@ bool CmrDataReader::ReadRawData(unsigned int channel_index)
 			data_path += temp_output.str();
 		}
 
+		files.emplace_back(data_path.c_str(), ios::binary);
 		unsigned int group_slice_count = 0;
-		float * temp_raw_data_buffer = ReadEcnuFile(data_path.c_str(), width, height, group_slice_count, dim4);
-		if (temp_raw_data_buffer == nullptr)
+		if (!ReadEcnuHeader(files.back(), width, height, group_slice_count, dim4))
 		{
 			return false;
 		}
-		channel_data_buffer.push_back(temp_raw_data_buffer);
 		total_slice_count += group_slice_count;
 		slices.push_back(group_slice_count);
 	}
 
-	float* raw_data_buffer = nullptr;
-	if (channel_data_buffer.size() == 1)
-	{
-		raw_data_buffer = channel_data_buffer[0];
-	}
-	else
-	{
-		try
-		{
-			raw_data_buffer = new float[width * height * total_slice_count * 2];
-		}
-		catch(bad_alloc&)
-		{
-			return false;
-		}
-
-		unsigned int offset = 0;
-		for (unsigned int i = 0; i < channel_data_buffer.size(); ++i)
-		{
-			std::memcpy(raw_data_buffer + offset, channel_data_buffer[i], width * height * slices[i] * 2 * sizeof(float));
-			offset += width * height * slices[i] * 2;
-		}
-	}
-
 	Dimensions dimensions;
 	dimensions(DimensionReadout, 0U, width)
 		(DimensionPhaseEncoding, 0U, height)
@@ -142,8 +119,22 @@ bool CmrDataReader::ReadRawData(unsigned int channel_index)
 		(Dimension4, 0U, dim4)
 		(DimensionChannel, channel_index, 1);
 
-	auto output_data = CreateData<complex<float>>(nullptr,
-		reinterpret_cast<complex<float>*>(raw_data_buffer), dimensions);
+	auto output_data = CreateOutputData<complex<float>>(L"Output", nullptr, &dimensions);
+	if (!output_data)
+	{
+		return false;
+	}
+
+	auto cursor = reinterpret_cast<char*>(output_data->GetData());
+	for (unsigned int i = 0; i < files.size(); ++i)
+	{
+		size_t group_size = size_t(width) * height * slices[i] * sizeof(complex<float>);
+		if (!files[i].read(cursor, group_size))
+		{
+			return false;
+		}
+		cursor += group_size;
+	}
 
 	Feed(L"Output", output_data.get());
 
@@ -151,24 +142,22 @@ bool CmrDataReader::ReadRawData(unsigned int channel_index)
 }
 
 /**
-Read raw data from raw data file.
-@return Pointer to the buffer used to store the raw-data. Should be released by the caller of this function.
+Read the header of a raw data file, leaving the file positioned at the raw data.
+@return true if the header was read successfully.
 @param width Output parameter used to store the width of the image (in pixel).
 @param height Output, height of the image.
-@param slices Output, number of slices read.
+@param slices Output, number of slices in the file.
 */
-float* CmrDataReader::ReadEcnuFile(const wchar_t * file_path,
+bool CmrDataReader::ReadEcnuHeader(ifstream& file,
 	unsigned int& width,
 	unsigned int& height,
 	unsigned int& slices,
 	unsigned int& dim4)
 {
-	ifstream file(file_path, ios::binary);
-
 	// read raw data header
 	details::EcnuRawSections sections;
 	if (!file.read(reinterpret_cast<char*>(&sections), sizeof(details::EcnuRawSections)))
-		return nullptr;
+		return false;
 
 	// read dimension information
 	file.seekg(sizeof(details::EcnuRawSections) + sections.Section1Size + sections.Section2Size + sections.Section3Size,
@@ -178,7 +167,8 @@ float* CmrDataReader::ReadEcnuFile(const wchar_t * file_path,
 	if (sections.FileVersion - 1.5701 > 0.00000005)
 	{
 		int buf[5];
-		file.read(reinterpret_cast<char*>(buf), sizeof(int) * 5);
+		if (!file.read(reinterpret_cast<char*>(buf), sizeof(int) * 5))
+			return false;
 		assert(buf[4] == 1);
 		width = buf[0];
 		height = buf[1];
@@ -189,24 +179,13 @@ float* CmrDataReader::ReadEcnuFile(const wchar_t * file_path,
 	{
 		// 1.5702版本以上的谱仪版本，数据增加到5维，目前暂时第5维为1.
 		int buf[4];
-		file.read(reinterpret_cast<char*>(buf), sizeof(int) * 4);
+		if (!file.read(reinterpret_cast<char*>(buf), sizeof(int) * 4))
+			return false;
 		width = buf[0];
 		height = buf[1];
 		slices = buf[2] * buf[3];
 		dim4 = buf[3];
 	}
 
-	unsigned buffer_size = width * height * 2 * slices;
-	float * data = new float[buffer_size];
-
-	// read actual data
-	if (file.read(reinterpret_cast<char*>(data), buffer_size * sizeof(float)))
-	{
-		return data;
-	}
-	else
-	{
-		delete[]data;
-		return nullptr;
-	}
-}
+	return true;
+}
\ No newline at end of file
@@ -5,6 +5,8 @@
 
 #include "Implement/processorImpl.h"
 
+#include <fstream>
+
 namespace Yap
 {
 	/// Class used to read raw data file created by CMR.
@@ -32,7 +34,7 @@ namespace Yap
 		virtual bool Input(const wchar_t * name, IData * data) override;
 
 		bool ReadRawData(unsigned int channel_index);
-		float* ReadEcnuFile(const wchar_t * file_path, unsigned int& width, unsigned int& height,
+		bool ReadEcnuHeader(std::ifstream& file, unsigned int& width, unsigned int& height,
 			unsigned int& slices, unsigned int& dim4);
 	};
 }
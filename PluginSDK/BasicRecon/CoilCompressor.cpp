@@ -0,0 +1,378 @@
+#include "stdafx.h"
+#include "CoilCompressor.h"
+#include "FftPlanCache.h"
+
+#include "Client/DataHelper.h"
+#include "Implement/ExecutionEngine.h"
+#include "Implement/LogUserImpl.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+using namespace std;
+using namespace Yap;
+using namespace arma;
+
+CoilCompressor::CoilCompressor() :
+	ProcessorImpl(L"CoilCompressor")
+{
+	AddProperty<std::wstring>(L"Mode", L"Global",
+		L"\"Global\" for one compression matrix, \"Geometric\" for one matrix per readout position.");
+	AddProperty<int>(L"TargetCount", 0, L"Number of virtual coils, 0 to use EnergyThreshold.");
+	AddProperty<double>(L"EnergyThreshold", 0.95, L"Fraction of the calibration energy kept by the virtual coils.");
+	AddProperty<int>(L"CalibrationLines", 24, L"Number of central phase encoding lines used for calibration, 0 for all.");
+
+	AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeComplexFloat | DataTypeComplexDouble);
+	AddOutput(L"Output", YAP_ANY_DIMENSION, DataTypeComplexFloat | DataTypeComplexDouble);
+
+	_mode = BindProperty<std::wstring>(L"Mode");
+	_target_count = BindProperty<int>(L"TargetCount");
+	_energy_threshold = BindProperty<double>(L"EnergyThreshold");
+	_calibration_lines = BindProperty<int>(L"CalibrationLines");
+
+	SetReentrant(true);
+}
+
+CoilCompressor::CoilCompressor(const CoilCompressor& rhs) :
+	ProcessorImpl(rhs),
+	_mode(rhs._mode),
+	_target_count(rhs._target_count),
+	_energy_threshold(rhs._energy_threshold),
+	_calibration_lines(rhs._calibration_lines)
+{
+}
+
+CoilCompressor::~CoilCompressor()
+{
+}
+
+bool CoilCompressor::Input(const wchar_t * port, IData * data)
+{
+	if (data == nullptr)
+	{
+		LOG_ERROR(L"<CoilCompressor> Invalid input data!", L"BasicRecon");
+		return false;
+	}
+	if (_wcsicmp(port, L"Input") != 0)
+	{
+		LOG_ERROR(L"<CoilCompressor> Error input port name!", L"BasicRecon");
+		return false;
+	}
+
+	DataHelper input_data(data);
+	if (input_data.GetDataType() != DataTypeComplexFloat && input_data.GetDataType() != DataTypeComplexDouble)
+	{
+		LOG_ERROR(L"<CoilCompressor> Error input data type!(DataTypeComplexFloat or DataTypeComplexDouble is available)!", L"BasicRecon");
+		return false;
+	}
+
+	auto dimensions = data->GetDimensions();
+	unsigned int channel_index = 0;
+	for (; channel_index < dimensions->GetDimensionCount(); ++channel_index)
+	{
+		DimensionType type;
+		unsigned int start, length;
+		dimensions->GetDimensionInfo(channel_index, type, start, length);
+		if (type == DimensionChannel)
+			break;
+	}
+	if (channel_index == dimensions->GetDimensionCount() || channel_index < 2)
+	{
+		LOG_ERROR(L"<CoilCompressor> Error input data dimention!(DimensionChannel after readout and phase encoding is required)!", L"BasicRecon");
+		return false;
+	}
+
+	bool geometric;
+	auto mode = GetProperty<std::wstring>(_mode);
+	if (_wcsicmp(mode.c_str(), L"Geometric") == 0)
+	{
+		geometric = true;
+	}
+	else if (_wcsicmp(mode.c_str(), L"Global") == 0)
+	{
+		geometric = false;
+	}
+	else
+	{
+		LOG_ERROR(L"<CoilCompressor> Unknown Mode!(Global or Geometric is available)", L"BasicRecon");
+		return false;
+	}
+
+	return (input_data.GetDataType() == DataTypeComplexDouble) ?
+		Compress<double>(data, channel_index, geometric) :
+		Compress<float>(data, channel_index, geometric);
+}
+
+template <typename T>
+bool CoilCompressor::Compress(IData * data, unsigned int channel_index, bool geometric)
+{
+	DataHelper input_data(data);
+	auto width = input_data.GetWidth();
+	auto height = input_data.GetHeight();
+
+	Dimensions dimensions(data->GetDimensions());
+	DimensionType type;
+	unsigned int start, coil_count;
+	size_t block_size = 1;
+	for (unsigned int i = 0; i < channel_index; ++i)
+	{
+		dimensions.GetDimensionInfo(i, type, start, coil_count);
+		block_size *= coil_count;
+	}
+	dimensions.GetDimensionInfo(channel_index, type, start, coil_count);
+	if (block_size == 0 || coil_count < 2)
+		return Feed(L"Output", data);
+
+	auto plane_count = unsigned(block_size / (size_t(width) * height));
+	auto block_count = input_data.GetDataSize() / (block_size * coil_count);
+	auto source = GetDataArray<complex<T>>(data);
+
+	unsigned int first_line, line_count;
+	GetCalibrationRange(height, first_line, line_count);
+
+	// Each block after the channel dimension, e.g. each slice, is calibrated independently.
+	vector<Basis> bases(block_count);
+	vector<vector<complex<T>>> hybrids(geometric ? block_count : 0);
+	TaskGroup tasks;
+	for (size_t block = 0; block < block_count; ++block)
+	{
+		tasks.Run([&, block]() {
+			auto block_data = source + block * block_size * coil_count;
+			if (!geometric)
+			{
+				GetGlobalBasis(block_data, width, height, plane_count, coil_count,
+					first_line, line_count, bases[block]);
+				return true;
+			}
+
+			// Hybrid space: the readout is transformed, so every position x is independent.
+			hybrids[block].assign(block_data, block_data + block_size * coil_count);
+			if (!FftPlanCache::GetInstance().ExecuteCentered(hybrids[block].data(), hybrids[block].data(),
+				vector<int>{int(width)}, true, int(block_size / width * coil_count)))
+				return false;
+
+			GetGeometricBasis(hybrids[block].data(), width, height, plane_count, coil_count,
+				first_line, line_count, bases[block]);
+			return true;
+		});
+	}
+	if (!tasks.Wait())
+	{
+		LOG_ERROR(L"<CoilCompressor> Failed to calibrate the compression!", L"BasicRecon");
+		return false;
+	}
+
+	// All blocks share the output dimensions, so the largest count needed by any block is used.
+	unsigned int virtual_count = 1;
+	for (auto& basis : bases)
+	{
+		virtual_count = max(virtual_count, SelectVirtualCoilCount(basis.eigenvalues, coil_count));
+	}
+	if (virtual_count >= coil_count)
+		return Feed(L"Output", data);
+
+	dimensions.SetDimensionInfo(channel_index, type, start, virtual_count);
+	auto output = CreateData<complex<T>>(data, &dimensions);
+	auto dest = GetDataArray<complex<T>>(output.get());
+
+	for (size_t block = 0; block < block_count; ++block)
+	{
+		tasks.Run([&, block]() {
+			auto block_dest = dest + block * block_size * virtual_count;
+			if (!geometric)
+			{
+				Mat<complex<T>> coil_data(const_cast<complex<T>*>(source + block * block_size * coil_count),
+					block_size, coil_count, false, true);
+				Mat<complex<T>> virtual_data(block_dest, block_size, virtual_count, false, true);
+				virtual_data = coil_data * conv_to<Mat<complex<T>>>::from(
+					bases[block].vectors[0].cols(0, virtual_count - 1));
+				return true;
+			}
+
+			AlignBasis(bases[block].vectors, virtual_count);
+			ApplyGeometric(hybrids[block].data(), block_dest, width, block_size / width,
+				coil_count, virtual_count, bases[block].vectors);
+			hybrids[block].clear();
+			hybrids[block].shrink_to_fit();
+
+			// ExecuteCentered() shifts after the transform, so it is not its own inverse. The
+			// shift is undone by ApplyGeometric(), leaving the plain transform.
+			return FftPlanCache::GetInstance().Execute(block_dest, block_dest,
+				vector<int>{int(width)}, false, int(block_size / width * virtual_count));
+		});
+	}
+	if (!tasks.Wait())
+	{
+		LOG_ERROR(L"<CoilCompressor> Failed to compress the coils!", L"BasicRecon");
+		return false;
+	}
+
+	return Feed(L"Output", output.get());
+}
+
+template <typename T>
+void CoilCompressor::GetGlobalBasis(const complex<T> * data, unsigned int width, unsigned int height,
+	unsigned int plane_count, unsigned int coil_count, unsigned int first_line, unsigned int line_count,
+	Basis& basis)
+{
+	// Rows of the central band are contiguous, one memcpy per coil and plane.
+	size_t band_size = size_t(width) * line_count;
+	size_t block_size = size_t(width) * height * plane_count;
+	Mat<complex<T>> calibration(band_size * plane_count, coil_count);
+	for (unsigned int coil = 0; coil < coil_count; ++coil)
+	{
+		for (unsigned int plane = 0; plane < plane_count; ++plane)
+		{
+			memcpy(calibration.colptr(coil) + plane * band_size,
+				data + coil * block_size + (size_t(plane) * height + first_line) * width,
+				band_size * sizeof(complex<T>));
+		}
+	}
+
+	cx_mat covariance = conv_to<cx_mat>::from(calibration.t() * calibration);
+	vec eigenvalues;
+	cx_mat eigenvectors;
+	eig_sym(eigenvalues, eigenvectors, covariance);
+
+	basis.eigenvalues = flipud(eigenvalues);
+	basis.vectors.assign(1, fliplr(eigenvectors));
+}
+
+template <typename T>
+void CoilCompressor::GetGeometricBasis(const complex<T> * hybrid, unsigned int width, unsigned int height,
+	unsigned int plane_count, unsigned int coil_count, unsigned int first_line, unsigned int line_count,
+	Basis& basis)
+{
+	size_t block_size = size_t(width) * height * plane_count;
+	Mat<complex<T>> calibration(line_count * plane_count, coil_count);
+	cx_mat total(coil_count, coil_count, fill::zeros);
+	vec eigenvalues;
+	cx_mat eigenvectors;
+
+	basis.vectors.resize(width);
+	for (unsigned int x = 0; x < width; ++x)
+	{
+		for (unsigned int coil = 0; coil < coil_count; ++coil)
+		{
+			auto column = calibration.colptr(coil);
+			for (unsigned int plane = 0; plane < plane_count; ++plane)
+			{
+				auto row = hybrid + coil * block_size + (size_t(plane) * height + first_line) * width + x;
+				for (unsigned int line = 0; line < line_count; ++line)
+				{
+					*column++ = row[size_t(line) * width];
+				}
+			}
+		}
+
+		cx_mat covariance = conv_to<cx_mat>::from(calibration.t() * calibration);
+		total += covariance;
+		eig_sym(eigenvalues, eigenvectors, covariance);
+		basis.vectors[x] = fliplr(eigenvectors);
+	}
+
+	// The transform along the readout is unitary, so the sum is the covariance of the k-space.
+	eig_sym(eigenvalues, total);
+	basis.eigenvalues = flipud(eigenvalues);
+}
+
+void CoilCompressor::AlignBasis(vector<cx_mat>& vectors, unsigned int virtual_count)
+{
+	for (auto& v : vectors)
+	{
+		v = v.cols(0, virtual_count - 1);
+	}
+
+	// Eigenvectors are only defined up to a unitary rotation within the kept subspace. Each one
+	// is rotated to best match its neighbour (orthogonal Procrustes), starting at the center of
+	// the readout where the signal is strongest, so virtual coil maps stay smooth along x.
+	auto center = vectors.size() / 2;
+	cx_mat u, w;
+	vec s;
+	for (size_t x = center + 1; x < vectors.size(); ++x)
+	{
+		svd(u, s, w, vectors[x].t() * vectors[x - 1]);
+		vectors[x] = vectors[x] * u * w.t();
+	}
+	for (size_t x = center; x-- > 0; )
+	{
+		svd(u, s, w, vectors[x].t() * vectors[x + 1]);
+		vectors[x] = vectors[x] * u * w.t();
+	}
+}
+
+template <typename T>
+void CoilCompressor::ApplyGeometric(const complex<T> * hybrid, complex<T> * dest, unsigned int width,
+	size_t row_count, unsigned int coil_count, unsigned int virtual_count, const vector<cx_mat>& vectors)
+{
+	size_t block_size = width * row_count;
+	auto scale = T(1.0 / sqrt(double(width)));
+	Mat<complex<T>> coil_data(row_count, coil_count);
+	Mat<complex<T>> virtual_data;
+	for (unsigned int x = 0; x < width; ++x)
+	{
+		for (unsigned int coil = 0; coil < coil_count; ++coil)
+		{
+			auto column = coil_data.colptr(coil);
+			auto source = hybrid + coil * block_size + x;
+			for (size_t row = 0; row < row_count; ++row)
+			{
+				column[row] = source[row * width];
+			}
+		}
+
+		virtual_data = coil_data * conv_to<Mat<complex<T>>>::from(vectors[x]);
+
+		// Undo the shift, position x of the hybrid space is this position of the plain transform.
+		auto position = (x + width - width / 2) % width;
+		for (unsigned int coil = 0; coil < virtual_count; ++coil)
+		{
+			auto column = virtual_data.colptr(coil);
+			auto target = dest + coil * block_size + position;
+			for (size_t row = 0; row < row_count; ++row)
+			{
+				target[row * width] = column[row] * scale;
+			}
+		}
+	}
+}
+
+void CoilCompressor::GetCalibrationRange(unsigned int height, unsigned int& first, unsigned int& count)
+{
+	auto lines = GetProperty<int>(_calibration_lines);
+	count = (lines <= 0 || unsigned(lines) > height) ? height : unsigned(lines);
+	first = (height - count) / 2;
+}
+
+unsigned int CoilCompressor::SelectVirtualCoilCount(const vec& eigenvalues, unsigned int coil_count)
+{
+	auto target = GetProperty<int>(_target_count);
+	if (target > 0)
+		return min(unsigned(target), coil_count);
+
+	return GetVirtualCoilCount(eigenvalues, GetProperty<double>(_energy_threshold));
+}
+
+unsigned int CoilCompressor::GetVirtualCoilCount(const vec& eigenvalues, double threshold)
+{
+	double total = 0.0;
+	for (auto value : eigenvalues)
+	{
+		total += max(value, 0.0);
+	}
+	if (total <= 0.0 || eigenvalues.n_elem == 0)
+		return 1;
+
+	double kept = 0.0;
+	unsigned int count = 0;
+	while (count < eigenvalues.n_elem)
+	{
+		kept += max(eigenvalues[count++], 0.0);
+		if (kept >= threshold * total)
+			break;
+	}
+
+	return count;
+}
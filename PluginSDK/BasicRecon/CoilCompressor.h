@@ -0,0 +1,78 @@
+#pragma once
+
+#ifndef CoilCompressor_h__20171101
+#define CoilCompressor_h__20171101
+
+#include "Implement/ProcessorImpl.h"
+#include <armadillo>
+#include <complex>
+#include <vector>
+
+namespace Yap
+{
+	/**
+	@brief Linear combination of the physical coils into fewer virtual coils.
+
+	The compression matrix is formed by the principal components of the coil covariance of the
+	central phase encoding lines. In Global mode one matrix is used for the whole k-space, in
+	Geometric mode the data is transformed along the readout and every readout position gets
+	its own matrix, aligned to its neighbour so that virtual coils vary smoothly. The number of
+	virtual coils is TargetCount, or if that is 0, the smallest count keeping EnergyThreshold of
+	the calibration energy. Dimensions before DimensionChannel are compressed as a block, each
+	block after it (e.g. each slice) gets its own matrix.
+	*/
+	class CoilCompressor :
+		public ProcessorImpl
+	{
+		IMPLEMENT_SHARED(CoilCompressor)
+	public:
+		CoilCompressor();
+		CoilCompressor(const CoilCompressor& rhs);
+
+		/// Number of leading eigenvalues (in descending order) needed to keep the energy threshold.
+		static unsigned int GetVirtualCoilCount(const arma::vec& eigenvalues, double threshold);
+
+	protected:
+		~CoilCompressor();
+
+		virtual bool Input(const wchar_t * port, IData * data) override;
+
+		/// Principal components of the coil covariance, eigenvalues in descending order.
+		struct Basis
+		{
+			std::vector<arma::cx_mat> vectors;	///< One per readout position in Geometric mode.
+			arma::vec eigenvalues;
+		};
+
+		template <typename T>
+		bool Compress(IData * data, unsigned int channel_index, bool geometric);
+
+		template <typename T>
+		static void GetGlobalBasis(const std::complex<T> * data, unsigned int width, unsigned int height,
+			unsigned int plane_count, unsigned int coil_count, unsigned int first_line, unsigned int line_count,
+			Basis& basis);
+
+		template <typename T>
+		static void GetGeometricBasis(const std::complex<T> * hybrid, unsigned int width, unsigned int height,
+			unsigned int plane_count, unsigned int coil_count, unsigned int first_line, unsigned int line_count,
+			Basis& basis);
+
+		static void AlignBasis(std::vector<arma::cx_mat>& vectors, unsigned int virtual_count);
+
+		/// Apply the matrix of each readout position, writing unshifted, scaled hybrid data to dest.
+		template <typename T>
+		static void ApplyGeometric(const std::complex<T> * hybrid, std::complex<T> * dest, unsigned int width,
+			size_t row_count, unsigned int coil_count, unsigned int virtual_count,
+			const std::vector<arma::cx_mat>& vectors);
+
+		unsigned int SelectVirtualCoilCount(const arma::vec& eigenvalues, unsigned int coil_count);
+		void GetCalibrationRange(unsigned int height, unsigned int& first, unsigned int& count);
+
+		PropertyHandle _mode;
+		PropertyHandle _target_count;
+		PropertyHandle _energy_threshold;
+		PropertyHandle _calibration_lines;
+	};
+}
+
+#endif // CoilCompressor_h__
@@ -10,6 +10,8 @@ ComplexSplitter::ComplexSplitter() :
 	AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeComplexDouble);
 	AddOutput(L"Real", YAP_ANY_DIMENSION, DataTypeDouble);
 	AddOutput(L"Imaginary", YAP_ANY_DIMENSION, DataTypeDouble);
+
+	SetReentrant(true);
 }
 
 ComplexSplitter::~ComplexSplitter()
@@ -43,7 +43,7 @@ bool Yap::Difference::Input(const wchar_t * port, IData * data)
 {
 	if (wstring(port) == L"Reference")
 	{
-		_reference_data = YapShared(data);
+		_reference_data = RetainedData(data);
 		return true;
 	}
 	else if (wstring(port) == L"Input")
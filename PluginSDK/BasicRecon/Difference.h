@@ -20,7 +20,7 @@ namespace Yap
 
 		virtual bool Input(const wchar_t * port, IData * data) override;
 
-		SmartPtr<IData> _reference_data;
+		RetainedData _reference_data;
 	};
 }
 
@@ -0,0 +1,265 @@
+#include "stdafx.h"
+#include "FastNlm.h"
+#include "NoiseEstimation.h"
+
+#include "Client/DataHelper.h"
+#include "Implement/ExecutionEngine.h"
+#include "Implement/LogUserImpl.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+using namespace std;
+using namespace Yap;
+
+namespace
+{
+	const unsigned int RowsPerTask = 32;
+
+	/// Weights below exp(-30) are dropped, the same cut off as the lookup table of Nlmeans.
+	const float MaxExponent = 30.0f;
+
+	/// Mirror index i into [0, size), the edge pixel is repeated: ... 1 0 | 0 1 2 ... size-1 | size-1 ...
+	int Reflect(int i, int size)
+	{
+		while (i < 0 || i >= size)
+		{
+			i = (i < 0) ? -i - 1 : 2 * size - 1 - i;
+		}
+		return i;
+	}
+}
+
+FastNlm::FastNlm() :
+	ProcessorImpl(L"FastNlm")
+{
+	AddProperty<double>(L"Sigma", 0.0, L"Standard deviation of the noise, 0 to use the estimate of the series.");
+	AddProperty<int>(L"PatchRadius", 0, L"Radius of the compared patches, 0 to choose by the noise level.");
+	AddProperty<int>(L"SearchRadius", 0, L"Radius of the search window, 0 to choose by the noise level.");
+	AddProperty<double>(L"FilterParameter", 0.0, L"Filtering strength h relative to sigma, 0 to choose by the noise level.");
+
+	AddInput(L"Input", 2, DataTypeFloat);
+	AddOutput(L"Output", 2, DataTypeFloat);
+
+	_sigma = BindProperty<double>(L"Sigma");
+	_patch_radius = BindProperty<int>(L"PatchRadius");
+	_search_radius = BindProperty<int>(L"SearchRadius");
+	_filter_parameter = BindProperty<double>(L"FilterParameter");
+
+	SetReentrant(true);
+}
+
+FastNlm::FastNlm(const FastNlm& rhs) :
+	ProcessorImpl(rhs),
+	_sigma(rhs._sigma),
+	_patch_radius(rhs._patch_radius),
+	_search_radius(rhs._search_radius),
+	_filter_parameter(rhs._filter_parameter)
+{
+}
+
+FastNlm::~FastNlm()
+{
+}
+
+bool FastNlm::Input(const wchar_t * name, IData * data)
+{
+	if (data == nullptr || data->GetDataType() != DataTypeFloat)
+	{
+		LOG_ERROR(L"<FastNlm> Error input data type!(DataTypeFloat is available)!", L"BasicRecon");
+		return false;
+	}
+	if (_wcsicmp(name, L"Input") != 0)
+	{
+		LOG_ERROR(L"<FastNlm> Error input port name!", L"BasicRecon");
+		return false;
+	}
+
+	DataHelper input_data(data);
+	unsigned int width = input_data.GetWidth();
+	unsigned int height = input_data.GetHeight();
+	auto input = GetDataArray<float>(data);
+
+	auto sigma = float(GetProperty<double>(_sigma));
+	if (sigma <= 0.0f && !NoiseEstimation::GetInstance().GetSigma(data, sigma))
+		return false;
+
+	// Same parameters as NLM and Nlmeans unless set explicitly.
+	unsigned int patch_radius, search_radius;
+	float h;
+	if (sigma <= 15.0f)
+	{
+		patch_radius = 1;
+		search_radius = 10;
+		h = 0.4f;
+	}
+	else if (sigma <= 30.0f)
+	{
+		patch_radius = 2;
+		search_radius = 10;
+		h = 0.4f;
+	}
+	else if (sigma <= 45.0f)
+	{
+		patch_radius = 3;
+		search_radius = 17;
+		h = 0.35f;
+	}
+	else if (sigma <= 75.0f)
+	{
+		patch_radius = 4;
+		search_radius = 17;
+		h = 0.35f;
+	}
+	else
+	{
+		patch_radius = 5;
+		search_radius = 17;
+		h = 0.30f;
+	}
+
+	if (GetProperty<int>(_patch_radius) > 0)
+	{
+		patch_radius = unsigned(GetProperty<int>(_patch_radius));
+	}
+	if (GetProperty<int>(_search_radius) > 0)
+	{
+		search_radius = unsigned(GetProperty<int>(_search_radius));
+	}
+	if (GetProperty<double>(_filter_parameter) > 0.0)
+	{
+		h = float(GetProperty<double>(_filter_parameter));
+	}
+
+	auto output = CreateData<float>(data);
+	if (sigma > 0.0f)
+	{
+		Denoise(input, GetDataArray<float>(output.get()), width, height, patch_radius, search_radius, sigma, h);
+	}
+	else
+	{
+		memcpy(GetDataArray<float>(output.get()), input, size_t(width) * height * sizeof(float));
+	}
+
+	return Feed(L"Output", output.get());
+}
+
+void FastNlm::Denoise(const float * input, float * output, unsigned int width, unsigned int height,
+	unsigned int patch_radius, unsigned int search_radius, float sigma, float h)
+{
+	assert(input != nullptr && output != nullptr && input != output);
+
+	// Mirrored margins cover every patch of every candidate in the search window.
+	auto margin = int(patch_radius + search_radius);
+	auto padded_width = width + 2 * margin;
+	vector<float> padded(size_t(padded_width) * (height + 2 * margin));
+	for (int y = -margin; y < int(height) + margin; ++y)
+	{
+		auto source = input + size_t(Reflect(y, int(height))) * width;
+		auto dest = padded.data() + size_t(y + margin) * padded_width;
+		for (int x = -margin; x < int(width) + margin; ++x)
+		{
+			dest[x + margin] = source[Reflect(x, int(width))];
+		}
+	}
+
+	TaskGroup tasks;
+	for (unsigned int first_row = 0; first_row < height; first_row += RowsPerTask)
+	{
+		tasks.Run([&, first_row]() {
+			DenoiseRows(padded, output, width, first_row, min(RowsPerTask, height - first_row),
+				patch_radius, search_radius, sigma, h);
+			return true;
+		});
+	}
+	tasks.Wait();
+}
+
+void FastNlm::DenoiseRows(const vector<float>& padded, float * output, unsigned int width,
+	unsigned int first_row, unsigned int row_count, unsigned int patch_radius,
+	unsigned int search_radius, float sigma, float h)
+{
+	auto margin = patch_radius + search_radius;
+	auto padded_width = width + 2 * margin;
+	auto patch_size = 2 * patch_radius + 1;
+	float patch_area = float(patch_size * patch_size);
+	float bias = 2.0f * sigma * sigma;
+	float filter = 1.0f / (h * sigma * h * sigma);
+
+	// The integral image covers the band plus the patch radius on every side, its first row and
+	// column are zero. Element (r, c) of the band is padded pixel (first_row + search_radius + r,
+	// search_radius + c).
+	auto rows = row_count + 2 * patch_radius;
+	auto columns = width + 2 * patch_radius;
+	vector<double> integral(size_t(rows + 1) * (columns + 1), 0.0);
+
+	size_t pixel_count = size_t(row_count) * width;
+	vector<float> total_weight(pixel_count, 0.0f);
+	vector<float> max_weight(pixel_count, 0.0f);
+	vector<float> weighted_sum(pixel_count, 0.0f);
+
+	auto band = padded.data() + size_t(first_row + search_radius) * padded_width + search_radius;
+	auto radius = int(search_radius);
+	for (int dy = -radius; dy <= radius; ++dy)
+	{
+		for (int dx = -radius; dx <= radius; ++dx)
+		{
+			if (dx == 0 && dy == 0)
+				continue;
+
+			auto shifted = band + dy * int(padded_width) + dx;
+			for (unsigned int r = 0; r < rows; ++r)
+			{
+				auto a = band + size_t(r) * padded_width;
+				auto b = shifted + size_t(r) * padded_width;
+				auto above = integral.data() + size_t(r) * (columns + 1);
+				auto current = above + columns + 1;
+				double row_sum = 0.0;
+				for (unsigned int c = 0; c < columns; ++c)
+				{
+					float difference = a[c] - b[c];
+					row_sum += difference * difference;
+					current[c + 1] = above[c + 1] + row_sum;
+				}
+			}
+
+			// Candidate pixels are the centers of the shifted patches.
+			auto candidates = shifted + patch_radius * padded_width + patch_radius;
+			for (unsigned int y = 0; y < row_count; ++y)
+			{
+				auto top = integral.data() + size_t(y) * (columns + 1);
+				auto bottom = top + size_t(patch_size) * (columns + 1);
+				auto candidate = candidates + size_t(y) * padded_width;
+				auto index = size_t(y) * width;
+				for (unsigned int x = 0; x < width; ++x, ++index)
+				{
+					auto distance = float(bottom[x + patch_size] - top[x + patch_size] - bottom[x] + top[x]);
+					auto exponent = max(distance / patch_area - bias, 0.0f) * filter;
+					if (exponent >= MaxExponent)
+						continue;
+
+					auto weight = expf(-exponent);
+					total_weight[index] += weight;
+					weighted_sum[index] += weight * candidate[x];
+					max_weight[index] = max(max_weight[index], weight);
+				}
+			}
+		}
+	}
+
+	auto centers = band + patch_radius * padded_width + patch_radius;
+	for (unsigned int y = 0; y < row_count; ++y)
+	{
+		auto center = centers + size_t(y) * padded_width;
+		auto dest = output + size_t(first_row + y) * width;
+		auto index = size_t(y) * width;
+		for (unsigned int x = 0; x < width; ++x, ++index)
+		{
+			auto weight = total_weight[index] + max_weight[index];
+			dest[x] = (weight > 0.0f) ?
+				(weighted_sum[index] + max_weight[index] * center[x]) / weight : center[x];
+		}
+	}
+}
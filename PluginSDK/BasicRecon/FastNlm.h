@@ -0,0 +1,50 @@
+#pragma once
+
+#ifndef FastNlm_h__20171102
+#define FastNlm_h__20171102
+
+#include "Implement/ProcessorImpl.h"
+#include <vector>
+
+namespace Yap
+{
+	/**
+	@brief Pixelwise non-local means with patch distances taken from integral images.
+
+	For every offset in the search window the squared difference between the image and its
+	shifted copy is summed into an integral image, after which the distance between any two
+	patches at that offset costs four lookups. The run time is O(N * S^2) instead of
+	O(N * S^2 * P^2). Patch distances are unweighted as in Nlmeans, the weights follow the
+	IPOL formulation: w = exp(-max(d^2 / P^2 - 2 * sigma^2, 0) / (h * sigma)^2), and the pixel
+	itself gets the largest weight of its window. The image is mirrored at the borders. Unless
+	Sigma is set, the noise level is taken from NoiseEstimation.
+	Bands of rows are denoised as independent tasks of the ExecutionEngine.
+	*/
+	class FastNlm :
+		public ProcessorImpl
+	{
+		IMPLEMENT_SHARED(FastNlm)
+	public:
+		FastNlm();
+		FastNlm(const FastNlm& rhs);
+
+		static void Denoise(const float * input, float * output, unsigned int width, unsigned int height,
+			unsigned int patch_radius, unsigned int search_radius, float sigma, float h);
+
+	protected:
+		~FastNlm();
+
+		virtual bool Input(const wchar_t * name, IData * data) override;
+
+		static void DenoiseRows(const std::vector<float>& padded, float * output, unsigned int width,
+			unsigned int first_row, unsigned int row_count, unsigned int patch_radius,
+			unsigned int search_radius, float sigma, float h);
+
+		PropertyHandle _sigma;
+		PropertyHandle _patch_radius;
+		PropertyHandle _search_radius;
+		PropertyHandle _filter_parameter;
+	};
+}
+
+#endif // FastNlm_h__
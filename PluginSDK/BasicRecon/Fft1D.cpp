@@ -1,8 +1,10 @@
 #include "Fft1D.h"
+#include "FftPlanCache.h"
 
 #include "Client/DataHelper.h"
 #include "Implement/LogUserImpl.h"
 
+#include <algorithm>
 #include <string.h>
 
 #pragma comment(lib, "libfftw3-3.lib")
@@ -13,24 +15,30 @@ using namespace std;
 using namespace Yap;
 
 Fft1D::Fft1D() : 
-	ProcessorImpl(L"Fft1D"),
-	_plan_data_size(0),
-	_plan_inverse(false),
-	_plan_in_place(false)
+	ProcessorImpl(L"Fft1D")
 {
 	AddProperty<bool>(L"Inverse", false, L"The direction of FFT1D.");
 	AddProperty<bool>(L"InPlace", true, L"The position of FFT1D.");
-
-	AddInput(L"Input", 1, DataTypeComplexDouble | DataTypeComplexFloat);
-	AddOutput(L"Output", 1, DataTypeComplexDouble | DataTypeComplexFloat);
+	AddProperty<int>(L"Threads", 0, L"Number of threads of the transform, 0 for the default.");
+	AddProperty<bool>(L"HalfSpectrum", false,
+		L"Output only the non-negative frequencies of real input, without fftshift.");
+	AddProperty<bool>(L"RealOutput", false,
+		L"Treat complex input as the output of HalfSpectrum and transform it into real data.");
+
+	// Real input is transformed with a real-to-complex plan, no conversion to complex is needed.
+	AddInput(L"Input", 1, DataTypeComplexDouble | DataTypeComplexFloat | DataTypeDouble | DataTypeFloat);
+	AddOutput(L"Output", 1, DataTypeComplexDouble | DataTypeComplexFloat | DataTypeDouble | DataTypeFloat);
+	_input_port = GetInputHandle(L"Input");
+	_output_port = GetOutputHandle(L"Output");
+
+	SetReentrant(true);
 }
 
 
 Fft1D::Fft1D(const Fft1D& rhs)
 	:ProcessorImpl(rhs),
-	_plan_data_size(rhs._plan_data_size),
-	_plan_inverse(rhs._plan_inverse),
-	_plan_in_place(rhs._plan_in_place)
+	_input_port(rhs._input_port),
+	_output_port(rhs._output_port)
 {
 }
 
@@ -41,169 +49,114 @@ Fft1D::~Fft1D()
 template<typename T> bool Fft1D::DoFft(IData * data, size_t size)
 {
 	auto data_array = GetDataArray<complex<T>>(data);
-	if (GetProperty<bool>(L"InPlace"))
+	if (GetProperty<bool>(L"InPlace") && IsWritable(data))
 	{
-		Fft<T>(data_array, data_array, size, GetProperty<bool>(L"Inverse"));
-		return Feed(L"Output", data);
+		if (!Fft<T>(data_array, data_array, size, GetProperty<bool>(L"Inverse")))
+			return false;
+
+		return Feed(_output_port, data);
 	}
 	else
 	{
-		auto output = CreateData<complex<T>>(data);
-		Fft<T>(data_array, GetDataArray<complex<T>>(output.get()), size, GetProperty<bool>(L"Inverse"));
-		return Feed(L"Output", output.get());
+		auto output = CreateOutputData<complex<T>>(_output_port, data);
+		if (!Fft<T>(data_array, GetDataArray<complex<T>>(output.get()), size, GetProperty<bool>(L"Inverse")))
+			return false;
+
+		return Feed(_output_port, output.get());
 	}
 }
 
-bool Fft1D::Input(const wchar_t * port, IData * data)
+template<typename T> bool Fft1D::DoRealFft(IData * data, size_t size)
 {
-	if (wstring(port) != L"Input")
-		return false;
+	auto half_spectrum = GetProperty<bool>(L"HalfSpectrum");
 
-	DataHelper input_data(data);
-	if (input_data.GetActualDimensionCount() != 1)
-		return false;
-
-	if ((input_data.GetDataType() & DataTypeComplexDouble) != 0)
-	{
-		return DoFft<double>(data, input_data.GetWidth());
-	}
-	else if ((input_data.GetDataType() & DataTypeComplexFloat) != 0)
+	Dimensions dimensions(data->GetDimensions());
+	if (half_spectrum)
 	{
-		return DoFft<float>(data, input_data.GetWidth());
+		SetWidth(dimensions, unsigned(size / 2 + 1));
 	}
-	else
-	{
+	auto output = CreateOutputData<complex<T>>(_output_port, data, &dimensions);
+
+	auto& plans = FftPlanCache::GetInstance();
+	auto threads = unsigned(max(GetProperty<int>(L"Threads"), 0));
+	auto inverse = GetProperty<bool>(L"Inverse");
+	auto data_array = GetDataArray<T>(data);
+	auto output_array = GetDataArray<complex<T>>(output.get());
+	if (!(half_spectrum ?
+		plans.ExecuteHalfSpectrum(data_array, output_array, { int(size) }, inverse, 1, threads) :
+		plans.ExecuteCenteredR2C(data_array, output_array, { int(size) }, inverse, 1, threads)))
 		return false;
-	}
-}
 
-template <typename T>
-void Fft1D::FFTShift(std::complex<T>* data, size_t size)
-{
-	bool is_odd = ((size % 2) != 0);
-	if (is_odd)
-	{
-		SwapBlock(data, data + (size-1) / 2 + 1, (size-1) / 2);
-	}
-	else
-	{
-		SwapBlock(data, data + size / 2, size / 2);
-	}
+	return Feed(_output_port, output.get());
 }
 
-template <typename T>
-void Fft1D::SwapBlock(std::complex<T>* block1, 
-	std::complex<T>* block2, 
-	size_t width)
+template<typename T> bool Fft1D::DoRealOutputFft(IData * data, size_t size)
 {
-	std::vector<std::complex<T>> swap_buffer;
-	swap_buffer.resize(width);
+	// A half spectrum of n / 2 + 1 elements is taken to come from real data of even size n.
+	auto real_size = (size - 1) * 2;
+	if (real_size == 0)
+		return false;
+
+	Dimensions dimensions(data->GetDimensions());
+	SetWidth(dimensions, unsigned(real_size));
+	auto output = CreateOutputData<T>(_output_port, data, &dimensions);
 
-	auto cursor1 = block1;
-	auto cursor2 = block2;
+	if (!FftPlanCache::GetInstance().ExecuteRealFromHalfSpectrum(GetDataArray<complex<T>>(data),
+		GetDataArray<T>(output.get()), { int(real_size) }, GetProperty<bool>(L"Inverse"),
+		1, unsigned(max(GetProperty<int>(L"Threads"), 0))))
+		return false;
 
-	memcpy(swap_buffer.data(), cursor1, width * sizeof(std::complex<T>));
-	memcpy(cursor1, cursor2, width * sizeof(std::complex<T>));
-	memcpy(cursor2, swap_buffer.data(), width * sizeof(std::complex<T>));
+	return Feed(_output_port, output.get());
 }
 
-template <>
-void Fft1D::Plan<double>(size_t size, bool inverse, bool in_place)
+void Fft1D::SetWidth(Dimensions& dimensions, unsigned int width)
 {
-	vector<fftw_complex> data(size);
-	if (in_place)
-	{
-		_fft_plan_double = fftw_plan_dft_1d(int(size), (fftw_complex*)data.data(),
-			(fftw_complex*)data.data(),
-			inverse ? FFTW_BACKWARD : FFTW_FORWARD,
-			FFTW_UNALIGNED);
-	}
-	else
-	{
-		vector<fftw_complex> result(size);
-		_fft_plan_double = fftw_plan_dft_1d(int(size), (fftw_complex*)data.data(),
-			(fftw_complex*)result.data(),
-			inverse ? FFTW_BACKWARD : FFTW_FORWARD,
-			FFTW_UNALIGNED);
-	}
-
-	_plan_data_size = static_cast<unsigned int> (size);
-	_plan_inverse = inverse;
-	_plan_in_place = in_place;
+	DimensionType type;
+	unsigned int start, length;
+	dimensions.GetDimensionInfo(0, type, start, length);
+	dimensions.SetDimensionInfo(0, type, start, width);
 }
 
-template <>
-void Fft1D::Plan<float>(size_t size, bool inverse, bool in_place)
+bool Fft1D::Input(const wchar_t * port, IData * data)
 {
-	vector<fftwf_complex> data(size);
-	if (in_place)
-	{
-		_fft_plan_float = fftwf_plan_dft_1d(int(size), (fftwf_complex*)data.data(),
-			(fftwf_complex*)data.data(),
-			inverse ? FFTW_BACKWARD : FFTW_FORWARD,
-			FFTW_UNALIGNED);
-	}
-	else
-	{
-		vector<fftwf_complex> result(size);
-		_fft_plan_float = fftwf_plan_dft_1d(int(size), (fftwf_complex*)data.data(),
-			(fftwf_complex*)result.data(),
-			inverse ? FFTW_BACKWARD : FFTW_FORWARD,
-			FFTW_UNALIGNED);
-	}
+	if (wstring(port) != L"Input")
+		return false;
 
-	_plan_data_size = static_cast<unsigned int> (size);
-	_plan_inverse = inverse;
-	_plan_in_place = in_place;
+	return InputByHandle(_input_port, data);
 }
 
-template<>
-bool Fft1D::Fft(std::complex<double> * data, 
-				std::complex<double> * result_data,
-				size_t size,
-				bool inverse)
+bool Fft1D::InputByHandle(PortHandle port, IData * data)
 {
-	bool in_place = (data == result_data);
+	assert(port == _input_port);
 
-	if (size != _plan_data_size || inverse != _plan_inverse || in_place != _plan_in_place)
-	{
-		Plan<double>(size, inverse, in_place);
-	}
-
-	fftw_execute_dft(_fft_plan_double, (fftw_complex*)data, (fftw_complex*)result_data);
+	DataHelper input_data(data);
+	if (input_data.GetActualDimensionCount() != 1)
+		return false;
 
-	for (auto data = result_data; data < result_data + size; ++data)
+	auto real_output = GetProperty<bool>(L"RealOutput");
+	switch (input_data.GetDataType())
 	{
-		*data /= sqrt(size);
+	case DataTypeComplexDouble:
+		return real_output ? DoRealOutputFft<double>(data, input_data.GetWidth()) :
+			DoFft<double>(data, input_data.GetWidth());
+	case DataTypeComplexFloat:
+		return real_output ? DoRealOutputFft<float>(data, input_data.GetWidth()) :
+			DoFft<float>(data, input_data.GetWidth());
+	case DataTypeDouble:
+		return DoRealFft<double>(data, input_data.GetWidth());
+	case DataTypeFloat:
+		return DoRealFft<float>(data, input_data.GetWidth());
+	default:
+		return false;
 	}
-
-	FFTShift(result_data, size);
-
-	return true;
 }
 
-template<>
-bool Fft1D::Fft(std::complex<float> * data,
-	std::complex<float> * result_data,
+template<typename T>
+bool Fft1D::Fft(std::complex<T> * data,
+	std::complex<T> * result_data,
 	size_t size,
 	bool inverse)
 {
-	bool in_place = (data == result_data);
-
-	if (size != _plan_data_size || inverse != _plan_inverse || in_place != _plan_in_place)
-	{
-		Plan<float>(size, inverse, in_place);
-	}
-
-	fftwf_execute_dft(_fft_plan_float, (fftwf_complex*)data, (fftwf_complex*)result_data);
-
-	for (auto data = result_data; data < result_data + size; ++data)
-	{
-		*data /= static_cast<float>(sqrt(size));
-	}
-
-	FFTShift(result_data, size);
-
-	return true;
+	return FftPlanCache::GetInstance().ExecuteCentered(data, result_data, { int(size) }, inverse,
+		1, unsigned(max(GetProperty<int>(L"Threads"), 0)));
 }
-
@@ -22,29 +22,24 @@ namespace Yap
 		~Fft1D();
 
 		virtual bool Input(const wchar_t * port, IData * data) override;
+		virtual bool InputByHandle(PortHandle port, IData * data) override;
 
-		template <typename T>
-		void FFTShift(std::complex<T>* data, size_t size);
+		PortHandle _input_port;
+		PortHandle _output_port;
 
-		template <typename T>
-		void SwapBlock(std::complex<T> * block1, std::complex<T> * block2,
-			size_t width);
+		template<typename T> bool DoFft(IData * data, size_t size);
 
-		unsigned int _plan_data_size;
-		bool _plan_inverse;
-		bool _plan_in_place;
+		/// Transform real input into a full centered spectrum or a half spectrum.
+		template<typename T> bool DoRealFft(IData * data, size_t size);
 
-		fftwf_plan _fft_plan_float;
-		fftw_plan _fft_plan_double;
+		/// Transform a half spectrum of size elements into real output.
+		template<typename T> bool DoRealOutputFft(IData * data, size_t size);
 
-		template<typename T> bool DoFft(IData * data, size_t size);
+		static void SetWidth(Dimensions& dimensions, unsigned int width);
 
 		template<typename T>
 		bool Fft(std::complex<T> * data, std::complex<T> * result,
 			size_t size, bool inverse = false);
-
-		template<typename T>
-		void Plan(size_t size, bool inverse, bool in_place);
 	};
 }
 
@@ -1,36 +1,55 @@
 #include "Fft2D.h"
+#include "FftPlanCache.h"
 
 #include "Client/DataHelper.h"
 #include "Implement/LogUserImpl.h"
 
+#include <algorithm>
 #include <string>
 
 using namespace std;
 using namespace Yap;
 
 Fft2D::Fft2D():
-	ProcessorImpl(L"Fft2D"),
-	_plan_data_width(0),
-	_plan_data_height(0),
-	_plan_inverse(false),
-	_plan_in_place(false),
-	_fft_plan(nullptr)
+	ProcessorImpl(L"Fft2D")
 {
 	AddProperty<bool>( L"Inverse", false, L"The direction of FFT2D.");
 	AddProperty<bool>( L"InPlace", true, L"The position of FFT2D.");
-
-	AddInput(L"Input", 2, DataTypeComplexFloat);
-	AddOutput(L"Output", 2, DataTypeComplexFloat);
+	AddProperty<int>(L"Threads", 0, L"Number of threads of the transform, 0 for the default.");
+	AddProperty<bool>(L"HalfSpectrum", false,
+		L"Output only the non-negative readout frequencies of real input, without fftshift.");
+	AddProperty<bool>(L"RealOutput", false,
+		L"Treat complex input as the output of HalfSpectrum and transform it into real data.");
+
+	// Dimensions after the first two are transformed as a batch of 2D images. Real input is
+	// transformed with a real-to-complex plan, no conversion to complex is needed.
+	AddInput(L"Input", YAP_ANY_DIMENSION,
+		DataTypeComplexFloat | DataTypeComplexDouble | DataTypeFloat | DataTypeDouble);
+	AddOutput(L"Output", YAP_ANY_DIMENSION,
+		DataTypeComplexFloat | DataTypeComplexDouble | DataTypeFloat | DataTypeDouble);
+	_input_port = GetInputHandle(L"Input");
+	_output_port = GetOutputHandle(L"Output");
+
+	_inverse = BindProperty<bool>(L"Inverse");
+	_in_place = BindProperty<bool>(L"InPlace");
+	_threads = BindProperty<int>(L"Threads");
+	_half_spectrum = BindProperty<bool>(L"HalfSpectrum");
+	_real_output = BindProperty<bool>(L"RealOutput");
+
+	// Plans are shared through FftPlanCache, no state is changed by Input().
+	SetReentrant(true);
 }
 
 
 Fft2D::Fft2D(const Fft2D& rhs)
 	:ProcessorImpl(rhs),
-	_plan_data_width(rhs._plan_data_width),
-	_plan_data_height(rhs._plan_data_height),
-	_plan_inverse(rhs._plan_inverse),
-	_plan_in_place(rhs._plan_in_place),
-	_fft_plan(rhs._fft_plan)
+	_input_port(rhs._input_port),
+	_output_port(rhs._output_port),
+	_inverse(rhs._inverse),
+	_in_place(rhs._in_place),
+	_threads(rhs._threads),
+	_half_spectrum(rhs._half_spectrum),
+	_real_output(rhs._real_output)
 {
 }
 
@@ -41,130 +60,167 @@ Fft2D::~Fft2D()
 
 bool Fft2D::Input(const wchar_t * port, IData * data)
 {
-	// Do some check.
-	if (data == nullptr)
+	if (_wcsicmp(port, L"Input") != 0)
 	{
-		LOG_ERROR(L"<Fft2D> Invalid input data!", L"BasicRecon");
+		LOG_ERROR(L"<Fft2D> Error input port name!", L"BasicRecon");
 		return false;
 	}
-	if (_wcsicmp(port, L"Input") != 0)
+
+	return InputByHandle(_input_port, data);
+}
+
+bool Fft2D::InputByHandle(PortHandle port, IData * data)
+{
+	assert(port == _input_port);
+
+	// Do some check.
+	if (data == nullptr)
 	{
-		LOG_ERROR(L"<Fft2D> Error input port name!", L"BasicRecon");
+		LOG_ERROR(L"<Fft2D> Invalid input data!", L"BasicRecon");
 		return false;
 	}
 
 	DataHelper input_data(data);
-	if (input_data.GetActualDimensionCount() != 2)
+	if (input_data.GetDimensionCount() < 2)
 	{
-		LOG_ERROR(L"<Fft2D> Error input data dimention!(2D data is available)!", L"BasicRecon");
+		LOG_ERROR(L"<Fft2D> Error input data dimention!(at least 2D data is required)!", L"BasicRecon");
 		return false;
 	}
-	if (input_data.GetDataType() != DataTypeComplexFloat)
+	auto data_type = input_data.GetDataType();
+	if (data_type != DataTypeComplexFloat && data_type != DataTypeComplexDouble &&
+		data_type != DataTypeFloat && data_type != DataTypeDouble)
 	{
-		LOG_ERROR(L"<Fft2D> Error input data type!(DataTypeComplexFloat is available)!", L"BasicRecon");
+		LOG_ERROR(L"<Fft2D> Error input data type!(DataTypeComplexFloat, DataTypeComplexDouble, DataTypeFloat or DataTypeDouble is available)!", L"BasicRecon");
 		return false;
 	}
 
 	LOG_TRACE(L"<Fft2D> Input::After Check.", L"BasicRecon");
 
-	auto width = input_data.GetWidth();
-	auto height = input_data.GetHeight();
+	size_t width = input_data.GetWidth();
+	size_t height = input_data.GetHeight();
+	if (width == 0 || height == 0)
+		return Feed(_output_port, data);
 
-	auto data_array = GetDataArray<complex<float>>(data);
+	// All images (slices, channels, ...) are transformed with one batched plan.
+	auto image_count = input_data.GetDataSize() / (width * height);
 
-	if (GetProperty<bool>(L"InPlace"))
+	auto real_output = GetProperty<bool>(_real_output);
+	switch (data_type)
 	{
-		LOG_TRACE(L"<Fft2D> Input::InPlace is true, before Fft().", L"BasicRecon");
-		Fft(data_array, data_array, width, height, GetProperty<bool>(L"Inverse"));
-		return Feed(L"Output", data);
+	case DataTypeComplexDouble:
+		return real_output ? DoRealOutputFft<double>(data, width, height, image_count) :
+			DoFft<double>(data, width, height, image_count);
+	case DataTypeComplexFloat:
+		return real_output ? DoRealOutputFft<float>(data, width, height, image_count) :
+			DoFft<float>(data, width, height, image_count);
+	case DataTypeDouble:
+		return DoRealFft<double>(data, width, height, image_count);
+	default:
+		return DoRealFft<float>(data, width, height, image_count);
 	}
-	else
-	{
-		auto output = CreateData<complex<double>>(data);
-
-		LOG_TRACE(L"<Fft2D> Input::InPlace is false, create data, before Fft().", L"BasicRecon");
-
-		Fft(data_array, GetDataArray<complex<float>>(output.get()),
-			width, height, GetProperty<bool>(L"Inverse"));
-		return Feed(L"Output", output.get());
-	}
-}
-
-void Fft2D::FftShift(std::complex<float>* data, size_t  width, size_t height)
-{
-	LOG_TRACE(L"<Fft2D> FftShift::Before SwapBlock().", L"BasicRecon");
-	SwapBlock(data, data + height / 2 * width + width / 2, width / 2, height / 2, width);
-	SwapBlock(data + width / 2, data + height / 2 * width, width / 2, height / 2, width);
-	LOG_TRACE(L"<Fft2D> FftShift::After SwapBlock().", L"BasicRecon");
 }
 
-void Fft2D::SwapBlock(std::complex<float>* block1, std::complex<float>* block2, size_t width, size_t height, size_t line_stride)
+template <typename T>
+bool Fft2D::DoRealFft(IData * data, size_t width, size_t height, size_t image_count)
 {
-	std::vector<std::complex<float>> swap_buffer;
-	swap_buffer.resize(width);
+	auto half_spectrum = GetProperty<bool>(_half_spectrum);
 
-	auto cursor1 = block1;
-	auto cursor2 = block2;
-	LOG_TRACE(L"<Fft2D> SwapBlock::Before memcpy().", L"BasicRecon");
-	for (unsigned int row = 0; row < height; ++row)
+	Dimensions dimensions(data->GetDimensions());
+	if (half_spectrum)
 	{
-		memcpy(swap_buffer.data(), cursor1, width * sizeof(std::complex<float>));
-		memcpy(cursor1, cursor2, width * sizeof(std::complex<float>));
-		memcpy(cursor2, swap_buffer.data(), width * sizeof(std::complex<float>));
-
-		cursor1 += line_stride;
-		cursor2 += line_stride;
+		SetWidth(dimensions, unsigned(width / 2 + 1));
 	}
-	LOG_TRACE(L"<Fft2D> SwapBlock::After memcpy().", L"BasicRecon");
+	auto output = CreateOutputData<complex<T>>(_output_port, data, &dimensions);
+
+	auto& plans = FftPlanCache::GetInstance();
+	auto threads = unsigned(max(GetProperty<int>(_threads), 0));
+	auto inverse = GetProperty<bool>(_inverse);
+	auto data_array = GetDataArray<T>(data);
+	auto output_array = GetDataArray<complex<T>>(output.get());
+	if (!(half_spectrum ?
+		plans.ExecuteHalfSpectrum(data_array, output_array, { int(height), int(width) }, inverse, int(image_count), threads) :
+		plans.ExecuteCenteredR2C(data_array, output_array, { int(height), int(width) }, inverse, int(image_count), threads)))
+	{
+		LOG_ERROR(L"<Fft2D> Failed to create FFT plan!", L"BasicRecon");
+		return false;
+	}
+
+	return Feed(_output_port, output.get());
 }
 
-bool Fft2D::Fft(std::complex<float> * data, std::complex<float> * result_data, size_t width, size_t height, bool inverse)
+template <typename T>
+bool Fft2D::DoRealOutputFft(IData * data, size_t width, size_t height, size_t image_count)
 {
-	bool in_place = (data == result_data);
-
-	LOG_TRACE(L"<Fft2D> Fft::Before Plan().", L"BasicRecon");
-	if (width != _plan_data_width || height != _plan_data_height || inverse != _plan_inverse || in_place != _plan_in_place)
+	// A half spectrum of n / 2 + 1 columns is taken to come from real images of even width n.
+	auto real_width = (width - 1) * 2;
+	if (real_width == 0)
 	{
-		Plan(width, height, inverse, in_place);
+		LOG_ERROR(L"<Fft2D> Half spectrum must have at least 2 columns!", L"BasicRecon");
+		return false;
 	}
-	LOG_TRACE(L"<Fft2D> Fft::After Plan(), before fftwf_execute_dft().", L"BasicRecon");
-	fftwf_execute_dft(_fft_plan, (fftwf_complex*)data, (fftwf_complex*)result_data);
-	LOG_TRACE(L"<Fft2D> Fft::After fftwf_execute_dft().", L"BasicRecon");
 
-	for (auto data = result_data; data < result_data + width * height; ++data)
+	Dimensions dimensions(data->GetDimensions());
+	SetWidth(dimensions, unsigned(real_width));
+	auto output = CreateOutputData<T>(_output_port, data, &dimensions);
+
+	if (!FftPlanCache::GetInstance().ExecuteRealFromHalfSpectrum(GetDataArray<complex<T>>(data),
+		GetDataArray<T>(output.get()), { int(height), int(real_width) }, GetProperty<bool>(_inverse),
+		int(image_count), unsigned(max(GetProperty<int>(_threads), 0))))
 	{
-		*data /=  float(sqrt(width * height));
+		LOG_ERROR(L"<Fft2D> Failed to create FFT plan!", L"BasicRecon");
+		return false;
 	}
 
-	LOG_TRACE(L"<Fft2D> Fft::Before FftShift().", L"BasicRecon");
-	FftShift(result_data, width, height);
-	LOG_TRACE(L"<Fft2D> Fft::After FftShift().", L"BasicRecon");
-	return true;
+	return Feed(_output_port, output.get());
+}
+
+void Fft2D::SetWidth(Dimensions& dimensions, unsigned int width)
+{
+	DimensionType type;
+	unsigned int start, length;
+	dimensions.GetDimensionInfo(0, type, start, length);
+	dimensions.SetDimensionInfo(0, type, start, width);
 }
 
-void Fft2D::Plan(size_t width, size_t height, bool inverse, bool in_place)
+template <typename T>
+bool Fft2D::DoFft(IData * data, size_t width, size_t height, size_t image_count)
 {
-	vector<fftwf_complex> data(width * height);
+	auto data_array = GetDataArray<complex<T>>(data);
 
-	if (in_place)
+	// Data shared with other consumers is transformed into new data instead.
+	if (GetProperty<bool>(_in_place) && IsWritable(data))
 	{
-		_fft_plan = fftwf_plan_dft_2d(int(height), int(width), (fftwf_complex*)data.data(),
-			(fftwf_complex*)data.data(),
-			inverse ? FFTW_BACKWARD : FFTW_FORWARD,
-			FFTW_UNALIGNED);
+		LOG_TRACE(L"<Fft2D> Input::InPlace is true, before Fft().", L"BasicRecon");
+		if (!Fft(data_array, data_array, width, height, image_count, GetProperty<bool>(_inverse)))
+			return false;
+
+		return Feed(_output_port, data);
 	}
 	else
 	{
-		vector<fftwf_complex> result(width * height);
-		_fft_plan = fftwf_plan_dft_2d(int(height), int(width),  (fftwf_complex*)data.data(),
-			(fftwf_complex*)result.data(),
-			inverse ? FFTW_BACKWARD : FFTW_FORWARD,
-			FFTW_UNALIGNED);
-	}
+		auto output = CreateOutputData<complex<T>>(_output_port, data);
+
+		LOG_TRACE(L"<Fft2D> Input::InPlace is false, create data, before Fft().", L"BasicRecon");
 
-	_plan_data_width = static_cast<unsigned int> (width);
-	_plan_data_height = static_cast<unsigned int> (height);
-	_plan_inverse = inverse;
-	_plan_in_place = in_place;
+		if (!Fft(data_array, GetDataArray<complex<T>>(output.get()),
+			width, height, image_count, GetProperty<bool>(_inverse)))
+			return false;
+
+		return Feed(_output_port, output.get());
+	}
 }
 
+template <typename T>
+bool Fft2D::Fft(std::complex<T> * data, std::complex<T> * result_data, size_t width, size_t height,
+	size_t image_count, bool inverse)
+{
+	// Shift and normalization are done in the same pass, see FftPlanCache::ExecuteCentered().
+	if (!FftPlanCache::GetInstance().ExecuteCentered(data, result_data, { int(height), int(width) },
+		inverse, int(image_count), unsigned(max(GetProperty<int>(_threads), 0))))
+	{
+		LOG_ERROR(L"<Fft2D> Failed to create FFT plan!", L"BasicRecon");
+		return false;
+	}
+
+	return true;
+}
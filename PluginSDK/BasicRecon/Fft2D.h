@@ -22,18 +22,34 @@ namespace Yap
 		~Fft2D();
 
 		virtual bool Input(const wchar_t * port, IData * data) override;
+		virtual bool InputByHandle(PortHandle port, IData * data) override;
 
-		void FftShift(std::complex<float>* data, size_t width, size_t height);
-		void SwapBlock(std::complex<float> * block1, std::complex<float> * block2, size_t width, size_t height, size_t line_stride);
+		PortHandle _input_port;
+		PortHandle _output_port;
 
-		unsigned int _plan_data_width;
-		unsigned int _plan_data_height;
-		bool _plan_inverse;
-		bool _plan_in_place;
-		fftwf_plan _fft_plan;
+		PropertyHandle _inverse;
+		PropertyHandle _in_place;
+		PropertyHandle _threads;
+		PropertyHandle _half_spectrum;
+		PropertyHandle _real_output;
 
-		bool Fft(std::complex<float> * data, std::complex<float> * result, size_t width, size_t height, bool inverse = false);
-		void Plan(size_t width, size_t height, bool inverse, bool in_place);
+		template <typename T>
+		bool DoFft(IData * data, size_t width, size_t height, size_t image_count);
+
+		/// Transform real images into full centered spectra or half spectra.
+		template <typename T>
+		bool DoRealFft(IData * data, size_t width, size_t height, size_t image_count);
+
+		/// Transform half spectra of width columns into real images.
+		template <typename T>
+		bool DoRealOutputFft(IData * data, size_t width, size_t height, size_t image_count);
+
+		static void SetWidth(Dimensions& dimensions, unsigned int width);
+
+		/// Transform image_count contiguous images of width * height elements.
+		template <typename T>
+		bool Fft(std::complex<T> * data, std::complex<T> * result, size_t width, size_t height,
+			size_t image_count, bool inverse = false);
 	};
 }
 
@@ -21,19 +21,13 @@ namespace Yap
 		~Fft3D();
 
 		virtual bool Input(const wchar_t * port, IData * data) override;
+		virtual bool InputByHandle(PortHandle port, IData * data) override;
+
+		PortHandle _input_port;
+		PortHandle _output_port;
 
 		bool Fft(std::complex<float> * data, std::complex<float> * result, 
 			size_t width, size_t height, size_t depth, bool inverse = false);
-		void Plan(size_t width, size_t height, size_t depth, bool inverse, bool in_place);
-		void FftShift(std::complex<float>* data, size_t width, size_t height, size_t depth);
-		void SwapBlock(std::complex<float> * block1, std::complex<float> * block2, size_t width, size_t height, size_t line_stride);
-
-		unsigned int _plan_data_width;
-		unsigned int _plan_data_height;
-		unsigned int _plan_data_depth;
-		bool _plan_inverse;
-		bool _plan_in_place;
-		fftwf_plan _fft_plan;
 	};
 }
 
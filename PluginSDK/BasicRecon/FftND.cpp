@@ -0,0 +1,202 @@
+#include "stdafx.h"
+#include "FftND.h"
+#include "FftPlanCache.h"
+
+#include "Client/DataHelper.h"
+#include "Implement/LogUserImpl.h"
+
+#include <algorithm>
+#include <string>
+
+using namespace std;
+using namespace Yap;
+
+namespace
+{
+	struct DimensionName
+	{
+		const wchar_t * name;
+		DimensionType type;
+	};
+
+	const DimensionName DimensionNames[] =
+	{
+		{ L"Readout", DimensionReadout },
+		{ L"PhaseEncoding", DimensionPhaseEncoding },
+		{ L"Slice", DimensionSlice },
+		{ L"Dimension4", Dimension4 },
+		{ L"Channel", DimensionChannel },
+		{ L"Average", DimensionAverage },
+		{ L"Slab", DimensionSlab },
+		{ L"Echo", DimensionEcho },
+		{ L"Phase", DimensionPhase },
+		{ L"User1", DimensionUser1 },
+		{ L"User2", DimensionUser2 },
+		{ L"User3", DimensionUser3 },
+		{ L"User4", DimensionUser4 },
+		{ L"User5", DimensionUser5 },
+		{ L"User6", DimensionUser6 },
+	};
+}
+
+FftND::FftND() :
+	ProcessorImpl(L"FftND")
+{
+	AddProperty<std::wstring>(L"Dimensions", L"Readout",
+		L"Dimensions to transform, e.g. \"Readout, PhaseEncoding\" or \"Slice\".");
+	AddProperty<bool>(L"Inverse", false, L"The direction of FFTND.");
+	AddProperty<bool>(L"InPlace", true, L"The position of FFTND.");
+	AddProperty<int>(L"Threads", 0, L"Number of threads of the transform, 0 for the default.");
+
+	AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeComplexFloat | DataTypeComplexDouble);
+	AddOutput(L"Output", YAP_ANY_DIMENSION, DataTypeComplexFloat | DataTypeComplexDouble);
+	_input_port = GetInputHandle(L"Input");
+	_output_port = GetOutputHandle(L"Output");
+
+	_dimensions = BindProperty<std::wstring>(L"Dimensions");
+	_inverse = BindProperty<bool>(L"Inverse");
+	_in_place = BindProperty<bool>(L"InPlace");
+	_threads = BindProperty<int>(L"Threads");
+
+	SetReentrant(true);
+}
+
+FftND::FftND(const FftND& rhs) :
+	ProcessorImpl(rhs),
+	_input_port(rhs._input_port),
+	_output_port(rhs._output_port),
+	_dimensions(rhs._dimensions),
+	_inverse(rhs._inverse),
+	_in_place(rhs._in_place),
+	_threads(rhs._threads)
+{
+}
+
+FftND::~FftND()
+{
+}
+
+bool FftND::ParseDimensions(const wstring& text, vector<DimensionType>& types)
+{
+	types.clear();
+
+	size_t first = 0;
+	while (first < text.size())
+	{
+		auto last = text.find_first_of(L",; ", first);
+		if (last == wstring::npos)
+		{
+			last = text.size();
+		}
+
+		if (last > first)
+		{
+			auto name = text.substr(first, last - first);
+			auto iter = find_if(begin(DimensionNames), end(DimensionNames), [&name](const DimensionName& item) {
+				return _wcsicmp(item.name, name.c_str()) == 0;
+			});
+			if (iter == end(DimensionNames))
+				return false;
+
+			types.push_back(iter->type);
+		}
+		first = last + 1;
+	}
+
+	return !types.empty();
+}
+
+bool FftND::Input(const wchar_t * port, IData * data)
+{
+	if (_wcsicmp(port, L"Input") != 0)
+	{
+		LOG_ERROR(L"<FftND> Error input port name!", L"BasicRecon");
+		return false;
+	}
+
+	return InputByHandle(_input_port, data);
+}
+
+bool FftND::InputByHandle(PortHandle port, IData * data)
+{
+	assert(port == _input_port);
+
+	if (data == nullptr)
+	{
+		LOG_ERROR(L"<FftND> Invalid input data!", L"BasicRecon");
+		return false;
+	}
+
+	DataHelper input_data(data);
+	if (input_data.GetDataType() != DataTypeComplexFloat && input_data.GetDataType() != DataTypeComplexDouble)
+	{
+		LOG_ERROR(L"<FftND> Error input data type!(DataTypeComplexFloat or DataTypeComplexDouble is available)!", L"BasicRecon");
+		return false;
+	}
+
+	vector<DimensionType> types;
+	if (!ParseDimensions(GetProperty<std::wstring>(_dimensions), types))
+	{
+		LOG_ERROR(L"<FftND> Invalid dimension names in property Dimensions!", L"BasicRecon");
+		return false;
+	}
+
+	// Sizes are ordered slowest varying first, the first dimension of the data varies fastest.
+	auto dimensions = data->GetDimensions();
+	auto dimension_count = dimensions->GetDimensionCount();
+	vector<int> sizes(dimension_count);
+	vector<bool> axes(dimension_count);
+	bool any_axis = false;
+	for (unsigned int i = 0; i < dimension_count; ++i)
+	{
+		DimensionType type;
+		unsigned int start, length;
+		dimensions->GetDimensionInfo(i, type, start, length);
+		if (length == 0)
+			return Feed(_output_port, data);
+
+		auto axis = dimension_count - 1 - i;
+		sizes[axis] = int(length);
+		axes[axis] = find(types.begin(), types.end(), type) != types.end();
+		any_axis = any_axis || axes[axis];
+	}
+
+	if (!any_axis)
+		return Feed(_output_port, data);
+
+	return (input_data.GetDataType() == DataTypeComplexDouble) ?
+		DoFft<double>(data, sizes, axes) :
+		DoFft<float>(data, sizes, axes);
+}
+
+template <typename T>
+bool FftND::DoFft(IData * data, const vector<int>& sizes, const vector<bool>& axes)
+{
+	auto data_array = GetDataArray<complex<T>>(data);
+	auto inverse = GetProperty<bool>(_inverse);
+	auto threads = unsigned(max(GetProperty<int>(_threads), 0));
+	auto& plans = FftPlanCache::GetInstance();
+
+	// Data shared with other consumers is transformed into new data instead.
+	if (GetProperty<bool>(_in_place) && IsWritable(data))
+	{
+		if (!plans.ExecuteCentered(data_array, data_array, sizes, axes, inverse, threads))
+		{
+			LOG_ERROR(L"<FftND> Failed to create FFT plan!", L"BasicRecon");
+			return false;
+		}
+
+		return Feed(_output_port, data);
+	}
+	else
+	{
+		auto output = CreateOutputData<complex<T>>(_output_port, data);
+		if (!plans.ExecuteCentered(data_array, GetDataArray<complex<T>>(output.get()), sizes, axes, inverse, threads))
+		{
+			LOG_ERROR(L"<FftND> Failed to create FFT plan!", L"BasicRecon");
+			return false;
+		}
+
+		return Feed(_output_port, output.get());
+	}
+}
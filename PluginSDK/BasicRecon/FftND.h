@@ -0,0 +1,50 @@
+#pragma once
+
+#ifndef FFTND_H_20171029
+#define FFTND_H_20171029
+
+#include "Implement/ProcessorImpl.h"
+#include <complex>
+#include <vector>
+
+namespace Yap
+{
+	/**
+	@brief Centered FFT along the dimensions named by the property Dimensions.
+
+	Dimensions is a list of DimensionType names separated by commas, e.g. "Readout" or
+	"Slice, Phase". The named dimensions are transformed with one FFTW guru plan that loops over
+	all other dimensions, so hybrid-space transforms need no transposed copy of the data.
+	Names of dimensions that the data doesn't have are ignored.
+	*/
+	class FftND :
+		public ProcessorImpl
+	{
+		IMPLEMENT_SHARED(FftND)
+	public:
+		FftND();
+		FftND(const FftND& rhs);
+
+		/// Parse a list of dimension names, return false if a name is unknown.
+		static bool ParseDimensions(const std::wstring& text, std::vector<DimensionType>& types);
+
+	protected:
+		~FftND();
+
+		virtual bool Input(const wchar_t * port, IData * data) override;
+		virtual bool InputByHandle(PortHandle port, IData * data) override;
+
+		PortHandle _input_port;
+		PortHandle _output_port;
+
+		PropertyHandle _dimensions;
+		PropertyHandle _inverse;
+		PropertyHandle _in_place;
+		PropertyHandle _threads;
+
+		template <typename T>
+		bool DoFft(IData * data, const std::vector<int>& sizes, const std::vector<bool>& axes);
+	};
+}
+
+#endif // FFTND_H_
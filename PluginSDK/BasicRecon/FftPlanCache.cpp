@@ -0,0 +1,596 @@
+#include "stdafx.h"
+#include "FftPlanCache.h"
+
+#include "Implement/ExecutionEngine.h"
+#include "Implement/LogUserImpl.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <tuple>
+
+using namespace std;
+using namespace Yap;
+
+namespace
+{
+	unsigned int GetDefaultRigor()
+	{
+		auto setting = getenv("YAP_FFTW_PLANNER");
+		if (setting == nullptr)
+			return FFTW_MEASURE;
+
+		if (_stricmp(setting, "estimate") == 0)
+			return FFTW_ESTIMATE;
+		else if (_stricmp(setting, "patient") == 0)
+			return FFTW_PATIENT;
+		else
+			return FFTW_MEASURE;
+	}
+
+	string GetDoubleWisdomFile(const string& path)
+	{
+		return path + ".double";
+	}
+
+	/// Transforms smaller than this many elements per thread are not worth splitting.
+	const size_t MinElementsPerThread = 32 * 1024;
+
+	unsigned int GetDefaultThreadCount()
+	{
+		auto setting = getenv("YAP_FFTW_THREADS");
+		return (setting != nullptr) ? static_cast<unsigned int>(atoi(setting)) : 0;
+	}
+
+	/// Split the axes of a contiguous array into transformed dims and loop dims of a guru plan.
+	template <typename IoDim>
+	void GetIoDims(const vector<int>& sizes, const vector<bool>& axes, vector<IoDim>& dims, vector<IoDim>& loop_dims)
+	{
+		int stride = 1;
+		for (int axis = int(sizes.size()) - 1; axis >= 0; --axis)
+		{
+			IoDim dim;
+			dim.n = sizes[axis];
+			dim.is = stride;
+			dim.os = stride;
+			stride *= sizes[axis];
+
+			if (axes[axis])
+			{
+				dims.insert(dims.begin(), dim);
+			}
+			else if (sizes[axis] > 1)
+			{
+				loop_dims.insert(loop_dims.begin(), dim);
+			}
+		}
+	}
+
+#ifdef YAP_FFTW_THREADS_CALLBACK
+	/// Run the parallel loops of FFTW as tasks of the execution engine.
+	void RunFftwJobs(void *(*work)(char *), char * job_data, size_t job_size, int job_count, void *)
+	{
+		TaskGroup tasks;
+		for (int i = 0; i < job_count; ++i)
+		{
+			auto job = job_data + job_size * i;
+			tasks.Run([work, job]() {
+				work(job);
+				return true;
+			});
+		}
+		tasks.Wait();
+	}
+#endif
+}
+
+shared_ptr<FftPlanCache> FftPlanCache::s_instance;
+once_flag FftPlanCache::s_instance_flag;
+
+FftPlanCache& FftPlanCache::GetInstance()
+{
+	call_once(s_instance_flag, []() {
+		s_instance = shared_ptr<FftPlanCache>(new FftPlanCache);
+	});
+
+	return *s_instance;
+}
+
+bool FftPlanCache::PlanKey::operator < (const PlanKey& rhs) const
+{
+	return tie(type, sizes, axes, inverse, in_place, aligned, threads) <
+		tie(rhs.type, rhs.sizes, rhs.axes, rhs.inverse, rhs.in_place, rhs.aligned, rhs.threads);
+}
+
+FftPlanCache::FftPlanCache() :
+	_rigor{ GetDefaultRigor() },
+	_thread_count{ GetDefaultThreadCount() },
+	_threads_initialized{ false },
+	_new_plans{ false }
+{
+	auto wisdom_file = getenv("YAP_FFTW_WISDOM");
+	if (wisdom_file != nullptr && wisdom_file[0] != 0)
+	{
+		_wisdom_file = wisdom_file;
+		ImportWisdom(_wisdom_file);
+	}
+}
+
+FftPlanCache::~FftPlanCache()
+{
+}
+
+void FftPlanCache::Release()
+{
+	if (!s_instance)
+		return;
+
+	if (s_instance->_new_plans && !s_instance->_wisdom_file.empty())
+	{
+		s_instance->ExportWisdom(s_instance->_wisdom_file);
+	}
+	s_instance->_new_plans = false;
+
+	s_instance->Clear();
+}
+
+fftwf_plan FftPlanCache::GetFloatPlan(const vector<int>& sizes, bool inverse, bool in_place, bool aligned,
+	int howmany, unsigned int threads)
+{
+	vector<int> batch_sizes;
+	vector<bool> axes;
+	GetBatchAxes(sizes, howmany, batch_sizes, axes);
+
+	return GetFloatPlan(batch_sizes, axes, inverse, in_place, aligned, threads);
+}
+
+fftw_plan FftPlanCache::GetDoublePlan(const vector<int>& sizes, bool inverse, bool in_place, bool aligned,
+	int howmany, unsigned int threads)
+{
+	vector<int> batch_sizes;
+	vector<bool> axes;
+	GetBatchAxes(sizes, howmany, batch_sizes, axes);
+
+	return GetDoublePlan(batch_sizes, axes, inverse, in_place, aligned, threads);
+}
+
+fftwf_plan FftPlanCache::GetFloatPlan(const vector<int>& sizes, const vector<bool>& axes,
+	bool inverse, bool in_place, bool aligned, unsigned int threads)
+{
+	assert(!sizes.empty() && sizes.size() == axes.size() && threads > 0);
+
+	PlanKey key{ PlanComplex, sizes, axes, inverse, in_place, aligned, threads };
+
+	lock_guard<mutex> lock(_mutex);
+	auto iter = _float_plans.find(key);
+	if (iter != _float_plans.end())
+		return iter->second;
+
+	// Plan on scratch buffers, since FFTW_MEASURE overwrites the arrays while planning.
+	auto count = GetElementCount(sizes);
+	auto data = reinterpret_cast<fftwf_complex*>(fftwf_malloc(sizeof(fftwf_complex) * count));
+	auto result = in_place ? data : reinterpret_cast<fftwf_complex*>(fftwf_malloc(sizeof(fftwf_complex) * count));
+	if (data == nullptr || result == nullptr)
+	{
+		fftwf_free(data);
+		return nullptr;
+	}
+
+	if (threads > 1 || _threads_initialized)
+	{
+		InitializeThreads();
+		fftwf_plan_with_nthreads(int(threads));
+	}
+	vector<fftwf_iodim> dims, loop_dims;
+	GetIoDims(sizes, axes, dims, loop_dims);
+	auto plan = fftwf_plan_guru_dft(int(dims.size()), dims.data(), int(loop_dims.size()), loop_dims.data(),
+		data, result, inverse ? FFTW_BACKWARD : FFTW_FORWARD, GetFlags(aligned));
+
+	if (!in_place)
+	{
+		fftwf_free(result);
+	}
+	fftwf_free(data);
+
+	if (plan == nullptr)
+	{
+		LOG_ERROR(L"<FftPlanCache> Failed to create FFT plan.", L"BasicRecon");
+		return nullptr;
+	}
+
+	_float_plans.insert(make_pair(key, plan));
+	_new_plans = true;
+
+	return plan;
+}
+
+fftw_plan FftPlanCache::GetDoublePlan(const vector<int>& sizes, const vector<bool>& axes,
+	bool inverse, bool in_place, bool aligned, unsigned int threads)
+{
+	assert(!sizes.empty() && sizes.size() == axes.size() && threads > 0);
+
+	PlanKey key{ PlanComplex, sizes, axes, inverse, in_place, aligned, threads };
+
+	lock_guard<mutex> lock(_mutex);
+	auto iter = _double_plans.find(key);
+	if (iter != _double_plans.end())
+		return iter->second;
+
+	auto count = GetElementCount(sizes);
+	auto data = reinterpret_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * count));
+	auto result = in_place ? data : reinterpret_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * count));
+	if (data == nullptr || result == nullptr)
+	{
+		fftw_free(data);
+		return nullptr;
+	}
+
+	if (threads > 1 || _threads_initialized)
+	{
+		InitializeThreads();
+		fftw_plan_with_nthreads(int(threads));
+	}
+	vector<fftw_iodim> dims, loop_dims;
+	GetIoDims(sizes, axes, dims, loop_dims);
+	auto plan = fftw_plan_guru_dft(int(dims.size()), dims.data(), int(loop_dims.size()), loop_dims.data(),
+		data, result, inverse ? FFTW_BACKWARD : FFTW_FORWARD, GetFlags(aligned));
+
+	if (!in_place)
+	{
+		fftw_free(result);
+	}
+	fftw_free(data);
+
+	if (plan == nullptr)
+	{
+		LOG_ERROR(L"<FftPlanCache> Failed to create FFT plan.", L"BasicRecon");
+		return nullptr;
+	}
+
+	_double_plans.insert(make_pair(key, plan));
+	_new_plans = true;
+
+	return plan;
+}
+
+fftwf_plan FftPlanCache::GetFloatRealPlan(const vector<int>& sizes, bool to_real, bool aligned,
+	int howmany, unsigned int threads)
+{
+	assert(!sizes.empty() && howmany > 0 && threads > 0);
+
+	PlanKey key{ to_real ? PlanComplexToReal : PlanRealToComplex, {}, {}, to_real, false, aligned, threads };
+	GetBatchAxes(sizes, howmany, key.sizes, key.axes);
+
+	lock_guard<mutex> lock(_mutex);
+	auto iter = _float_plans.find(key);
+	if (iter != _float_plans.end())
+		return iter->second;
+
+	auto real_distance = int(GetElementCount(sizes));
+	auto complex_distance = real_distance / sizes.back() * (sizes.back() / 2 + 1);
+	auto real_array = reinterpret_cast<float*>(fftwf_malloc(sizeof(float) * real_distance * howmany));
+	auto complex_array = reinterpret_cast<fftwf_complex*>(fftwf_malloc(sizeof(fftwf_complex) * complex_distance * howmany));
+	if (real_array == nullptr || complex_array == nullptr)
+	{
+		fftwf_free(real_array);
+		fftwf_free(complex_array);
+		return nullptr;
+	}
+
+	if (threads > 1 || _threads_initialized)
+	{
+		InitializeThreads();
+		fftwf_plan_with_nthreads(int(threads));
+	}
+	auto plan = to_real ?
+		fftwf_plan_many_dft_c2r(int(sizes.size()), sizes.data(), howmany, complex_array, nullptr, 1, complex_distance,
+			real_array, nullptr, 1, real_distance, GetFlags(aligned)) :
+		fftwf_plan_many_dft_r2c(int(sizes.size()), sizes.data(), howmany, real_array, nullptr, 1, real_distance,
+			complex_array, nullptr, 1, complex_distance, GetFlags(aligned));
+
+	fftwf_free(real_array);
+	fftwf_free(complex_array);
+
+	if (plan == nullptr)
+	{
+		LOG_ERROR(L"<FftPlanCache> Failed to create FFT plan.", L"BasicRecon");
+		return nullptr;
+	}
+
+	_float_plans.insert(make_pair(key, plan));
+	_new_plans = true;
+
+	return plan;
+}
+
+fftw_plan FftPlanCache::GetDoubleRealPlan(const vector<int>& sizes, bool to_real, bool aligned,
+	int howmany, unsigned int threads)
+{
+	assert(!sizes.empty() && howmany > 0 && threads > 0);
+
+	PlanKey key{ to_real ? PlanComplexToReal : PlanRealToComplex, {}, {}, to_real, false, aligned, threads };
+	GetBatchAxes(sizes, howmany, key.sizes, key.axes);
+
+	lock_guard<mutex> lock(_mutex);
+	auto iter = _double_plans.find(key);
+	if (iter != _double_plans.end())
+		return iter->second;
+
+	auto real_distance = int(GetElementCount(sizes));
+	auto complex_distance = real_distance / sizes.back() * (sizes.back() / 2 + 1);
+	auto real_array = reinterpret_cast<double*>(fftw_malloc(sizeof(double) * real_distance * howmany));
+	auto complex_array = reinterpret_cast<fftw_complex*>(fftw_malloc(sizeof(fftw_complex) * complex_distance * howmany));
+	if (real_array == nullptr || complex_array == nullptr)
+	{
+		fftw_free(real_array);
+		fftw_free(complex_array);
+		return nullptr;
+	}
+
+	if (threads > 1 || _threads_initialized)
+	{
+		InitializeThreads();
+		fftw_plan_with_nthreads(int(threads));
+	}
+	auto plan = to_real ?
+		fftw_plan_many_dft_c2r(int(sizes.size()), sizes.data(), howmany, complex_array, nullptr, 1, complex_distance,
+			real_array, nullptr, 1, real_distance, GetFlags(aligned)) :
+		fftw_plan_many_dft_r2c(int(sizes.size()), sizes.data(), howmany, real_array, nullptr, 1, real_distance,
+			complex_array, nullptr, 1, complex_distance, GetFlags(aligned));
+
+	fftw_free(real_array);
+	fftw_free(complex_array);
+
+	if (plan == nullptr)
+	{
+		LOG_ERROR(L"<FftPlanCache> Failed to create FFT plan.", L"BasicRecon");
+		return nullptr;
+	}
+
+	_double_plans.insert(make_pair(key, plan));
+	_new_plans = true;
+
+	return plan;
+}
+
+bool FftPlanCache::Execute(complex<float> * data, complex<float> * result,
+	const vector<int>& sizes, bool inverse, int howmany, unsigned int threads)
+{
+	vector<int> batch_sizes;
+	vector<bool> axes;
+	GetBatchAxes(sizes, howmany, batch_sizes, axes);
+
+	return Execute(data, result, batch_sizes, axes, inverse, threads);
+}
+
+bool FftPlanCache::Execute(complex<double> * data, complex<double> * result,
+	const vector<int>& sizes, bool inverse, int howmany, unsigned int threads)
+{
+	vector<int> batch_sizes;
+	vector<bool> axes;
+	GetBatchAxes(sizes, howmany, batch_sizes, axes);
+
+	return Execute(data, result, batch_sizes, axes, inverse, threads);
+}
+
+bool FftPlanCache::Execute(complex<float> * data, complex<float> * result,
+	const vector<int>& sizes, const vector<bool>& axes, bool inverse, unsigned int threads)
+{
+	threads = GetThreadCount(threads, GetElementCount(sizes));
+	auto plan = GetFloatPlan(sizes, axes, inverse, data == result, IsAligned(data, result), threads);
+	if (plan == nullptr)
+		return false;
+
+	fftwf_execute_dft(plan, reinterpret_cast<fftwf_complex*>(data), reinterpret_cast<fftwf_complex*>(result));
+	return true;
+}
+
+bool FftPlanCache::Execute(complex<double> * data, complex<double> * result,
+	const vector<int>& sizes, const vector<bool>& axes, bool inverse, unsigned int threads)
+{
+	threads = GetThreadCount(threads, GetElementCount(sizes));
+	auto plan = GetDoublePlan(sizes, axes, inverse, data == result, IsAligned(data, result), threads);
+	if (plan == nullptr)
+		return false;
+
+	fftw_execute_dft(plan, reinterpret_cast<fftw_complex*>(data), reinterpret_cast<fftw_complex*>(result));
+	return true;
+}
+
+bool FftPlanCache::ExecuteR2C(float * data, complex<float> * result,
+	const vector<int>& sizes, int howmany, unsigned int threads)
+{
+	threads = GetThreadCount(threads, GetElementCount(sizes) * howmany);
+	auto plan = GetFloatRealPlan(sizes, false, IsAligned(data, result), howmany, threads);
+	if (plan == nullptr)
+		return false;
+
+	fftwf_execute_dft_r2c(plan, data, reinterpret_cast<fftwf_complex*>(result));
+	return true;
+}
+
+bool FftPlanCache::ExecuteR2C(double * data, complex<double> * result,
+	const vector<int>& sizes, int howmany, unsigned int threads)
+{
+	threads = GetThreadCount(threads, GetElementCount(sizes) * howmany);
+	auto plan = GetDoubleRealPlan(sizes, false, IsAligned(data, result), howmany, threads);
+	if (plan == nullptr)
+		return false;
+
+	fftw_execute_dft_r2c(plan, data, reinterpret_cast<fftw_complex*>(result));
+	return true;
+}
+
+bool FftPlanCache::ExecuteC2R(complex<float> * data, float * result,
+	const vector<int>& sizes, int howmany, unsigned int threads)
+{
+	threads = GetThreadCount(threads, GetElementCount(sizes) * howmany);
+	auto plan = GetFloatRealPlan(sizes, true, IsAligned(data, result), howmany, threads);
+	if (plan == nullptr)
+		return false;
+
+	fftwf_execute_dft_c2r(plan, reinterpret_cast<fftwf_complex*>(data), result);
+	return true;
+}
+
+bool FftPlanCache::ExecuteC2R(complex<double> * data, double * result,
+	const vector<int>& sizes, int howmany, unsigned int threads)
+{
+	threads = GetThreadCount(threads, GetElementCount(sizes) * howmany);
+	auto plan = GetDoubleRealPlan(sizes, true, IsAligned(data, result), howmany, threads);
+	if (plan == nullptr)
+		return false;
+
+	fftw_execute_dft_c2r(plan, reinterpret_cast<fftw_complex*>(data), result);
+	return true;
+}
+
+bool FftPlanCache::IsAligned(const void * data, const void * result)
+{
+	// Buffers from BufferPool are aligned, slices of them normally are too. Both precisions
+	// are checked, so the result holds for float and double plans.
+	auto is_aligned = [](const void * array) {
+		return fftwf_alignment_of(reinterpret_cast<float*>(const_cast<void*>(array))) == 0 &&
+			fftw_alignment_of(reinterpret_cast<double*>(const_cast<void*>(array))) == 0;
+	};
+
+	return is_aligned(data) && is_aligned(result);
+}
+
+void FftPlanCache::SetPlanningRigor(unsigned int rigor)
+{
+	assert(rigor == FFTW_ESTIMATE || rigor == FFTW_MEASURE || rigor == FFTW_PATIENT);
+
+	lock_guard<mutex> lock(_mutex);
+	_rigor = rigor;
+}
+
+unsigned int FftPlanCache::GetPlanningRigor() const
+{
+	lock_guard<mutex> lock(_mutex);
+	return _rigor;
+}
+
+bool FftPlanCache::ImportWisdom(const string& path)
+{
+	lock_guard<mutex> lock(_mutex);
+
+	// A missing file is not an error, it is created when wisdom is exported.
+	bool float_imported = fftwf_import_wisdom_from_filename(path.c_str()) != 0;
+	bool double_imported = fftw_import_wisdom_from_filename(GetDoubleWisdomFile(path).c_str()) != 0;
+
+	return float_imported || double_imported;
+}
+
+bool FftPlanCache::ExportWisdom(const string& path)
+{
+	lock_guard<mutex> lock(_mutex);
+
+	bool succeeded = fftwf_export_wisdom_to_filename(path.c_str()) != 0;
+	if (!_double_plans.empty())
+	{
+		succeeded = (fftw_export_wisdom_to_filename(GetDoubleWisdomFile(path).c_str()) != 0) && succeeded;
+	}
+
+	return succeeded;
+}
+
+void FftPlanCache::SetThreadCount(unsigned int threads)
+{
+	lock_guard<mutex> lock(_mutex);
+	_thread_count = threads;
+}
+
+unsigned int FftPlanCache::GetThreadCount(unsigned int requested, size_t element_count) const
+{
+	auto& engine = ExecutionEngine::GetInstance();
+
+	// Workers of the engine already run other parts of the pipeline on the other cores.
+	if (engine.IsWorkerThread())
+		return 1;
+
+	unsigned int threads = requested;
+	if (threads == 0)
+	{
+		lock_guard<mutex> lock(_mutex);
+		threads = _thread_count;
+	}
+	if (threads == 0)
+	{
+		threads = engine.IsEnabled() ? engine.GetThreadCount() : 1;
+	}
+
+	auto hardware_threads = max(thread::hardware_concurrency(), 1u);
+	auto useful_threads = max(element_count / MinElementsPerThread, size_t(1));
+
+	return static_cast<unsigned int>(min(min(size_t(threads), size_t(hardware_threads)), useful_threads));
+}
+
+void FftPlanCache::InitializeThreads()
+{
+	if (_threads_initialized)
+		return;
+
+	fftwf_init_threads();
+	fftw_init_threads();
+#ifdef YAP_FFTW_THREADS_CALLBACK
+	fftwf_threads_set_callback(RunFftwJobs, nullptr);
+	fftw_threads_set_callback(RunFftwJobs, nullptr);
+#endif
+	_threads_initialized = true;
+}
+
+void FftPlanCache::SetWisdomFile(const string& path)
+{
+	lock_guard<mutex> lock(_mutex);
+	_wisdom_file = path;
+}
+
+void FftPlanCache::Clear()
+{
+	lock_guard<mutex> lock(_mutex);
+
+	for (auto& item : _float_plans)
+	{
+		fftwf_destroy_plan(item.second);
+	}
+	_float_plans.clear();
+
+	for (auto& item : _double_plans)
+	{
+		fftw_destroy_plan(item.second);
+	}
+	_double_plans.clear();
+}
+
+unsigned int FftPlanCache::GetFlags(bool aligned) const
+{
+	return _rigor | (aligned ? 0 : FFTW_UNALIGNED);
+}
+
+void FftPlanCache::GetBatchAxes(const vector<int>& sizes, int howmany,
+	vector<int>& batch_sizes, vector<bool>& axes)
+{
+	assert(howmany > 0);
+
+	batch_sizes = sizes;
+	axes.assign(sizes.size(), true);
+	if (howmany > 1)
+	{
+		batch_sizes.insert(batch_sizes.begin(), howmany);
+		axes.insert(axes.begin(), false);
+	}
+}
+
+size_t FftPlanCache::GetElementCount(const vector<int>& sizes)
+{
+	size_t count = 1;
+	for (auto size : sizes)
+	{
+		count *= size_t(size);
+	}
+
+	return count;
+}
@@ -0,0 +1,344 @@
+#pragma once
+
+#ifndef FftPlanCache_h__20171027
+#define FftPlanCache_h__20171027
+
+#include "FftShift.h"
+
+#include <fftw3.h>
+#include <cassert>
+#include <cmath>
+#include <complex>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace Yap
+{
+	/**
+	@brief Process-wide cache of FFTW plans shared by all FFT processors of the module.
+
+	Plans are created once per (sizes, transformed axes, direction, in-place, alignment, threads,
+	precision) and executed with the new-array execute functions, so one plan serves all processor instances, clones
+	and threads. Planning is serialized with an internal mutex since the FFTW planner is not
+	thread-safe, while executing plans is.
+
+	Planning rigor defaults to FFTW_MEASURE and can be set with the environment variable
+	YAP_FFTW_PLANNER (estimate, measure or patient). If YAP_FFTW_WISDOM names a file, wisdom is
+	imported from it when the cache is created and exported to it by Release(), which the module
+	calls from ReleaseProcessorManager(), so production runs don't pay for planning on the first
+	frame. Nothing is exported or destroyed by the destructor, since it runs under the loader lock. Single precision wisdom is
+	kept in the file itself, double precision wisdom in the file with ".double" appended.
+
+	Large transforms can be planned for several threads, see SetThreadCount(). By default the
+	thread count follows ExecutionEngine, so FFTs only go multi-threaded when the pipeline does,
+	and transforms called from an engine worker (e.g. per slice after SliceIterator) always run
+	single-threaded, since the other workers are already busy with the other slices. If the
+	module is built against FFTW 3.3.9 or later with YAP_FFTW_THREADS_CALLBACK defined, FFTW
+	runs its parallel loops as tasks of ExecutionEngine instead of starting its own threads.
+	*/
+	class FftPlanCache
+	{
+	public:
+		static FftPlanCache& GetInstance();
+		~FftPlanCache();
+
+		/// Export the wisdom of new plans and destroy all plans, if the instance has been created.
+		/**
+			\remarks Called when the module is released, after the execution engine has stopped.
+		*/
+		static void Release();
+
+		/// Return a plan of a complex transform, sizes are given slowest varying first.
+		/**
+			\remarks The plan can be executed on any arrays with the same alignment as given.
+			If howmany is larger than 1, the plan transforms howmany contiguous arrays at once.
+		*/
+		fftwf_plan GetFloatPlan(const std::vector<int>& sizes, bool inverse, bool in_place, bool aligned,
+			int howmany = 1, unsigned int threads = 1);
+		fftw_plan GetDoublePlan(const std::vector<int>& sizes, bool inverse, bool in_place, bool aligned,
+			int howmany = 1, unsigned int threads = 1);
+
+		/// Return a plan transforming only the axes flagged in axes of a contiguous array.
+		/**
+			\remarks The plan uses FFTW guru strides and loops over all other axes, so hybrid-space
+			transforms, e.g. along the slice direction only, don't need a transposed copy.
+		*/
+		fftwf_plan GetFloatPlan(const std::vector<int>& sizes, const std::vector<bool>& axes,
+			bool inverse, bool in_place, bool aligned, unsigned int threads = 1);
+		fftw_plan GetDoublePlan(const std::vector<int>& sizes, const std::vector<bool>& axes,
+			bool inverse, bool in_place, bool aligned, unsigned int threads = 1);
+
+		/// Return an out-of-place plan of a real-to-complex transform, or complex-to-real if to_real is true.
+		fftwf_plan GetFloatRealPlan(const std::vector<int>& sizes, bool to_real, bool aligned,
+			int howmany = 1, unsigned int threads = 1);
+		fftw_plan GetDoubleRealPlan(const std::vector<int>& sizes, bool to_real, bool aligned,
+			int howmany = 1, unsigned int threads = 1);
+
+		/// Transform howmany contiguous arrays, return false if no plan could be created.
+		/**
+			\remarks threads is the requested thread count, 0 for the default. See GetThreadCount().
+		*/
+		bool Execute(std::complex<float> * data, std::complex<float> * result,
+			const std::vector<int>& sizes, bool inverse, int howmany = 1, unsigned int threads = 0);
+		bool Execute(std::complex<double> * data, std::complex<double> * result,
+			const std::vector<int>& sizes, bool inverse, int howmany = 1, unsigned int threads = 0);
+
+		/// Transform the axes flagged in axes, return false if no plan could be created.
+		bool Execute(std::complex<float> * data, std::complex<float> * result,
+			const std::vector<int>& sizes, const std::vector<bool>& axes, bool inverse, unsigned int threads = 0);
+		bool Execute(std::complex<double> * data, std::complex<double> * result,
+			const std::vector<int>& sizes, const std::vector<bool>& axes, bool inverse, unsigned int threads = 0);
+
+		/// Forward transform of howmany real arrays.
+		/**
+			\remarks Each result array holds sizes.back() / 2 + 1 elements along the last axis, the
+			non-negative frequencies. The result arrays are packed one after another.
+		*/
+		bool ExecuteR2C(float * data, std::complex<float> * result,
+			const std::vector<int>& sizes, int howmany = 1, unsigned int threads = 0);
+		bool ExecuteR2C(double * data, std::complex<double> * result,
+			const std::vector<int>& sizes, int howmany = 1, unsigned int threads = 0);
+
+		/// Backward transform of half spectra as returned by ExecuteR2C() into real arrays.
+		/**
+			\remarks sizes are the sizes of the real arrays. FFTW overwrites data.
+		*/
+		bool ExecuteC2R(std::complex<float> * data, float * result,
+			const std::vector<int>& sizes, int howmany = 1, unsigned int threads = 0);
+		bool ExecuteC2R(std::complex<double> * data, double * result,
+			const std::vector<int>& sizes, int howmany = 1, unsigned int threads = 0);
+
+		/// Unitary transform followed by fftshift, i.e. result = fftshift(fft(data)) / sqrt(N).
+		/**
+			\remarks Shift and normalization take a single pass, done before the transform if
+			all sizes are even (see FftShift) and after it otherwise, so odd sizes are supported.
+			If data and result differ, data is left unchanged.
+		*/
+		template <typename T>
+		bool ExecuteCentered(std::complex<T> * data, std::complex<T> * result,
+			const std::vector<int>& sizes, bool inverse, int howmany = 1, unsigned int threads = 0)
+		{
+			std::vector<int> batch_sizes;
+			std::vector<bool> axes;
+			GetBatchAxes(sizes, howmany, batch_sizes, axes);
+
+			return ExecuteCentered(data, result, batch_sizes, axes, inverse, threads);
+		}
+
+		/// Centered unitary transform of the axes flagged in axes, the others are left in place.
+		template <typename T>
+		bool ExecuteCentered(std::complex<T> * data, std::complex<T> * result,
+			const std::vector<int>& sizes, const std::vector<bool>& axes, bool inverse, unsigned int threads = 0)
+		{
+			assert(sizes.size() == axes.size());
+
+			size_t count = 1;
+			for (size_t i = 0; i < sizes.size(); ++i)
+			{
+				count *= axes[i] ? size_t(sizes[i]) : 1;
+			}
+			auto scale = T(1.0 / std::sqrt(double(count)));
+
+			if (FftShift::IsModulatable(sizes, axes))
+			{
+				FftShift::Modulate(data, result, sizes, scale, axes);
+				return Execute(result, result, sizes, axes, inverse, threads);
+			}
+
+			if (!Execute(data, result, sizes, axes, inverse, threads))
+				return false;
+
+			FftShift::Shift(result, sizes, scale, axes);
+			return true;
+		}
+
+		/// Same as ExecuteCentered() on real data converted to complex, with half the transform work.
+		/**
+			\remarks result must hold howmany full complex arrays. The missing half of each spectrum
+			is filled in from Hermitian symmetry.
+		*/
+		template <typename T>
+		bool ExecuteCenteredR2C(T * data, std::complex<T> * result,
+			const std::vector<int>& sizes, bool inverse, int howmany = 1, unsigned int threads = 0)
+		{
+			if (!ExecuteR2C(data, result, sizes, howmany, threads))
+				return false;
+
+			ExpandHermitian(result, sizes, howmany);
+
+			auto count = FftShift::GetElementCount(sizes);
+			auto scale = T(1.0 / std::sqrt(double(count)));
+			for (int i = 0; i < howmany; ++i)
+			{
+				FftShift::Shift(result + i * count, sizes, scale);
+			}
+
+			// The inverse transform of real data is the conjugate of the forward transform.
+			if (inverse)
+			{
+				for (size_t i = 0; i < count * howmany; ++i)
+				{
+					result[i] = std::conj(result[i]);
+				}
+			}
+			return true;
+		}
+
+		/// Unitary transform of real data without fftshift, keeping only the non-negative
+		/// frequencies along the last axis, see ExecuteR2C().
+		template <typename T>
+		bool ExecuteHalfSpectrum(T * data, std::complex<T> * result,
+			const std::vector<int>& sizes, bool inverse, int howmany = 1, unsigned int threads = 0)
+		{
+			if (!ExecuteR2C(data, result, sizes, howmany, threads))
+				return false;
+
+			auto half_count = FftShift::GetElementCount(sizes) / sizes.back() * (sizes.back() / 2 + 1);
+			auto scale = T(1.0 / std::sqrt(double(FftShift::GetElementCount(sizes))));
+			for (size_t i = 0; i < half_count * howmany; ++i)
+			{
+				result[i] = (inverse ? std::conj(result[i]) : result[i]) * scale;
+			}
+			return true;
+		}
+
+		/// Unitary transform of half spectra of Hermitian arrays into real arrays of the given sizes.
+		/**
+			\remarks Undoes ExecuteHalfSpectrum() when inverse is the opposite direction. data is
+			left unchanged.
+		*/
+		template <typename T>
+		bool ExecuteRealFromHalfSpectrum(const std::complex<T> * data, T * result,
+			const std::vector<int>& sizes, bool inverse, int howmany = 1, unsigned int threads = 0)
+		{
+			// Conjugation turns the backward transform of FFTW into a forward one, since the
+			// result is real. Both are combined with the scaling into the copy FFTW may overwrite.
+			auto half_count = FftShift::GetElementCount(sizes) / sizes.back() * (sizes.back() / 2 + 1);
+			auto scale = T(1.0 / std::sqrt(double(FftShift::GetElementCount(sizes))));
+			std::vector<std::complex<T>> spectrum(half_count * howmany);
+			for (size_t i = 0; i < spectrum.size(); ++i)
+			{
+				spectrum[i] = (inverse ? data[i] : std::conj(data[i])) * scale;
+			}
+
+			return ExecuteC2R(spectrum.data(), result, sizes, howmany, threads);
+		}
+
+		/// Fill in the negative frequencies of howmany half spectra packed at the start of data.
+		/**
+			\remarks data must hold howmany full arrays of the given sizes, X[-k] = conj(X[k]).
+		*/
+		template <typename T>
+		static void ExpandHermitian(std::complex<T> * data, const std::vector<int>& sizes, int howmany = 1)
+		{
+			auto width = size_t(sizes.back());
+			auto half_width = width / 2 + 1;
+			auto array_rows = FftShift::GetElementCount(sizes) / width;
+			auto rows = array_rows * howmany;
+
+			// Rows only move towards the end, so the last row is moved first.
+			for (size_t row = rows; row-- > 0;)
+			{
+				memmove(data + row * width, data + row * half_width, half_width * sizeof(std::complex<T>));
+			}
+
+			for (size_t row = 0; row < rows; ++row)
+			{
+				auto array_row = row % array_rows;
+				size_t mirror_row = 0, rest = array_row, stride = 1;
+				for (int axis = int(sizes.size()) - 2; axis >= 0; --axis)
+				{
+					auto size = size_t(sizes[axis]);
+					mirror_row += ((size - rest % size) % size) * stride;
+					rest /= size;
+					stride *= size;
+				}
+
+				auto target = data + row * width;
+				auto source = data + (row - array_row + mirror_row) * width;
+				for (size_t x = half_width; x < width; ++x)
+				{
+					target[x] = std::conj(source[width - x]);
+				}
+			}
+		}
+
+		/// Default thread count of transforms, 0 to follow ExecutionEngine. Initial value is taken
+		/// from YAP_FFTW_THREADS.
+		void SetThreadCount(unsigned int threads);
+
+		/// Return the number of threads used for a transform of the given number of elements.
+		/**
+			\remarks requested is the thread count asked for by the processor, 0 for the default.
+			Small transforms and transforms called from ExecutionEngine workers use one thread.
+		*/
+		unsigned int GetThreadCount(unsigned int requested, size_t element_count) const;
+
+		/// Return true if the arrays can be used with aligned plans.
+		static bool IsAligned(const void * data, const void * result);
+
+		/// FFTW_ESTIMATE, FFTW_MEASURE or FFTW_PATIENT, only affects plans created afterwards.
+		void SetPlanningRigor(unsigned int rigor);
+		unsigned int GetPlanningRigor() const;
+
+		bool ImportWisdom(const std::string& path);
+		bool ExportWisdom(const std::string& path);
+
+		/// File the wisdom is written to by Release(), empty to disable.
+		void SetWisdomFile(const std::string& path);
+
+		/// Destroy all cached plans, the plans returned before must no longer be used.
+		void Clear();
+
+	protected:
+		FftPlanCache();
+
+		enum PlanType
+		{
+			PlanComplex,
+			PlanRealToComplex,
+			PlanComplexToReal,
+		};
+
+		struct PlanKey
+		{
+			PlanType type;
+			std::vector<int> sizes;
+			std::vector<bool> axes;
+			bool inverse;
+			bool in_place;
+			bool aligned;
+			unsigned int threads;
+
+			bool operator < (const PlanKey& rhs) const;
+		};
+
+		/// Called with the mutex locked before the first multi-threaded plan is created.
+		void InitializeThreads();
+
+		unsigned int GetFlags(bool aligned) const;
+
+		/// Describe howmany contiguous arrays as one array with an extra, untransformed axis.
+		static void GetBatchAxes(const std::vector<int>& sizes, int howmany,
+			std::vector<int>& batch_sizes, std::vector<bool>& axes);
+		static size_t GetElementCount(const std::vector<int>& sizes);
+
+		std::map<PlanKey, fftwf_plan> _float_plans;
+		std::map<PlanKey, fftw_plan> _double_plans;
+		unsigned int _rigor;
+		unsigned int _thread_count;
+		bool _threads_initialized;
+		std::string _wisdom_file;
+		bool _new_plans;
+
+		mutable std::mutex _mutex;
+
+		static std::shared_ptr<FftPlanCache> s_instance;
+		static std::once_flag s_instance_flag;
+	};
+}
+
+#endif // FftPlanCache_h__
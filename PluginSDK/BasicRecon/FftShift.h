@@ -0,0 +1,207 @@
+#pragma once
+
+#ifndef FftShift_h__20171028
+#define FftShift_h__20171028
+
+#include <cassert>
+#include <complex>
+#include <cstring>
+#include <vector>
+
+namespace Yap
+{
+	/**
+	@brief Single pass fftshift and normalization used by the FFT processors.
+
+	Sizes are given slowest varying first, like FFTW. Along each axis of size n the element at
+	index (i + n - n / 2) % n is moved to index i, which is fftshift for even and odd sizes.
+	If axes is not empty, only the axes flagged in it are shifted.
+
+	If all shifted sizes are even (or 1), fftshift of a transform equals the transform of the
+	input multiplied by a checkerboard of +1/-1, so Modulate() can be applied before the
+	transform and no pass is needed afterwards. Otherwise Shift() is applied to the result of
+	the transform.
+	*/
+	namespace FftShift
+	{
+		inline bool IsShifted(const std::vector<bool>& axes, size_t axis)
+		{
+			return axes.empty() || axes[axis];
+		}
+
+		inline bool IsModulatable(const std::vector<int>& sizes, const std::vector<bool>& axes = std::vector<bool>())
+		{
+			for (size_t axis = 0; axis < sizes.size(); ++axis)
+			{
+				if (IsShifted(axes, axis) && sizes[axis] % 2 != 0 && sizes[axis] != 1)
+					return false;
+			}
+
+			return true;
+		}
+
+		inline size_t GetElementCount(const std::vector<int>& sizes, size_t first_axis = 0)
+		{
+			size_t count = 1;
+			for (auto i = first_axis; i < sizes.size(); ++i)
+			{
+				count *= size_t(sizes[i]);
+			}
+
+			return count;
+		}
+
+		/// destination = source * scale * (-1)^(sum of indices along shifted axes), source may equal destination.
+		template <typename T>
+		void Modulate(const std::complex<T> * source, std::complex<T> * destination,
+			const std::vector<int>& sizes, T scale, const std::vector<bool>& axes = std::vector<bool>())
+		{
+			assert(!sizes.empty() && IsModulatable(sizes, axes));
+
+			auto width = size_t(sizes.back());
+			auto row_count = GetElementCount(sizes) / width;
+			bool alternate = width > 1 && IsShifted(axes, sizes.size() - 1);
+			std::vector<int> index(sizes.size() - 1, 0);
+			bool negative = false;
+
+			for (size_t row = 0; row < row_count; ++row)
+			{
+				auto factor = negative ? -scale : scale;
+				if (alternate)
+				{
+					for (size_t x = 0; x < width; x += 2)
+					{
+						destination[x] = source[x] * factor;
+						destination[x + 1] = source[x + 1] * -factor;
+					}
+				}
+				else
+				{
+					for (size_t x = 0; x < width; ++x)
+					{
+						destination[x] = source[x] * factor;
+					}
+				}
+				source += width;
+				destination += width;
+
+				// Advance the index of the outer axes, each step along a shifted axis flips the sign.
+				for (int axis = int(index.size()) - 1; axis >= 0; --axis)
+				{
+					auto shifted = IsShifted(axes, axis);
+					if (shifted)
+					{
+						negative = !negative;
+					}
+					if (++index[axis] < sizes[axis])
+						break;
+
+					// Wrapped around by size - 1 steps, which is odd unless the size is 1.
+					index[axis] = 0;
+					if (shifted && sizes[axis] == 1)
+					{
+						negative = !negative;
+					}
+				}
+			}
+		}
+
+		/// Copy the shifted and scaled source to destination, the two must not overlap.
+		template <typename T>
+		void ShiftCopy(const std::complex<T> * source, std::complex<T> * destination,
+			const std::vector<int>& sizes, size_t axis, T scale, const std::vector<bool>& axes = std::vector<bool>())
+		{
+			auto size = size_t(sizes[axis]);
+			auto shift = IsShifted(axes, axis) ? size - size / 2 : 0;
+
+			if (axis + 1 == sizes.size())
+			{
+				for (size_t i = 0; i < size - shift; ++i)
+				{
+					destination[i] = source[i + shift] * scale;
+				}
+				for (size_t i = size - shift; i < size; ++i)
+				{
+					destination[i] = source[i + shift - size] * scale;
+				}
+			}
+			else
+			{
+				auto stride = GetElementCount(sizes, axis + 1);
+				for (size_t i = 0; i < size; ++i)
+				{
+					ShiftCopy(source + ((i + shift) % size) * stride, destination + i * stride, sizes, axis + 1, scale, axes);
+				}
+			}
+		}
+
+		/// Shift and scale data in place, every element is read and written once.
+		template <typename T>
+		void Shift(std::complex<T> * data, const std::vector<int>& sizes, T scale,
+			const std::vector<bool>& axes = std::vector<bool>(), size_t axis = 0)
+		{
+			assert(!sizes.empty() && axis < sizes.size());
+
+			auto size = size_t(sizes[axis]);
+			auto shift = size - size / 2;
+			auto stride = GetElementCount(sizes, axis + 1);
+
+			if (shift == size || !IsShifted(axes, axis))
+			{
+				// Nothing moves along this axis.
+				for (size_t i = 0; i < size; ++i)
+				{
+					if (axis + 1 < sizes.size())
+					{
+						Shift(data + i * stride, sizes, scale, axes, axis + 1);
+					}
+					else
+					{
+						data[i] *= scale;
+					}
+				}
+				return;
+			}
+
+			// Hyperplanes along this axis are moved in cycles, keeping the first of each cycle
+			// in a scratch buffer. The number of cycles is gcd(size, shift).
+			std::vector<std::complex<T>> first(stride);
+			size_t moved = 0;
+			for (size_t start = 0; moved < size; ++start)
+			{
+				memcpy(first.data(), data + start * stride, stride * sizeof(std::complex<T>));
+
+				auto destination = start;
+				for (;;)
+				{
+					auto source = (destination + shift) % size;
+					++moved;
+					if (source == start)
+					{
+						if (axis + 1 < sizes.size())
+						{
+							ShiftCopy(first.data(), data + destination * stride, sizes, axis + 1, scale, axes);
+						}
+						else
+						{
+							data[destination] = first[0] * scale;
+						}
+						break;
+					}
+
+					if (axis + 1 < sizes.size())
+					{
+						ShiftCopy(data + source * stride, data + destination * stride, sizes, axis + 1, scale, axes);
+					}
+					else
+					{
+						data[destination] = data[source] * scale;
+					}
+					destination = source;
+				}
+			}
+		}
+	}
+}
+
+#endif // FftShift_h__
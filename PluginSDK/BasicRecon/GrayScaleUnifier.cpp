@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "GrayScaleUnifier.h"
+#include "NoiseEstimation.h"
 #include "Implement/LogUserImpl.h"
 #include "Client/DataHelper.h"
 
@@ -51,5 +52,8 @@ bool Yap::GrayScaleUnifier::Input(const wchar_t * name, IData * data)
 		*(output_data++) = static_cast<float>((*(input_data++) - min_val) * rate);
 	}
 
+	// Noise estimates of the series no longer match the scale of the data.
+	NoiseEstimation::GetInstance().Invalidate(output.get());
+
 	return Feed(L"Output", output.get());
 }
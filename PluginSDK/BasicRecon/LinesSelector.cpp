@@ -64,14 +64,10 @@ bool Yap::LinesSelector::Input(const wchar_t * name, IData * data)
 	Yap::Dimensions dims;
 	dims(DimensionReadout, 0, input_data.GetWidth())
 		(DimensionPhaseEncoding, 0, lines_count);
-	auto output = CreateData<complex<float>>(data, &dims);
 
-	memset(Yap::GetDataArray<complex<float>>(output.get()), 0,
-		input_data.GetWidth() * lines_count * sizeof(complex<float>));
-
-	memcpy(Yap::GetDataArray<complex<float>>(output.get()),
-		Yap::GetDataArray<complex<float>>(data) + first_line_index * input_data.GetWidth(),
-		input_data.GetWidth() * lines_count * sizeof(complex<float>));
+	// The selected lines are contiguous, so the output is just a view into the input.
+	auto output = CreateData<complex<float>>(data,
+		Yap::GetDataArray<complex<float>>(data) + first_line_index * input_data.GetWidth(), dims, data);
 
 	return Feed(L"Output", output.get());
 }
\ No newline at end of file
@@ -46,6 +46,8 @@ ModulePhase::ModulePhase(void) :
 	AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeComplexDouble | DataTypeComplexFloat);
 	AddOutput(L"Module", YAP_ANY_DIMENSION, DataTypeDouble | DataTypeFloat);
 	AddOutput(L"Phase", YAP_ANY_DIMENSION, DataTypeDouble | DataTypeFloat);
+
+	SetReentrant(true);
 }
 
 Yap::ModulePhase::ModulePhase(const ModulePhase& rhs):
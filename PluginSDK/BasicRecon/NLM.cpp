@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "NLM.h"
+#include "NoiseEstimation.h"
 #include "Client/DataHelper.h"
 #include "Implement/LogUserImpl.h"
 
@@ -40,7 +41,9 @@ bool Yap::NLM::Input(const wchar_t * name, IData * data)
 	float * input_img = GetDataArray<float>(data);
 	auto output_img = CreateData<float>(data);
 
-	float sigma = GetSigma(input_img, width, height);
+	float sigma;
+	if (!NoiseEstimation::GetInstance().GetSigma(data, sigma))
+		return false;
 
 	unsigned int sw_r, pl_r;
 	float h;
@@ -176,28 +179,3 @@ arma::fmat Yap::NLM::GetGaussianKernel(int pl, float sigma)
 
 	return kernel;
 }
-
-float Yap::NLM::GetSigma(float * input_img, unsigned int width, unsigned int height)
-{
-	vector<float> input_data(width * height);
-	fmat input(height, width);
-	input.zeros();
-	memcpy(input_data.data(), input_img, width * height * sizeof(float));
-	for (unsigned int row = 0; row < height; ++row)
-	{
-		for (unsigned int col = 0; col < width; ++col)
-		{
-			input(row, col) = input_data[row * width + col];
-		}
-	}
-
-	fmat back_ground(20, 20);
-	back_ground.zeros();
-	back_ground(span(0, 9), span(0, 9)) = input(span(0, 9), span(0, 9));
-	back_ground(span(0, 9), span(10, 19)) = input(span(0, 9), span((width - 10), width - 1));
-	back_ground(span(10, 19), span(0, 9)) = input(span(height - 10, height - 1), span(0, 9));
-	back_ground(span(10, 19), span(10, 19)) = input(span(height - 10, height - 1), span(width - 10, width - 1));
-
-	auto sigma = stddev(vectorise(back_ground));
-	return sigma;
-}
@@ -21,7 +21,5 @@ namespace Yap
 		void nlmeans(float * input_img, float * output_img, unsigned int pl_r, 
 			unsigned int sw_r, float sigma, float h, unsigned int width, unsigned int height);
 		arma::fmat GetGaussianKernel(int pl, float sigma);
-
-		float GetSigma(float * input_img, unsigned int width, unsigned int height);
 	};
 }
@@ -1,5 +1,6 @@
 #include "stdafx.h"
 #include "NiumagPFFTConjugator.h"
+#include "FftPlanCache.h"
 #include "Implement/LogUserImpl.h"
 #include "Client/DataHelper.h"
 
@@ -36,30 +37,6 @@ bool Conjugate(T* input_data,
 	return true;
 }
 
-void SwapBlock(std::complex<float>* block1, std::complex<float>* block2, size_t width, size_t height, size_t line_stride)
-{
-	std::vector<std::complex<float>> swap_buffer;
-	swap_buffer.resize(width);
-
-	auto cursor1 = block1;
-	auto cursor2 = block2;
-	for (unsigned int row = 0; row < height; ++row)
-	{
-		memcpy(swap_buffer.data(), cursor1, width * sizeof(std::complex<float>));
-		memcpy(cursor1, cursor2, width * sizeof(std::complex<float>));
-		memcpy(cursor2, swap_buffer.data(), width * sizeof(std::complex<float>));
-
-		cursor1 += line_stride;
-		cursor2 += line_stride;
-	}
-}
-
-void FftShift(std::complex<float>* data, size_t  width, size_t height)
-{
-	SwapBlock(data, data + height / 2 * width + width / 2, width / 2, height / 2, width);
-	SwapBlock(data + width / 2, data + height / 2 * width, width / 2, height / 2, width);
-}
-
 Yap::NiumagPFFTConjugator::NiumagPFFTConjugator():
 	ProcessorImpl(L"NiumagPFFTConjugator")
 {
@@ -100,7 +77,6 @@ bool Yap::NiumagPFFTConjugator::Input(const wchar_t * name, IData * data)
 		return false;
 	}
 
-	auto data_size = input.GetWidth() * input.GetHeight();
 	auto dest_height = GetProperty<int>(L"DestHeight");
 	if (dest_height == 0)
 	{
@@ -141,18 +117,13 @@ bool Yap::NiumagPFFTConjugator::Input(const wchar_t * name, IData * data)
 	auto valid_data = output_data + input.GetWidth() * (dest_height - input.GetHeight()) / 2;
 
 	// FFT2D
-	auto forward_plan = fftwf_plan_dft_2d(int(input.GetHeight()), int(input.GetWidth()),
-										(fftwf_complex*)input_data,
-										(fftwf_complex*)valid_data,
-										FFTW_BACKWARD, FFTW_ESTIMATE);
-	fftwf_execute(forward_plan);
-	for (auto iter = valid_data; iter < valid_data + data_size; ++iter)
+	if (!FftPlanCache::GetInstance().ExecuteCentered(input_data, valid_data,
+		{ int(input.GetHeight()), int(input.GetWidth()) }, true))
 	{
-		(*iter) /= float(sqrt(data_size));
+		LOG_ERROR(L"<NiumagPFFTConjugator> Failed to create FFT plan!", L"BasicRecon");
+		return false;
 	}
 
-	FftShift(valid_data, input.GetWidth(), input.GetHeight());
-
 	LOG_TRACE(L"<NiumagPFFTConjugator> FFT2D.", L"BasicRecon");
 
 	// conjugate
@@ -165,11 +136,14 @@ bool Yap::NiumagPFFTConjugator::Input(const wchar_t * name, IData * data)
 	LOG_TRACE(L"<NiumagPFFTConjugator> Conjugate.", L"BasicRecon");
 
 	// inverse FFT2D
-	auto backward_plan = fftwf_plan_dft_2d(dest_height, int(input.GetWidth()),
-										(fftwf_complex*)output_data,
-										(fftwf_complex*)output_data,
-										FFTW_FORWARD, FFTW_ESTIMATE);
-	fftwf_execute(backward_plan);
+	auto backward_plan = FftPlanCache::GetInstance().GetFloatPlan(
+		{ int(dest_height), int(input.GetWidth()) }, false, true, FftPlanCache::IsAligned(output_data, output_data));
+	if (backward_plan == nullptr)
+	{
+		LOG_ERROR(L"<NiumagPFFTConjugator> Failed to create FFT plan!", L"BasicRecon");
+		return false;
+	}
+	fftwf_execute_dft(backward_plan, (fftwf_complex*)output_data, (fftwf_complex*)output_data);
 	for (auto iter = output_data; iter < output_data + dest_height * input.GetWidth(); ++iter)
 	{
 		(*iter) /= float(sqrt(dest_height * input.GetWidth()));
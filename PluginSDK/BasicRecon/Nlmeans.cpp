@@ -1,17 +1,34 @@
 #include "stdafx.h"
 #include "Nlmeans.h"
+#include "NoiseEstimation.h"
 #include "Client/DataHelper.h"
+#include "Implement/ExecutionEngine.h"
 #include "Implement/LogUserImpl.h"
 
+#include <algorithm>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define NLMEANS_SSE
+#include <xmmintrin.h>
+#endif
+
 using namespace std;
 using namespace Yap;
 using namespace arma;
 
+namespace
+{
+	const unsigned int RowsPerTile = 16;
+}
+
 Nlmeans::Nlmeans(void):
 	ProcessorImpl(L"Nlmeans")
 {
-	AddInput(L"Input", 2, DataTypeFloat);
-	AddOutput(L"Output", 2, DataTypeFloat);
+	AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeFloat);
+	AddOutput(L"Output", YAP_ANY_DIMENSION, DataTypeFloat);
+
+	SetReentrant(true);
 }
 
 Yap::Nlmeans::Nlmeans(const Nlmeans & rhs) :
@@ -34,13 +51,18 @@ bool Yap::Nlmeans::Input(const wchar_t * name, IData * data)
 	DataHelper input_data(data);
 	unsigned int width = input_data.GetWidth();
 	unsigned int height = input_data.GetHeight();
+	size_t image_size = size_t(width) * height;
+	auto image_count = input_data.GetDataSize() / image_size;
 
 	float * fpI = GetDataArray<float>(data);
 
 	auto fpO = CreateData<float>(data);
 
 //	float Sigma = GetFloat(L"Sigma");
-	float Sigma = GetSigma(fpI, width, height);
+	// The noise level is estimated once per series and shared by all images of a volume.
+	float Sigma;
+	if (!NoiseEstimation::GetInstance().GetSigma(data, Sigma))
+		return false;
 
 	unsigned int bloc, win;
 	float fFiltPar;
@@ -80,7 +102,11 @@ bool Yap::Nlmeans::Input(const wchar_t * name, IData * data)
 		return false;
 	}
 
-	nlmeans_ipol(win, bloc, Sigma, fFiltPar, fpI, GetDataArray<float>(fpO.get()), width, height);
+	for (size_t image = 0; image < image_count; ++image)
+	{
+		nlmeans_ipol(win, bloc, Sigma, fFiltPar, fpI + image * image_size,
+			GetDataArray<float>(fpO.get()) + image * image_size, width, height);
+	}
 
 	Feed(L"Output", fpO.get());
 
@@ -88,10 +114,9 @@ bool Yap::Nlmeans::Input(const wchar_t * name, IData * data)
 }
 
 void Yap::Nlmeans::nlmeans_ipol(unsigned int iDWin, unsigned int iDBloc, float Sigma, 
-	float fFiltPar, float * fpI, float * fpO, unsigned int iWidth, unsigned int iHeight)
+	float fFiltPar, const float * fpI, float * fpO, unsigned int iWidth, unsigned int iHeight)
 {
 	unsigned int iwxh = iWidth * iHeight;
-	unsigned int ihwl = (2 * iDWin + 1);
 	unsigned int iwl = (2 * iDWin + 1) * (2 * iDWin + 1);
 
 	float Sigma2 = Sigma * Sigma;
@@ -99,22 +124,86 @@ void Yap::Nlmeans::nlmeans_ipol(unsigned int iDWin, unsigned int iDBloc, float S
 	float fH2 = fH * fH;
 	fH2 *= (float)iwl;
 
-	unsigned int iLutLength = (unsigned int)rintf((float)LUTMAX * (float)LUTPRECISION);
-	float * fpLut = new float[iLutLength];//
-	wxFillExpLut(fpLut, iLutLength);
+	// Patches of a tile reach iDWin rows above and below it, so each tile accumulates into its
+	// own buffers, which are merged in order once all tiles are done.
+	struct Partial
+	{
+		unsigned int first_row;
+		vector<float> sum;
+		vector<float> count;
+	};
 
-	float * fpCount = new  float[iwxh];//
+	unsigned int tile_count = (iHeight + RowsPerTile - 1) / RowsPerTile;
+	vector<Partial> partials(tile_count);
 
-	for (unsigned int y = 0; y < iHeight; y++)
+	TaskGroup tasks;
+	for (unsigned int tile = 0; tile < tile_count; ++tile)
 	{
-		for (unsigned int x = 0; x < iWidth; x++)
+		tasks.Run([&, tile]() {
+			auto first_row = tile * RowsPerTile;
+			auto end_row = min(first_row + RowsPerTile, iHeight);
+			auto& partial = partials[tile];
+			partial.first_row = (first_row > iDWin) ? first_row - iDWin : 0;
+			size_t size = size_t(min(end_row + iDWin, iHeight) - partial.first_row) * iWidth;
+			partial.sum.assign(size, 0.0f);
+			partial.count.assign(size, 0.0f);
+
+			nlmeans_tile(iDWin, iDBloc, Sigma2, fH2, fpI, iWidth, iHeight, first_row, end_row,
+				partial.sum.data(), partial.count.data(), partial.first_row);
+			return true;
+		});
+	}
+	tasks.Wait();
+
+	vector<float> fpCount(iwxh, 0.0f);
+	memset(fpO, 0, iwxh * sizeof(float));
+	for (auto& partial : partials)
+	{
+		auto offset = size_t(partial.first_row) * iWidth;
+		for (size_t ii = 0; ii < partial.sum.size(); ii++)
 		{
-			int iDWin0 = MIN(iDWin, MIN(iWidth - 1 - x, MIN(iHeight - 1 - y, MIN(x, y))));
-			int imin = MAX(int(x - iDBloc), iDWin0);
-			int jmin = MAX(int(y - iDBloc), iDWin0);
+			fpO[offset + ii] += partial.sum[ii];
+			fpCount[offset + ii] += partial.count[ii];
+		}
+	}
 
-			int imax = MIN(x + iDBloc, iWidth - 1 - iDWin0);
-			int jmax = MIN(y + iDBloc, iHeight - 1 - iDWin0);
+	for (unsigned int ii = 0; ii < iwxh; ii++)
+	{
+		if (fpCount[ii] > 0.0)
+		{
+			fpO[ii] /= fpCount[ii];
+		}
+		else
+		{
+			fpO[ii] = fpI[ii];
+		}
+	}
+}
+
+void Yap::Nlmeans::nlmeans_tile(unsigned int iDWin, unsigned int iDBloc, float Sigma2, float fH2,
+	const float * fpI, unsigned int iWidth, unsigned int iHeight, unsigned int first_row,
+	unsigned int end_row, float * fpSum, float * fpCount, unsigned int acc_first_row)
+{
+	int ihwl = (2 * iDWin + 1);
+	int iwl = (2 * iDWin + 1) * (2 * iDWin + 1);
+	int width = int(iWidth);
+	int height = int(iHeight);
+
+	const float * fpLut = GetExpLut();
+	vector<float> fpODenoised(iwl);
+
+	for (int y = int(first_row); y < int(end_row); y++)
+	{
+		for (int x = 0; x < width; x++)
+		{
+			int iDWin0 = MIN(int(iDWin), MIN(width - 1 - x, MIN(height - 1 - y, MIN(x, y))));
+			int imin = MAX(x - int(iDBloc), iDWin0);
+			int jmin = MAX(y - int(iDBloc), iDWin0);
+
+			int imax = MIN(x + int(iDBloc), width - 1 - iDWin0);
+			int jmax = MIN(y + int(iDBloc), height - 1 - iDWin0);
+
+			std::fill(fpODenoised.begin(), fpODenoised.end(), 0.0f);
 
 			float fMaxWeight = 0.0f;
 
@@ -126,7 +215,7 @@ void Yap::Nlmeans::nlmeans_ipol(unsigned int iDWin, unsigned int iDBloc, float S
 				{
 					if (i != x || j != y)
 					{
-						float fDif = fiL2FloatDist(fpI, fpI, x, y, i, j, iDWin0, iWidth, iHeight);
+						float fDif = fiL2FloatDist(fpI, fpI, x, y, i, j, iDWin0, iWidth, iWidth);
 						fDif = MAX(fDif - 2.0f * (float)iwl * Sigma2, 0.0f);
 						fDif = fDif / fH2;
 
@@ -141,27 +230,24 @@ void Yap::Nlmeans::nlmeans_ipol(unsigned int iDWin, unsigned int iDBloc, float S
 						for (int is = -iDWin0; is <= iDWin0; is++)
 						{
 							int aiindex = (iDWin + is) * ihwl + iDWin;
-							int ail = (j + is) * iWidth + i;
+							int ail = (j + is) * width + i;
 							for (int ir = -iDWin0; ir <= iDWin0; ir++)
 							{
-								int iindex = aiindex + ir;
-								int il = ail + ir;
-								fpO[iindex] += fWeight * fpI[il];
+								fpODenoised[aiindex + ir] += fWeight * fpI[ail + ir];
 							}
 						}
 					}
+				}
+			}
 
-					for (int is = -iDWin0; is <= iDWin0; is++)
-					{
-						int aiindex = (iDWin + is) * ihwl + iDWin;
-						int ail = (y + is) * iWidth + x;
-						for (int ir = -iDWin0; ir <= iDWin0; ir++)
-						{
-							int iindex = aiindex + ir;
-							int il = ail + ir;
-							fpO[iindex] += fMaxWeight * fpI[il];
-						}
-					}
+			// The pixel itself is weighted like its most similar neighbour.
+			for (int is = -iDWin0; is <= iDWin0; is++)
+			{
+				int aiindex = (iDWin + is) * ihwl + iDWin;
+				int ail = (y + is) * width + x;
+				for (int ir = -iDWin0; ir <= iDWin0; ir++)
+				{
+					fpODenoised[aiindex + ir] += fMaxWeight * fpI[ail + ir];
 				}
 			}
 
@@ -172,68 +258,68 @@ void Yap::Nlmeans::nlmeans_ipol(unsigned int iDWin, unsigned int iDBloc, float S
 				for (int is = -iDWin0; is <= iDWin0; is++)
 				{
 					int aiindex = (iDWin + is) * ihwl + iDWin;
-					int ail = (y + is)*iWidth + x;
+					int ail = (y + is - int(acc_first_row)) * width + x;
 					for (int ir = -iDWin0; ir <= iDWin0; ir++)
 					{
-						int iindex = aiindex + ir;
-						int il = ail + ir;
-
-						fpCount[il]++;
-
-						fpO[il] += fpO[iindex] / fTotalWeight;
+						fpCount[ail + ir]++;
+						fpSum[ail + ir] += fpODenoised[aiindex + ir] / fTotalWeight;
 					}
 				}
 			}
 		}
 	}
-
-	for (unsigned int ii = 0; ii < iwxh; ii++)
-	{
-		if (fpCount[ii] > 0.0)
-		{
-			fpO[ii] /= fpCount[ii];
-		}
-		else
-		{
-			fpO[ii] = fpI[ii];
-		}
-	}
-
-	delete[] fpLut;
-	delete[] fpCount;
 }
 
-float Yap::Nlmeans::fiL2FloatDist(float * u0, float *u1, unsigned int i0, 
+float Yap::Nlmeans::fiL2FloatDist(const float * u0, const float * u1, unsigned int i0, 
 	unsigned int j0, unsigned int i1, unsigned int j1, int radius, unsigned int width0, unsigned int width1)
 {
+	int length = 2 * radius + 1;
 	float dist = 0.0;
+#ifdef NLMEANS_SSE
+	__m128 sum = _mm_setzero_ps();
+#endif
 	for (int s = -radius; s <= radius; s++) {
 
-		int l = (j0 + s)*width0 + (i0 - radius);
-		float *ptr0 = &u0[l];
-
-		l = (j1 + s)*width1 + (i1 - radius);
-		float *ptr1 = &u1[l];
+		const float *ptr0 = &u0[(j0 + s)*width0 + (i0 - radius)];
+		const float *ptr1 = &u1[(j1 + s)*width1 + (i1 - radius)];
 
-		for (int r = -radius; r <= radius; r++, ptr0++, ptr1++) {
-			float dif = (*ptr0 - *ptr1);
+		int r = 0;
+#ifdef NLMEANS_SSE
+		for (; r + 4 <= length; r += 4) {
+			__m128 dif = _mm_sub_ps(_mm_loadu_ps(ptr0 + r), _mm_loadu_ps(ptr1 + r));
+			sum = _mm_add_ps(sum, _mm_mul_ps(dif, dif));
+		}
+#endif
+		for (; r < length; r++) {
+			float dif = (ptr0[r] - ptr1[r]);
 			dist += (dif*dif);
 		}
 
 	}
+#ifdef NLMEANS_SSE
+	float lanes[4];
+	_mm_storeu_ps(lanes, sum);
+	dist += (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
 
 	return dist;
 }
 
-void Yap::Nlmeans::wxFillExpLut(float *lut, unsigned int size)
+const float * Yap::Nlmeans::GetExpLut()
 {
-	for (unsigned int i = 0; i < size; i++)
-	{
-		lut[i] = expf(-(float)i / (float)LUTPRECISION);
-	}
+	static const vector<float> lut = []() {
+		vector<float> table((unsigned int)rintf((float)LUTMAX * (float)LUTPRECISION));
+		for (unsigned int i = 0; i < table.size(); i++)
+		{
+			table[i] = expf(-(float)i / (float)LUTPRECISION);
+		}
+		return table;
+	}();
+
+	return lut.data();
 }
 
-float Yap::Nlmeans::wxSLUT(float dif, float *lut)
+float Yap::Nlmeans::wxSLUT(float dif, const float *lut)
 {
 	if (dif >= (float)LUTMAXM1) return 0.0;
 
@@ -244,28 +330,3 @@ float Yap::Nlmeans::wxSLUT(float dif, float *lut)
 
 	return float(y1 + (y2 - y1)*(dif*LUTPRECISION - x));
 }
-
-float Yap::Nlmeans::GetSigma(float * input_img, unsigned int width, unsigned int height)
-{
-	vector<float> input_data(width * height);
-	fmat input(height , width);
-	input.zeros();
-	memcpy(input_data.data(), input_img, width * height * sizeof(float));
-	for (unsigned int row = 0; row < height; ++row)
-	{
-		for (unsigned int col = 0; col < width; ++col)
-		{
-			input(row, col) = input_data[row * width + col];
-		}
-	}
-
-	fmat back_ground(20, 20);
-	back_ground.zeros();
-	back_ground(span(0, 9), span(0, 9)) = input(span(0, 9), span(0, 9));
-	back_ground(span(0, 9), span(10, 19)) = input(span(0, 9), span((width - 10), width - 1));
-	back_ground(span(10, 19), span(0, 9)) = input(span(height - 10, height - 1), span(0, 9));
-	back_ground(span(10, 19), span(10, 19)) = input(span(height - 10, height - 1), span(width - 10, width - 1));
-
-	auto sigma = stddev(vectorise(back_ground));
-	return sigma;
-}
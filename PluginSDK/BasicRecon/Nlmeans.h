@@ -28,16 +28,21 @@ namespace Yap
 
 		virtual bool Input(const wchar_t * name, IData * data) override;
 
-		void nlmeans_ipol(unsigned int iDWin, unsigned int iDBloc, float Sigma, float fFiltPar, 
-			float * fpI, float * fpO, unsigned int iWidth, unsigned int iHeight);
+		static void nlmeans_ipol(unsigned int iDWin, unsigned int iDBloc, float Sigma, float fFiltPar,
+			const float * fpI, float * fpO, unsigned int iWidth, unsigned int iHeight);
 
-		float fiL2FloatDist(float * u0, float *u1, unsigned int i0, unsigned int j0, 
-			unsigned int i1, unsigned int j1, int radius, unsigned int width0, unsigned int width1);
+		/// Denoise rows [first_row, end_row), patch estimates are accumulated into fpSum and fpCount,
+		/// which start at row acc_first_row.
+		static void nlmeans_tile(unsigned int iDWin, unsigned int iDBloc, float Sigma2, float fH2,
+			const float * fpI, unsigned int iWidth, unsigned int iHeight, unsigned int first_row,
+			unsigned int end_row, float * fpSum, float * fpCount, unsigned int acc_first_row);
 
-		void  wxFillExpLut(float *lut, unsigned int size);
+		static float fiL2FloatDist(const float * u0, const float * u1, unsigned int i0, unsigned int j0,
+			unsigned int i1, unsigned int j1, int radius, unsigned int width0, unsigned int width1);
 
-		float wxSLUT(float dif, float *lut);
+		/// Table of exp(-x) shared by all instances, built on first use.
+		static const float * GetExpLut();
 
-		float GetSigma(float * input_img, unsigned int width, unsigned int height);
+		static float wxSLUT(float dif, const float * lut);
 	};
 }
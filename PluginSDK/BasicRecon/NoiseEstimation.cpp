@@ -0,0 +1,381 @@
+#include "stdafx.h"
+#include "NoiseEstimation.h"
+
+#include "Client/DataHelper.h"
+#include "Implement/LogUserImpl.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__SSE__)
+#define NOISE_ESTIMATION_SSE
+#include <xmmintrin.h>
+#endif
+
+using namespace std;
+using namespace Yap;
+
+namespace
+{
+	/// Median of |N(0, 1)|, converts the median absolute deviation to a standard deviation.
+	const float MadToSigma = 1.0f / 0.6745f;
+
+	const unsigned int HistogramBins = 1024;
+
+	/// Add the sum and the sum of squares of count elements to sum and square_sum.
+	void Accumulate(const float * data, size_t count, double& sum, double& square_sum)
+	{
+		size_t i = 0;
+		float row_sum = 0.0f, row_square_sum = 0.0f;
+#ifdef NOISE_ESTIMATION_SSE
+		__m128 sums = _mm_setzero_ps();
+		__m128 square_sums = _mm_setzero_ps();
+		for (; i + 4 <= count; i += 4)
+		{
+			__m128 values = _mm_loadu_ps(data + i);
+			sums = _mm_add_ps(sums, values);
+			square_sums = _mm_add_ps(square_sums, _mm_mul_ps(values, values));
+		}
+		float lanes[4];
+		_mm_storeu_ps(lanes, sums);
+		row_sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+		_mm_storeu_ps(lanes, square_sums);
+		row_square_sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+#endif
+		for (; i < count; ++i)
+		{
+			row_sum += data[i];
+			row_square_sum += data[i] * data[i];
+		}
+		sum += row_sum;
+		square_sum += row_square_sum;
+	}
+
+	float GetMaximum(const float * data, size_t count)
+	{
+		size_t i = 0;
+		float maximum = 0.0f;
+#ifdef NOISE_ESTIMATION_SSE
+		__m128 maxima = _mm_setzero_ps();
+		for (; i + 4 <= count; i += 4)
+		{
+			maxima = _mm_max_ps(maxima, _mm_loadu_ps(data + i));
+		}
+		float lanes[4];
+		_mm_storeu_ps(lanes, maxima);
+		maximum = max(max(lanes[0], lanes[1]), max(lanes[2], lanes[3]));
+#endif
+		for (; i < count; ++i)
+		{
+			maximum = max(maximum, data[i]);
+		}
+		return maximum;
+	}
+
+	/// Center of the highest bin of the histogram of the values in (0, limit], smoothed over 5 bins.
+	float GetHistogramMode(const float * data, size_t count, float limit)
+	{
+		vector<unsigned int> histogram(HistogramBins, 0);
+		float scale = HistogramBins / limit;
+		for (size_t i = 0; i < count; ++i)
+		{
+			if (data[i] > 0.0f && data[i] <= limit)
+			{
+				++histogram[min(unsigned(data[i] * scale), HistogramBins - 1)];
+			}
+		}
+
+		unsigned int mode = 0, mode_count = 0;
+		for (unsigned int bin = 0; bin < HistogramBins; ++bin)
+		{
+			unsigned int smoothed = 0;
+			for (unsigned int i = (bin >= 2) ? bin - 2 : 0; i <= min(bin + 2, HistogramBins - 1); ++i)
+			{
+				smoothed += histogram[i];
+			}
+			if (smoothed > mode_count)
+			{
+				mode = bin;
+				mode_count = smoothed;
+			}
+		}
+
+		return (mode + 0.5f) / scale;
+	}
+}
+
+shared_ptr<NoiseEstimation> NoiseEstimation::s_instance;
+once_flag NoiseEstimation::s_instance_flag;
+
+NoiseEstimation& NoiseEstimation::GetInstance()
+{
+	call_once(s_instance_flag, []() {
+		s_instance = shared_ptr<NoiseEstimation>(new NoiseEstimation);
+	});
+
+	return *s_instance;
+}
+
+NoiseEstimation::NoiseEstimation()
+{
+}
+
+NoiseEstimation::~NoiseEstimation()
+{
+}
+
+bool NoiseEstimation::GetSigma(IData * data, float& sigma, NoiseMethod method, unsigned int corner_size)
+{
+	return GetSigma(data, sigma, method, corner_size, false);
+}
+
+bool NoiseEstimation::SelectSigma(IData * data, float& sigma, NoiseMethod method, unsigned int corner_size)
+{
+	assert(method != NoiseMethodAny);
+	return GetSigma(data, sigma, method, corner_size, true);
+}
+
+bool NoiseEstimation::GetSigma(IData * data, float& sigma, NoiseMethod method, unsigned int corner_size,
+	bool select)
+{
+	assert(data != nullptr);
+
+	Series series;
+	bool has_series = GetSeries(data, series);
+	if (has_series)
+	{
+		lock_guard<mutex> lock(_mutex);
+		auto matches = [&](const CachedSigma& cached) {
+			return cached.series == series && cached.method == method &&
+				(method != NoiseMethodCorner || cached.corner_size == corner_size);
+		};
+
+		auto iter = _cache.begin();
+		if (method == NoiseMethodAny)
+		{
+			iter = find_if(_cache.begin(), _cache.end(), [&](const CachedSigma& cached) {
+				return cached.series == series && cached.selected;
+			});
+			if (iter == _cache.end())
+			{
+				method = NoiseMethodCorner;
+				iter = find_if(_cache.begin(), _cache.end(), matches);
+			}
+		}
+		else
+		{
+			iter = find_if(_cache.begin(), _cache.end(), matches);
+		}
+
+		if (iter != _cache.end())
+		{
+			if (select)
+			{
+				for (auto& cached : _cache)
+				{
+					if (cached.series == series)
+					{
+						cached.selected = (&cached == &*iter);
+					}
+				}
+			}
+			_cache.splice(_cache.begin(), _cache, iter);
+			sigma = iter->sigma;
+			return true;
+		}
+	}
+
+	if (data->GetDataType() != DataTypeFloat)
+	{
+		LOG_ERROR(L"<NoiseEstimation> Error input data type!(DataTypeFloat is available)!", L"BasicRecon");
+		return false;
+	}
+
+	DataHelper helper(data);
+	auto width = helper.GetWidth();
+	auto height = helper.GetHeight();
+	if (method == NoiseMethodAny)
+	{
+		method = NoiseMethodCorner;
+	}
+	if (width < 2 || height < 2 ||
+		(method == NoiseMethodCorner && (corner_size == 0 || corner_size > width / 2 || corner_size > height / 2)))
+	{
+		LOG_ERROR(L"<NoiseEstimation> Image too small to estimate the noise!", L"BasicRecon");
+		return false;
+	}
+
+	sigma = Estimate(GetDataArray<float>(data), width, height, method, corner_size);
+
+	if (has_series)
+	{
+		lock_guard<mutex> lock(_mutex);
+		if (select)
+		{
+			for (auto& cached : _cache)
+			{
+				if (cached.series == series)
+				{
+					cached.selected = false;
+				}
+			}
+		}
+		_cache.push_front(CachedSigma{ series, method, corner_size, sigma, select });
+		if (_cache.size() > CacheCapacity)
+		{
+			_cache.pop_back();
+		}
+	}
+
+	return true;
+}
+
+void NoiseEstimation::Invalidate(IData * data)
+{
+	assert(data != nullptr);
+
+	Series series;
+	if (!GetSeries(data, series))
+		return;
+
+	lock_guard<mutex> lock(_mutex);
+	_cache.remove_if([&series](const CachedSigma& cached) { return cached.series == series; });
+}
+
+bool NoiseEstimation::GetSeries(IData * data, Series& series)
+{
+	auto variables = data->GetVariables();
+	if (variables == nullptr)
+		return false;
+
+	auto id = dynamic_cast<ISimpleVariable<int>*>(variables->Find(L"series_id"));
+	if (id != nullptr)
+	{
+		series = Series{ SmartPtr<IVariableContainer>(), id->Get() };
+	}
+	else
+	{
+		series = Series{ YapShared(variables), 0 };
+	}
+
+	return true;
+}
+
+void NoiseEstimation::Reset()
+{
+	lock_guard<mutex> lock(_mutex);
+	_cache.clear();
+}
+
+bool NoiseEstimation::ParseMethod(const wchar_t * text, NoiseMethod& method)
+{
+	assert(text != nullptr);
+
+	if (_wcsicmp(text, L"Corner") == 0)
+	{
+		method = NoiseMethodCorner;
+	}
+	else if (_wcsicmp(text, L"WaveletMad") == 0)
+	{
+		method = NoiseMethodWaveletMad;
+	}
+	else if (_wcsicmp(text, L"BackgroundHistogram") == 0)
+	{
+		method = NoiseMethodBackgroundHistogram;
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
+
+float NoiseEstimation::Estimate(const float * image, unsigned int width, unsigned int height,
+	NoiseMethod method, unsigned int corner_size)
+{
+	switch (method)
+	{
+	case NoiseMethodWaveletMad:
+		return EstimateWaveletMad(image, width, height);
+	case NoiseMethodBackgroundHistogram:
+		return EstimateBackgroundHistogram(image, width, height);
+	default:
+		return EstimateCorner(image, width, height, corner_size);
+	}
+}
+
+float NoiseEstimation::EstimateCorner(const float * image, unsigned int width, unsigned int height,
+	unsigned int corner_size)
+{
+	assert(image != nullptr && corner_size > 0 && corner_size <= width / 2 && corner_size <= height / 2);
+
+	double sum = 0.0, square_sum = 0.0;
+	const float * rows[] = { image, image + size_t(width) * (height - corner_size) };
+	for (auto row : rows)
+	{
+		for (unsigned int i = 0; i < corner_size; ++i, row += width)
+		{
+			Accumulate(row, corner_size, sum, square_sum);
+			Accumulate(row + width - corner_size, corner_size, sum, square_sum);
+		}
+	}
+
+	double count = 4.0 * corner_size * corner_size;
+	auto variance = (square_sum - sum * sum / count) / (count - 1.0);
+	return float(sqrt(max(variance, 0.0)));
+}
+
+float NoiseEstimation::EstimateWaveletMad(const float * image, unsigned int width, unsigned int height)
+{
+	assert(image != nullptr && width >= 2 && height >= 2);
+
+	// Diagonal (HH) coefficients of the orthonormal Haar transform, one per 2 x 2 block. They
+	// hold little of the image but all of the white noise at its full level.
+	unsigned int block_columns = width / 2;
+	vector<float> coefficients(size_t(block_columns) * (height / 2));
+	auto coefficient = coefficients.data();
+	for (unsigned int y = 0; y + 1 < height; y += 2)
+	{
+		auto row0 = image + size_t(y) * width;
+		auto row1 = row0 + width;
+		unsigned int x = 0;
+#ifdef NOISE_ESTIMATION_SSE
+		const __m128 half = _mm_set1_ps(0.5f);
+		const __m128 sign = _mm_set1_ps(-0.0f);
+		for (; x + 4 <= block_columns; x += 4, coefficient += 4)
+		{
+			__m128 low = _mm_sub_ps(_mm_loadu_ps(row0 + 2 * x), _mm_loadu_ps(row1 + 2 * x));
+			__m128 high = _mm_sub_ps(_mm_loadu_ps(row0 + 2 * x + 4), _mm_loadu_ps(row1 + 2 * x + 4));
+			__m128 even = _mm_shuffle_ps(low, high, _MM_SHUFFLE(2, 0, 2, 0));
+			__m128 odd = _mm_shuffle_ps(low, high, _MM_SHUFFLE(3, 1, 3, 1));
+			_mm_storeu_ps(coefficient, _mm_andnot_ps(sign, _mm_mul_ps(_mm_sub_ps(even, odd), half)));
+		}
+#endif
+		for (; x < block_columns; ++x)
+		{
+			*coefficient++ = 0.5f * fabs(row0[2 * x] - row0[2 * x + 1] - row1[2 * x] + row1[2 * x + 1]);
+		}
+	}
+
+	auto median = coefficients.begin() + coefficients.size() / 2;
+	nth_element(coefficients.begin(), median, coefficients.end());
+
+	return *median * MadToSigma;
+}
+
+float NoiseEstimation::EstimateBackgroundHistogram(const float * image, unsigned int width, unsigned int height)
+{
+	assert(image != nullptr);
+
+	// The background of a magnitude image is Rayleigh distributed, its mode is sigma. Zeros,
+	// e.g. from masking, are left out. A second pass around the first guess refines the bins.
+	size_t count = size_t(width) * height;
+	auto maximum = GetMaximum(image, count);
+	if (maximum <= 0.0f)
+		return 0.0f;
+
+	auto sigma = GetHistogramMode(image, count, maximum);
+	return GetHistogramMode(image, count, min(4.0f * sigma, maximum));
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#ifndef NoiseEstimation_h__20171103
+#define NoiseEstimation_h__20171103
+
+#include "Interface/Interfaces.h"
+#include "Interface/smartptr.h"
+
+#include <cassert>
+#include <list>
+#include <memory>
+#include <mutex>
+
+namespace Yap
+{
+	enum NoiseMethod
+	{
+		NoiseMethodAny,					///< The method selected for the series by SelectSigma(), NoiseMethodCorner otherwise.
+		NoiseMethodCorner,				///< Standard deviation of the four corners.
+		NoiseMethodWaveletMad,			///< Median absolute diagonal Haar coefficient / 0.6745.
+		NoiseMethodBackgroundHistogram,	///< Mode of the Rayleigh distributed background of magnitude images.
+	};
+
+	/**
+	@brief Noise level estimators shared by the denoisers, with a cache of one estimate per series.
+
+	The static functions estimate the standard deviation of the noise of a single float image.
+	GetSigma() estimates the noise of the first image of a series and returns the same value for
+	every later image of it. The series is identified by the int variable "series_id" if the data
+	has one, by its variable container otherwise. Data created from the same scan shares its
+	variable container, processors which copy the variables of a series for each output, e.g.
+	SliceIterator when the execution engine is enabled, tag it with a series_id first. Estimates
+	are kept per method, NoiseMethodAny only returns one made by another method if it was
+	selected for the series with SelectSigma().
+
+	An estimate is only valid at the scale of the image it was made from. Processors which rescale
+	the data, e.g. GrayScaleUnifier, call Invalidate() on their output, so that processors after
+	them estimate again. A NoiseEstimator must therefore follow the last rescaling before the
+	denoisers relying on its estimate.
+	*/
+	class NoiseEstimation
+	{
+	public:
+		static NoiseEstimation& GetInstance();
+		~NoiseEstimation();
+
+		/// Noise level of the series of data, estimated from its first 2D image if not known yet.
+		bool GetSigma(IData * data, float& sigma, NoiseMethod method = NoiseMethodAny,
+			unsigned int corner_size = 10);
+
+		/// Same as GetSigma(), and the estimate is returned for NoiseMethodAny from then on.
+		bool SelectSigma(IData * data, float& sigma, NoiseMethod method, unsigned int corner_size = 10);
+
+		/// Drop the estimates of the series of data, e.g. after its scale was changed.
+		void Invalidate(IData * data);
+
+		/// Drop all cached estimates.
+		void Reset();
+
+		static bool ParseMethod(const wchar_t * text, NoiseMethod& method);
+
+		static float EstimateCorner(const float * image, unsigned int width, unsigned int height,
+			unsigned int corner_size = 10);
+		static float EstimateWaveletMad(const float * image, unsigned int width, unsigned int height);
+		static float EstimateBackgroundHistogram(const float * image, unsigned int width, unsigned int height);
+		static float Estimate(const float * image, unsigned int width, unsigned int height,
+			NoiseMethod method, unsigned int corner_size = 10);
+
+		/// Mean of the four corner_size x corner_size corners, used as the DC level of an image.
+		template <typename T>
+		static T GetCornerMean(const T * image, size_t width, size_t height, size_t corner_size)
+		{
+			assert(corner_size <= width / 2 && corner_size <= height / 2 && corner_size > 0);
+
+			T total = T(0);
+			const T * rows[] = { image, image + width * (height - corner_size) };
+			for (auto row : rows)
+			{
+				for (size_t i = 0; i < corner_size; ++i, row += width)
+				{
+					for (size_t j = 0; j < corner_size; ++j)
+					{
+						total += row[j] + row[width - corner_size + j];
+					}
+				}
+			}
+
+			return total / T(double(corner_size * corner_size * 4));
+		}
+
+	protected:
+		NoiseEstimation();
+
+		/// Either the variable container of the series or its series_id.
+		struct Series
+		{
+			SmartPtr<IVariableContainer> variables;
+			int id;
+
+			bool operator == (const Series& rhs) const
+			{
+				return variables.get() == rhs.variables.get() && id == rhs.id;
+			}
+		};
+
+		struct CachedSigma
+		{
+			Series series;
+			NoiseMethod method;
+			unsigned int corner_size;
+			float sigma;
+			bool selected;	///< Returned for NoiseMethodAny.
+		};
+
+		bool GetSigma(IData * data, float& sigma, NoiseMethod method, unsigned int corner_size, bool select);
+		static bool GetSeries(IData * data, Series& series);
+
+		static const unsigned int CacheCapacity = 8;
+
+		std::list<CachedSigma> _cache;	///< Most recently used first.
+		std::mutex _mutex;
+
+		static std::shared_ptr<NoiseEstimation> s_instance;
+		static std::once_flag s_instance_flag;
+
+		NoiseEstimation(const NoiseEstimation&) = delete;
+		const NoiseEstimation& operator = (const NoiseEstimation&) = delete;
+	};
+}
+
+#endif // NoiseEstimation_h__
@@ -0,0 +1,65 @@
+#include "stdafx.h"
+#include "NoiseEstimator.h"
+#include "NoiseEstimation.h"
+
+#include "Implement/LogUserImpl.h"
+
+#include <string>
+
+using namespace std;
+using namespace Yap;
+
+NoiseEstimator::NoiseEstimator() :
+	ProcessorImpl(L"NoiseEstimator")
+{
+	AddProperty<std::wstring>(L"Method", L"Corner",
+		L"Estimator of the noise level, Corner, WaveletMad or BackgroundHistogram.");
+	AddProperty<int>(L"CornerSize", 10, L"Size of the corners used by the Corner method.");
+
+	AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeFloat);
+	AddOutput(L"Output", YAP_ANY_DIMENSION, DataTypeFloat);
+
+	_method = BindProperty<std::wstring>(L"Method");
+	_corner_size = BindProperty<int>(L"CornerSize");
+
+	SetReentrant(true);
+}
+
+NoiseEstimator::NoiseEstimator(const NoiseEstimator& rhs) :
+	ProcessorImpl(rhs),
+	_method(rhs._method),
+	_corner_size(rhs._corner_size)
+{
+}
+
+NoiseEstimator::~NoiseEstimator()
+{
+}
+
+bool NoiseEstimator::Input(const wchar_t * port, IData * data)
+{
+	if (data == nullptr)
+	{
+		LOG_ERROR(L"<NoiseEstimator> Invalid input data!", L"BasicRecon");
+		return false;
+	}
+	if (_wcsicmp(port, L"Input") != 0)
+	{
+		LOG_ERROR(L"<NoiseEstimator> Error input port name!", L"BasicRecon");
+		return false;
+	}
+
+	NoiseMethod method;
+	if (!NoiseEstimation::ParseMethod(GetProperty<std::wstring>(_method).c_str(), method))
+	{
+		LOG_ERROR(L"<NoiseEstimator> Unknown Method!(Corner, WaveletMad or BackgroundHistogram is available)", L"BasicRecon");
+		return false;
+	}
+
+	auto corner_size = GetProperty<int>(_corner_size);
+	float sigma;
+	if (!NoiseEstimation::GetInstance().SelectSigma(data, sigma, method, corner_size > 0 ? unsigned(corner_size) : 0))
+		return false;
+
+	return Feed(L"Output", data);
+}
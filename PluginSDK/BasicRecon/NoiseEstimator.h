@@ -0,0 +1,36 @@
+#pragma once
+
+#ifndef NoiseEstimator_h__20171103
+#define NoiseEstimator_h__20171103
+
+#include "Implement/ProcessorImpl.h"
+
+namespace Yap
+{
+	/**
+	@brief Estimate the noise level of a series once and pass the data on unchanged.
+
+	The estimate is kept by NoiseEstimation, where the denoisers downstream (NLM, Nlmeans,
+	FastNlm) find it instead of estimating the noise of every image themselves. Method is one of
+	Corner, WaveletMad and BackgroundHistogram. The estimator has to follow any processor which
+	rescales the data, e.g. GrayScaleUnifier, since that drops the estimates of the series.
+	*/
+	class NoiseEstimator :
+		public ProcessorImpl
+	{
+		IMPLEMENT_SHARED(NoiseEstimator)
+	public:
+		NoiseEstimator();
+		NoiseEstimator(const NoiseEstimator& rhs);
+
+	protected:
+		~NoiseEstimator();
+
+		virtual bool Input(const wchar_t * port, IData * data) override;
+
+		PropertyHandle _method;
+		PropertyHandle _corner_size;
+	};
+}
+
+#endif // NoiseEstimator_h__
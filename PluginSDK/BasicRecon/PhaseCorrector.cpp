@@ -46,7 +46,7 @@ bool Yap::PhaseCorrector::Input(const wchar_t * name, IData * data)
 {
 	if (wstring(name) == L"Phase")
 	{
-		_phase = YapShared(data);
+		_phase = RetainedData(data);
 		return true;
 	}
 	else if (wstring(name) == L"Input")
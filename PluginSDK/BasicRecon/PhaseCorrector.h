@@ -19,7 +19,7 @@ namespace Yap
 		~PhaseCorrector();
 		virtual bool Input(const wchar_t * name, IData * data) override;
 
-		SmartPtr<IData> _phase;
+		RetainedData _phase;
 	};
 
 }
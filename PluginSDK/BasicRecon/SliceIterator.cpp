@@ -4,19 +4,32 @@
 #include "Client/DataHelper.h"
 #include <complex>
 #include "Implement/LogUserImpl.h"
+#include "Implement/ExecutionEngine.h"
+#include <atomic>
 
 using namespace Yap;
 using namespace std;
 
+namespace
+{
+	atomic<int> s_next_series_id(1);
+}
+
 SliceIterator::SliceIterator(void) :
 	ProcessorImpl(L"SliceIterator")
 {
 	AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeComplexFloat | DataTypeUnsignedShort);
 	AddOutput(L"Output", 2, DataTypeComplexFloat | DataTypeUnsignedShort);
+	_input_port = GetInputHandle(L"Input");
+	_output_port = GetOutputHandle(L"Output");
+
+	SetReentrant(true);
 }
 
 SliceIterator::SliceIterator( const SliceIterator& rhs)
-	: ProcessorImpl(rhs)
+	: ProcessorImpl(rhs),
+	_input_port(rhs._input_port),
+	_output_port(rhs._output_port)
 {
 
 }
@@ -28,16 +41,34 @@ SliceIterator::~SliceIterator(void)
 
 bool SliceIterator::Input(const wchar_t * name, IData * data)
 {
-	assert((data != nullptr) && ((Yap::GetDataArray<complex<float>>(data) != nullptr) || Yap::GetDataArray<unsigned short>(data) != nullptr));
 	assert(Inputs()->Find(name) != nullptr);
 
+	return InputByHandle(_input_port, data);
+}
+
+bool SliceIterator::InputByHandle(PortHandle port, IData * data)
+{
+	assert(port == _input_port);
+	assert((data != nullptr) && ((Yap::GetDataArray<complex<float>>(data) != nullptr) || Yap::GetDataArray<unsigned short>(data) != nullptr));
+
 	DataHelper helper(data);
 
 	unsigned int slice_block_size = helper.GetBlockSize(DimensionSlice);
 
 	Dimension slice_dimension = helper.GetDimension(DimensionSlice);
 	assert(slice_dimension.type == DimensionSlice);
-	
+
+	// Slices are fed as independent tasks, so each slice needs its own copy of the variables.
+	// The series_id keeps the copies of one series identifiable, e.g. for NoiseEstimation.
+	bool parallel = ExecutionEngine::GetInstance().IsEnabled();
+	if (parallel && data->GetVariables() != nullptr && data->GetVariables()->Find(L"series_id") == nullptr)
+	{
+		VariableSpace series(data->GetVariables());
+		series.AddVariable(L"int", L"series_id", L"series id.");
+		series.Set(L"series_id", s_next_series_id++);
+	}
+	TaskGroup tasks;
+
 	for (unsigned int i = slice_dimension.start_index; i < slice_dimension.start_index + slice_dimension.length; ++i)
 	{
 		Dimensions slice_data_dimensions(data->GetDimensions());
@@ -45,6 +76,10 @@ bool SliceIterator::Input(const wchar_t * name, IData * data)
 		//Add variable "slice_index" to the variable space.
 
 		VariableSpace variables(data->GetVariables());
+		if (parallel)
+		{
+			variables = VariableSpace(variables);
+		}
 		variables.AddVariable(L"int", L"slice_index", L"slice index.");
 		variables.Set(L"slice_index", static_cast<int>(i) );
 		//
@@ -53,20 +88,24 @@ bool SliceIterator::Input(const wchar_t * name, IData * data)
 		{
 			auto output = CreateData<complex<float>>(data,
 				Yap::GetDataArray<complex<float>>(data) + i * slice_block_size, slice_data_dimensions, data);
+			output->SetVariables(variables.Variables());
 
-			Feed(L"Output", output.get());
+			FeedAsync(tasks, _output_port, output.get());
 		}
 		else
 		{
 			auto output = CreateData<unsigned short>(data,
 				Yap::GetDataArray<unsigned short>(data) + i * slice_block_size, slice_data_dimensions, data);
+			output->SetVariables(variables.Variables());
 
-			Feed(L"Output", output.get());
+			FeedAsync(tasks, _output_port, output.get());
 		}
 
 		// output->SetSliceLocalization(GetParams(), i);
 	}
 
+	tasks.Wait();
+
 	return true;
 }
 
@@ -18,6 +18,10 @@ namespace Yap
 		~SliceIterator(void);
 
 		virtual bool Input(const wchar_t * name, IData * data) override;
+		virtual bool InputByHandle(PortHandle port, IData * data) override;
+
+		PortHandle _input_port;
+		PortHandle _output_port;
 	};
 }
 #endif // SliceIterator_h__
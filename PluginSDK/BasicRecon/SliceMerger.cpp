@@ -1,6 +1,7 @@
 ﻿#include "stdafx.h"
 #include "SliceMerger.h"
 
+#include <algorithm>
 #include <complex.h>
 #include "Client/DataHelper.h"
 #include "Implement/LogUserImpl.h"
@@ -8,17 +9,44 @@
 using namespace Yap;
 using namespace std;
 
+namespace
+{
+	/// Return the index of the slice in the volume, false if dimensions doesn't place it there.
+	bool GetSliceIndex(IDimensions * dimensions, unsigned int slice_count, unsigned int& slice_index)
+	{
+		for (unsigned int i = 0; i < dimensions->GetDimensionCount(); ++i)
+		{
+			DimensionType type = DimensionInvalid;
+			unsigned int start_index = 0, length = 0;
+			dimensions->GetDimensionInfo(i, type, start_index, length);
+			if (type == DimensionSlice)
+			{
+				slice_index = start_index;
+				return length == 1 && start_index < slice_count;
+			}
+		}
+
+		return false;
+	}
+}
+
 SliceMerger::SliceMerger(void) :
-	ProcessorImpl(L"SliceMerger")
+	ProcessorImpl(L"SliceMerger"),
+	_received_count(0)
 {
 	AddInput(L"Input", 2, DataTypeAll);
 	AddOutput(L"Output", 3, DataTypeAll);
+	_input_port = GetInputHandle(L"Input");
+	_output_port = GetOutputHandle(L"Output");
 
 	AddProperty<int>(L"SliceCount", 0, L"Slice count");
 }
 
 SliceMerger::SliceMerger(const SliceMerger& rhs)
-	: ProcessorImpl(rhs)
+	: ProcessorImpl(rhs),
+	_input_port(rhs._input_port),
+	_output_port(rhs._output_port),
+	_received_count(0)
 {
 }
 
@@ -31,44 +59,123 @@ bool SliceMerger::Input(const wchar_t * port, IData * data)
 	if (wstring(port) != L"Input")
 		return false;
 
-	static int slice_num = 0;
-	auto slice_count = GetProperty<int>(L"SliceCount");
+	return InputByHandle(_input_port, data);
+}
+
+bool SliceMerger::InputByHandle(PortHandle port, IData * data)
+{
+	assert(port == _input_port);
+
+	auto slice_count = unsigned(GetProperty<int>(L"SliceCount"));
 	assert(slice_count > 0);
 
-	if (slice_num == 0)
+	DataHelper helper(data);
+	if (helper.GetDataType() != DataTypeUnsignedShort)
 	{
-		DataHelper helper(data);
-		auto width = helper.GetWidth();
-		auto height = helper.GetHeight();
-
-		Yap::Dimensions dims;
-		dims(DimensionReadout, 0, width)
-			(DimensionPhaseEncoding, 0, height)
-			(DimensionSlice, 0, slice_count);
-		
-		TODO(让SliceMerger适应不同数据类型);
-		_data = CreateData<unsigned short>(data, &dims);
-
-		++slice_num;
+		LOG_ERROR(L"<SliceMerger> Only unsigned short data can be merged!", L"BasicRecon");
+		return false;
 	}
 
-	assert(slice_num != 0);
-	DataHelper helper(data);
 	auto width = helper.GetWidth();
 	auto height = helper.GetHeight();
+	auto slice_size = helper.GetDataSize();
 	auto input_array = GetDataArray<unsigned short>(data);
-	auto output_array = GetDataArray<unsigned short>(_data.get());
 
-	auto slice_start = output_array + width * height * (slice_num++ - 1);
-	for (unsigned int row = 0; row < height; ++row)
+	SmartPtr<UnsignedShortData> output;
 	{
-		memcpy(slice_start + row * width, input_array + row * width, width * sizeof(unsigned short));
+		lock_guard<mutex> lock(_mutex);
+		if (!_data)
+		{
+			CreateVolume(data, width, height);
+		}
+
+		if (DataHelper(_data.get()).GetDataSize() != slice_size * slice_count)
+		{
+			LOG_ERROR(L"<SliceMerger> Slice size doesn't match the volume!", L"BasicRecon");
+			return false;
+		}
+
+		// Slices created in a slot handed out by GetInputSlot() are already in place. Others are
+		// copied to their slice index, or to the first free position if they don't carry one.
+		auto output_array = _data->GetData();
+		bool in_place = input_array >= output_array && input_array < output_array + slice_size * slice_count;
+		unsigned int slice_index = 0;
+		if (in_place)
+		{
+			slice_index = unsigned((input_array - output_array) / slice_size);
+		}
+		else if (!GetSliceIndex(data->GetDimensions(), slice_count, slice_index))
+		{
+			slice_index = unsigned(find(_filled.begin(), _filled.end(), false) - _filled.begin());
+		}
+
+		if (slice_index >= slice_count)
+		{
+			LOG_ERROR(L"<SliceMerger> More slices than SliceCount received!", L"BasicRecon");
+			return false;
+		}
+		if (_filled[slice_index])
+		{
+			LOG_ERROR(L"<SliceMerger> Slice received twice!", L"BasicRecon");
+			return false;
+		}
+
+		if (!in_place)
+		{
+			memcpy(output_array + slice_size * slice_index, input_array, slice_size * sizeof(unsigned short));
+		}
+		_filled[slice_index] = true;
+
+		if (++_received_count == slice_count)
+		{
+			output = _data;
+			_data.reset();
+			_received_count = 0;
+		}
 	}
 
-	if (slice_num > slice_count)
+	return !output || Feed(_output_port, output.get());
+}
+
+SmartPtr<IData> SliceMerger::GetInputSlot(PortHandle port, int data_type, IDimensions * dimensions,
+	IData * reference)
+{
+	auto slice_count = unsigned(GetProperty<int>(L"SliceCount"));
+	unsigned int slice_index = 0;
+	if (data_type != DataTypeUnsignedShort || !GetSliceIndex(dimensions, slice_count, slice_index))
+		return SmartPtr<IData>();
+
+	Dimensions slice_dimensions(dimensions);
+	size_t slice_size = 1;
+	for (unsigned int i = 0; i < slice_dimensions.GetDimensionCount(); ++i)
 	{
-		Feed(L"Output", _data.get());
+		slice_size *= slice_dimensions.GetLength(i);
 	}
 
-	return true;
+	lock_guard<mutex> lock(_mutex);
+	if (!_data)
+	{
+		CreateVolume(reference, slice_dimensions.GetLength(0),
+			slice_dimensions.GetDimensionCount() > 1 ? slice_dimensions.GetLength(1) : 1);
+	}
+
+	// The position is only marked as filled when the slice arrives in Input(), so a slot which is
+	// never fed doesn't keep the volume from completing.
+	if (_filled[slice_index] || DataHelper(_data.get()).GetDataSize() != slice_size * slice_count)
+		return SmartPtr<IData>();
+
+	return CreateData<unsigned short>(reference, _data->GetData() + slice_size * slice_index,
+		dimensions, _data.get());
+}
+
+void SliceMerger::CreateVolume(IData * reference, unsigned int width, unsigned int height)
+{
+	Yap::Dimensions dims;
+	dims(DimensionReadout, 0, width)
+		(DimensionPhaseEncoding, 0, height)
+		(DimensionSlice, 0, GetProperty<int>(L"SliceCount"));
+
+	TODO(让SliceMerger适应不同数据类型);
+	_data = CreateData<unsigned short>(reference, &dims);
+	_filled.assign(GetProperty<int>(L"SliceCount"), false);
 }
\ No newline at end of file
@@ -4,6 +4,10 @@
 #define SliceMerger_h__20161221
 
 #include "Implement/ProcessorImpl.h"
+
+#include <mutex>
+#include <vector>
+
 namespace Yap
 {
 	class SliceMerger:
@@ -18,8 +22,25 @@ namespace Yap
 		~SliceMerger();
 
 		virtual bool Input(const wchar_t * port, IData * data) override;
+		virtual bool InputByHandle(PortHandle port, IData * data) override;
+
+		PortHandle _input_port;
+		PortHandle _output_port;
+
+		/// Hand out the position of the slice in the volume, see ProcessorImpl::GetInputSlot().
+		/**
+			\remarks The position is given by the start index along DimensionSlice, slices without
+			one are copied to the first free position when they arrive.
+		*/
+		virtual SmartPtr<IData> GetInputSlot(PortHandle port, int data_type, IDimensions * dimensions,
+			IData * reference) override;
+
+		void CreateVolume(IData * reference, unsigned int width, unsigned int height);
 
-		SmartPtr<IData> _data;
+		SmartPtr<UnsignedShortData> _data;
+		std::vector<bool> _filled;		///< Slice positions already received.
+		unsigned int _received_count;
+		std::mutex _mutex;
 	};
 }
 #endif // SliceMerger_h__
@@ -14,6 +14,9 @@ SliceSelector::SliceSelector(void):
 	AddOutput(L"Output", YAP_ANY_DIMENSION, DataTypeComplexFloat);
 
 	AddProperty<int>(L"SliceIndex", 3, L"The index of the slice you want to get.");
+
+	SetReentrant(true);
+	SetStridedInput(true);
 }
 
 Yap::SliceSelector::SliceSelector(const SliceSelector & rhs)
@@ -34,77 +37,46 @@ bool Yap::SliceSelector::Input(const wchar_t * name, IData * data)
 	assert(Inputs()->Find(name) != nullptr);
 
 	int slice_index = GetProperty<int>(L"SliceIndex");
+	if (slice_index < 0)
+	{
+		LOG_ERROR(L"<SliceSelector> Improper property(SliceIndex) value.", L"BasicRecon");
+		return false;
+	}
 
+	return is_type_complexf ? FeedSlice<complex<float>>(data, slice_index) : 
+		FeedSlice<short>(data, slice_index);
+}
+
+/**
+	Feed the selected slice as a view into the input data, other dimensions (e.g. channels)
+	are kept. The view is contiguous unless there are dimensions after the slice dimension.
+*/
+template <typename T>
+bool Yap::SliceSelector::FeedSlice(IData * data, unsigned int slice_index)
+{
 	DataHelper input_data(data);
-	Dimensions data_dimentions(data->GetDimensions());
-	unsigned int slice_block_size = input_data.GetBlockSize(DimensionSlice);
-	if (input_data.GetActualDimensionCount() <= 3)
-	{		
-		data_dimentions.SetDimension(DimensionSlice, 1, slice_index);
-		if (is_type_complexf)
-		{
-			auto output = CreateData<complex<float>>(data,
-				Yap::GetDataArray<complex<float>>(data) + slice_index * slice_block_size, 
-				data_dimentions, data);
-			Feed(L"Output", output.get());
-		}
-		if(is_type_short)
-		{
-			auto output = CreateData<short>(data,
-				Yap::GetDataArray<short>(data)
-				+ slice_index * slice_block_size, data_dimentions, data);
-			Feed(L"Output", output.get());
-		}
-	}
-	else
+	auto slice_dimension = input_data.GetDimension(DimensionSlice);
+	if (slice_index < slice_dimension.start_index || 
+		slice_index >= slice_dimension.start_index + slice_dimension.length)
 	{
-		Dimension channel_dimention = input_data.GetDimension(DimensionChannel);
-		unsigned int channel_block_size = input_data.GetBlockSize(DimensionChannel);
-		Dimensions dimensions;
-		dimensions(DimensionReadout, 0U, input_data.GetWidth())
-			(DimensionPhaseEncoding, 0U, input_data.GetHeight())
-			(DimensionSlice, slice_index, 1)
-			(Dimension4, 0U, input_data.GetDim4())
-			(DimensionChannel, 0U, input_data.GetCoilCount());
+		LOG_ERROR(L"<SliceSelector> SliceIndex out of range.", L"BasicRecon");
+		return false;
+	}
 
-		if (is_type_complexf)
-		{
-			complex<float>* slice_channel_data = nullptr;
-			try
-			{
-				slice_channel_data = new complex<float>[input_data.GetWidth() * input_data.GetHeight() * input_data.GetCoilCount()];
-			}
-			catch(bad_alloc&)
-			{
-				return false;
-			}	
-			for (unsigned int i = channel_dimention.start_index; i < channel_dimention.start_index + channel_dimention.length; ++i)
-			{
-				memcpy(slice_channel_data + i * slice_block_size, Yap::GetDataArray<complex<float>>(data) + slice_index * slice_block_size + i * channel_block_size, 
-					slice_block_size * sizeof(complex<float>));
-			}
-			auto outdata = CreateData<complex<float>>(data, slice_channel_data, dimensions, nullptr);
-			Feed(L"Output", outdata.get());
-		}
-		if(is_type_short)
-		{
-			short* slice_channel_data = nullptr;
-			try
-			{
-				slice_channel_data = new  short[input_data.GetWidth() * input_data.GetHeight() * input_data.GetCoilCount()];
-			}
-			catch (bad_alloc&)
-			{
-				return false;
-			}
-			for (unsigned int i = channel_dimention.start_index; i < channel_dimention.start_index + channel_dimention.length; ++i)
-			{
-				memcpy(slice_channel_data + i * slice_block_size, Yap::GetDataArray<short>(data) + slice_index * slice_block_size + i * channel_block_size,
-					slice_block_size * sizeof(short));
-			}
-			auto outdata = CreateData<short>(data, slice_channel_data, dimensions, nullptr);
-			Feed(L"Output", outdata.get());
-		}
+	Dimensions dimensions(data->GetDimensions());
+	std::vector<size_t> strides(dimensions.GetDimensionCount());
+	for (unsigned int i = 0; i < dimensions.GetDimensionCount(); ++i)
+	{
+		DimensionType type;
+		unsigned int start, length;
+		dimensions.GetDimensionInfo(i, type, start, length);
+		strides[i] = input_data.GetStride(type);
 	}
-	return true;
+	dimensions.SetDimension(DimensionSlice, 1, slice_index);
+
+	auto slice_data = Yap::GetDataArray<T>(data) +
+		(slice_index - slice_dimension.start_index) * input_data.GetStride(DimensionSlice);
+	auto output = CreateView<T>(data, slice_data, dimensions, strides, data);
+
+	return Feed(L"Output", output.get());
 }
@@ -19,6 +19,9 @@ namespace Yap
 		~SliceSelector();
 
 		virtual bool Input(const wchar_t * name, IData * data) override;
+
+		template <typename T>
+		bool FeedSlice(IData * data, unsigned int slice_index);
 	};
 }
 #endif // SliceSelector_h__
@@ -28,7 +28,7 @@ bool Yap::SubSampling::Input(const wchar_t * port, IData * data)
 {
 	if (wstring(port) == L"Mask")
 	{
-		_mask = YapShared(data);
+		_mask = RetainedData(data);
 	}
 	else if (wstring(port) == L"Input")
 	{
@@ -19,7 +19,7 @@ namespace Yap
 		void GetSubSampledData(std::complex<float> * input_data, float * mask, std::complex<float> * output_data, unsigned int width, unsigned int height);
 
 	private:
-		SmartPtr<IData> _mask;
+		RetainedData _mask;
 
 	};
 }
\ No newline at end of file
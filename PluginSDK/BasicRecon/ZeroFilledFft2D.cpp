@@ -0,0 +1,191 @@
+#include "stdafx.h"
+#include "ZeroFilledFft2D.h"
+#include "FftPlanCache.h"
+
+#include "Client/DataHelper.h"
+#include "Implement/LogUserImpl.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <string>
+
+using namespace std;
+using namespace Yap;
+
+ZeroFilledFft2D::ZeroFilledFft2D() :
+	ProcessorImpl(L"ZeroFilledFft2D")
+{
+	AddProperty<int>(L"DestWidth", 0, L"Destination width, 0 to keep the input width.");
+	AddProperty<int>(L"DestHeight", 0, L"Destination height, 0 to keep the input height.");
+	AddProperty<int>(L"Left", -1, L"X coordinate of top left corner of source data in destination data.(-1 means source data locate at center in destination)");
+	AddProperty<int>(L"Top", -1, L"Y coordinate of top left corner of source data in destination data.(-1 means source data locate at center in destination)");
+	AddProperty<bool>(L"Inverse", false, L"The direction of FFT2D.");
+	AddProperty<int>(L"Threads", 0, L"Number of threads of the transform, 0 for the default.");
+
+	AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeComplexFloat | DataTypeComplexDouble);
+	AddOutput(L"Output", YAP_ANY_DIMENSION, DataTypeComplexFloat | DataTypeComplexDouble);
+	_input_port = GetInputHandle(L"Input");
+	_output_port = GetOutputHandle(L"Output");
+
+	SetReentrant(true);
+}
+
+ZeroFilledFft2D::ZeroFilledFft2D(const ZeroFilledFft2D& rhs) :
+	ProcessorImpl(rhs),
+	_input_port(rhs._input_port),
+	_output_port(rhs._output_port)
+{
+}
+
+ZeroFilledFft2D::~ZeroFilledFft2D()
+{
+}
+
+bool ZeroFilledFft2D::Input(const wchar_t * port, IData * data)
+{
+	if (_wcsicmp(port, L"Input") != 0)
+	{
+		LOG_ERROR(L"<ZeroFilledFft2D> Error input port name!", L"BasicRecon");
+		return false;
+	}
+
+	return InputByHandle(_input_port, data);
+}
+
+bool ZeroFilledFft2D::InputByHandle(PortHandle port, IData * data)
+{
+	assert(port == _input_port);
+
+	if (data == nullptr)
+	{
+		LOG_ERROR(L"<ZeroFilledFft2D> Invalid input data!", L"BasicRecon");
+		return false;
+	}
+
+	DataHelper input_data(data);
+	if (input_data.GetDimensionCount() < 2)
+	{
+		LOG_ERROR(L"<ZeroFilledFft2D> Error input data dimention!(at least 2D data is required)!", L"BasicRecon");
+		return false;
+	}
+	if (input_data.GetDataType() != DataTypeComplexFloat && input_data.GetDataType() != DataTypeComplexDouble)
+	{
+		LOG_ERROR(L"<ZeroFilledFft2D> Error input data type!(DataTypeComplexFloat or DataTypeComplexDouble is available)!", L"BasicRecon");
+		return false;
+	}
+
+	int width = int(input_data.GetWidth());
+	int height = int(input_data.GetHeight());
+	int dest_width = GetProperty<int>(L"DestWidth");
+	int dest_height = GetProperty<int>(L"DestHeight");
+	dest_width = (dest_width == 0) ? width : dest_width;
+	dest_height = (dest_height == 0) ? height : dest_height;
+
+	int left = GetProperty<int>(L"Left");
+	int top = GetProperty<int>(L"Top");
+	left = (left < 0) ? (dest_width - width) / 2 : left;
+	top = (top < 0) ? (dest_height - height) / 2 : top;
+
+	if (left < 0 || dest_width < width + left)
+	{
+		LOG_ERROR(L"<ZeroFilledFft2D> Improper property DestWidth!(DestWidth should larger than sum of source width and property Left)", L"BasicRecon");
+		return false;
+	}
+	if (top < 0 || dest_height < height + top)
+	{
+		LOG_ERROR(L"<ZeroFilledFft2D> Improper property DestHeight!(DestHeight should larger than sum of source height and property Top)", L"BasicRecon");
+		return false;
+	}
+	if (width == 0 || height == 0)
+		return Feed(_output_port, data);
+
+	return (input_data.GetDataType() == DataTypeComplexDouble) ?
+		DoFft<double>(data, dest_width, dest_height, left, top) :
+		DoFft<float>(data, dest_width, dest_height, left, top);
+}
+
+template <typename T>
+bool ZeroFilledFft2D::DoFft(IData * data, unsigned int dest_width, unsigned int dest_height,
+	unsigned int left, unsigned int top)
+{
+	DataHelper input_data(data);
+	size_t width = input_data.GetWidth();
+	size_t height = input_data.GetHeight();
+	auto image_count = input_data.GetDataSize() / (width * height);
+
+	Dimensions dimensions(data->GetDimensions());
+	DimensionType type;
+	unsigned int start, length;
+	dimensions.GetDimensionInfo(0, type, start, length);
+	dimensions.SetDimensionInfo(0, type, 0, dest_width);
+	dimensions.GetDimensionInfo(1, type, start, length);
+	dimensions.SetDimensionInfo(1, type, 0, dest_height);
+
+	auto output = CreateOutputData<complex<T>>(_output_port, data, &dimensions);
+	auto source = GetDataArray<complex<T>>(data);
+	auto dest = GetDataArray<complex<T>>(output.get());
+
+	// fftshift along an axis of even size is a modulation of the input by +1/-1, which is
+	// applied together with the normalization while the acquired rows are copied.
+	bool modulate_columns = (dest_width % 2 == 0 || dest_width == 1);
+	bool modulate_rows = (dest_height % 2 == 0 || dest_height == 1);
+	double scale = 1.0;
+	scale /= modulate_columns ? sqrt(double(dest_width)) : 1.0;
+	scale /= modulate_rows ? sqrt(double(dest_height)) : 1.0;
+
+	auto& plans = FftPlanCache::GetInstance();
+	auto inverse = GetProperty<bool>(L"Inverse");
+	auto threads = unsigned(max(GetProperty<int>(L"Threads"), 0));
+	size_t dest_size = size_t(dest_width) * dest_height;
+
+	for (size_t image = 0; image < image_count; ++image)
+	{
+		auto image_dest = dest + image * dest_size;
+		auto band = image_dest + size_t(top) * dest_width;
+
+		memset(image_dest, 0, size_t(top) * dest_width * sizeof(complex<T>));
+		memset(band + height * dest_width, 0, (dest_height - top - height) * dest_width * sizeof(complex<T>));
+
+		for (size_t row = 0; row < height; ++row)
+		{
+			auto source_row = source + (image * height + row) * width;
+			auto dest_row = band + row * dest_width;
+			bool negative = (modulate_rows && (top + row) % 2 != 0) != (modulate_columns && left % 2 != 0);
+			auto factor = T(negative ? -scale : scale);
+
+			memset(dest_row, 0, left * sizeof(complex<T>));
+			for (size_t column = 0; column < width; ++column)
+			{
+				dest_row[left + column] = source_row[column] * factor;
+				if (modulate_columns)
+				{
+					factor = -factor;
+				}
+			}
+			memset(dest_row + left + width, 0, (dest_width - left - width) * sizeof(complex<T>));
+		}
+
+		// Rows that are all zeros stay zero after the transform along the readout.
+		if (!(modulate_columns ?
+			plans.Execute(band, band, { int(dest_width) }, inverse, int(height), threads) :
+			plans.ExecuteCentered(band, band, { int(dest_width) }, inverse, int(height), threads)))
+		{
+			LOG_ERROR(L"<ZeroFilledFft2D> Failed to create FFT plan!", L"BasicRecon");
+			return false;
+		}
+	}
+
+	// Transform along the phase encoding of all images with one strided plan.
+	vector<int> sizes{ int(image_count), int(dest_height), int(dest_width) };
+	vector<bool> axes{ false, true, false };
+	if (!(modulate_rows ?
+		plans.Execute(dest, dest, sizes, axes, inverse, threads) :
+		plans.ExecuteCentered(dest, dest, sizes, axes, inverse, threads)))
+	{
+		LOG_ERROR(L"<ZeroFilledFft2D> Failed to create FFT plan!", L"BasicRecon");
+		return false;
+	}
+
+	return Feed(_output_port, output.get());
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#ifndef ZeroFilledFft2D_h__20171030
+#define ZeroFilledFft2D_h__20171030
+
+#include "Implement/ProcessorImpl.h"
+#include <complex>
+
+namespace Yap
+{
+	/**
+	@brief Same result as ZeroFilling followed by Fft2D, without materializing the padded k-space.
+
+	Only the acquired rows are copied into the output and transformed along the readout, the
+	rows that are all zeros are skipped. The transform along the phase encoding then runs in
+	place on the output. Where the sizes allow, fftshift and normalization are folded into the
+	copy, so no extra pass over the output is needed. Dimensions after the first two are
+	transformed as a batch of images.
+	*/
+	class ZeroFilledFft2D :
+		public ProcessorImpl
+	{
+		IMPLEMENT_SHARED(ZeroFilledFft2D)
+	public:
+		ZeroFilledFft2D();
+		ZeroFilledFft2D(const ZeroFilledFft2D& rhs);
+
+	protected:
+		~ZeroFilledFft2D();
+
+		virtual bool Input(const wchar_t * port, IData * data) override;
+		virtual bool InputByHandle(PortHandle port, IData * data) override;
+
+		PortHandle _input_port;
+		PortHandle _output_port;
+
+		template <typename T>
+		bool DoFft(IData * data, unsigned int dest_width, unsigned int dest_height,
+			unsigned int left, unsigned int top);
+	};
+}
+
+#endif // ZeroFilledFft2D_h__
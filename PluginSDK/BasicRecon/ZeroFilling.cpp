@@ -41,6 +41,8 @@ ZeroFilling::ZeroFilling() : ProcessorImpl(L"ZeroFilling")
 	AddProperty<int>(L"Left", -1, L"X coordinate of top left corner of source data in destination data.(-1 means source data locate at center in destination)");
 	AddProperty<int>(L"Top", -1, L"Y coordinate of top left corner of source data in destination data.(-1 means source data locate at center in destination)");
 	AddProperty<int>(L"Front", -1, L"Z coordinate of front top left corner of source data in destination data.(-1 means source data locate at center in destination)");
+
+	SetReentrant(true);
 }
 
 ZeroFilling::ZeroFilling(const ZeroFilling& rhs)
@@ -4,17 +4,22 @@
 #include "Implement/ContainerImpl.h"
 #include "Algorithm2DWrapper.h"
 #include "CalcuArea.h"
+#include "ChannelCombiner.h"
 #include "ChannelDataCollector.h"
 #include "ChannelIterator.h"
 #include "ChannelMerger.h"
 #include "CmrDataReader.h"
+#include "CoilCompressor.h"
 #include "ComplexSplitter.h"
 #include "DataTypeConvertor.h"
 #include "DcRemover.h"
 #include "Difference.h"
+#include "FastNlm.h"
 #include "Fft1D.h"
 #include "Fft2D.h"
 #include "Fft3D.h"
+#include "FftND.h"
+#include "FftPlanCache.h"
 #include "FineCF.h"
 #include "GrayScaleUnifier.h"
 #include "imageProcessing.h"
@@ -29,12 +34,14 @@
 #include "NiuMriImageWriter.h"
 #include "NLM.h"
 #include "Nlmeans.h"
+#include "NoiseEstimator.h"
 #include "PhaseCorrector.h"
 #include "SamplingMaskCreator.h"
 #include "SliceIterator.h"
 #include "SliceMerger.h"
 #include "SliceSelector.h"
 #include "SubSampling.h"
+#include "ZeroFilledFft2D.h"
 #include "ZeroFilling.h"
 
 #include "Implement/LogUserImpl.h"
@@ -49,19 +56,31 @@ extern "C" {
 	}
 };
 
-BEGIN_DECL_PROCESSORS
+namespace
+{
+	void ReleaseModule()
+	{
+		FftPlanCache::Release();
+	}
+}
+
+BEGIN_DECL_PROCESSORS_WITH_RELEASE(ReleaseModule)
 	ADD_PROCESSOR(CalcuArea)
+	ADD_PROCESSOR(ChannelCombiner)
 	ADD_PROCESSOR(ChannelDataCollector)
 	ADD_PROCESSOR(ChannelIterator)
 	ADD_PROCESSOR(ChannelMerger)
 	ADD_PROCESSOR(CmrDataReader)
+	ADD_PROCESSOR(CoilCompressor)
 	ADD_PROCESSOR(ComplexSplitter)
 	ADD_PROCESSOR(DataTypeConvertor)
 	ADD_PROCESSOR(DcRemover)
 	ADD_PROCESSOR(Difference)
+	ADD_PROCESSOR(FastNlm)
 	ADD_PROCESSOR(Fft1D)
 	ADD_PROCESSOR(Fft2D)
 	ADD_PROCESSOR(Fft3D)
+	ADD_PROCESSOR(FftND)
 	ADD_PROCESSOR(FineCF)
 	ADD_PROCESSOR(GrayScaleUnifier)
 	ADD_PROCESSOR(JpegExporter)
@@ -75,12 +94,14 @@ BEGIN_DECL_PROCESSORS
 	ADD_PROCESSOR(NiuMriImageWriter)
 	ADD_PROCESSOR(NLM)
 	ADD_PROCESSOR(Nlmeans)
+	ADD_PROCESSOR(NoiseEstimator)
 	ADD_PROCESSOR(PhaseCorrector)
 	ADD_PROCESSOR(SamplingMaskCreator)
 	ADD_PROCESSOR(SliceIterator)
 	ADD_PROCESSOR(SliceMerger)
 	ADD_PROCESSOR(SliceSelector)
 	ADD_PROCESSOR(SubSampling)
+	ADD_PROCESSOR(ZeroFilledFft2D)
 	ADD_PROCESSOR(ZeroFilling)
 	ADD(L"HFlipFloat", new Algorithm2DInPlaceWrapper<float>(hflip<float>, L"HFlipFloat"))
 END_DECL_PROCESSORS
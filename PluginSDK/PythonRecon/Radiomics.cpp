@@ -5,7 +5,7 @@
 #include "Implement\PythonUserImpl.h"
 
 Yap::Radiomics::Radiomics() : 
-	_ref_data( YapShared<ISharedObject>(nullptr) ),
+	_ref_data(),
 	ProcessorImpl( L"Radiomics" )
 {
 	AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeAll);
@@ -35,7 +35,7 @@ bool Yap::Radiomics::Input(const wchar_t * port, IData * data)
 	VariableSpace variable(data->GetVariables());
 	if (variable.Get<bool>(L"FilesIteratorFinished"))
 	{
-		_ref_data = YapShared<ISharedObject>(nullptr);
+		_ref_data.reset();
 		PYTHON_DELETE_REF_DATA();
 		Feed(L"Output", data);
 		return true;
@@ -188,7 +188,7 @@ size_t Yap::Radiomics::GetTotalSize(size_t dimension_count, size_t size[])
 bool Yap::Radiomics::SetRefData(IData * data)
 {
 	DataHelper help_data(data);
-	_ref_data = YapShared(data);
+	_ref_data = RetainedData(data);
 
 	auto input_dims = help_data.GetActualDimensionCount();
 	if (input_dims > 4)
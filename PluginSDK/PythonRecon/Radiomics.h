@@ -32,7 +32,7 @@ namespace Yap
 		void* PythonRunScript(IData * data, OUT int & output_type, Dimensions& dimensions,
 			OUT size_t & output_dims, size_t output_size[]);
 
-		SmartPtr<IData> _ref_data;
+		RetainedData _ref_data;
 	};
 
 }
@@ -1,4 +1,5 @@
 #include "DcRemover.h"
+#include "NoiseEstimation.h"
 
 #include "Client/DataHelper.h"
 #include "Implement/LogUserImpl.h"
@@ -16,27 +17,7 @@ void RemoveDC(T * input_data,
 	bool inplace,
 	size_t corner_size)
 {
-	assert(corner_size <= width / 2 && corner_size <= height / 2 && corner_size >= 2);
-	T total = 0.0;
-
-	T * p1 = input_data;
-	T * p2 = input_data + width - corner_size;
-	T * p3 = input_data + width * (height - corner_size);
-	T * p4 = input_data + width * (height - corner_size) + width - corner_size;
-
-	for (unsigned int i = 0; i < corner_size; ++i)
-	{
-		for (unsigned int j = 0; j < corner_size; ++j)
-		{
-			total += (*p1++) + (*p2++) + (*p3++) + (*p4++);
-		}
-		p1 += (width - corner_size);
-		p2 += (width - corner_size);
-		p3 += (width - corner_size);
-		p4 += (width - corner_size);
-	}
-
-	total /= static_cast<T::value_type>(corner_size * corner_size) * 4;
+	auto total = NoiseEstimation::GetCornerMean(input_data, width, height, corner_size);
 
 	auto end = input_data + width * height;
 
@@ -65,10 +46,17 @@ DcRemover::DcRemover() :
 	AddProperty<int>(L"CornerSize", 10, L"Size of the corners used to estimate noise level.");
 
 	AddOutput(L"Output", 2, DataTypeComplexDouble | DataTypeComplexFloat);
+
+	_inplace = BindProperty<bool>(L"Inplace");
+	_corner_size = BindProperty<int>(L"CornerSize");
+
+	SetReentrant(true);
 }
 
 Yap::DcRemover::DcRemover(const DcRemover& rhs)
-	:ProcessorImpl(rhs)
+	:ProcessorImpl(rhs),
+	_inplace(rhs._inplace),
+	_corner_size(rhs._corner_size)
 {
 }
 
@@ -90,8 +78,9 @@ bool DcRemover::Input(const wchar_t * port, IData * data)
 
 	unsigned int width = input_data.GetWidth();
 	unsigned int height = input_data.GetHeight();
-	auto inplace = GetProperty<bool>(L"Inplace");
-	unsigned int corner_size = GetProperty<int>(L"CornerSize");
+	// Data shared with other consumers is never modified.
+	auto inplace = GetProperty<bool>(_inplace) && IsWritable(data);
+	unsigned int corner_size = GetProperty<int>(_corner_size);
 	if (corner_size >= height / 2 || corner_size >= width / 2 || corner_size < 2)
 		return false;
 
@@ -19,6 +19,9 @@ namespace Yap
 		~DcRemover();
 
 		virtual bool Input(const wchar_t * port, IData * data) override;
+
+		PropertyHandle _inplace;
+		PropertyHandle _corner_size;
 	};
 }
 
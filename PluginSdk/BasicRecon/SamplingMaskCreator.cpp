@@ -1,4 +1,5 @@
 ﻿#include "SamplingMaskCreator.h"
+#include "FftPlanCache.h"
 #include "Client/DataHelper.h"
 #include "Implement/LogUserImpl.h"
 
@@ -160,10 +161,13 @@ std::vector<unsigned int> Yap::SamplingMaskCreator::GetRandomSamplingPattern(
 	vector<complex<float>> normalized_sampling_pattern(pdf.size());
 	vector<complex<float>> fft_result(pdf.size());
 
-	fftwf_plan p = fftwf_plan_dft_1d(int(normalized_sampling_pattern.size()),
-		(fftwf_complex*)normalized_sampling_pattern.data(),
-		(fftwf_complex*)fft_result.data(),
-		FFTW_BACKWARD, FFTW_ESTIMATE);	//从k空间到图像是反傅里叶变换
+	fftwf_plan p = FftPlanCache::GetInstance().GetFloatPlan({ int(normalized_sampling_pattern.size()) },
+		true, false, FftPlanCache::IsAligned(normalized_sampling_pattern.data(), fft_result.data()));	//从k空间到图像是反傅里叶变换
+	if (p == nullptr)
+	{
+		LOG_ERROR(L"<SamplingMaskCreator> Failed to create FFT plan!", L"BasicRecon");
+		return min_interference_pattern;
+	}
 
 	for (unsigned int i = 0; i < _try_count; ++i)
 	{
@@ -187,7 +191,7 @@ std::vector<unsigned int> Yap::SamplingMaskCreator::GetRandomSamplingPattern(
 			normalized_sampling_pattern[t] = std::complex<float>(sampling_pattern[t] / pdf[t], 0);
 		}
 		// 傅里叶变换
-		fftwf_execute(p);
+		fftwf_execute_dft(p, (fftwf_complex*)normalized_sampling_pattern.data(), (fftwf_complex*)fft_result.data());
 		for (auto iter = fft_result.begin() + 1; iter != fft_result.end(); ++iter)
 		{
 			(*iter) /= float(sqrt(fft_result.size()));
@@ -209,8 +213,6 @@ std::vector<unsigned int> Yap::SamplingMaskCreator::GetRandomSamplingPattern(
 			min_interference_pattern = sampling_pattern;
 		}
 	}
-	//
-	fftwf_destroy_plan(p);
 	return min_interference_pattern;
 }
 
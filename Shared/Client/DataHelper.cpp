@@ -170,4 +170,30 @@ unsigned int DataHelper::GetBlockSize(DimensionType type) const
 	}
 
 	return block_size;
-}
\ No newline at end of file
+}
+
+size_t DataHelper::GetStride(DimensionType type) const
+{
+	auto strided = dynamic_cast<IStridedData*>(&_data_object);
+	if (strided == nullptr || strided->IsContiguous())
+		return GetBlockSize(type);
+
+	auto dimensions = _data_object.GetDimensions();
+	assert(dimensions != nullptr);
+
+	Dimension dimension;
+	for (unsigned int dimension_index = 0; dimension_index < dimensions->GetDimensionCount(); ++dimension_index)
+	{
+		dimensions->GetDimensionInfo(dimension_index, dimension.type, dimension.start_index, dimension.length);
+		if (dimension.type == type)
+			return strided->GetStride(dimension_index);
+	}
+
+	return GetDataSize();
+}
+
+bool DataHelper::IsContiguous() const
+{
+	auto strided = dynamic_cast<IStridedData*>(&_data_object);
+	return strided == nullptr || strided->IsContiguous();
+}
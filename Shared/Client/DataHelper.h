@@ -35,6 +35,13 @@ namespace Yap
 		size_t GetDataSize() const;
 		unsigned int GetBlockSize(DimensionType type) const;
 
+		/// Return the distance in elements between adjacent elements along the dimension.
+		/**
+			\remarks Same as GetBlockSize() unless the data is a strided view, see IStridedData.
+		*/
+		size_t GetStride(DimensionType type) const;
+		bool IsContiguous() const;
+
 		unsigned int GetSliceCount();
 		unsigned int GetCoilCount();
 		unsigned int GetDim4();
@@ -0,0 +1,449 @@
+#include "BufferPool.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+#include <new>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <malloc.h>
+#else
+#include <sys/mman.h>
+#endif
+
+using namespace std;
+using namespace Yap;
+
+/// Bookkeeping stored in the Alignment bytes in front of every buffer.
+struct BufferPool::Header
+{
+	unsigned int size_class;
+	bool huge_page;
+	void * base;
+	size_t allocated_size;
+};
+
+/// Recently freed buffers of current thread, handed back to the global cache on thread exit.
+/**
+	\remarks The mutex is only contended while BufferPool::Trim() empties the cache.
+*/
+struct BufferPool::ThreadCache
+{
+	static const size_t MaxBuffersPerClass = 4;
+	static const size_t MaxBytes = 64 * 1024 * 1024;
+
+	explicit ThreadCache(shared_ptr<BufferPool> pool_) :
+		pool{ pool_ },
+		buffers(SizeClassCount),
+		bytes{ 0 }
+	{
+		lock_guard<mutex> lock(pool->_mutex);
+		pool->_thread_caches.push_back(this);
+	}
+
+	~ThreadCache()
+	{
+		{
+			lock_guard<mutex> lock(pool->_mutex);
+			auto& caches = pool->_thread_caches;
+			caches.erase(find(caches.begin(), caches.end(), this));
+		}
+
+		for (auto buffer : Take())
+		{
+			pool->PushGlobal(buffer);
+		}
+	}
+
+	void * Pop(unsigned int size_class)
+	{
+		auto size = GetClassSize(size_class);
+		lock_guard<mutex> lock(cache_mutex);
+		auto& cached = buffers[size_class];
+		if (cached.empty())
+			return nullptr;
+
+		auto buffer = cached.back();
+		cached.pop_back();
+		bytes -= size;
+		pool->_thread_cached_bytes -= size;
+
+		return buffer;
+	}
+
+	bool Push(void * buffer, unsigned int size_class)
+	{
+		auto size = GetClassSize(size_class);
+		lock_guard<mutex> lock(cache_mutex);
+		auto& cached = buffers[size_class];
+		if (cached.size() >= MaxBuffersPerClass || bytes + size > pool->_thread_cache_limit)
+			return false;
+
+		// The thread caches and the global cache share the limit of the pool.
+		auto thread_cached_bytes = (pool->_thread_cached_bytes += size);
+		if (thread_cached_bytes + pool->_cached_bytes > pool->_cache_limit)
+		{
+			pool->_thread_cached_bytes -= size;
+			return false;
+		}
+
+		cached.push_back(buffer);
+		bytes += size;
+
+		return true;
+	}
+
+	/// Remove all buffers from the cache.
+	vector<void*> Take()
+	{
+		vector<void*> taken;
+		lock_guard<mutex> lock(cache_mutex);
+		for (auto& size_class : buffers)
+		{
+			taken.insert(taken.end(), size_class.begin(), size_class.end());
+			size_class.clear();
+		}
+		pool->_thread_cached_bytes -= bytes;
+		bytes = 0;
+
+		return taken;
+	}
+
+	static ThreadCache& Get()
+	{
+		static thread_local ThreadCache cache(s_instance);
+		return cache;
+	}
+
+	shared_ptr<BufferPool> pool;
+	mutex cache_mutex;
+	vector<vector<void*>> buffers;
+	size_t bytes;
+};
+
+namespace
+{
+	thread_local unsigned long long t_allocations = 0;
+	thread_local unsigned long long t_allocated_bytes = 0;
+
+	size_t GetDefaultCacheLimit()
+	{
+		auto setting = getenv("YAP_POOL_LIMIT_MB");
+		size_t limit_mb = (setting != nullptr) ? static_cast<size_t>(atoi(setting)) : 512;
+
+		return limit_mb * 1024 * 1024;
+	}
+
+	bool GetDefaultHugePages()
+	{
+		auto setting = getenv("YAP_HUGE_PAGES");
+		return setting != nullptr && atoi(setting) != 0;
+	}
+}
+
+shared_ptr<BufferPool> BufferPool::s_instance;
+once_flag BufferPool::s_instance_flag;
+
+BufferPool& BufferPool::GetInstance()
+{
+	call_once(s_instance_flag, []() {
+		s_instance = shared_ptr<BufferPool>(new BufferPool);
+	});
+
+	return *s_instance;
+}
+
+BufferPool::BufferPool() :
+	_free_buffers(SizeClassCount),
+	_cached_bytes{ 0 },
+	_thread_cached_bytes{ 0 },
+	_cache_limit{ GetDefaultCacheLimit() },
+	_thread_cache_limit{ GetThreadCacheLimit(_cache_limit) },
+	_huge_pages{ GetDefaultHugePages() },
+	_allocations{ 0 },
+	_reused{ 0 }
+{
+}
+
+BufferPool::~BufferPool()
+{
+	Trim();
+}
+
+BufferPool::Header * BufferPool::GetHeader(const void * buffer)
+{
+	return reinterpret_cast<Header*>(reinterpret_cast<char*>(const_cast<void*>(buffer)) - Alignment);
+}
+
+/**
+	Map a size to its size class. Class 0 holds buffers up to 256 bytes, above that every power
+	of two is split into four classes, so at most 25% of a buffer is wasted.
+*/
+unsigned int BufferPool::GetSizeClass(size_t bytes)
+{
+	if (bytes <= 256)
+		return 0;
+
+	unsigned int shift = 8;
+	while ((size_t(1) << (shift + 1)) < bytes)
+	{
+		++shift;
+	}
+
+	size_t step = size_t(1) << (shift - 2);
+	auto quarter = static_cast<unsigned int>((bytes - (size_t(1) << shift) + step - 1) / step);
+	assert(quarter >= 1 && quarter <= 4);
+
+	return 1 + (shift - 8) * 4 + (quarter - 1);
+}
+
+size_t BufferPool::GetClassSize(unsigned int size_class)
+{
+	if (size_class == 0)
+		return 256;
+
+	unsigned int shift = 8 + (size_class - 1) / 4;
+	size_t quarter = (size_class - 1) % 4 + 1;
+
+	return (size_t(1) << shift) + quarter * (size_t(1) << (shift - 2));
+}
+
+void * BufferPool::Allocate(size_t bytes)
+{
+	auto size_class = GetSizeClass(bytes);
+	if (size_class >= SizeClassCount)
+		throw bad_alloc();
+
+	++_allocations;
+	++t_allocations;
+	t_allocated_bytes += bytes;
+
+	auto buffer = ThreadCache::Get().Pop(size_class);
+	if (buffer == nullptr)
+	{
+		buffer = PopGlobal(size_class);
+	}
+
+	if (buffer != nullptr)
+	{
+		++_reused;
+		return buffer;
+	}
+
+	return AllocateFromSystem(size_class);
+}
+
+void BufferPool::Free(void * buffer)
+{
+	if (buffer == nullptr)
+		return;
+
+	auto size_class = GetHeader(buffer)->size_class;
+	if (!ThreadCache::Get().Push(buffer, size_class))
+	{
+		PushGlobal(buffer);
+	}
+}
+
+size_t BufferPool::GetThreadCacheLimit(size_t cache_limit)
+{
+	return (cache_limit / 8 < ThreadCache::MaxBytes) ? cache_limit / 8 : size_t(ThreadCache::MaxBytes);
+}
+
+size_t BufferPool::GetCapacity(const void * buffer)
+{
+	assert(buffer != nullptr);
+	return GetClassSize(GetHeader(buffer)->size_class);
+}
+
+void * BufferPool::PopGlobal(unsigned int size_class)
+{
+	lock_guard<mutex> lock(_mutex);
+	auto& cached = _free_buffers[size_class];
+	if (cached.empty())
+		return nullptr;
+
+	auto buffer = cached.back();
+	cached.pop_back();
+	_cached_bytes -= GetClassSize(size_class);
+
+	return buffer;
+}
+
+void BufferPool::PushGlobal(void * buffer)
+{
+	auto size_class = GetHeader(buffer)->size_class;
+	auto size = GetClassSize(size_class);
+	{
+		lock_guard<mutex> lock(_mutex);
+		if (_cached_bytes + _thread_cached_bytes + size <= _cache_limit)
+		{
+			_free_buffers[size_class].push_back(buffer);
+			_cached_bytes += size;
+			return;
+		}
+	}
+
+	FreeToSystem(buffer);
+}
+
+void * BufferPool::AllocateFromSystem(unsigned int size_class)
+{
+	static_assert(sizeof(Header) <= Alignment, "Header must fit in front of the buffer.");
+
+	size_t size = GetClassSize(size_class) + Alignment;
+	void * base = nullptr;
+	bool huge_page = false;
+
+	if (_huge_pages && size >= HugePageThreshold)
+	{
+#ifdef _WIN32
+		// Requires SeLockMemoryPrivilege, fall back to normal pages if it's not granted.
+		size_t large_page = GetLargePageMinimum();
+		if (large_page != 0)
+		{
+			size_t huge_size = (size + large_page - 1) / large_page * large_page;
+			base = VirtualAlloc(nullptr, huge_size, MEM_RESERVE | MEM_COMMIT | MEM_LARGE_PAGES, PAGE_READWRITE);
+			if (base != nullptr)
+			{
+				size = huge_size;
+				huge_page = true;
+			}
+		}
+#else
+		const size_t huge_page_size = 2 * 1024 * 1024;
+		size_t huge_size = (size + huge_page_size - 1) / huge_page_size * huge_page_size;
+		base = mmap(nullptr, huge_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (base == MAP_FAILED)
+		{
+			base = nullptr;
+		}
+		else
+		{
+#ifdef MADV_HUGEPAGE
+			madvise(base, huge_size, MADV_HUGEPAGE);
+#endif
+			size = huge_size;
+			huge_page = true;
+		}
+#endif
+	}
+
+	if (base == nullptr)
+	{
+#ifdef _WIN32
+		base = _aligned_malloc(size, Alignment);
+#else
+		if (posix_memalign(&base, Alignment, size) != 0)
+		{
+			base = nullptr;
+		}
+#endif
+	}
+
+	if (base == nullptr)
+		throw bad_alloc();
+
+	auto header = reinterpret_cast<Header*>(base);
+	header->size_class = size_class;
+	header->huge_page = huge_page;
+	header->base = base;
+	header->allocated_size = size;
+
+	return reinterpret_cast<char*>(base) + Alignment;
+}
+
+void BufferPool::FreeToSystem(void * buffer)
+{
+	auto header = GetHeader(buffer);
+	auto base = header->base;
+
+	if (header->huge_page)
+	{
+#ifdef _WIN32
+		VirtualFree(base, 0, MEM_RELEASE);
+#else
+		munmap(base, header->allocated_size);
+#endif
+	}
+	else
+	{
+#ifdef _WIN32
+		_aligned_free(base);
+#else
+		free(base);
+#endif
+	}
+}
+
+void BufferPool::SetHugePages(bool enable)
+{
+	_huge_pages = enable;
+}
+
+bool BufferPool::GetHugePages() const
+{
+	return _huge_pages;
+}
+
+void BufferPool::SetCacheLimit(size_t bytes)
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_cache_limit = bytes;
+		_thread_cache_limit = GetThreadCacheLimit(bytes);
+		if (_cached_bytes + _thread_cached_bytes <= _cache_limit)
+			return;
+	}
+
+	Trim();
+}
+
+void BufferPool::Trim()
+{
+	vector<void*> buffers;
+	{
+		lock_guard<mutex> lock(_mutex);
+		for (auto& size_class : _free_buffers)
+		{
+			buffers.insert(buffers.end(), size_class.begin(), size_class.end());
+			size_class.clear();
+		}
+		_cached_bytes = 0;
+
+		// Caches of threads which are idle would otherwise keep their buffers indefinitely.
+		for (auto cache : _thread_caches)
+		{
+			auto taken = cache->Take();
+			buffers.insert(buffers.end(), taken.begin(), taken.end());
+		}
+	}
+
+	for (auto buffer : buffers)
+	{
+		FreeToSystem(buffer);
+	}
+}
+
+BufferPool::Statistics BufferPool::GetStatistics() const
+{
+	Statistics statistics;
+	statistics.allocations = _allocations;
+	statistics.reused = _reused;
+
+	statistics.cached_bytes = _cached_bytes;
+	statistics.thread_cached_bytes = _thread_cached_bytes;
+
+	return statistics;
+}
+
+unsigned long long BufferPool::GetThreadAllocations()
+{
+	return t_allocations;
+}
+
+unsigned long long BufferPool::GetThreadAllocatedBytes()
+{
+	return t_allocated_bytes;
+}
@@ -0,0 +1,120 @@
+#pragma once
+
+#ifndef BufferPool_h__20171016
+#define BufferPool_h__20171016
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Yap
+{
+	/**
+	@brief Size-class buffer pool used for payloads of data objects.
+
+	Reconstruction pipelines allocate and free buffers of the same few sizes for every slice
+	or channel. BufferPool keeps freed buffers in size classes (four classes per power of two)
+	so that steady-state pipelines reuse already faulted-in memory instead of going to the heap.
+
+	All buffers are aligned to BufferPool::Alignment bytes, which is enough for AVX-512 and
+	lets FFTW use aligned plans. Buffers of at least HugePageThreshold bytes can optionally be
+	backed by huge (large) pages, see SetHugePages().
+
+	Each thread keeps a small cache of recently freed buffers; buffers overflowing the thread
+	cache go to a global cache. SetCacheLimit() bounds the global cache and the thread caches
+	together, and Trim() empties both. Buffers can be freed in any thread.
+
+	@remarks Like ExecutionEngine, each module which links Implement owns its own pool.
+	A buffer must be freed by the module which allocated it, which is always the case for
+	data objects since they are deleted by their own Release().
+	*/
+	class BufferPool
+	{
+	public:
+		static const size_t Alignment = 64;
+		static const size_t HugePageThreshold = 2 * 1024 * 1024;
+
+		struct Statistics
+		{
+			unsigned long long allocations;		///< Number of calls to Allocate().
+			unsigned long long reused;			///< Allocations served from one of the caches.
+			unsigned long long cached_bytes;	///< Bytes currently held in the global cache.
+			unsigned long long thread_cached_bytes;	///< Bytes currently held in the caches of all threads.
+		};
+
+		static BufferPool& GetInstance();
+		~BufferPool();
+
+		/// Allocate an aligned buffer of at least the given size.
+		void * Allocate(size_t bytes);
+
+		/// Return a buffer allocated by Allocate() to the pool.
+		void Free(void * buffer);
+
+		template <typename T>
+		T * Allocate(size_t count)
+		{
+			return reinterpret_cast<T*>(Allocate(count * sizeof(T)));
+		}
+
+		/// Return the usable size of a buffer allocated by Allocate().
+		static size_t GetCapacity(const void * buffer);
+
+		/// Enable huge page backing for large buffers, default is taken from YAP_HUGE_PAGES.
+		void SetHugePages(bool enable);
+		bool GetHugePages() const;
+
+		/// Maximum number of bytes kept in the global and thread caches, default 512 MB or YAP_POOL_LIMIT_MB.
+		/**
+			\remarks A thread cache holds at most an eighth of the limit, and never more than 64 MB.
+		*/
+		void SetCacheLimit(size_t bytes);
+
+		/// Release all buffers in the global cache and in the caches of all threads back to the system.
+		void Trim();
+
+		Statistics GetStatistics() const;
+
+		/// Number of buffers allocated by the calling thread from the pool of this module.
+		static unsigned long long GetThreadAllocations();
+		static unsigned long long GetThreadAllocatedBytes();
+
+	protected:
+		BufferPool();
+
+		struct Header;
+		struct ThreadCache;
+
+		static Header * GetHeader(const void * buffer);
+		static unsigned int GetSizeClass(size_t bytes);
+		static size_t GetClassSize(unsigned int size_class);
+
+		void * AllocateFromSystem(unsigned int size_class);
+		void FreeToSystem(void * buffer);
+
+		void * PopGlobal(unsigned int size_class);
+		void PushGlobal(void * buffer);
+
+		static size_t GetThreadCacheLimit(size_t cache_limit);
+
+		static const unsigned int SizeClassCount = 4 * 48;
+
+		std::vector<std::vector<void*>> _free_buffers;
+		std::vector<ThreadCache*> _thread_caches;	///< Caches of all threads, guarded by _mutex.
+		mutable std::mutex _mutex;
+		std::atomic<size_t> _cached_bytes;			///< Written with _mutex locked.
+		std::atomic<size_t> _thread_cached_bytes;
+		std::atomic<size_t> _cache_limit;
+		std::atomic<size_t> _thread_cache_limit;
+
+		std::atomic<bool> _huge_pages;
+		std::atomic<unsigned long long> _allocations;
+		std::atomic<unsigned long long> _reused;
+
+		static std::shared_ptr<BufferPool> s_instance;
+		static std::once_flag s_instance_flag;
+	};
+}
+
+#endif // BufferPool_h__
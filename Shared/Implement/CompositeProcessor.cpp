@@ -1,5 +1,10 @@
 #include "CompositeProcessor.h"
+#include "LinkQueue.h"
 
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
 #include <utility>
 
 using namespace Yap;
@@ -8,22 +13,96 @@ using namespace std;
 CompositeProcessor::CompositeProcessor(const wchar_t * class_id) :
 	ProcessorImpl(class_id)
 {
+	// Inputs are forwarded to inner processors, which are serialized individually.
+	SetReentrant(true);
+
+	auto statistics_file = getenv("YAP_PROFILE_FILE");
+	if (statistics_file != nullptr)
+	{
+		_statistics_file = wstring(statistics_file, statistics_file + strlen(statistics_file));
+	}
 }
 
 CompositeProcessor::~CompositeProcessor()
 {
+	if (!_statistics_file.empty() && GetStatistics() != nullptr)
+	{
+		wofstream file(string(_statistics_file.begin(), _statistics_file.end()));
+		if (file)
+		{
+			file << GetStatisticsJson() << endl;
+		}
+	}
 }
 
 Yap::CompositeProcessor::CompositeProcessor(const CompositeProcessor& rhs) :
-	ProcessorImpl(rhs.GetClassId())
+	ProcessorImpl(rhs)
 {
+	map<IProcessor*, IProcessor*> clones;	// <source processor, cloned processor>
+
+	// LinkQueues are created after the processors they feed.
+	for (auto processor : rhs._processors)
+	{
+		if (dynamic_cast<LinkQueue*>(processor.second.get()) != nullptr)
+			continue;
+
+		auto clone = dynamic_cast<IProcessor*>(processor.second->Clone());
+		if (clone == nullptr)
+			throw bad_alloc();
+
+		_processors.insert(make_pair(processor.first, YapShared(clone)));
+		clones.insert(make_pair(processor.second.get(), clone));
+	}
+
+	for (auto processor : rhs._processors)
+	{
+		auto queue = dynamic_cast<LinkQueue*>(processor.second.get());
+		if (queue == nullptr)
+			continue;
+
+		auto next = clones.find(queue->GetNext());
+		if (next == clones.end())
+			throw logic_error("LinkQueue feeding a processor outside of the pipeline can't be cloned.");
+
+		auto clone = new LinkQueue(next->second, queue->GetNextPort(), queue->GetCapacity(), queue->GetPolicy());
+		clone->SetInstanceId(queue->GetInstanceId());
+
+		_processors.insert(make_pair(processor.first, YapShared<IProcessor>(clone)));
+		clones.insert(make_pair(processor.second.get(), clone));
+	}
 
+	for (auto processor : rhs._processors)
+	{
+		auto source = dynamic_cast<ProcessorImpl*>(processor.second.get());
+		auto clone = dynamic_cast<ProcessorImpl*>(clones[processor.second.get()]);
+		if (source != nullptr && clone != nullptr && !clone->CopyLinks(*source, clones))
+			throw logic_error("Failed to link cloned processors.");
+	}
+
+	for (auto& input : rhs._inputs)
+	{
+		_inputs.insert(make_pair(input.first, Anchor(clones[input.second.processor], input.second.port.c_str())));
+	}
+
+	for (auto& output : rhs._output)
+	{
+		_output.insert(make_pair(output.first, Anchor(clones[output.second.processor], output.second.port.c_str())));
+	}
+
+	CopyLinks(rhs, clones);
+	ResolveLinks();
 }
 
 Yap::IProcessor * Yap::CompositeProcessor::Clone()  const
 {
-	NOT_IMPLEMENTED
-	throw std::logic_error("The method or operation is not implemented.");
+	try
+	{
+		return new CompositeProcessor(*this);
+	}
+	catch (std::exception&)
+	{
+		return nullptr;
+	}
 }
 
 bool Yap::CompositeProcessor::SetGlobalVariables(IVariableContainer * params)
@@ -54,7 +133,7 @@ bool Yap::CompositeProcessor::Input(const wchar_t * port, IData * data)
 	if (iter == _inputs.end())
 		return false;
 
-	return iter->second.processor->Input(iter->second.port.c_str(), data);
+	return InputTo(iter->second.processor, iter->second.port.c_str(), data);
 }
 
 bool Yap::CompositeProcessor::MapInput(const wchar_t * port, 
@@ -76,7 +155,7 @@ bool Yap::CompositeProcessor::MapOutput(const wchar_t * port,
 	const wchar_t * inner_processor, 
 	const wchar_t * inner_port)
 {
-	if (_output.find(port) == _output.end())
+	if (_output.find(port) != _output.end())
 		return false;
 
 	auto processor = Find(inner_processor);
@@ -106,3 +185,68 @@ IProcessor * Yap::CompositeProcessor::Find(const wchar_t * instance_id)
 
 	return iter->second.get();
 }
+
+void Yap::CompositeProcessor::ResolveLinks()
+{
+	ProcessorImpl::ResolveLinks();
+
+	for (auto processor : _processors)
+	{
+		auto processor_impl = dynamic_cast<ProcessorImpl*>(processor.second.get());
+		if (processor_impl != nullptr)
+		{
+			processor_impl->ResolveLinks();
+		}
+	}
+}
+
+void Yap::CompositeProcessor::EnableStatistics(bool enable)
+{
+	ProcessorImpl::EnableStatistics(enable);
+
+	for (auto processor : _processors)
+	{
+		auto processor_impl = dynamic_cast<ProcessorImpl*>(processor.second.get());
+		if (processor_impl != nullptr)
+		{
+			processor_impl->EnableStatistics(enable);
+		}
+	}
+}
+
+bool Yap::CompositeProcessor::GetProcessorStatistics(const wchar_t * instance_id, 
+	ProcessorStatistics::Snapshot& snapshot)
+{
+	auto processor_impl = dynamic_cast<ProcessorImpl*>(Find(instance_id));
+	if (processor_impl == nullptr || processor_impl->GetStatistics() == nullptr)
+		return false;
+
+	snapshot = processor_impl->GetStatistics()->GetSnapshot();
+	return true;
+}
+
+std::wstring Yap::CompositeProcessor::GetStatisticsJson()
+{
+	wostringstream output;
+	output << L"{";
+
+	bool first = true;
+	for (auto processor : _processors)
+	{
+		ProcessorStatistics::Snapshot snapshot;
+		if (!GetProcessorStatistics(processor.first.c_str(), snapshot))
+			continue;
+
+		output << (first ? L"\n" : L",\n") << L"  \"" << processor.first << L"\": "
+			<< ProcessorStatistics::ToJson(snapshot);
+		first = false;
+	}
+	output << L"\n}";
+
+	return output.str();
+}
+
+void Yap::CompositeProcessor::SetStatisticsFile(const wchar_t * path)
+{
+	_statistics_file = (path != nullptr) ? path : L"";
+}
@@ -12,6 +12,12 @@
 
 namespace Yap
 {
+	/**
+	@brief Processor made of other processors, used to implement pipelines.
+
+	Clone() makes a deep copy: the inner processors are cloned and linked like the originals,
+	with the same property mappings. Global variables have to be set for the clone.
+	*/
 	class CompositeProcessor :
 		public ProcessorImpl  
 	{
@@ -32,6 +38,24 @@ namespace Yap
 
 		bool AddProcessor(IProcessor * processor);
 		IProcessor * Find(const wchar_t * instance_id);
+
+		/// Resolve the links of the pipeline and all processors in it.
+		virtual void ResolveLinks() override;
+
+		/// Enable or disable statistics of the pipeline and all processors in it.
+		virtual void EnableStatistics(bool enable) override;
+
+		/// Get statistics of the inner processor with the given instance id.
+		bool GetProcessorStatistics(const wchar_t * instance_id, ProcessorStatistics::Snapshot& snapshot);
+
+		/// Return statistics of all inner processors as a JSON object keyed by instance id.
+		std::wstring GetStatisticsJson();
+
+		/// Statistics are written to this file when the pipeline is destroyed.
+		/**
+			Defaults to the value of environment variable YAP_PROFILE_FILE.
+		*/
+		void SetStatisticsFile(const wchar_t * path);
 	protected:
         virtual ~CompositeProcessor();
 
@@ -39,6 +63,7 @@ namespace Yap
 		std::map<std::wstring, Anchor> _output;
 		std::map<std::wstring, Anchor> _inputs;
 
+		std::wstring _statistics_file;
 	};
 
 	typedef CompositeProcessor Pipeline;
@@ -2,7 +2,11 @@
 
 #include <complex>
 #include <vector>
+#include <memory>
+#include <type_traits>
+#include <atomic>
 #include "Interface/Interfaces.h"
+#include "BufferPool.h"
 #include <assert.h>
 
 namespace Yap
@@ -105,7 +109,9 @@ namespace Yap
 
 	template<typename T>
 	class DataObject :
-		public IDataArray<T>
+		public IDataArray<T>,
+		public IStridedData,
+		public IWritableData
 	{
 		IMPLEMENT_CLONE(DataObject<T>)
 	public:
@@ -135,6 +141,36 @@ namespace Yap
 			assert(data != nullptr);
 		}
 
+		/// Create a view into the memory of the parent.
+		/**
+			\remarks Elements are located using the strides (in elements) of the dimensions.
+			If the strides describe a contiguous block, the view is an ordinary data object.
+		*/
+		DataObject(IData * reference, T * data, const Dimensions& dimensions,
+			const std::vector<size_t>& strides, ISharedObject * parent, ISharedObject * module = nullptr) :
+			_data(data),
+			_dimensions(dimensions),
+			_parent(YapShared(parent)),
+			_module(YapShared(module)),
+			_geometry{ YapShared(reference != nullptr ? new Localization(reference->GetGeometry()) : nullptr) },
+			_variables{ YapShared(reference != nullptr ? reference->GetVariables() : nullptr) }
+		{
+			assert(data != nullptr && parent != nullptr);
+			assert(strides.size() == _dimensions.GetDimensionCount());
+
+			size_t contiguous_stride = 1;
+			for (unsigned int i = 0; i < _dimensions.GetDimensionCount(); ++i)
+			{
+				auto length = _dimensions.GetLength(i);
+				if (length > 1 && strides[i] != contiguous_stride)
+				{
+					_strides = strides;
+					break;
+				}
+				contiguous_stride *= length;
+			}
+		}
+
 		DataObject(IData * reference, IDimensions * dimensions, ISharedObject * module) :
 			_dimensions(dimensions),
 			_module(module),
@@ -148,13 +184,13 @@ namespace Yap
 				total_size *= _dimensions.GetLength(i);
 			}
 
-			_data = new T[total_size];
+			_data = AllocateData(total_size);
 		}
 
 		/// Copy constructor
 		/**
 			\remarks  Deep copy a data object. The new object will own the copied data
-			even if the rhs does not own its data.
+			even if the rhs does not own its data. A strided view is copied into contiguous memory.
 		*/
 		DataObject(const DataObject& rhs, ISharedObject * module = nullptr) :
 			_dimensions{ rhs._dimensions },
@@ -169,8 +205,15 @@ namespace Yap
 				total_size *= _dimensions.GetLength(i);
 			}
 
-			_data = new T[total_size];
-			memcpy(_data, rhs._data, total_size * sizeof(T));
+			_data = AllocateData(total_size);
+			if (rhs._strides.empty())
+			{
+				memcpy(_data, rhs._data, total_size * sizeof(T));
+			}
+			else if (_dimensions.GetDimensionCount() > 0)
+			{
+				CopyStrided(_data, rhs._data, _dimensions.GetDimensionCount() - 1, rhs._strides);
+			}
 		}
 
 		DataObject(IVariableContainer * variables, ISharedObject * module) :
@@ -193,16 +236,60 @@ namespace Yap
 			return _data;
 		}
 
+		virtual size_t GetStride(unsigned int dimension_index) override
+		{
+			assert(dimension_index < _dimensions.GetDimensionCount());
+			if (!_strides.empty())
+				return _strides[dimension_index];
+
+			size_t stride = 1;
+			for (unsigned int i = 0; i < dimension_index; ++i)
+			{
+				stride *= _dimensions.GetLength(i);
+			}
+
+			return stride;
+		}
+
+		virtual bool IsContiguous() override
+		{
+			return _strides.empty();
+		}
+
+		virtual void Share() override
+		{
+			_share_count.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		virtual void Unshare() override
+		{
+			assert(_share_count.load(std::memory_order_relaxed) > 0);
+			_share_count.fetch_sub(1, std::memory_order_release);
+		}
+
+		/// A view is exclusive only if its parent is not shared either.
+		virtual bool IsExclusive() override
+		{
+			if (_share_count.load(std::memory_order_acquire) != 0)
+				return false;
+
+			if (!_parent)
+				return true;
+
+			auto parent = dynamic_cast<IWritableData*>(_parent.get());
+			return parent != nullptr && parent->IsExclusive();
+		}
+
 		virtual void Lock() override
 		{
-			++_use_count;
+			_use_count.Increment();
 		}
 
 		virtual void Release() override
 		{
-			assert(_use_count > 0 && "Logic error. Forget to Lock()?");
+			assert(_use_count.Get() > 0 && "Logic error. Forget to Lock()?");
 
-			if (_use_count == 0 || --_use_count == 0)
+			if (_use_count.Decrement())
 			{
 				delete this;
 			}
@@ -290,6 +377,19 @@ namespace Yap
 			}
 		}
 
+		static SmartPtr<DataObject<T>> CreateView(IData * reference, T * data, const Dimensions& dimensions,
+			const std::vector<size_t>& strides, ISharedObject * parent, ISharedObject * module = nullptr)
+		{
+			try
+			{
+				return YapShared(new DataObject<T>(reference, data, dimensions, strides, parent, module));
+			}
+			catch (std::bad_alloc&)
+			{
+				return YapShared<DataObject<T>>(nullptr);
+			}
+		}
+
 		/**
 		\remarks  Deep copy a data object. The new object will own the copied data
 		even if the rhs does not own its data.
@@ -309,22 +409,74 @@ namespace Yap
 	private:
 		~DataObject()
 		{
-			if (!_parent)
+			if (_pooled)
+			{
+				BufferPool::GetInstance().Free(_data);
+				_data = nullptr;
+			}
+			else if (!_parent)
 			{
 				delete[]_data;
 				_data = nullptr;
 			}
 		}
 
+		/// Allocates an aligned buffer from the pool, elements are constructed as with new T[].
+		T * AllocateData(size_t count)
+		{
+			static_assert(std::is_trivially_destructible<T>::value, "Pooled elements are not destroyed.");
+
+			auto data = BufferPool::GetInstance().Allocate<T>(count);
+			if (!std::is_trivially_default_constructible<T>::value)
+			{
+				std::uninitialized_fill_n(data, count, T());
+			}
+			_pooled = true;
+
+			return data;
+		}
+
+		/// Copies the elements of a strided view to contiguous memory, returns the end of the copied data.
+		T * CopyStrided(T * destination, const T * source, unsigned int dimension_index,
+			const std::vector<size_t>& strides)
+		{
+			auto length = _dimensions.GetLength(dimension_index);
+			auto stride = strides[dimension_index];
+
+			if (dimension_index == 0)
+			{
+				if (stride == 1)
+				{
+					memcpy(destination, source, length * sizeof(T));
+					return destination + length;
+				}
+
+				for (unsigned int i = 0; i < length; ++i)
+				{
+					*destination++ = source[i * stride];
+				}
+				return destination;
+			}
+
+			for (unsigned int i = 0; i < length; ++i)
+			{
+				destination = CopyStrided(destination, source + i * stride, dimension_index - 1, strides);
+			}
+			return destination;
+		}
+
 		virtual int GetDataType() override
 		{
 			return data_type_id<T>::type;
 		}
 
 		T * _data = nullptr;
+		bool _pooled = false;	///< true if _data was allocated from BufferPool.
 		Dimensions _dimensions;
+		std::vector<size_t> _strides;	///< Empty unless the object is a non-contiguous view.
 
-		unsigned int _use_count = 0;
+		ReferenceCount _use_count;
+		std::atomic<unsigned int> _share_count{ 0 };	///< Number of Feed() calls sharing the data.
 
 		SmartPtr<ISharedObject> _parent;	// default to null pointer
 		SmartPtr<ISharedObject> _module;	// default to null pointer
@@ -0,0 +1,458 @@
+#include "ExecutionEngine.h"
+#include "ProcessorStatistics.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+
+using namespace std;
+using namespace Yap;
+
+namespace
+{
+	/// Index of the worker running on current thread, -1 for threads outside the pool.
+	thread_local int t_worker_index = -1;
+	thread_local ExecutionEngine * t_worker_engine = nullptr;
+
+	/// Group of the task running on current thread.
+	thread_local TaskGroup * t_current_group = nullptr;
+
+	unsigned int GetDefaultThreadCount()
+	{
+		auto setting = getenv("YAP_THREADS");
+		if (setting == nullptr)
+			return 0;
+
+		int thread_count = atoi(setting);
+		if (thread_count < 0)
+		{
+			// negative value means 'use all cores'.
+			return thread::hardware_concurrency();
+		}
+
+		return static_cast<unsigned int>(thread_count);
+	}
+}
+
+shared_ptr<ExecutionEngine> ExecutionEngine::s_instance;
+once_flag ExecutionEngine::s_instance_flag;
+atomic<IExecutionEngine*> ExecutionEngine::s_host{ nullptr };
+ExecutionEngine::User ExecutionEngine::s_user;
+
+ExecutionEngine& ExecutionEngine::GetInstance()
+{
+	call_once(s_instance_flag, []() {
+		s_instance = shared_ptr<ExecutionEngine>(new ExecutionEngine);
+		if (s_host == nullptr)
+		{
+			s_instance->SetThreadCount(GetDefaultThreadCount());
+		}
+	});
+
+	return *s_instance;
+}
+
+IExecutionEngineUser& ExecutionEngine::GetUser()
+{
+	return s_user;
+}
+
+void ExecutionEngine::User::SetExecutionEngine(IExecutionEngine * engine)
+{
+	if (engine == s_instance.get())
+	{
+		engine = nullptr;
+	}
+
+	// Workers of this module are no longer needed, the tasks queued to them are run here.
+	if (engine != nullptr && s_instance)
+	{
+		assert(!s_instance->IsOwnWorkerThread() && "Engine can't be replaced from a worker thread.");
+
+		lock_guard<mutex> lock(s_instance->_config_mutex);
+		s_instance->Stop();
+	}
+	s_host = engine;
+}
+
+ExecutionEngine::ExecutionEngine() :
+	_queued{ 0 },
+	_running{ false }
+{
+}
+
+ExecutionEngine::~ExecutionEngine()
+{
+	assert(_threads.empty());
+}
+
+void ExecutionEngine::Shutdown()
+{
+	// The engine of the host outlives this module, it's only detached.
+	s_host = nullptr;
+	if (!s_instance)
+		return;
+
+	assert(!s_instance->IsOwnWorkerThread() && "Engine can't be shut down from a worker thread.");
+
+	lock_guard<mutex> lock(s_instance->_config_mutex);
+	s_instance->Stop();
+}
+
+void ExecutionEngine::SetThreadCount(unsigned int thread_count)
+{
+	assert(!IsWorkerThread() && "Thread count can't be changed from a worker thread.");
+
+	lock_guard<mutex> lock(_config_mutex);
+	if (s_host != nullptr)
+		return;
+
+	if (thread_count <= 1)
+	{
+		thread_count = 0;
+	}
+
+	if (thread_count == _threads.size())
+		return;
+
+	Stop();
+
+	if (thread_count == 0)
+		return;
+
+	_workers.clear();
+	for (unsigned int i = 0; i < thread_count; ++i)
+	{
+		_workers.push_back(unique_ptr<Worker>(new Worker));
+	}
+
+	_running = true;
+	for (unsigned int i = 0; i < thread_count; ++i)
+	{
+		// Each worker keeps the engine alive, so that static destruction never has to join them.
+		auto self = shared_from_this();
+		_threads.push_back(thread([self, i]() { self->WorkerProc(i); }));
+	}
+}
+
+unsigned int ExecutionEngine::GetThreadCount() const
+{
+	auto host = s_host.load();
+	return (host != nullptr) ? host->GetThreadCount() : static_cast<unsigned int>(_threads.size());
+}
+
+bool ExecutionEngine::IsEnabled() const
+{
+	auto host = s_host.load();
+	return (host != nullptr) ? host->IsEnabled() : _running.load();
+}
+
+bool ExecutionEngine::IsWorkerThread() const
+{
+	// Workers of the host are recognized by the host, thread local variables are per module.
+	auto host = s_host.load();
+	return (host != nullptr) ? host->IsWorkerThread() : IsOwnWorkerThread();
+}
+
+bool ExecutionEngine::IsOwnWorkerThread() const
+{
+	return t_worker_engine == this && t_worker_index >= 0;
+}
+
+void ExecutionEngine::Stop()
+{
+	{
+		lock_guard<mutex> lock(_wake_mutex);
+		_running = false;
+	}
+	_wake.notify_all();
+
+	for (auto& worker_thread : _threads)
+	{
+		if (worker_thread.joinable())
+		{
+			worker_thread.join();
+		}
+	}
+	_threads.clear();
+
+	// Tasks left in the queues are run on current thread so that no group waits forever.
+	ITask * task = nullptr;
+	while (PopAny(task))
+	{
+		Execute(task);
+	}
+}
+
+void ExecutionEngine::Submit(ITask * task)
+{
+	assert(task != nullptr);
+
+	auto host = s_host.load();
+	if (host != nullptr)
+	{
+		host->Submit(task);
+		return;
+	}
+
+	{
+		// Count the task before it becomes visible, so that _queued never underflows.
+		lock_guard<mutex> lock(_wake_mutex);
+		++_queued;
+	}
+
+	if (IsOwnWorkerThread())
+	{
+		auto& worker = *_workers[t_worker_index];
+		lock_guard<mutex> lock(worker.mutex);
+		worker.tasks.push_back(task);
+	}
+	else
+	{
+		lock_guard<mutex> lock(_injected_mutex);
+		_injected.push_back(task);
+	}
+	_wake.notify_one();
+}
+
+/**
+	Run the most recently pushed task of the calling worker, but only if it belongs to the
+	specified group. A worker waiting for a group must not pick up unrelated tasks, since they
+	may need processors which are busy further up the calling stack.
+*/
+bool ExecutionEngine::RunLocal(const void * group)
+{
+	auto host = s_host.load();
+	if (host != nullptr)
+		return host->RunLocal(group);
+
+	if (!IsOwnWorkerThread())
+		return false;
+
+	ITask * task = nullptr;
+	{
+		auto& worker = *_workers[t_worker_index];
+		lock_guard<mutex> lock(worker.mutex);
+		if (worker.tasks.empty() || worker.tasks.back()->GetGroup() != group)
+			return false;
+
+		task = worker.tasks.back();
+		worker.tasks.pop_back();
+		--_queued;
+	}
+
+	Execute(task);
+	return true;
+}
+
+bool ExecutionEngine::PopAny(ITask *& task)
+{
+	auto self = IsOwnWorkerThread() ? t_worker_index : -1;
+	if (self >= 0)
+	{
+		auto& worker = *_workers[self];
+		lock_guard<mutex> lock(worker.mutex);
+		if (!worker.tasks.empty())
+		{
+			task = worker.tasks.back();
+			worker.tasks.pop_back();
+			--_queued;
+			return true;
+		}
+	}
+
+	{
+		lock_guard<mutex> lock(_injected_mutex);
+		if (!_injected.empty())
+		{
+			task = _injected.front();
+			_injected.pop_front();
+			--_queued;
+			return true;
+		}
+	}
+
+	// steal the oldest task of other workers.
+	auto worker_count = static_cast<int>(_workers.size());
+	for (int i = 1; i <= worker_count; ++i)
+	{
+		auto victim = (self + i + worker_count) % worker_count;
+		if (victim == self)
+			continue;
+
+		auto& worker = *_workers[victim];
+		lock_guard<mutex> lock(worker.mutex);
+		if (!worker.tasks.empty())
+		{
+			task = worker.tasks.front();
+			worker.tasks.pop_front();
+			--_queued;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+void ExecutionEngine::Execute(ITask * task)
+{
+	task->Complete(task->Run());
+}
+
+void ExecutionEngine::WorkerProc(unsigned int index)
+{
+	t_worker_index = static_cast<int>(index);
+	t_worker_engine = this;
+
+	ITask * task = nullptr;
+	while (_running)
+	{
+		if (PopAny(task))
+		{
+			Execute(task);
+			continue;
+		}
+
+		unique_lock<mutex> lock(_wake_mutex);
+		_wake.wait(lock, [this]() { return !_running || _queued > 0; });
+	}
+
+	t_worker_index = -1;
+	t_worker_engine = nullptr;
+}
+
+/// Task of a group, exceptions of the work are caught here so that they never leave the module.
+struct TaskGroup::GroupTask : public ITask
+{
+	GroupTask(TaskGroup * group_, function<bool()>&& work_) : group(group_), work(move(work_)) {}
+
+	virtual bool Run() override
+	{
+		return RunTask(group, work);
+	}
+
+	virtual void Complete(bool succeeded) override
+	{
+		auto owner = group;
+		delete this;
+		owner->Complete(succeeded);
+	}
+
+	virtual const void * GetGroup() const override
+	{
+		return group;
+	}
+
+	TaskGroup * group;
+	function<bool()> work;
+};
+
+TaskGroup::TaskGroup() :
+	_pending{ 0 },
+	_succeeded{ true }
+{
+}
+
+TaskGroup::~TaskGroup()
+{
+	Wait();
+}
+
+void TaskGroup::Run(std::function<bool()> task)
+{
+	auto& engine = ExecutionEngine::GetInstance();
+	if (!engine.IsEnabled())
+	{
+		if (!RunTask(this, task))
+		{
+			_succeeded = false;
+		}
+		return;
+	}
+
+	AddPending();
+	engine.Submit(new GroupTask(this, move(task)));
+}
+
+TaskGroup * TaskGroup::GetCurrent()
+{
+	return t_current_group;
+}
+
+void TaskGroup::AddPending()
+{
+	lock_guard<mutex> lock(_mutex);
+	++_pending;
+}
+
+void TaskGroup::RunPending(std::function<bool()> task)
+{
+	Complete(RunTask(this, task));
+}
+
+/// Run the task with the group as current group, exceptions are reported as failure.
+bool TaskGroup::RunTask(TaskGroup * group, std::function<bool()>& task)
+{
+	auto outer_group = t_current_group;
+	t_current_group = group;
+
+	bool succeeded = false;
+	try
+	{
+		succeeded = task();
+	}
+	catch (...)
+	{
+		succeeded = false;
+	}
+
+	t_current_group = outer_group;
+	return succeeded;
+}
+
+bool TaskGroup::Wait()
+{
+	auto& engine = ExecutionEngine::GetInstance();
+
+	for (;;)
+	{
+		// A waiting worker helps with tasks of this group still in its own deque.
+		while (engine.RunLocal(this))
+		{
+		}
+
+		unique_lock<mutex> lock(_mutex);
+		if (_pending == 0)
+			break;
+
+		// Time blocked here is spent by other threads, not by the processor waiting.
+		auto start = chrono::steady_clock::now();
+		if (engine.IsWorkerThread())
+		{
+			_done.wait_for(lock, chrono::milliseconds(1), [this]() { return _pending == 0; });
+		}
+		else
+		{
+			_done.wait(lock, [this]() { return _pending == 0; });
+		}
+		StatisticsScope::ExcludeBlockedTime(static_cast<unsigned long long>(
+			chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count()));
+	}
+
+	return _succeeded;
+}
+
+void TaskGroup::Complete(bool succeeded)
+{
+	if (!succeeded)
+	{
+		_succeeded = false;
+	}
+
+	// Notify under the lock, the waiter may destroy the group as soon as it sees zero.
+	lock_guard<mutex> lock(_mutex);
+	if (--_pending == 0)
+	{
+		_done.notify_all();
+	}
+}
@@ -0,0 +1,159 @@
+#pragma once
+
+#ifndef ExecutionEngine_h__20171016
+#define ExecutionEngine_h__20171016
+
+#include "Interface/IExecutionEngine.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace Yap
+{
+	class TaskGroup;
+
+	/**
+	@brief Work-stealing thread pool used to run independent parts of a pipeline concurrently.
+
+	The engine is opt-in. It stays disabled (no worker threads) unless the environment variable
+	YAP_THREADS is set to a value greater than 1, or SetThreadCount() is called explicitly.
+	When disabled, tasks submitted through TaskGroup::Run() are executed synchronously on the
+	calling thread, so existing pipelines behave exactly as before.
+
+	Each worker owns a task deque. Tasks submitted from a worker are pushed to the back of its
+	own deque and popped LIFO, idle workers steal from the front of other deques. Tasks submitted
+	from threads outside the pool go to a shared injection queue.
+
+	@remarks Implement is linked statically into every plugin module, so each module has its own
+	engine instance. The host passes its engine to the modules it loads through the exported
+	GetExecutionEngineUser() (see YapImplement.h), and the engine of a module then forwards all
+	tasks to it instead of starting workers of its own, so there is only one pool per process.
+	Modules loaded by other hosts start their own workers, all reading the same YAP_THREADS setting.
+
+	Worker threads must not be joined from a static destructor, since that runs under the loader
+	lock when a module is unloaded. Shutdown() (called by ReleaseProcessorManager() of each module)
+	stops them, or detaches the module from the engine of the host, before unloading. Workers hold
+	a reference to the engine, so an engine never shut down is left to the OS at process exit
+	instead of being destroyed.
+	*/
+	class ExecutionEngine : public IExecutionEngine, public std::enable_shared_from_this<ExecutionEngine>
+	{
+	public:
+		static ExecutionEngine& GetInstance();
+
+		/// Stop the workers of the instance if it has been created, tasks run synchronously after this.
+		static void Shutdown();
+
+		/// Receives the engine of the host, which is used instead of the workers of this module.
+		static IExecutionEngineUser& GetUser();
+
+		~ExecutionEngine();
+
+		/// Set number of worker threads. 0 or 1 disables the engine.
+		/**
+			\remarks Has no effect while the engine of the host is used.
+		*/
+		void SetThreadCount(unsigned int thread_count);
+		virtual unsigned int GetThreadCount() const override;
+
+		/// Return true if tasks are dispatched to worker threads.
+		virtual bool IsEnabled() const override;
+
+		/// Return true if the calling thread is one of the workers of this engine.
+		virtual bool IsWorkerThread() const override;
+
+		virtual void Submit(ITask * task) override;
+		virtual bool RunLocal(const void * group) override;
+
+	protected:
+		ExecutionEngine();
+
+		struct Worker
+		{
+			std::deque<ITask*> tasks;
+			std::mutex mutex;
+		};
+
+		class User : public IExecutionEngineUser
+		{
+		public:
+			virtual void SetExecutionEngine(IExecutionEngine * engine) override;
+		};
+
+		/// Return true if the calling thread is one of the workers started by this instance.
+		bool IsOwnWorkerThread() const;
+		bool PopAny(ITask *& task);
+		static void Execute(ITask * task);
+		void WorkerProc(unsigned int index);
+		void Stop();
+
+		std::vector<std::unique_ptr<Worker>> _workers;
+		std::vector<std::thread> _threads;
+
+		std::deque<ITask*> _injected;
+		std::mutex _injected_mutex;
+
+		std::atomic<unsigned int> _queued;
+		std::atomic<bool> _running;
+		std::mutex _wake_mutex;
+		std::condition_variable _wake;
+
+		std::mutex _config_mutex;
+
+		static std::shared_ptr<ExecutionEngine> s_instance;
+		static std::once_flag s_instance_flag;
+		static std::atomic<IExecutionEngine*> s_host;	///< Engine of the host, nullptr if not hosted.
+		static User s_user;
+	};
+
+	/**
+	@brief A set of tasks that can be waited for as a whole.
+
+	TaskGroup is the barrier used by fan-out processors: every emitted piece of data is fed
+	downstream as an independent task, and Wait() returns only when all of them are finished.
+	Wait() returns false if any of the tasks returned false or threw an exception.
+	*/
+	class TaskGroup
+	{
+	public:
+		TaskGroup();
+		~TaskGroup();
+
+		/// Run the task in the pool, or synchronously if the engine is disabled.
+		void Run(std::function<bool()> task);
+
+		/// Block till all tasks of the group are finished.
+		bool Wait();
+
+		/// Return the group of the task running on current thread, nullptr outside of tasks.
+		static TaskGroup * GetCurrent();
+
+		/// Add a task which is deferred outside the engine, Wait() blocks till RunPending() is called for it.
+		void AddPending();
+
+		/// Run a task added by AddPending() on current thread as part of the group.
+		void RunPending(std::function<bool()> task);
+
+	private:
+		struct GroupTask;
+
+		static bool RunTask(TaskGroup * group, std::function<bool()>& task);
+		void Complete(bool succeeded);
+
+		unsigned int _pending;
+		std::atomic<bool> _succeeded;
+		std::mutex _mutex;
+		std::condition_variable _done;
+
+		TaskGroup(const TaskGroup&) = delete;
+		const TaskGroup& operator = (const TaskGroup&) = delete;
+	};
+}
+
+#endif // ExecutionEngine_h__
@@ -0,0 +1,203 @@
+#include "LinkQueue.h"
+#include "LogUserImpl.h"
+
+#include <cassert>
+#include <cwchar>
+
+using namespace std;
+using namespace Yap;
+
+LinkQueue::LinkQueue(IProcessor * next, const wchar_t * next_port, unsigned int capacity, QueuePolicy policy) :
+	ProcessorImpl(L"LinkQueue"),
+	_next(YapShared(next)),
+	_next_port(next_port),
+	_next_impl(dynamic_cast<ProcessorImpl*>(next)),
+	_next_port_handle(_next_impl != nullptr ? _next_impl->GetInputHandle(next_port) : InvalidPortHandle),
+	_capacity(capacity > 0 ? capacity : 1),
+	_policy(policy),
+	_busy(false),
+	_stopping(false),
+	_failed(false),
+	_dropped(0)
+{
+	assert(next != nullptr);
+
+	auto in_port = (next->Inputs() != nullptr) ? next->Inputs()->Find(next_port) : nullptr;
+	if (in_port != nullptr)
+	{
+		AddInput(L"Input", in_port->GetDimensionCount(), in_port->GetDataType());
+	}
+	else
+	{
+		AddInput(L"Input", YAP_ANY_DIMENSION, DataTypeAll);
+	}
+
+	SetReentrant(true);
+	Start();
+}
+
+LinkQueue::LinkQueue(const LinkQueue& rhs) :
+	ProcessorImpl(rhs),
+	_next(rhs._next),
+	_next_port(rhs._next_port),
+	_next_impl(rhs._next_impl),
+	_next_port_handle(rhs._next_port_handle),
+	_capacity(rhs._capacity),
+	_policy(rhs._policy),
+	_busy(false),
+	_stopping(false),
+	_failed(false),
+	_dropped(0)
+{
+	Start();
+}
+
+LinkQueue::~LinkQueue()
+{
+	{
+		lock_guard<mutex> lock(_mutex);
+		_stopping = true;
+	}
+	_not_empty.notify_all();
+
+	// Data already queued is still fed to the next processor.
+	if (_consumer.joinable())
+	{
+		_consumer.join();
+	}
+}
+
+void LinkQueue::Start()
+{
+	_consumer = thread([this]() { Consume(); });
+}
+
+bool LinkQueue::Input(const wchar_t * port, IData * data)
+{
+	assert(data != nullptr);
+
+	{
+		unique_lock<mutex> lock(_mutex);
+		if (_failed)
+		{
+			_failed = false;
+			return false;
+		}
+
+		switch (_policy)
+		{
+		case QueuePolicyBlock:
+			_not_full.wait(lock, [this]() { return _queue.size() < _capacity; });
+			break;
+		case QueuePolicyDropOldest:
+			while (_queue.size() >= _capacity)
+			{
+				_queue.pop_front();
+				++_dropped;
+			}
+			break;
+		case QueuePolicyCoalesceLatest:
+			_dropped += static_cast<unsigned int>(_queue.size());
+			_queue.clear();
+			break;
+		default:
+			assert(0);
+		}
+
+		_queue.push_back(RetainedData(data));
+	}
+	_not_empty.notify_one();
+
+	return true;
+}
+
+void LinkQueue::Consume()
+{
+	for (;;)
+	{
+		RetainedData data;
+		{
+			unique_lock<mutex> lock(_mutex);
+			_not_empty.wait(lock, [this]() { return _stopping || !_queue.empty(); });
+			if (_queue.empty())
+				return;
+
+			data = _queue.front();
+			_queue.pop_front();
+			_busy = true;
+		}
+		_not_full.notify_one();
+
+		auto succeeded = (_next_impl != nullptr) ?
+			InputTo(_next_impl, _next_port_handle, _next_port.c_str(), data.get()) :
+			_next->Input(_next_port.c_str(), data.get());
+		data.reset();
+		if (!succeeded)
+		{
+			LOG_ERROR(L"<LinkQueue> Failed to feed queued data to the next processor!", L"Implement");
+		}
+
+		{
+			lock_guard<mutex> lock(_mutex);
+			_busy = false;
+			_failed = _failed || !succeeded;
+		}
+		_idle.notify_all();
+	}
+}
+
+void LinkQueue::Flush()
+{
+	unique_lock<mutex> lock(_mutex);
+	_idle.wait(lock, [this]() { return _queue.empty() && !_busy; });
+}
+
+unsigned int LinkQueue::GetDroppedCount() const
+{
+	lock_guard<mutex> lock(_mutex);
+	return _dropped;
+}
+
+IProcessor * LinkQueue::GetNext() const
+{
+	return _next.get();
+}
+
+const wchar_t * LinkQueue::GetNextPort() const
+{
+	return _next_port.c_str();
+}
+
+unsigned int LinkQueue::GetCapacity() const
+{
+	return _capacity;
+}
+
+QueuePolicy LinkQueue::GetPolicy() const
+{
+	return _policy;
+}
+
+bool LinkQueue::ParsePolicy(const wchar_t * text, QueuePolicy& policy)
+{
+	assert(text != nullptr);
+
+	if (wcscmp(text, L"Block") == 0)
+	{
+		policy = QueuePolicyBlock;
+	}
+	else if (wcscmp(text, L"DropOldest") == 0)
+	{
+		policy = QueuePolicyDropOldest;
+	}
+	else if (wcscmp(text, L"CoalesceLatest") == 0)
+	{
+		policy = QueuePolicyCoalesceLatest;
+	}
+	else
+	{
+		return false;
+	}
+
+	return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#ifndef LinkQueue_h__20171018
+#define LinkQueue_h__20171018
+
+#include "ProcessorImpl.h"
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+namespace Yap
+{
+	/// Policy of a LinkQueue when data arrives while the queue is full.
+	enum QueuePolicy
+	{
+		QueuePolicyBlock,			///< The producer waits till the consumer takes some data.
+		QueuePolicyDropOldest,		///< The oldest queued data is discarded.
+		QueuePolicyCoalesceLatest,	///< Queued data is replaced by the latest data, e.g. for displays.
+	};
+
+	/**
+	@brief Processor used to decouple a link between two processors.
+
+	Input() puts the data into a bounded queue and returns immediately (unless the queue is
+	full and the policy is QueuePolicyBlock). A dedicated consumer thread feeds queued data to
+	the next processor in the order it arrived. This keeps producers such as acquisition from
+	waiting on slow consumers such as visualization. If the next processor fails, the error is
+	logged and the following call to Input() returns false without queuing its data.
+
+	Queued links are created by PipelineConstructor, which inserts a LinkQueue between the two
+	processors and adds it to the pipeline.
+	*/
+	class LinkQueue :
+		public ProcessorImpl
+	{
+		IMPLEMENT_SHARED(LinkQueue)
+	public:
+		LinkQueue(IProcessor * next, const wchar_t * next_port, unsigned int capacity, QueuePolicy policy);
+		LinkQueue(const LinkQueue& rhs);
+
+		virtual bool Input(const wchar_t * port, IData * data) override;
+
+		/// Wait till all queued data has been fed to the next processor.
+		void Flush();
+
+		/// Number of data objects discarded because of the queue policy.
+		unsigned int GetDroppedCount() const;
+
+		static bool ParsePolicy(const wchar_t * text, QueuePolicy& policy);
+
+		IProcessor * GetNext() const;
+		const wchar_t * GetNextPort() const;
+		unsigned int GetCapacity() const;
+		QueuePolicy GetPolicy() const;
+
+	protected:
+		~LinkQueue();
+
+		void Start();
+		void Consume();
+
+		SmartPtr<IProcessor> _next;
+		std::wstring _next_port;
+		ProcessorImpl * _next_impl;			///< nullptr if the next processor is not a ProcessorImpl.
+		PortHandle _next_port_handle;
+		unsigned int _capacity;
+		QueuePolicy _policy;
+
+		/// Queued data stays shared till it has been fed on, since the producer may still use it.
+		std::deque<RetainedData> _queue;
+		mutable std::mutex _mutex;
+		std::condition_variable _not_empty;
+		std::condition_variable _not_full;
+		std::condition_variable _idle;
+		bool _busy;
+		bool _stopping;
+		bool _failed;			///< The next processor failed since the last call to Input().
+		unsigned int _dropped;
+
+		std::thread _consumer;
+	};
+}
+
+#endif // LinkQueue_h__
@@ -0,0 +1,63 @@
+#include "PipelinePool.h"
+
+#include <algorithm>
+#include <cassert>
+
+using namespace std;
+using namespace Yap;
+
+PipelinePool::PipelinePool(CompositeProcessor * prototype, unsigned int size)
+{
+	assert(prototype != nullptr);
+
+	for (unsigned int i = 0; i < size; ++i)
+	{
+		auto pipeline = dynamic_cast<CompositeProcessor*>(static_cast<IProcessor*>(prototype)->Clone());
+		if (pipeline == nullptr)
+			break;
+
+		_pipelines.push_back(YapShared(pipeline));
+		_idle.push_back(pipeline);
+	}
+}
+
+SmartPtr<CompositeProcessor> PipelinePool::Acquire()
+{
+	unique_lock<mutex> lock(_mutex);
+	if (_pipelines.empty())
+		return YapShared<CompositeProcessor>(nullptr);
+
+	_released.wait(lock, [this]() { return !_idle.empty(); });
+
+	auto pipeline = _idle.back();
+	_idle.pop_back();
+
+	return YapShared(pipeline);
+}
+
+void PipelinePool::Release(CompositeProcessor * pipeline)
+{
+	if (pipeline == nullptr)
+		return;
+
+	{
+		lock_guard<mutex> lock(_mutex);
+		assert(find_if(_pipelines.begin(), _pipelines.end(),
+			[pipeline](const SmartPtr<CompositeProcessor>& item) { return item.get() == pipeline; }) != _pipelines.end());
+		assert(find(_idle.begin(), _idle.end(), pipeline) == _idle.end());
+
+		_idle.push_back(pipeline);
+	}
+	_released.notify_one();
+}
+
+unsigned int PipelinePool::GetSize() const
+{
+	return static_cast<unsigned int>(_pipelines.size());
+}
+
+unsigned int PipelinePool::GetIdleCount() const
+{
+	lock_guard<mutex> lock(_mutex);
+	return static_cast<unsigned int>(_idle.size());
+}
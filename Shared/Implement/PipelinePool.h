@@ -0,0 +1,73 @@
+#pragma once
+
+#ifndef PipelinePool_h__20171020
+#define PipelinePool_h__20171020
+
+#include "CompositeProcessor.h"
+
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+
+namespace Yap
+{
+	/**
+	@brief Pool of identical pipelines used to run several reconstructions concurrently.
+
+	The pipelines are clones of a compiled prototype, so the pipeline script is compiled and
+	the modules are loaded only once. The pool doesn't warm up the clones: state built on first
+	use, such as FFT plans or Grappa weights, is built by the first job each pipeline runs.
+	Pipelines are returned to the pool after each job and the most recently released one is
+	handed out first, so later jobs reuse that state.
+
+	\code
+	PipelinePool pool(compiler.CompileFile(path).get(), 4);
+	// In each worker thread:
+	PipelinePool::Lease pipeline(pool);
+	pipeline->SetGlobalVariables(variables);
+	pipeline->Input(L"Input", data);
+	\endcode
+	*/
+	class PipelinePool
+	{
+	public:
+		PipelinePool(CompositeProcessor * prototype, unsigned int size);
+
+		/// Take the most recently released idle pipeline, waiting till one is released if all are in use.
+		SmartPtr<CompositeProcessor> Acquire();
+
+		/// Return a pipeline taken with Acquire() to the pool.
+		void Release(CompositeProcessor * pipeline);
+
+		/// Number of pipelines in the pool, may be less than requested if cloning failed.
+		unsigned int GetSize() const;
+		unsigned int GetIdleCount() const;
+
+		/// Holds a pipeline of the pool during its lifetime.
+		class Lease
+		{
+		public:
+			explicit Lease(PipelinePool& pool) : _pool(pool), _pipeline(pool.Acquire()) {}
+			~Lease() { _pool.Release(_pipeline.get()); }
+
+			CompositeProcessor * operator -> () const { return _pipeline.get(); }
+			CompositeProcessor * get() const { return _pipeline.get(); }
+
+		private:
+			Lease(const Lease&);
+			const Lease& operator = (const Lease&);
+
+			PipelinePool& _pool;
+			SmartPtr<CompositeProcessor> _pipeline;
+		};
+
+	protected:
+		std::vector<SmartPtr<CompositeProcessor>> _pipelines;
+		std::vector<CompositeProcessor*> _idle;
+
+		mutable std::mutex _mutex;
+		std::condition_variable _released;
+	};
+}
+
+#endif // PipelinePool_h__
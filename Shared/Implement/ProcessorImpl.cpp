@@ -2,10 +2,13 @@
 
 #include <iostream>
 #include <algorithm>
+#include <iterator>
 #include <assert.h>
+#include <chrono>
 #include "Interface/Interfaces.h"
 
 #include "VariableSpace.h"
+#include "ExecutionEngine.h"
 
 using namespace std;
 using namespace Yap;
@@ -55,9 +58,13 @@ namespace _details
 		_class_id(class_id),
 		_properties(shared_ptr<VariableSpace>(new VariableSpace)),
 		_input(YapShared(new PtrContainerImpl<IPort>)),
-		_output(YapShared(new PtrContainerImpl<IPort>))
+		_output(YapShared(new PtrContainerImpl<IPort>)),
+		_links_resolved(false),
+		_reentrant(false),
+		_strided_input(false),
+		_input_busy(false)
 	{
-		
+		EnableStatistics(ProcessorStatistics::IsEnabledByDefault());
 	}
 
 	Yap::ProcessorImpl::ProcessorImpl(const ProcessorImpl& rhs) :
@@ -67,10 +74,24 @@ namespace _details
 		_instance_id(rhs._instance_id),
 		_class_id(rhs._class_id),
 		_system_variables(nullptr),
-		_module{rhs._module}
+		_module{rhs._module},
+		_property_bindings(rhs._property_bindings),
+		_input_names(rhs._input_names),
+		_output_names(rhs._output_names),
+		_links_resolved(false),
+		_reentrant(rhs._reentrant),
+		_strided_input(rhs._strided_input),
+		_input_busy(false)
 	{
+		EnableStatistics(rhs._statistics != nullptr);
 		_links.clear();
 		_in_property_mapping.clear();
+
+		// Bindings of rhs refer to the properties of rhs.
+		for (auto& binding : _property_bindings)
+		{
+			ResolvePropertyBinding(binding);
+		}
 	}
 
 	ProcessorImpl::~ProcessorImpl()
@@ -99,21 +120,156 @@ namespace _details
 			return false;
 
 		_links.insert(std::make_pair(out_port, Anchor(next_processor, in_port)));
+
+		_links_resolved = false;
+		_resolved_links.clear();
+
 		return true;
 	}
 
+	void ProcessorImpl::ResolveLinks()
+	{
+		_resolved_links.clear();
+		_resolved_links.resize(_output_names.size());
+
+		// Links of the same port keep the order they were added in.
+		for (auto& link : _links)
+		{
+			auto handle = GetOutputHandle(link.first.c_str());
+			assert(handle != InvalidPortHandle && link.second.processor != nullptr);
+
+			ResolvedLink resolved_link;
+			resolved_link.processor = link.second.processor;
+			resolved_link.processor_impl = dynamic_cast<ProcessorImpl*>(link.second.processor);
+			resolved_link.port = (resolved_link.processor_impl != nullptr) ?
+				resolved_link.processor_impl->GetInputHandle(link.second.port.c_str()) : InvalidPortHandle;
+			resolved_link.port_name = link.second.port;
+
+			_resolved_links[handle].push_back(resolved_link);
+		}
+
+		_links_resolved = true;
+	}
+
+	bool ProcessorImpl::CopyLinks(const ProcessorImpl& source, const map<IProcessor*, IProcessor*>& processors)
+	{
+		_in_property_mapping = source._in_property_mapping;
+		_out_property_mapping = source._out_property_mapping;
+		for (auto& binding : _property_bindings)
+		{
+			ResolvePropertyBinding(binding);
+		}
+
+		for (auto& link : source._links)
+		{
+			auto next = processors.find(link.second.processor);
+			if (next == processors.end())
+				continue;
+
+			if (!Link(link.first.c_str(), next->second, link.second.port.c_str()))
+				return false;
+		}
+
+		return true;
+	}
+
+	ProcessorImpl::PortHandle ProcessorImpl::GetInputHandle(const wchar_t * name) const
+	{
+		assert(name != nullptr);
+
+		for (size_t i = 0; i < _input_names.size(); ++i)
+		{
+			if (wcscmp(_input_names[i].c_str(), name) == 0)
+				return static_cast<PortHandle>(i);
+		}
+
+		return InvalidPortHandle;
+	}
+
+	ProcessorImpl::PortHandle ProcessorImpl::GetOutputHandle(const wchar_t * name) const
+	{
+		assert(name != nullptr);
+
+		for (size_t i = 0; i < _output_names.size(); ++i)
+		{
+			if (wcscmp(_output_names[i].c_str(), name) == 0)
+				return static_cast<PortHandle>(i);
+		}
+
+		return InvalidPortHandle;
+	}
+
+	bool ProcessorImpl::InputByHandle(PortHandle port, IData * data)
+	{
+		assert(port < _input_names.size());
+
+		return Input(_input_names[port].c_str(), data);
+	}
+
+	SmartPtr<IData> ProcessorImpl::GetInputSlot(PortHandle port, int data_type, IDimensions * dimensions,
+		IData * reference)
+	{
+		return SmartPtr<IData>();
+	}
+
+	SmartPtr<IData> ProcessorImpl::RequestOutputSlot(PortHandle out_port, int data_type,
+		IDimensions * dimensions, IData * reference)
+	{
+		assert(dimensions != nullptr);
+
+		if (out_port == InvalidPortHandle)
+			return SmartPtr<IData>();
+
+		// Data fed to several processors can't be placed in the block of one of them.
+		ProcessorImpl * consumer = nullptr;
+		PortHandle port = InvalidPortHandle;
+		if (_links_resolved)
+		{
+			if (_resolved_links[out_port].size() != 1)
+				return SmartPtr<IData>();
+
+			consumer = _resolved_links[out_port][0].processor_impl;
+			port = _resolved_links[out_port][0].port;
+		}
+		else
+		{
+			auto range = _links.equal_range(_output_names[out_port]);
+			if (range.first == range.second || next(range.first) != range.second)
+				return SmartPtr<IData>();
+
+			consumer = dynamic_cast<ProcessorImpl*>(range.first->second.processor);
+			if (consumer != nullptr)
+			{
+				port = consumer->GetInputHandle(range.first->second.port.c_str());
+			}
+		}
+
+		if (consumer == nullptr || port == InvalidPortHandle)
+			return SmartPtr<IData>();
+
+		return consumer->GetInputSlot(port, data_type, dimensions, reference);
+	}
+
 	bool ProcessorImpl::AddInput(const wchar_t * name, 
 								 unsigned int dimensions,
 								 int data_type)
 	{
-		return _input->Add(name, new Port(name, dimensions, data_type));
+		if (!_input->Add(name, new Port(name, dimensions, data_type)))
+			return false;
+
+		_input_names.push_back(name);
+		return true;
 	}
 
 	bool ProcessorImpl::AddOutput(const wchar_t * name,
 								  unsigned int dimensions, 
 								  int data_type)
 	{
-		return _output->Add(name, new Port(name, dimensions, data_type));
+		if (!_output->Add(name, new Port(name, dimensions, data_type)))
+			return false;
+
+		_output_names.push_back(name);
+		return true;
 	}
 
 	bool ProcessorImpl::Feed(const wchar_t * out_port, IData * data)
@@ -121,18 +277,305 @@ namespace _details
 		assert(wcslen(out_port) != 0);
 		assert(data != nullptr);
 
+		if (_links_resolved)
+		{
+			auto handle = GetOutputHandle(out_port);
+			return (handle == InvalidPortHandle) || Feed(handle, data);
+		}
+
+		if (_statistics)
+		{
+			_statistics->RecordOutput(ProcessorStatistics::GetDataBytes(data));
+		}
+
+		auto strided = dynamic_cast<IStridedData*>(data);
+		bool is_view = (strided != nullptr && !strided->IsContiguous());
+		SmartPtr<IData> contiguous_data;
+
 		auto range = _links.equal_range(out_port);
 		for (auto iter = range.first; iter != range.second; ++iter)
 		{
-			auto link = iter->second;
-			assert(link.processor != nullptr);
-			if (link.processor == nullptr || !link.processor->Input(link.port.c_str(), data))
+			assert(iter->second.processor != nullptr);
+			if (iter->second.processor == nullptr)
+				return false;
+
+			ResolvedLink link;
+			link.processor = iter->second.processor;
+			link.processor_impl = dynamic_cast<ProcessorImpl*>(iter->second.processor);
+			link.port = InvalidPortHandle;
+			link.port_name = iter->second.port;
+
+			if (!FeedLink(link, data, is_view, next(iter) == range.second, contiguous_data))
+				return false;
+		}
+
+		return true;
+	}
+
+	bool ProcessorImpl::Feed(PortHandle out_port, IData * data)
+	{
+		assert(out_port < _output_names.size());
+		assert(data != nullptr);
+
+		if (!_links_resolved)
+			return Feed(_output_names[out_port].c_str(), data);
+
+		if (_statistics)
+		{
+			_statistics->RecordOutput(ProcessorStatistics::GetDataBytes(data));
+		}
+
+		auto strided = dynamic_cast<IStridedData*>(data);
+		bool is_view = (strided != nullptr && !strided->IsContiguous());
+		SmartPtr<IData> contiguous_data;
+
+		auto& links = _resolved_links[out_port];
+		for (size_t i = 0; i < links.size(); ++i)
+		{
+			if (!FeedLink(links[i], data, is_view, i + 1 == links.size(), contiguous_data))
 				return false;
 		}
 
 		return true;
 	}
 
+	bool ProcessorImpl::FeedLink(const ResolvedLink& link, IData * data, bool is_view, bool last_consumer,
+		SmartPtr<IData>& contiguous_data)
+	{
+		auto input = data;
+		if (is_view && (link.processor_impl == nullptr || !link.processor_impl->_strided_input))
+		{
+			// Materialize the view only once for all processors which need contiguous data.
+			if (!contiguous_data)
+			{
+				contiguous_data = MakeContiguous(data);
+				if (!contiguous_data)
+					return false;
+			}
+			input = contiguous_data.get();
+		}
+
+		// Processors fed before the last one must not modify the data in place.
+		auto writable = last_consumer ? nullptr : dynamic_cast<IWritableData*>(input);
+		if (writable != nullptr)
+		{
+			writable->Share();
+		}
+
+		bool succeeded = (link.processor_impl != nullptr) ?
+			InputTo(link.processor_impl, link.port, link.port_name.c_str(), input) :
+			link.processor->Input(link.port_name.c_str(), input);
+
+		if (writable != nullptr)
+		{
+			writable->Unshare();
+		}
+
+		return succeeded;
+	}
+
+	void ProcessorImpl::FeedAsync(TaskGroup& tasks, const wchar_t * out_port, IData * data)
+	{
+		assert(wcslen(out_port) != 0);
+		assert(data != nullptr);
+
+		// Keep the data alive till the task is finished. This reference doesn't make the data
+		// shared, exclusivity only depends on the consumers (see IWritableData).
+		auto shared_data = YapShared(data);
+		wstring port(out_port);
+
+		tasks.Run([this, port, shared_data]() mutable {
+			return Feed(port.c_str(), shared_data.get());
+		});
+	}
+
+	void ProcessorImpl::FeedAsync(TaskGroup& tasks, PortHandle out_port, IData * data)
+	{
+		assert(out_port < _output_names.size());
+		assert(data != nullptr);
+
+		auto shared_data = YapShared(data);
+		tasks.Run([this, out_port, shared_data]() mutable {
+			return Feed(out_port, shared_data.get());
+		});
+	}
+
+	bool ProcessorImpl::InputTo(IProcessor * processor, const wchar_t * port, IData * data)
+	{
+		assert(processor != nullptr);
+
+		auto processor_impl = dynamic_cast<ProcessorImpl*>(processor);
+		if (processor_impl == nullptr)
+			return processor->Input(port, data);
+
+		return InputTo(processor_impl, InvalidPortHandle, port, data);
+	}
+
+	bool ProcessorImpl::InputTo(ProcessorImpl * processor, PortHandle port, const wchar_t * port_name, IData * data)
+	{
+		assert(processor != nullptr);
+
+		// Calls of processors which are not reentrant are serialized while the engine runs.
+		if (processor->_reentrant || !ExecutionEngine::GetInstance().IsEnabled())
+			return DispatchInput(processor, port, port_name, data);
+
+		{
+			unique_lock<mutex> lock(processor->_input_mutex);
+			if (processor->_input_busy)
+			{
+				// A task doesn't park its worker, the input is queued to the thread which keeps the
+				// processor busy. Sharing the data stops later consumers from modifying it in place.
+				auto group = TaskGroup::GetCurrent();
+				if (group != nullptr)
+				{
+					auto writable = dynamic_cast<IWritableData*>(data);
+					if (writable != nullptr)
+					{
+						writable->Share();
+					}
+
+					group->AddPending();
+					processor->_queued_inputs.push_back(QueuedInput{ port,
+						(port_name != nullptr) ? port_name : L"", YapShared(data), group });
+					return true;
+				}
+
+				// The wait is spent by another call, so it is excluded from the self time of the
+				// calling processor.
+				auto start = chrono::steady_clock::now();
+				processor->_input_idle.wait(lock, [processor]() { return !processor->_input_busy; });
+				StatisticsScope::ExcludeBlockedTime(static_cast<unsigned long long>(
+					chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count()));
+			}
+			processor->_input_busy = true;
+		}
+
+		bool succeeded = false;
+		try
+		{
+			succeeded = DispatchInput(processor, port, port_name, data);
+		}
+		catch (...)
+		{
+			processor->RunQueuedInputs();
+			throw;
+		}
+
+		processor->RunQueuedInputs();
+		return succeeded;
+	}
+
+	bool ProcessorImpl::DispatchInput(ProcessorImpl * processor, PortHandle port, const wchar_t * port_name,
+		IData * data)
+	{
+		if (processor->_statistics)
+		{
+			StatisticsScope scope(processor->_statistics.get(), data);
+			return (port != InvalidPortHandle) ? processor->InputByHandle(port, data) :
+				processor->Input(port_name, data);
+		}
+
+		return (port != InvalidPortHandle) ? processor->InputByHandle(port, data) :
+			processor->Input(port_name, data);
+	}
+
+	void ProcessorImpl::RunQueuedInputs()
+	{
+		unique_lock<mutex> lock(_input_mutex);
+		while (!_queued_inputs.empty())
+		{
+			auto input = std::move(_queued_inputs.front());
+			_queued_inputs.pop_front();
+			lock.unlock();
+
+			input.group->RunPending([this, &input]() {
+				// Consumers still queued hold their own share, so the data is only exclusive if
+				// it was exclusive to this consumer when it was queued.
+				auto writable = dynamic_cast<IWritableData*>(input.data.get());
+				if (writable != nullptr)
+				{
+					writable->Unshare();
+				}
+
+				bool succeeded = DispatchInput(this, input.port, input.port_name.c_str(), input.data.get());
+				input.data.reset();
+				return succeeded;
+			});
+
+			lock.lock();
+		}
+
+		_input_busy = false;
+		_input_idle.notify_one();
+	}
+
+	void ProcessorImpl::SetReentrant(bool reentrant)
+	{
+		_reentrant = reentrant;
+	}
+
+	bool ProcessorImpl::IsReentrant() const
+	{
+		return _reentrant;
+	}
+
+	void ProcessorImpl::EnableStatistics(bool enable)
+	{
+		if (!enable)
+		{
+			_statistics.reset();
+		}
+		else if (!_statistics)
+		{
+			_statistics.reset(new ProcessorStatistics);
+		}
+	}
+
+	ProcessorStatistics * ProcessorImpl::GetStatistics()
+	{
+		return _statistics.get();
+	}
+
+	void ProcessorImpl::SetStridedInput(bool accept)
+	{
+		_strided_input = accept;
+	}
+
+	bool ProcessorImpl::AcceptsStridedInput() const
+	{
+		return _strided_input;
+	}
+
+	SmartPtr<IData> ProcessorImpl::MakeContiguous(IData * data)
+	{
+		assert(data != nullptr);
+
+		auto strided = dynamic_cast<IStridedData*>(data);
+		if (strided == nullptr || strided->IsContiguous())
+			return YapShared(data);
+
+		// Copy constructor of DataObject gathers the elements of the view.
+		return YapShared<IData>(data->Clone());
+	}
+
+	bool ProcessorImpl::IsWritable(IData * data)
+	{
+		assert(data != nullptr);
+
+		auto writable = dynamic_cast<IWritableData*>(data);
+		return writable != nullptr && writable->IsExclusive();
+	}
+
+	SmartPtr<IData> ProcessorImpl::MakeWritable(IData * data)
+	{
+		assert(data != nullptr);
+
+		if (IsWritable(data))
+			return YapShared(data);
+
+		return YapShared<IData>(data->Clone());
+	}
+
 	
 	IVariableContainer * ProcessorImpl::GetProperties() 
 	{
@@ -175,6 +618,12 @@ namespace _details
 		{
 			_out_property_mapping.insert(make_pair(wstring(property_id), wstring(param_id)));
 		}
+
+		for (auto& binding : _property_bindings)
+		{
+			ResolvePropertyBinding(binding);
+		}
+
 		return true;
 	}
 
@@ -192,9 +641,52 @@ namespace _details
 			}
 		}
 
+		for (auto& binding : _property_bindings)
+		{
+			ResolvePropertyBinding(binding);
+		}
+
 		return true;
 	}
 
+	void Yap::ProcessorImpl::ResolvePropertyBinding(PropertyBinding& binding)
+	{
+		binding.input = YapShared(FindMappedVariable(binding, _in_property_mapping));
+		binding.output = YapShared(FindMappedVariable(binding, _out_property_mapping));
+		binding.typed_input = binding.input ? binding.cast(binding.input.get()) : nullptr;
+		binding.typed_output = binding.output ? binding.cast(binding.output.get()) : nullptr;
+	}
+
+	IVariable * Yap::ProcessorImpl::FindMappedVariable(const PropertyBinding& binding,
+		const std::map<std::wstring, std::wstring>& mapping)
+	{
+		VariableTable * variables = _properties.get();
+		auto id = binding.id.c_str();
+
+		if (_system_variables)
+		{
+			auto link = mapping.find(binding.id);
+			if (link != mapping.end())
+			{
+				variables = _system_variables.get();
+				id = link->second.c_str();
+			}
+		}
+
+		// Elements of arrays may be reallocated, they are always looked up by name.
+		if (wcschr(id, L'[') != nullptr)
+			return nullptr;
+
+		try
+		{
+			return variables->GetVariable(id, binding.type);
+		}
+		catch (VariableException&)
+		{
+			return nullptr;
+		}
+	}
+
 	bool Yap::ProcessorImpl::CanLink(const wchar_t * source_output_name,
 		IProcessor * next,
 		const wchar_t * next_input_name)
@@ -7,16 +7,23 @@
 #include <map>
 #include <string>
 #include <memory>
+#include <vector>
 #include "Utilities/macros.h"
 #include "Implement/DataObject.h"
 #include "Implement/ContainerImpl.h"
 #include "VariableSpace.h"
+#include "ProcessorStatistics.h"
+#include "RetainedData.h"
 #include "Interface/smartptr.h"
 #include <type_traits>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
 
 namespace Yap
 {
 	class VariableSpace;
+	class TaskGroup;
 
 	struct Anchor
 	{
@@ -29,6 +36,13 @@ namespace Yap
 		public IProcessor
 	{
 	public:
+		/// Index of a port in the order the ports were added.
+		typedef unsigned int PortHandle;
+		static const PortHandle InvalidPortHandle = static_cast<PortHandle>(-1);
+
+		/// Index of a property binding, see BindProperty().
+		typedef unsigned int PropertyHandle;
+
 		explicit ProcessorImpl(const wchar_t * class_id);
 		ProcessorImpl(const ProcessorImpl& rhs);
 
@@ -48,6 +62,54 @@ namespace Yap
 		virtual bool Link(const wchar_t * output, IProcessor * next, const wchar_t * next_input) override;
 		virtual void SetModule(ISharedObject * module) override;
 
+		/// Resolve the links of all output ports to the port handles of the linked processors.
+		/**
+			\remarks Called once the pipeline is constructed. Feed() then no longer looks up links
+			by port name, and linked processors derived from ProcessorImpl receive data through
+			InputByHandle(). Link() discards the resolved links of this processor.
+		*/
+		virtual void ResolveLinks();
+
+		PortHandle GetInputHandle(const wchar_t * name) const;
+		PortHandle GetOutputHandle(const wchar_t * name) const;
+
+		/// Copy the links and property mappings of source, normally the processor this one was cloned from.
+		/**
+			\param processors Maps processors linked by source to the processors this one should be
+			linked to instead. Links to processors not in the map are not copied.
+		*/
+		bool CopyLinks(const ProcessorImpl& source, const std::map<IProcessor*, IProcessor*>& processors);
+
+		/// Receive data through the input port with the given handle.
+		/**
+			\remarks The default implementation calls Input() with the name of the port. Override
+			it to avoid comparing port names for every data object.
+		*/
+		virtual bool InputByHandle(PortHandle port, IData * data);
+
+		/// Offer memory inside a block being assembled for data to be fed to the input port.
+		/**
+			\remarks Called by CreateOutputData() of the processor linked to the port before it
+			creates its output. Gathering processors (e.g. ChannelDataCollector) return a
+			contiguous slot of their destination block, the producer writes its result there and
+			Input() finds the data already in place instead of copying it. The default
+			implementation returns null, the producer then allocates the data as usual.
+			\param dimensions Dimensions of the data the producer is going to feed.
+			\param reference Reference data of the producer, may be null.
+		*/
+		virtual SmartPtr<IData> GetInputSlot(PortHandle port, int data_type, IDimensions * dimensions,
+			IData * reference);
+
+		/// Enable or disable timing and throughput statistics of this processor.
+		/**
+			\remarks Should not be called while data is flowing through the processor.
+			Statistics are enabled by default if YAP_PROFILE is set to 1.
+		*/
+		virtual void EnableStatistics(bool enable);
+
+		/// Return the statistics of this processor, or nullptr if statistics are disabled.
+		ProcessorStatistics * GetStatistics();
+
 		template<typename T> 
 		SmartPtr<DataObject<T>> CreateData(IData * reference, T* data, const Dimensions& dimensions, 
 			ISharedObject * parent = nullptr)
@@ -62,12 +124,52 @@ namespace Yap
 			return DataObject<T>::Create(reference, data, dimensions, parent, _module.get());
 		}
 
+		/// Create a view into the memory of parent, see IStridedData.
+		template<typename T>
+		SmartPtr<DataObject<T>> CreateView(IData * reference, T * data, const Dimensions& dimensions,
+			const std::vector<size_t>& strides, ISharedObject * parent)
+		{
+			return DataObject<T>::CreateView(reference, data, dimensions, strides, parent, _module.get());
+		}
+
 		template<typename T>
 		SmartPtr<DataObject<T>> CreateData(IData * reference, IDimensions * dimensions = nullptr)
 		{
 			return DataObject<T>::Create(reference, dimensions, _module.get());
 		}
 
+		/// Create data to be fed to the output port, placed in the slot offered by the consumer if any.
+		/**
+			\remarks Only a port linked to a single processor derived from ProcessorImpl can get a
+			slot, see GetInputSlot(). Otherwise new data is created as by CreateData(). The data
+			keeps the block of the consumer alive and must be fed to the port it was created for.
+		*/
+		template<typename T>
+		SmartPtr<DataObject<T>> CreateOutputData(const wchar_t * out_port, IData * reference,
+			IDimensions * dimensions = nullptr)
+		{
+			return CreateOutputData<T>(GetOutputHandle(out_port), reference, dimensions);
+		}
+
+		/// Same as above, with the handle of the output port.
+		template<typename T>
+		SmartPtr<DataObject<T>> CreateOutputData(PortHandle out_port, IData * reference,
+			IDimensions * dimensions = nullptr)
+		{
+			if (dimensions == nullptr)
+			{
+				assert(reference != nullptr);
+				dimensions = reference->GetDimensions();
+			}
+
+			auto slot = RequestOutputSlot(out_port, data_type_id<T>::type, dimensions, reference);
+			auto slot_array = dynamic_cast<IDataArray<T>*>(slot.get());
+			if (slot_array == nullptr)
+				return CreateData<T>(reference, dimensions);
+
+			return CreateData<T>(reference, slot_array->GetData(), dimensions, slot.get());
+		}
+
 		/**
 		\remarks  Deep copy a data object. The new object will own the copied data
 		even if the rhs does not own its data.
@@ -89,6 +191,52 @@ namespace Yap
 		bool AddOutput(const wchar_t * name, unsigned int dimensions, int data_type);
 
 		bool Feed(const wchar_t * name, IData * data);
+		bool Feed(PortHandle port, IData * data);
+
+		/// Feed data via the output port as an independent task of the task group.
+		/**
+			\remarks Used by fan-out processors (e.g. SliceIterator) to process each emitted
+			data object concurrently. The caller should call TaskGroup::Wait() before returning
+			from Input(). If the execution engine is disabled, data is fed synchronously.
+		*/
+		void FeedAsync(TaskGroup& tasks, const wchar_t * name, IData * data);
+		void FeedAsync(TaskGroup& tasks, PortHandle port, IData * data);
+
+		/// Pass data to the processor, serializing the call if the processor is not reentrant.
+		/**
+			\remarks If the processor is busy on another thread and the caller runs as a task of
+			a TaskGroup, the data is queued and the call returns true at once. The busy thread
+			runs the queued input when it's done, and its result is reported by the group.
+		*/
+		static bool InputTo(IProcessor * processor, const wchar_t * port, IData * data);
+
+		/// Same as above, port_name is only used if port is InvalidPortHandle.
+		static bool InputTo(ProcessorImpl * processor, PortHandle port, const wchar_t * port_name, IData * data);
+
+		/// Declare that Input() of this processor can be called from several threads at once.
+		void SetReentrant(bool reentrant);
+		bool IsReentrant() const;
+
+		/// Declare that Input() of this processor handles non-contiguous views (see IStridedData).
+		/**
+			\remarks Views fed to processors which don't accept them are copied to contiguous
+			memory by Feed(), so by default processors always get contiguous data.
+		*/
+		void SetStridedInput(bool accept);
+		bool AcceptsStridedInput() const;
+
+		/// Return the data itself if it's stored contiguously, otherwise a contiguous copy of it.
+		static SmartPtr<IData> MakeContiguous(IData * data);
+
+		/// Check if Input() may modify the data in place, see IWritableData.
+		/**
+			\remarks In-place processors should write into new data if this returns false,
+			otherwise other consumers of the same output would see the modified data.
+		*/
+		static bool IsWritable(IData * data);
+
+		/// Return the data itself if it can be modified in place, otherwise a copy of it.
+		static SmartPtr<IData> MakeWritable(IData * data);
 
 		template <typename T>
 		bool AddProperty(const wchar_t * property_id, typename variable_type_id<T>::set_type value, const wchar_t * description)
@@ -131,6 +279,64 @@ namespace Yap
 			return _properties->Get<T>(property_id);
 		}
 
+		/// Bind a property so that it can be accessed by handle instead of by name.
+		/**
+			\remarks The variable the property refers to, either the property itself or the
+			global variable it's mapped to, is resolved here and again whenever MapProperty() or
+			SetGlobalVariables() is called. Accessing the property by handle is then a single
+			virtual call. Call this in the constructor after the property is added; handles stay
+			valid in clones of the processor.
+		*/
+		template <typename T>
+		PropertyHandle BindProperty(const wchar_t * property_id)
+		{
+			static_assert(std::is_same<T, int>::value ||
+				std::is_same<T, double>::value ||
+				std::is_same<T, bool>::value ||
+				std::is_same<T, std::wstring>::value,
+				"You can only use one of the following types: int, double, bool, std::wstring");
+
+			PropertyBinding binding;
+			binding.id = property_id;
+			binding.type = variable_type_id<T>::type_id;
+			binding.cast = &CastVariable<T>;
+			ResolvePropertyBinding(binding);
+
+			_property_bindings.push_back(binding);
+			return static_cast<PropertyHandle>(_property_bindings.size() - 1);
+		}
+
+		template <typename T>
+		T GetProperty(PropertyHandle property)
+		{
+			assert(property < _property_bindings.size());
+			auto& binding = _property_bindings[property];
+			assert(binding.type == variable_type_id<T>::type_id);
+
+			// Not resolved, e.g. the variable didn't exist yet. Errors are reported as usual.
+			if (binding.typed_input == nullptr)
+				return GetProperty<T>(binding.id.c_str());
+
+			return static_cast<ISimpleVariable<T>*>(binding.typed_input)->Get();
+		}
+
+		template <typename T>
+		void SetProperty(PropertyHandle property, typename variable_type_id<T>::set_type value)
+		{
+			assert(property < _property_bindings.size());
+			auto& binding = _property_bindings[property];
+			assert(binding.type == variable_type_id<T>::type_id);
+
+			if (binding.typed_output == nullptr)
+			{
+				SetProperty<T>(binding.id.c_str(), value);
+			}
+			else
+			{
+				static_cast<ISimpleVariable<T>*>(binding.typed_output)->Set(value);
+			}
+		}
+
 		template <typename T> 
 		void SetProperty(const wchar_t * property_id, T value)
 		{
@@ -166,9 +372,74 @@ namespace Yap
 
 
 	private:
+		struct PropertyBinding
+		{
+			std::wstring id;
+			int type;
+			void * (*cast)(IVariable * variable);	///< Casts to ISimpleVariable<T>.
+
+			SmartPtr<IVariable> input;		///< Variable read by GetProperty(), null if looked up by name.
+			SmartPtr<IVariable> output;		///< Variable written by SetProperty(), null if looked up by name.
+			void * typed_input;
+			void * typed_output;
+		};
+
+		template <typename T>
+		static void * CastVariable(IVariable * variable)
+		{
+			return dynamic_cast<ISimpleVariable<T>*>(variable);
+		}
+
+		void ResolvePropertyBinding(PropertyBinding& binding);
+		IVariable * FindMappedVariable(const PropertyBinding& binding,
+			const std::map<std::wstring, std::wstring>& mapping);
+
+		std::vector<PropertyBinding> _property_bindings;	///< Indexed by property handle.
+
+		struct ResolvedLink
+		{
+			IProcessor * processor;
+			ProcessorImpl * processor_impl;	///< nullptr if processor is not derived from ProcessorImpl.
+			PortHandle port;
+			std::wstring port_name;
+		};
+
+		/// Call Input() or InputByHandle() of the processor and measure it, serialized by the caller if required.
+		static bool DispatchInput(ProcessorImpl * processor, PortHandle port, const wchar_t * port_name,
+			IData * data);
+		/// Run inputs queued while the processor was busy, then mark it idle.
+		void RunQueuedInputs();
+		bool FeedLink(const ResolvedLink& link, IData * data, bool is_view, bool last_consumer,
+			SmartPtr<IData>& contiguous_data);
+		SmartPtr<IData> RequestOutputSlot(PortHandle out_port, int data_type, IDimensions * dimensions,
+			IData * reference);
+
+		std::vector<std::wstring> _input_names;		///< Indexed by port handle.
+		std::vector<std::wstring> _output_names;
+		std::vector<std::vector<ResolvedLink>> _resolved_links;	///< Indexed by output port handle.
+		bool _links_resolved;
+
 		std::shared_ptr<VariableSpace> _properties;
 		std::shared_ptr<VariableSpace> _system_variables;
 
+		bool _reentrant;
+		bool _strided_input;
+
+		struct QueuedInput
+		{
+			PortHandle port;
+			std::wstring port_name;
+			SmartPtr<IData> data;
+			TaskGroup * group;
+		};
+
+		std::mutex _input_mutex;	///< Guards the members below.
+		std::condition_variable _input_idle;
+		bool _input_busy;
+		std::deque<QueuedInput> _queued_inputs;
+
+		std::unique_ptr<ProcessorStatistics> _statistics;
+
 		ProcessorImpl(const ProcessorImpl&& rhs);
 		const ProcessorImpl& operator = (ProcessorImpl&& rhs);
 		const ProcessorImpl& operator = (const ProcessorImpl& rhs);
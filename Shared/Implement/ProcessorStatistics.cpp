@@ -0,0 +1,262 @@
+#include "ProcessorStatistics.h"
+
+#include "BufferPool.h"
+#include "Interface/Interfaces.h"
+
+#include <cassert>
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <time.h>
+#endif
+
+using namespace std;
+using namespace Yap;
+
+namespace
+{
+	thread_local StatisticsScope * t_current_scope = nullptr;
+
+	unsigned long long GetWallTime()
+	{
+		return static_cast<unsigned long long>(chrono::duration_cast<chrono::nanoseconds>(
+			chrono::steady_clock::now().time_since_epoch()).count());
+	}
+
+	/// CPU time consumed by current thread, in nanoseconds.
+	unsigned long long GetThreadCpuTime()
+	{
+#ifdef _WIN32
+		FILETIME creation_time, exit_time, kernel_time, user_time;
+		if (!GetThreadTimes(GetCurrentThread(), &creation_time, &exit_time, &kernel_time, &user_time))
+			return 0;
+
+		ULARGE_INTEGER kernel, user;
+		kernel.LowPart = kernel_time.dwLowDateTime;
+		kernel.HighPart = kernel_time.dwHighDateTime;
+		user.LowPart = user_time.dwLowDateTime;
+		user.HighPart = user_time.dwHighDateTime;
+
+		// FILETIME is in 100 ns units.
+		return (kernel.QuadPart + user.QuadPart) * 100;
+#else
+		timespec time;
+		if (clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time) != 0)
+			return 0;
+
+		return static_cast<unsigned long long>(time.tv_sec) * 1000000000ULL + time.tv_nsec;
+#endif
+	}
+
+	unsigned int GetHistogramBucket(unsigned long long nanoseconds)
+	{
+		auto microseconds = nanoseconds / 1000;
+		unsigned int bucket = 0;
+		while (microseconds > 1 && bucket < ProcessorStatistics::HistogramBuckets - 1)
+		{
+			microseconds >>= 1;
+			++bucket;
+		}
+
+		return bucket;
+	}
+
+	size_t GetElementSize(int data_type)
+	{
+		switch (data_type)
+		{
+		case DataTypeChar:
+		case DataTypeUnsignedChar:
+		case DataTypeBool:
+			return 1;
+		case DataTypeShort:
+		case DataTypeUnsignedShort:
+			return 2;
+		case DataTypeFloat:
+		case DataTypeInt:
+		case DataTypeUnsignedInt:
+			return 4;
+		case DataTypeDouble:
+		case DataTypeLongLong:
+		case DataTypeUnsignedLongLong:
+		case DataTypeComplexFloat:
+			return 8;
+		case DataTypeComplexDouble:
+			return 16;
+		default:
+			return 0;
+		}
+	}
+}
+
+ProcessorStatistics::ProcessorStatistics()
+{
+	Reset();
+}
+
+void ProcessorStatistics::RecordInput(unsigned long long wall_time,
+	unsigned long long self_time,
+	unsigned long long cpu_time,
+	unsigned long long bytes_in,
+	unsigned long long allocations,
+	unsigned long long allocated_bytes)
+{
+	_calls.fetch_add(1, memory_order_relaxed);
+	_wall_time.fetch_add(wall_time, memory_order_relaxed);
+	_self_time.fetch_add(self_time, memory_order_relaxed);
+	_cpu_time.fetch_add(cpu_time, memory_order_relaxed);
+	_bytes_in.fetch_add(bytes_in, memory_order_relaxed);
+	_allocations.fetch_add(allocations, memory_order_relaxed);
+	_allocated_bytes.fetch_add(allocated_bytes, memory_order_relaxed);
+	_histogram[GetHistogramBucket(self_time)].fetch_add(1, memory_order_relaxed);
+}
+
+void ProcessorStatistics::RecordOutput(unsigned long long bytes_out)
+{
+	_bytes_out.fetch_add(bytes_out, memory_order_relaxed);
+}
+
+ProcessorStatistics::Snapshot ProcessorStatistics::GetSnapshot() const
+{
+	Snapshot snapshot;
+	snapshot.calls = _calls.load(memory_order_relaxed);
+	snapshot.wall_time = _wall_time.load(memory_order_relaxed);
+	snapshot.self_time = _self_time.load(memory_order_relaxed);
+	snapshot.cpu_time = _cpu_time.load(memory_order_relaxed);
+	snapshot.bytes_in = _bytes_in.load(memory_order_relaxed);
+	snapshot.bytes_out = _bytes_out.load(memory_order_relaxed);
+	snapshot.allocations = _allocations.load(memory_order_relaxed);
+	snapshot.allocated_bytes = _allocated_bytes.load(memory_order_relaxed);
+	for (unsigned int i = 0; i < HistogramBuckets; ++i)
+	{
+		snapshot.histogram[i] = _histogram[i].load(memory_order_relaxed);
+	}
+
+	return snapshot;
+}
+
+void ProcessorStatistics::Reset()
+{
+	_calls = 0;
+	_wall_time = 0;
+	_self_time = 0;
+	_cpu_time = 0;
+	_bytes_in = 0;
+	_bytes_out = 0;
+	_allocations = 0;
+	_allocated_bytes = 0;
+	for (auto& bucket : _histogram)
+	{
+		bucket = 0;
+	}
+}
+
+wstring ProcessorStatistics::ToJson(const Snapshot& snapshot)
+{
+	wostringstream output;
+	output << L"{\"calls\": " << snapshot.calls
+		<< L", \"wall_time_ns\": " << snapshot.wall_time
+		<< L", \"self_time_ns\": " << snapshot.self_time
+		<< L", \"cpu_time_ns\": " << snapshot.cpu_time
+		<< L", \"bytes_in\": " << snapshot.bytes_in
+		<< L", \"bytes_out\": " << snapshot.bytes_out
+		<< L", \"allocations\": " << snapshot.allocations
+		<< L", \"allocated_bytes\": " << snapshot.allocated_bytes
+		<< L", \"self_time_histogram_us\": [";
+
+	// Trailing empty buckets are omitted.
+	unsigned int bucket_count = HistogramBuckets;
+	while (bucket_count > 0 && snapshot.histogram[bucket_count - 1] == 0)
+	{
+		--bucket_count;
+	}
+	for (unsigned int i = 0; i < bucket_count; ++i)
+	{
+		output << (i == 0 ? L"" : L", ") << snapshot.histogram[i];
+	}
+	output << L"]}";
+
+	return output.str();
+}
+
+unsigned long long ProcessorStatistics::GetDataBytes(IData * data)
+{
+	if (data == nullptr || data->GetDimensions() == nullptr)
+		return 0;
+
+	auto dimensions = data->GetDimensions();
+	unsigned long long count = 1;
+	for (unsigned int i = 0; i < dimensions->GetDimensionCount(); ++i)
+	{
+		DimensionType type;
+		unsigned int start, length;
+		dimensions->GetDimensionInfo(i, type, start, length);
+		count *= length;
+	}
+
+	return count * GetElementSize(data->GetDataType());
+}
+
+bool ProcessorStatistics::IsEnabledByDefault()
+{
+	static const bool enabled = []() {
+		auto setting = getenv("YAP_PROFILE");
+		return setting != nullptr && atoi(setting) != 0;
+	}();
+
+	return enabled;
+}
+
+StatisticsScope::StatisticsScope(ProcessorStatistics * statistics, IData * data) :
+	_statistics{ statistics },
+	_parent{ t_current_scope },
+	_bytes_in{ ProcessorStatistics::GetDataBytes(data) },
+	_start_wall_time{ GetWallTime() },
+	_start_cpu_time{ GetThreadCpuTime() },
+	_start_allocations{ BufferPool::GetThreadAllocations() },
+	_start_allocated_bytes{ BufferPool::GetThreadAllocatedBytes() },
+	_child_wall_time{ 0 },
+	_child_cpu_time{ 0 },
+	_child_allocations{ 0 },
+	_child_allocated_bytes{ 0 },
+	_blocked_wall_time{ 0 }
+{
+	assert(statistics != nullptr);
+	t_current_scope = this;
+}
+
+StatisticsScope::~StatisticsScope()
+{
+	auto wall_time = GetWallTime() - _start_wall_time;
+	auto cpu_time = GetThreadCpuTime() - _start_cpu_time;
+	auto allocations = BufferPool::GetThreadAllocations() - _start_allocations;
+	auto allocated_bytes = BufferPool::GetThreadAllocatedBytes() - _start_allocated_bytes;
+
+	// Clamp, thread CPU time may have a coarser resolution than wall time.
+	auto self_cpu_time = (cpu_time > _child_cpu_time) ? cpu_time - _child_cpu_time : 0;
+	auto excluded_wall_time = _child_wall_time + _blocked_wall_time;
+	auto self_wall_time = (wall_time > excluded_wall_time) ? wall_time - excluded_wall_time : 0;
+	_statistics->RecordInput(wall_time, self_wall_time, self_cpu_time, _bytes_in,
+		allocations - _child_allocations, allocated_bytes - _child_allocated_bytes);
+
+	t_current_scope = _parent;
+	if (_parent != nullptr)
+	{
+		_parent->_child_wall_time += wall_time;
+		_parent->_child_cpu_time += cpu_time;
+		_parent->_child_allocations += allocations;
+		_parent->_child_allocated_bytes += allocated_bytes;
+	}
+}
+
+void StatisticsScope::ExcludeBlockedTime(unsigned long long wall_time)
+{
+	if (t_current_scope != nullptr)
+	{
+		t_current_scope->_blocked_wall_time += wall_time;
+	}
+}
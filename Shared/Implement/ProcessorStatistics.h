@@ -0,0 +1,108 @@
+#pragma once
+
+#ifndef ProcessorStatistics_h__20171019
+#define ProcessorStatistics_h__20171019
+
+#include <atomic>
+#include <string>
+
+namespace Yap
+{
+	struct IData;
+
+	/**
+	@brief Timing and throughput counters of one processor instance.
+
+	Counters are updated by ProcessorImpl::InputTo() and ProcessorImpl::Feed() when statistics
+	are enabled for the processor, either with ProcessorImpl::EnableStatistics() or for all
+	processors by setting the environment variable YAP_PROFILE to 1.
+
+	Self time excludes the time spent in processors fed by this processor on the same thread and
+	the time blocked in TaskGroup::Wait() for tasks run by other threads, so the processor with
+	the largest self time is the bottleneck of the pipeline.
+	*/
+	class ProcessorStatistics
+	{
+	public:
+		/// Bucket 0 of the histogram counts calls with self time below 2 microseconds, bucket i > 0
+		/// counts calls with self time in [2^i, 2^(i+1)) microseconds.
+		static const unsigned int HistogramBuckets = 32;
+
+		struct Snapshot
+		{
+			unsigned long long calls;
+			unsigned long long wall_time;		///< Total wall time of Input(), in nanoseconds.
+			unsigned long long self_time;		///< Wall time excluding downstream processors.
+			unsigned long long cpu_time;		///< Thread CPU time excluding downstream processors.
+			unsigned long long bytes_in;
+			unsigned long long bytes_out;
+			unsigned long long allocations;		///< Buffers allocated from BufferPool.
+			unsigned long long allocated_bytes;
+			unsigned long long histogram[HistogramBuckets];
+		};
+
+		ProcessorStatistics();
+
+		void RecordInput(unsigned long long wall_time, unsigned long long self_time, unsigned long long cpu_time,
+			unsigned long long bytes_in, unsigned long long allocations, unsigned long long allocated_bytes);
+		void RecordOutput(unsigned long long bytes_out);
+
+		Snapshot GetSnapshot() const;
+		void Reset();
+
+		/// Write the snapshot as a JSON object.
+		static std::wstring ToJson(const Snapshot& snapshot);
+
+		/// Return the size of the data in bytes.
+		static unsigned long long GetDataBytes(IData * data);
+
+		/// Return true if YAP_PROFILE is set to a non-zero value.
+		static bool IsEnabledByDefault();
+
+	protected:
+		std::atomic<unsigned long long> _calls;
+		std::atomic<unsigned long long> _wall_time;
+		std::atomic<unsigned long long> _self_time;
+		std::atomic<unsigned long long> _cpu_time;
+		std::atomic<unsigned long long> _bytes_in;
+		std::atomic<unsigned long long> _bytes_out;
+		std::atomic<unsigned long long> _allocations;
+		std::atomic<unsigned long long> _allocated_bytes;
+		std::atomic<unsigned long long> _histogram[HistogramBuckets];
+	};
+
+	/**
+	@brief Measures one call to Input() of a processor, used by ProcessorImpl::InputTo().
+
+	Measurements nest: the inclusive time of a measurement is subtracted from the self time of
+	the enclosing measurement on the same thread. Nesting is tracked per module, so time spent
+	in processors of another module is counted as self time of the calling processor.
+	*/
+	class StatisticsScope
+	{
+	public:
+		StatisticsScope(ProcessorStatistics * statistics, IData * data);
+		~StatisticsScope();
+
+		/// Exclude wall time the calling thread spent blocked from the self time of the current measurement.
+		static void ExcludeBlockedTime(unsigned long long wall_time);
+
+	protected:
+		ProcessorStatistics * _statistics;
+		StatisticsScope * _parent;
+
+		unsigned long long _bytes_in;
+		unsigned long long _start_wall_time;
+		unsigned long long _start_cpu_time;
+		unsigned long long _start_allocations;
+		unsigned long long _start_allocated_bytes;
+
+		unsigned long long _child_wall_time;
+		unsigned long long _child_cpu_time;
+		unsigned long long _child_allocations;
+		unsigned long long _child_allocated_bytes;
+		unsigned long long _blocked_wall_time;
+	};
+}
+
+#endif // ProcessorStatistics_h__
@@ -0,0 +1,96 @@
+#pragma once
+
+#ifndef RetainedData_h__20171026
+#define RetainedData_h__20171026
+
+#include "Interface/Interfaces.h"
+
+#include <cassert>
+
+namespace Yap
+{
+	/**
+	@brief Reference to data which a processor keeps after Input() returns.
+
+	Exclusivity of data (see IWritableData) only counts the consumers sharing it, not the
+	references to it. A processor which keeps data to read it later therefore marks it shared
+	for as long as it keeps it, otherwise a consumer fed afterwards could modify it in place.
+	*/
+	class RetainedData
+	{
+	public:
+		RetainedData() {}
+
+		explicit RetainedData(IData * data) :
+			_data(YapShared(data))
+		{
+			Share(_data.get());
+		}
+
+		RetainedData(const RetainedData& rhs) :
+			_data(rhs._data)
+		{
+			Share(_data.get());
+		}
+
+		~RetainedData()
+		{
+			Unshare(_data.get());
+		}
+
+		const RetainedData& operator = (const RetainedData& rhs)
+		{
+			auto data = rhs._data;
+			Share(data.get());
+			Unshare(_data.get());
+			_data = data;
+
+			return *this;
+		}
+
+		void reset()
+		{
+			Unshare(_data.get());
+			_data.reset();
+		}
+
+		IData * get() const
+		{
+			return const_cast<IData*>(_data.get());
+		}
+
+		IData * operator -> () const
+		{
+			assert(_data);
+			return get();
+		}
+
+		explicit operator bool() const
+		{
+			return _data;
+		}
+
+	private:
+		static void Share(IData * data)
+		{
+			auto writable = dynamic_cast<IWritableData*>(data);
+			if (writable != nullptr)
+			{
+				writable->Share();
+			}
+		}
+
+		static void Unshare(IData * data)
+		{
+			auto writable = dynamic_cast<IWritableData*>(data);
+			if (writable != nullptr)
+			{
+				writable->Unshare();
+			}
+		}
+
+		SmartPtr<IData> _data;
+	};
+}
+
+#endif // RetainedData_h__
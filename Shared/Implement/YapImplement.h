@@ -4,16 +4,27 @@
 #define YapImplement_h_20160831
 
 #include "ContainerImpl.h"
+#include "ExecutionEngine.h"
 
-#define BEGIN_DECL_PROCESSORS PtrContainerImpl<IProcessor> * g_processor_manager;\
+#define BEGIN_DECL_PROCESSORS BEGIN_DECL_PROCESSORS_WITH_RELEASE(nullptr)
+
+// release is a void() function of the module run by ReleaseProcessorManager() after the
+// execution engine is stopped, outside the loader lock, e.g. to write caches to disk.
+#define BEGIN_DECL_PROCESSORS_WITH_RELEASE(release) PtrContainerImpl<IProcessor> * g_processor_manager;\
 	extern "C" {\
-	__declspec(dllexport) void ReleaseProcessManager(){\
+	__declspec(dllexport) void ReleaseProcessorManager(){\
+		Yap::ExecutionEngine::Shutdown();\
+		void (*release_module)() = release;\
+		if (release_module) release_module();\
 		if (g_processor_manager) {\
 			ISharedObject* obj = g_processor_manager;\
 			obj->Release();\
 			g_processor_manager = nullptr;\
 		}\
 	}\
+	__declspec(dllexport) Yap::IExecutionEngineUser * GetExecutionEngineUser(){\
+		return &Yap::ExecutionEngine::GetUser();\
+	}\
 	__declspec(dllexport) IProcessorContainer * GetProcessorManager()\
 	{\
 		if (g_processor_manager)\
@@ -154,6 +154,44 @@ namespace Yap
 		virtual T * GetData() = 0;
 	};
 
+	/**
+	@brief Optional interface of data objects which are views into the memory of other data.
+
+	GetData() of such an object returns the address of its first element, and the elements
+	are located using the strides of the dimensions. Data objects not implementing this
+	interface are always stored contiguously, with the first dimension varying fastest.
+	*/
+	struct IStridedData
+	{
+		/// Get the distance, in elements, between two adjacent elements along the dimension.
+		virtual size_t GetStride(unsigned int dimension_index) = 0;
+
+		/// Check if the elements are stored contiguously, as in an ordinary data object.
+		virtual bool IsContiguous() = 0;
+	};
+
+	/**
+	@brief Optional interface of data objects which know if they can be modified in place.
+
+	Processors such as Fft2D write their result into the input data and feed it on. This is
+	only safe if no other processor will read the data afterwards. ProcessorImpl::Feed() calls
+	Share() before it feeds data to a processor which is not the last consumer of the output
+	port, and Unshare() after the processor returns.
+
+	Exclusivity depends on these consumers only, references held by the pipeline itself (e.g.
+	by an iterator feeding views of its input, or by a pending task) don't count. A processor
+	which keeps data after Input() returns must Share() it as long as it keeps it, see
+	RetainedData. Views of the same parent fed one after another must not overlap.
+	*/
+	struct IWritableData
+	{
+		virtual void Share() = 0;
+		virtual void Unshare() = 0;
+
+		/// Check if neither the data nor the data it is a view of is shared with other consumers.
+		virtual bool IsExclusive() = 0;
+	};
+
 };
 
 #endif // IDATA_H_20170626
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+#ifndef IExecutionEngine_h__
+#define IExecutionEngine_h__
+
+namespace Yap
+{
+	/// Work queued to an IExecutionEngine.
+	struct ITask
+	{
+		/// Run the task, return false if it failed. Must not throw.
+		virtual bool Run() = 0;
+
+		/// Called once after Run() with its result, the task may delete itself.
+		virtual void Complete(bool succeeded) = 0;
+
+		/// Tasks of a group are waited for together, see IExecutionEngine::RunLocal().
+		virtual const void * GetGroup() const = 0;
+	};
+
+	/// Thread pool of the host, shared with all modules it loads.
+	struct IExecutionEngine
+	{
+		/// Return true if tasks are dispatched to worker threads.
+		virtual bool IsEnabled() const = 0;
+
+		/// Return true if the calling thread is one of the workers.
+		virtual bool IsWorkerThread() const = 0;
+
+		virtual unsigned int GetThreadCount() const = 0;
+
+		/// Queue the task, Run() and Complete() of it are called by a worker.
+		virtual void Submit(ITask * task) = 0;
+
+		/// Run the task queued last by the calling worker if it belongs to the group.
+		/**
+			\return false if there is no such task.
+		*/
+		virtual bool RunLocal(const void * group) = 0;
+	};
+
+	struct IExecutionEngineUser
+	{
+		virtual void SetExecutionEngine(IExecutionEngine * engine) = 0;
+	};
+}
+
+#endif // IExecutionEngine_h__
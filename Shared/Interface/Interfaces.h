@@ -6,6 +6,7 @@
 #include "smartptr.h"
 #include "IProcessor.h"
 #include "ILog.h"
+#include "IExecutionEngine.h"
 #include "IPythonUser.h"
 #include "IPython.h"
 
@@ -3,6 +3,7 @@
 #ifndef yapMemory_h__20160817
 #define yapMemory_h__20160817
 
+#include <atomic>
 #include <cassert>
 #include <memory>
 
@@ -66,6 +67,65 @@ namespace Yap {
 
 	};
 
+	/**
+	Thread-safe reference count used to implement ISharedObject::Lock() and Release().
+
+	Lock() only needs atomicity. Release() uses release ordering on the decrement and an
+	acquire fence before the object is deleted, so that all writes made through other
+	references are visible to the thread which deletes the object.
+
+	Copying a ReferenceCount yields a zero count: a cloned object is a new object and is not
+	referenced by the users of the source object.
+	*/
+	class ReferenceCount
+	{
+	public:
+		ReferenceCount() : _count{ 0 } {}
+		ReferenceCount(const ReferenceCount&) : _count{ 0 } {}
+		const ReferenceCount& operator = (const ReferenceCount&) { return *this; }
+
+		void Increment()
+		{
+			_count.fetch_add(1, std::memory_order_relaxed);
+		}
+
+		/// Decrease the count. Return true if the object should be deleted.
+		/**
+			\remarks An object which has never been locked is deleted on the first Release().
+		*/
+		bool Decrement()
+		{
+			if (_count.load(std::memory_order_relaxed) == 0)
+				return true;
+
+			if (_count.fetch_sub(1, std::memory_order_release) == 1)
+			{
+				std::atomic_thread_fence(std::memory_order_acquire);
+				return true;
+			}
+
+			return false;
+		}
+
+		unsigned int Get() const
+		{
+			return _count.load(std::memory_order_relaxed);
+		}
+
+		/// Check if the object is referenced at most once.
+		/**
+			\remarks Acquire ordering makes accesses through released references visible, so
+			the only owner may modify the object after the check.
+		*/
+		bool IsUnique() const
+		{
+			return _count.load(std::memory_order_acquire) <= 1;
+		}
+
+	private:
+		std::atomic<unsigned int> _count;
+	};
+
 /**
 	SmartPtr is used to wrap ISharedObject object. It's similar to std::smart_ptr, however, it 
 	calles ISharedObject::Lock() to add reference, and calles ISharedObject::Release() when SmartPtr
@@ -78,6 +138,10 @@ namespace Yap {
 
 	@remarks TYPE class should implement ISharedObject or the pointer should pointer to an object of 
 	a class derived from both ISharedObject and TYPE. 
+
+	@remarks Different SmartPtr instances pointing to the same object can be copied and destroyed
+	in different threads concurrently. Like std::shared_ptr, a single SmartPtr instance must not
+	be modified by one thread while being accessed by another.
 */
 template <typename TYPE>
 class SmartPtr
@@ -123,7 +187,8 @@ public:
 		if (source.get() == nullptr)
 			return;
 
-		assert(dynamic_cast<TYPE*>(source.get()) != nullptr &&
+		_pointer = dynamic_cast<TYPE*>(const_cast<SOURCE_TYPE*>(source.get()));
+		assert(_pointer != nullptr &&
 			"SOURCE_TYPE should be same as the TYPE, or can be convert to TYPE.");
 
 		auto shared_object = dynamic_cast<ISharedObject*>(_pointer);
@@ -324,12 +389,12 @@ virtual my_interface * Clone() const override {\
 
 #define IMPLEMENT_LOCK_RELEASE private:\
 virtual void Release() override{\
-		if (_use_count == 0 || --_use_count == 0) \
+		if (_use_count.Decrement()) \
 		{ delete this; } \
 }\
 virtual void Lock() override{\
-	++_use_count;}\
-unsigned int _use_count = 0;
+	_use_count.Increment();}\
+Yap::ReferenceCount _use_count;
 
 #define IMPLEMENT_SHARED(my_class) IMPLEMENT_LOCK_RELEASE \
 IMPLEMENT_CLONE(my_class)